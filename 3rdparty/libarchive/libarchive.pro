@@ -42,10 +42,15 @@ INCLUDEPATH *= $$PWD/libarchive
 
 include(../libz.pri)
 
-# disabled for now, since we have 2 problems:
-#  1) the python/django appstore is based on python 2.7 which does not support it via tarfile
-#  2) we get a weird error on MacOSX when creating XZ'ed packages from libarchive
-# include(../liblzma.pri)
+# XZ support is optional: packages are still gzip compressed by default, so the python 2.7 based
+# appstore (no XZ support in tarfile) is only affected when XZ packages are explicitly requested.
+# It is only enabled on Linux, since we get a weird error on MacOSX when creating XZ'ed packages.
+# The top-level project makes sure that liblzma is available, unless disable-xz is set.
+linux:!android:!disable-xz {
+    CONFIG *= link_pkgconfig
+    include(../liblzma.pri)
+    DEFINES += HAVE_LZMA_H=1 HAVE_LIBLZMA=1
+}
 
 SOURCES += \
     libarchive/archive_acl.c \
@@ -38,6 +38,17 @@ load(am-config)
 !config_libarchive|no-system-libarchive {
     force-system-libarchive:error("Could not find a system installation for libarchive.")
     else:SUBDIRS += 3rdparty/libarchive/libarchive.pro
+
+    # XZ support is not auto-detected, so the feature set does not depend on the build host
+    linux:!android:!disable-xz {
+        !packagesExist(liblzma):error("XZ support needs liblzma: use CONFIG+=disable-xz to build without it.")
+        check_xz = "yes"
+    } else {
+        check_xz = "no"
+        linux:!android:warning("XZ support is disabled: XZ compressed packages can neither be created nor installed.")
+    }
+} else {
+    check_xz = "auto (system libarchive)"
 }
 
 linux:!android:!disable-libbacktrace:if(enable-libbacktrace|CONFIG(debug, debug|release))  {
@@ -97,6 +108,7 @@ printConfigLine("libbacktrace support", $$check_libbacktrace, auto)
 printConfigLine("Systemd workaround", $$yesNo(CONFIG(systemd-workaround)), auto)
 printConfigLine("System libarchive", $$yesNo(config_libarchive:!no-system-libarchive), auto)
 printConfigLine("System libyaml", $$yesNo(config_libyaml:!no-system-libyaml), auto)
+printConfigLine("XZ support", $$check_xz, auto)
 printConfigLine()
 
 OTHER_FILES += \
@@ -14,12 +14,14 @@ HEADERS += \
     application.h \
     applicationscanner.h \
     yamlapplicationscanner.h \
+    applicationmanifestcache.h \
     installationreport.h \
     applicationinterface.h \
 
 SOURCES += \
     application.cpp \
     yamlapplicationscanner.cpp \
+    applicationmanifestcache.cpp \
     installationreport.cpp \
     applicationinterface.cpp \
 
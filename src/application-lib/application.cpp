@@ -42,6 +42,7 @@
 #include <QDebug>
 #include <QDataStream>
 #include <QBuffer>
+#include <QThread>
 
 #include "application.h"
 #include "exception.h"
@@ -235,13 +236,17 @@
 QT_BEGIN_NAMESPACE_AM
 
 //TODO Make this really unique
-static int uniqueCounter = 0;
+// atomic, since applications are created in parallel while scanning the manifests
+static QAtomicInt uniqueCounter = 0;
 static int nextUniqueNumber() {
-    uniqueCounter++;
-    if (uniqueCounter > 999)
-        uniqueCounter = 0;
+    int current;
+    int next;
+    do {
+        current = uniqueCounter.load();
+        next = (current >= 999) ? 0 : current + 1;
+    } while (!uniqueCounter.testAndSetOrdered(current, next));
 
-    return uniqueCounter;
+    return next;
 }
 
 Application::Application()
@@ -285,7 +290,7 @@ QVariantMap Application::toVariantMap() const
     map[qSL("codeDir")] = m_codeDir.absolutePath();
     map[qSL("manifestDir")] = m_manifestDir.absolutePath();
     map[qSL("environmentVariables")] = m_environmentVariables;
-    map[qSL("installationLocationId")] = m_installationReport ? m_installationReport->installationLocationId() : QString();
+    map[qSL("installationLocationId")] = installationLocationId();
     map[qSL("applicationProperties")] = m_allAppProperties;
     map[qSL("supportsApplicationInterface")] = m_supportsApplicationInterface;
 
@@ -548,14 +553,54 @@ void Application::mergeInto(Application *app) const
     emit app->bulkChange();
 }
 
+namespace {
+enum InstallationReportState {
+    ReportDecoded = 0,  // m_installationReport is valid (but may be a nullptr)
+    ReportSerialized,   // m_installationReport still needs to be decoded
+    ReportDecoding      // another thread is currently decoding m_installationReport
+};
+}
+
+// installationReport() is const, but may be called from the installer thread: the report is
+// decoded exactly once, by whichever thread gets to it first. The setters are only ever called
+// from the main thread while no task is accessing the report.
 const InstallationReport *Application::installationReport() const
 {
+    if (m_installationReportState.loadAcquire() != ReportDecoded) {
+        if (m_installationReportState.testAndSetAcquire(ReportSerialized, ReportDecoding)) {
+            QByteArray data = m_serializedInstallationReport;
+            QBuffer buffer(&data);
+            buffer.open(QBuffer::ReadOnly);
+            m_installationReport.reset(new InstallationReport(m_id));
+            if (!m_installationReport->deserialize(&buffer))
+                m_installationReport.reset();
+            m_installationReportState.storeRelease(ReportDecoded);
+        } else {
+            while (m_installationReportState.loadAcquire() != ReportDecoded)
+                QThread::yieldCurrentThread();
+        }
+    }
     return m_installationReport.data();
 }
 
 void Application::setInstallationReport(InstallationReport *report)
 {
+    m_serializedInstallationReport.clear();
+    m_serializedInstallationReportStorage.reset();
     m_installationReport.reset(report);
+    m_installationLocationId = report ? report->installationLocationId() : QString();
+    m_installationReportState.storeRelease(ReportDecoded);
+}
+
+// Both functions below can be used without decoding the report
+bool Application::hasInstallationReport() const
+{
+    return !m_serializedInstallationReport.isEmpty() || m_installationReport;
+}
+
+QString Application::installationLocationId() const
+{
+    return m_installationLocationId;
 }
 
 QString Application::manifestDir() const
@@ -674,9 +719,10 @@ Application *Application::readFromDataStream(QDataStream &ds, const QVector<cons
        >> manifestDir
        >> app->m_uid
        >> app->m_environmentVariables
+       >> app->m_installationLocationId
        >> installationReport;
 
-    uniqueCounter = qMax(uniqueCounter, app->m_uniqueNumber);
+    uniqueCounter.store(qMax(uniqueCounter.load(), app->m_uniqueNumber));
 
     app->m_capabilities.sort();
     app->m_categories.sort();
@@ -685,13 +731,7 @@ Application *Application::readFromDataStream(QDataStream &ds, const QVector<cons
     app->m_backgroundMode = static_cast<Application::BackgroundMode>(backgroundMode);
     app->m_codeDir.setPath(codeDir);
     app->m_manifestDir.setPath(manifestDir);
-    if (!installationReport.isEmpty()) {
-        QBuffer buffer(&installationReport);
-        buffer.open(QBuffer::ReadOnly);
-        app->m_installationReport.reset(new InstallationReport(app->m_id));
-        if (!app->m_installationReport->deserialize(&buffer))
-            app->m_installationReport.reset();
-    }
+    app->setSerializedInstallationReport(installationReport, QSharedPointer<QObject>());
 
     if (isAlias) {
         QString baseId = app->m_id.section(qL1C('@'), 0, 0);
@@ -710,15 +750,12 @@ Application *Application::readFromDataStream(QDataStream &ds, const QVector<cons
     return app.take();
 }
 
-void Application::writeToDataStream(QDataStream &ds, const QVector<const Application *> &applicationDatabase) const Q_DECL_NOEXCEPT_EXPR(false)
+void Application::writeToDataStream(QDataStream &ds, const QVector<const Application *> &applicationDatabase,
+                                    bool withInstallationReport) const Q_DECL_NOEXCEPT_EXPR(false)
 {
     QByteArray serializedReport;
-
-    if (auto report = installationReport()) {
-        QBuffer buffer(&serializedReport);
-        buffer.open(QBuffer::WriteOnly);
-        report->serialize(&buffer);
-    }
+    if (withInstallationReport)
+        serializedReport = serializedInstallationReport();
 
     ds << m_id
        << m_uniqueNumber
@@ -744,9 +781,40 @@ void Application::writeToDataStream(QDataStream &ds, const QVector<const Applica
        << m_manifestDir.absolutePath()
        << m_uid
        << m_environmentVariables
+       << m_installationLocationId
        << serializedReport;
 }
 
+void Application::renewUniqueNumber()
+{
+    m_uniqueNumber = nextUniqueNumber();
+}
+
+QByteArray Application::serializedInstallationReport() const
+{
+    // the serialized data is kept after decoding, so it can be passed on without a round-trip
+    if (!m_serializedInstallationReport.isEmpty())
+        return m_serializedInstallationReport;
+
+    QByteArray serializedReport;
+    if (m_installationReport) {
+        QBuffer buffer(&serializedReport);
+        buffer.open(QBuffer::WriteOnly);
+        m_installationReport->serialize(&buffer);
+    }
+    return serializedReport;
+}
+
+// The report will be deserialized on first access. The data may reference memory owned by
+// storage (e.g. a memory-mapped database file), which is kept alive as long as the data is.
+void Application::setSerializedInstallationReport(const QByteArray &data, const QSharedPointer<QObject> &storage)
+{
+    m_installationReport.reset();
+    m_serializedInstallationReport = data;
+    m_serializedInstallationReportStorage = storage;
+    m_installationReportState.storeRelease(data.isEmpty() ? ReportDecoded : ReportSerialized);
+}
+
 QT_END_NAMESPACE_AM
 
 QDebug operator<<(QDebug debug, const QT_PREPEND_NAMESPACE_AM(Application) *app)
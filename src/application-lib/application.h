@@ -48,6 +48,7 @@
 #include <QStringList>
 #include <QDir>
 #include <QObject>
+#include <QSharedPointer>
 
 #include <QtAppManCommon/global.h>
 #include <QtAppManApplication/installationreport.h>
@@ -90,6 +91,10 @@ public:
     enum ExitStatus { NormalExit, CrashExit, ForcedExit };
     Q_ENUM(ExitStatus)
 
+    // needs to be incremented on every change to readFromDataStream()/writeToDataStream(), since
+    // their output is persisted in the application database and the manifest cache
+    enum { DataStreamVersion = 2 };
+
     QString id() const;
     int uniqueNumber() const;
     QString absoluteCodeFilePath() const;
@@ -205,7 +210,12 @@ private:
     QString m_version;
 
     // added by installer
-    QScopedPointer<InstallationReport> m_installationReport;
+    mutable QScopedPointer<InstallationReport> m_installationReport;
+    // the serialized report is only deserialized on first access (see installationReport())
+    QByteArray m_serializedInstallationReport;
+    QSharedPointer<QObject> m_serializedInstallationReportStorage;
+    mutable QAtomicInt m_installationReportState;
+    QString m_installationLocationId; // copied from the report, so it can be used without decoding
     QDir m_manifestDir;
     QDir m_codeDir;
     uint m_uid = uint(-1); // unix user id - move to installationReport
@@ -224,10 +234,19 @@ private:
     friend class YamlApplicationScanner;
     friend class ApplicationManager; // needed to update installation status
     friend class ApplicationDatabase; // needed to create Application objects
+    friend class ApplicationDatabasePrivate;
+    friend class ApplicationManifestCache; // needed to (de)serialize cached manifests
     friend class InstallationTask; // needed to set m_uid and m_builtin during the installation
+    friend class ApplicationInstaller; // needed to assign a free m_uid when starting an installation
 
     static Application *readFromDataStream(QDataStream &ds, const QVector<const Application *> &applicationDatabase) Q_DECL_NOEXCEPT_EXPR(false);
-    void writeToDataStream(QDataStream &ds, const QVector<const Application *> &applicationDatabase) const Q_DECL_NOEXCEPT_EXPR(false);
+    void writeToDataStream(QDataStream &ds, const QVector<const Application *> &applicationDatabase,
+                           bool withInstallationReport = true) const Q_DECL_NOEXCEPT_EXPR(false);
+    bool hasInstallationReport() const;
+    QString installationLocationId() const;
+    QByteArray serializedInstallationReport() const;
+    void renewUniqueNumber(); // for objects that are re-created from a cache
+    void setSerializedInstallationReport(const QByteArray &data, const QSharedPointer<QObject> &storage);
 
     Q_DISABLE_COPY(Application)
 };
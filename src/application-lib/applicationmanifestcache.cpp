@@ -0,0 +1,328 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QHash>
+#include <QMutex>
+#include <QScopedPointer>
+
+#if defined(Q_OS_LINUX)
+#  include <sys/stat.h>
+#endif
+
+#include "global.h"
+#include "logging.h"
+#include "exception.h"
+#include "application.h"
+#include "applicationmanifestcache.h"
+
+/*
+ * The cache maps the absolute path of an info.yaml manifest to the QDataStream serialized
+ * Application object that the YamlApplicationScanner created from it. An entry is valid, if
+ * the file's inode, modification time and size are unchanged. If any of those did change
+ * (e.g. a firmware update re-created all files), the SHA1 of the file content is compared
+ * before deciding to re-parse the manifest.
+ *
+ * Entries that were not looked up or inserted since the last load() are dropped on save(),
+ * so the cache does not grow when applications are removed.
+ *
+ * The records are only valid for the Application::DataStreamVersion they were written with: the
+ * whole cache is discarded, if that version does not match.
+ */
+
+QT_BEGIN_NAMESPACE_AM
+
+namespace {
+
+static const quint32 CacheMagic = 0x414d4d43; // 'AMMC'
+enum { CacheVersion = 2 };
+
+struct CacheEntry
+{
+    quint64 inode = 0;
+    qint64 mtime = 0;     // opaque, platform specific time-stamp
+    qint64 size = -1;
+    QByteArray checksum;  // sha1 (fast and sufficient for this use-case)
+    QByteArray record;    // the serialized Application
+    bool used = false;
+};
+
+static bool stampFile(const QString &filePath, CacheEntry &entry)
+{
+#if defined(Q_OS_LINUX)
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0)
+        return false;
+    entry.inode = quint64(st.st_ino);
+    entry.mtime = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    entry.size = qint64(st.st_size);
+#else
+    QFileInfo fi(filePath);
+    if (!fi.isFile())
+        return false;
+    entry.inode = 0;
+    entry.mtime = fi.lastModified().toMSecsSinceEpoch();
+    entry.size = fi.size();
+#endif
+    return true;
+}
+
+static bool sameStamp(const CacheEntry &e1, const CacheEntry &e2)
+{
+    return (e1.inode == e2.inode) && (e1.mtime == e2.mtime) && (e1.size == e2.size);
+}
+
+} // anonymous namespace
+
+class ApplicationManifestCachePrivate
+{
+public:
+    QString fileName;
+    QMutex mutex;
+    QHash<QString, CacheEntry> entries;
+    bool modified = false;
+    QAtomicInt hits;
+    QAtomicInt misses;
+};
+
+ApplicationManifestCache::ApplicationManifestCache(const QString &fileName)
+    : d(new ApplicationManifestCachePrivate())
+{
+    d->fileName = fileName;
+}
+
+ApplicationManifestCache::~ApplicationManifestCache()
+{
+    delete d;
+}
+
+QString ApplicationManifestCache::fileName() const
+{
+    return d->fileName;
+}
+
+bool ApplicationManifestCache::load()
+{
+    QFile f(d->fileName);
+    if (!f.open(QFile::ReadOnly))
+        return false;
+
+    try {
+        QDataStream ds(&f);
+        quint32 magic = 0;
+        quint32 version = 0;
+        quint32 applicationVersion = 0;
+        qint32 dataStreamVersion = 0;
+        quint32 count = 0;
+
+        ds >> magic >> version >> applicationVersion >> dataStreamVersion >> count;
+
+        if ((ds.status() != QDataStream::Ok) || (magic != CacheMagic) || (version != CacheVersion))
+            throw Exception("not a valid manifest cache file");
+        if (applicationVersion != Application::DataStreamVersion)
+            throw Exception("the cache was created by a different application-manager version");
+        if (dataStreamVersion != ds.version())
+            throw Exception("the cache was created by a different Qt version");
+
+        QHash<QString, CacheEntry> entries;
+        entries.reserve(int(count));
+        for (quint32 i = 0; i < count; ++i) {
+            QString filePath;
+            CacheEntry entry;
+            ds >> filePath >> entry.inode >> entry.mtime >> entry.size >> entry.checksum >> entry.record;
+            entries.insert(filePath, entry);
+        }
+        if (ds.status() != QDataStream::Ok)
+            throw Exception("failed to read the cache content");
+
+        QMutexLocker locker(&d->mutex);
+        d->entries = entries;
+        d->modified = false;
+        return true;
+
+    } catch (const Exception &e) {
+        qCWarning(LogSystem) << "Failed to read manifest cache" << d->fileName << ":" << e.errorString();
+        clear();
+        return false;
+    }
+}
+
+bool ApplicationManifestCache::save()
+{
+    QMutexLocker locker(&d->mutex);
+
+    int usedCount = 0;
+    for (const CacheEntry &entry : qAsConst(d->entries)) {
+        if (entry.used)
+            ++usedCount;
+    }
+    if (!d->modified && (usedCount == d->entries.size()))
+        return true;
+
+    try {
+        QSaveFile f(d->fileName);
+        if (!f.open(QFile::WriteOnly))
+            throw Exception("failed to open file for writing: %1").arg(f.errorString());
+
+        QDataStream ds(&f);
+        ds << CacheMagic << quint32(CacheVersion) << quint32(Application::DataStreamVersion)
+           << qint32(ds.version()) << quint32(usedCount);
+
+        for (auto it = d->entries.cbegin(); it != d->entries.cend(); ++it) {
+            const CacheEntry &entry = it.value();
+            if (entry.used)
+                ds << it.key() << entry.inode << entry.mtime << entry.size << entry.checksum << entry.record;
+        }
+        if ((ds.status() != QDataStream::Ok) || !f.commit())
+            throw Exception("error writing the cache content: %1").arg(f.errorString());
+
+        d->modified = false;
+        return true;
+
+    } catch (const Exception &e) {
+        qCWarning(LogSystem) << "Failed to write manifest cache" << d->fileName << ":" << e.errorString();
+        return false;
+    }
+}
+
+void ApplicationManifestCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->modified = !d->entries.isEmpty();
+    d->entries.clear();
+}
+
+Application *ApplicationManifestCache::lookup(const QString &manifestFilePath, const Application *nonAliased)
+{
+    CacheEntry stamp;
+    QByteArray record;
+
+    if (stampFile(manifestFilePath, stamp)) {
+        QMutexLocker locker(&d->mutex);
+        auto it = d->entries.find(manifestFilePath);
+
+        if ((it != d->entries.end()) && !sameStamp(*it, stamp)) {
+            // the file was touched, but it only needs to be parsed again if the content changed
+            const QByteArray cachedChecksum = it->checksum;
+            locker.unlock();
+
+            QFile f(manifestFilePath);
+            bool unchanged = f.open(QFile::ReadOnly)
+                    && (QCryptographicHash::hash(f.readAll(), QCryptographicHash::Sha1) == cachedChecksum);
+
+            locker.relock();
+            it = d->entries.find(manifestFilePath);
+            if (unchanged && (it != d->entries.end()) && (it->checksum == cachedChecksum)) {
+                it->inode = stamp.inode;
+                it->mtime = stamp.mtime;
+                it->size = stamp.size;
+                d->modified = true;
+            } else {
+                it = d->entries.end();
+            }
+        }
+        if (it != d->entries.end()) {
+            it->used = true;
+            record = it->record;
+        }
+    }
+
+    if (!record.isEmpty()) {
+        try {
+            QDataStream ds(record);
+            QVector<const Application *> baseApplication;
+            if (nonAliased)
+                baseApplication << nonAliased;
+
+            QScopedPointer<Application> app(Application::readFromDataStream(ds, baseApplication));
+            if ((ds.status() == QDataStream::Ok) && (app->isAlias() == bool(nonAliased))) {
+                app->renewUniqueNumber();
+                d->hits.ref();
+                return app.take();
+            }
+        } catch (const Exception &) {
+        }
+    }
+    d->misses.ref();
+    return nullptr;
+}
+
+void ApplicationManifestCache::insert(const QString &manifestFilePath, const QByteArray &manifestContent,
+                                      const Application *app)
+{
+    CacheEntry entry;
+    if (!app || !stampFile(manifestFilePath, entry))
+        return;
+
+    entry.checksum = QCryptographicHash::hash(manifestContent, QCryptographicHash::Sha1);
+    entry.used = true;
+
+    QVector<const Application *> baseApplication;
+    if (app->m_nonAliased)
+        baseApplication << app->m_nonAliased;
+
+    QDataStream ds(&entry.record, QIODevice::WriteOnly);
+    app->writeToDataStream(ds, baseApplication, false);
+    if (ds.status() != QDataStream::Ok)
+        return;
+
+    QMutexLocker locker(&d->mutex);
+    d->entries.insert(manifestFilePath, entry);
+    d->modified = true;
+}
+
+int ApplicationManifestCache::hits() const
+{
+    return d->hits.load();
+}
+
+int ApplicationManifestCache::misses() const
+{
+    return d->misses.load();
+}
+
+QT_END_NAMESPACE_AM
@@ -52,6 +52,7 @@
 #include "exception.h"
 #include "application.h"
 #include "yamlapplicationscanner.h"
+#include "applicationmanifestcache.h"
 #include "utilities.h"
 
 QT_BEGIN_NAMESPACE_AM
@@ -77,19 +78,35 @@ Application *YamlApplicationScanner::scanInternal(const QString &filePath, bool
         if (scanAlias && !application)
             throw Exception("cannot scan an alias without a valid base application");
 
+        if (m_cache) {
+            if (Application *cachedApp = m_cache->lookup(filePath, scanAlias ? application : nullptr))
+                return cachedApp;
+        }
+
         QFile f(filePath);
         if (!f.open(QIODevice::ReadOnly))
             throw Exception(f, "could not open file for reading");
+        const QByteArray content = f.readAll();
 
-        QtYaml::ParseError parseError;
-        QVector<QVariant> docs = QtYaml::variantDocumentsFromYaml(f.readAll(), &parseError);
+        // The manifest document is parsed field by field straight from the YAML event stream,
+        // without creating an intermediate QVariantMap for it.
+        QtYaml::YamlParser yp(content);
+        QVector<QVariant> docs;
+        bool hasManifestDocument = false;
 
-        if (parseError.error != QJsonParseError::NoError) {
+        try {
+            if (yp.nextDocument()) {
+                docs << yp.parseValue();
+                hasManifestDocument = yp.nextDocument();
+            }
+        } catch (const QtYaml::ParseError &parseError) {
             throw Exception(Error::IO, "YAML parse error at line %1, column %2: %3")
                     .arg(parseError.line).arg(parseError.column).arg(parseError.errorString());
         }
 
         try {
+            if (hasManifestDocument)
+                docs << QVariant(); // placeholder: parsed below
             checkYamlFormat(docs, 2 /*number of expected docs*/, { "am-application", "am-application-alias" }, 1);
         } catch (const Exception &e) {
             throw Exception(Error::Parse, "not a valid YAML application meta-data file: %1").arg(e.errorString());
@@ -110,11 +127,10 @@ Application *YamlApplicationScanner::scanInternal(const QString &filePath, bool
         app->m_manifestDir = QFileInfo(f).absoluteDir();
         app->m_codeDir = app->m_manifestDir;
 
-        QVariantMap yaml = docs.at(1).toMap();
-        for (auto it = yaml.constBegin(); it != yaml.constEnd(); ++it) {
-            QByteArray field = it.key().toLatin1();
+        auto parseField = [&app, isAlias, application](QtYaml::YamlParser *parser, const QString &key) {
+            QByteArray field = key.toLatin1();
             bool unknownField = false;
-            const QVariant &v = it.value();
+            const QVariant v = parser->parseValue();
 
             if ((!isAlias && (field == "id"))
                     || (isAlias && (field == "aliasId"))) {
@@ -205,9 +221,20 @@ Application *YamlApplicationScanner::scanInternal(const QString &filePath, bool
 
             if (unknownField)
                 throw Exception(Error::Parse, "contains unsupported field: '%1'").arg(field);
+        };
+
+        try {
+            yp.parseFields(parseField);
+            if (yp.nextDocument())
+                throw Exception(Error::Parse, "not a valid YAML application meta-data file: wrong number of YAML documents: expected 2, got more");
+        } catch (const QtYaml::ParseError &parseError) {
+            throw Exception(Error::IO, "YAML parse error at line %1, column %2: %3")
+                    .arg(parseError.line).arg(parseError.column).arg(parseError.errorString());
         }
 
         app->validate();
+        if (m_cache)
+            m_cache->insert(filePath, content, app.data());
         return app.take();
     } catch (const Exception &e) {
         throw Exception(e.errorCode(), "Failed to parse manifest file %1: %2").arg(filePath, e.errorString());
@@ -220,4 +247,9 @@ QString YamlApplicationScanner::metaDataFileName() const
     return qSL("info.yaml");
 }
 
+void YamlApplicationScanner::setCache(ApplicationManifestCache *cache)
+{
+    m_cache = cache;
+}
+
 QT_END_NAMESPACE_AM
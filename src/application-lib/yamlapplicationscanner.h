@@ -45,6 +45,8 @@
 
 QT_BEGIN_NAMESPACE_AM
 
+class ApplicationManifestCache;
+
 class YamlApplicationScanner : public ApplicationScanner
 {
 public:
@@ -56,9 +58,13 @@ public:
 
     QString metaDataFileName() const override;
 
+    void setCache(ApplicationManifestCache *cache);
+
 private:
     Application *scanInternal(const QString &filePath, bool scanAlias,
                               const Application *application) Q_DECL_NOEXCEPT_EXPR(false);
+
+    ApplicationManifestCache *m_cache = nullptr;
 };
 
 QT_END_NAMESPACE_AM
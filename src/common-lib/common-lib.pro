@@ -29,10 +29,14 @@ SOURCES += \
     crashhandler.cpp \
     logging.cpp \
     dbus-utilities.cpp \
+    sharedmemoryring.cpp \
 
 qtHaveModule(qml):SOURCES += \
     qml-utilities.cpp \
 
+linux:SOURCES += \
+    forkserverprotocol.cpp \
+
 HEADERS += \
     global.h \
     error.h \
@@ -43,11 +47,15 @@ HEADERS += \
     unixsignalhandler.h \
     processtitle.h \
     crashhandler.h \
-    logging.h
+    logging.h \
+    sharedmemoryring.h \
 
 qtHaveModule(qml):HEADERS += \
     qml-utilities.h \
 
+linux:HEADERS += \
+    forkserverprotocol.h \
+
 qtHaveModule(dbus):HEADERS += \
     dbus-utilities.h \
 
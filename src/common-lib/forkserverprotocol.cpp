@@ -0,0 +1,173 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#include <QtGlobal>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+#include "forkserverprotocol.h"
+
+QT_BEGIN_NAMESPACE_AM
+
+namespace ForkServerProtocol {
+
+bool createSocketPair(int *applicationManagerSide, int *forkServerSide)
+{
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+        return false;
+
+    // the environment of a QML application can be quite big
+    for (int fd : fds) {
+        int size = MaximumMessageSize;
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    *applicationManagerSide = fds[0];
+    *forkServerSide = fds[1];
+    return true;
+}
+
+bool sendMessage(int socket, const QByteArray &message, const QVector<int> &fds)
+{
+    if ((message.size() > MaximumMessageSize) || (fds.size() > MaximumFileDescriptors)) {
+        errno = EMSGSIZE;
+        return false;
+    }
+
+    struct iovec iov;
+    iov.iov_base = const_cast<char *>(message.constData());
+    iov.iov_len = size_t(message.size());
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * MaximumFileDescriptors)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (!fds.isEmpty()) {
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * size_t(fds.size()));
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * size_t(fds.size()));
+        memcpy(CMSG_DATA(cmsg), fds.constData(), sizeof(int) * size_t(fds.size()));
+    }
+
+    ssize_t result;
+    do {
+        result = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+    } while ((result < 0) && (errno == EINTR));
+
+    return result == message.size();
+}
+
+bool receiveMessage(int socket, QByteArray *message, QVector<int> *fds, bool nonBlocking)
+{
+    message->resize(MaximumMessageSize);
+    fds->clear();
+
+    struct iovec iov;
+    iov.iov_base = message->data();
+    iov.iov_len = size_t(message->size());
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * MaximumFileDescriptors)];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    ssize_t result;
+    do {
+        result = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC | (nonBlocking ? MSG_DONTWAIT : 0));
+    } while ((result < 0) && (errno == EINTR));
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS)) {
+            int count = int((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            const int *received = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+            for (int i = 0; i < count; ++i)
+                fds->append(received[i]);
+        }
+    }
+
+    if (result <= 0) {
+        if (result == 0)
+            errno = 0;
+        for (int fd : qAsConst(*fds))
+            ::close(fd);
+        fds->clear();
+        message->clear();
+        return false;
+    }
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        for (int fd : qAsConst(*fds))
+            ::close(fd);
+        fds->clear();
+        message->clear();
+        errno = EMSGSIZE;
+        return false;
+    }
+    message->resize(int(result));
+    return true;
+}
+
+} // namespace ForkServerProtocol
+
+QT_END_NAMESPACE_AM
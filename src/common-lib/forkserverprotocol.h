@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include <QtAppManCommon/global.h>
+
+QT_BEGIN_NAMESPACE_AM
+
+// The wire protocol between the application-manager and a runtime launcher in fork-server mode.
+// Messages are sent over a SOCK_SEQPACKET socket pair, so there is no need for any framing.
+// File descriptors (stdio redirections) are passed along via SCM_RIGHTS.
+// This is only available on Linux.
+namespace ForkServerProtocol {
+
+enum MessageType : quint8 {
+    Spawn = 1,    // id, arguments, environment, working directory, stdio mask + fds
+    Started = 2,  // id, pid (<= 0: -errno), error string
+    Finished = 3, // pid, exit code, crashed
+};
+
+// the environment variable that tells a launcher to become a fork-server and which fd to use
+static const char EnvironmentVariable[] = "AM_FORK_SERVER_FD";
+static const int MaximumMessageSize = 1024 * 1024;
+static const int MaximumFileDescriptors = 3;
+
+bool createSocketPair(int *applicationManagerSide, int *forkServerSide);
+bool sendMessage(int socket, const QByteArray &message, const QVector<int> &fds = QVector<int>());
+// returns false on EOF or errors (errno is set, EAGAIN for non-blocking sockets without data)
+bool receiveMessage(int socket, QByteArray *message, QVector<int> *fds, bool nonBlocking = false);
+
+} // namespace ForkServerProtocol
+
+QT_END_NAMESPACE_AM
@@ -43,6 +43,7 @@
 #include <QRegExp>
 #include <QDebug>
 #include <QtNumeric>
+#include <QHash>
 
 #include <yaml.h>
 
@@ -53,206 +54,415 @@ QT_BEGIN_NAMESPACE
 
 namespace QtYaml {
 
-static QVariant convertYamlNodeToVariant(yaml_document_t *doc, yaml_node_t *node, std::function<QVariant (const QVariant &)> &filter)
+static QVariant convertYamlScalarToVariant(const yaml_char_t *value, size_t length, yaml_scalar_style_t style)
 {
-    QVariant result;
-
-    if (!doc)
-        return result;
-    if (!node)
-        return result;
-
-    switch (node->type) {
-    case YAML_SCALAR_NODE: {
-        const QByteArray ba = QByteArray::fromRawData(reinterpret_cast<const char *>(node->data.scalar.value),
-                                                int(node->data.scalar.length));
-
-        if (node->data.scalar.style == YAML_SINGLE_QUOTED_SCALAR_STYLE
-                || node->data.scalar.style == YAML_DOUBLE_QUOTED_SCALAR_STYLE) {
-            result = QString::fromUtf8(ba);
-            break;
-        }
-
-        enum ValueIndex {
-            ValueNull,
-            ValueTrue,
-            ValueFalse,
-            ValueNaN,
-            ValueInf
-        };
-
-        struct StaticMapping
-        {
-            const char *text;
-            ValueIndex index;
-        };
-
-        static QVariant staticValues[] = {
-            QVariant(),                    // ValueNull
-            QVariant(true),                // ValueTrue
-            QVariant(false),               // ValueFalse
-            QVariant(qQNaN()),             // ValueNaN
-            QVariant(qInf()),              // ValueInf
-        };
+    const QByteArray ba = QByteArray::fromRawData(reinterpret_cast<const char *>(value), int(length));
+
+    if (style == YAML_SINGLE_QUOTED_SCALAR_STYLE || style == YAML_DOUBLE_QUOTED_SCALAR_STYLE)
+        return QString::fromUtf8(ba);
+
+    enum ValueIndex {
+        ValueNull,
+        ValueTrue,
+        ValueFalse,
+        ValueNaN,
+        ValueInf
+    };
+
+    struct StaticMapping
+    {
+        const char *text;
+        ValueIndex index;
+    };
+
+    static QVariant staticValues[] = {
+        QVariant(),                    // ValueNull
+        QVariant(true),                // ValueTrue
+        QVariant(false),               // ValueFalse
+        QVariant(qQNaN()),             // ValueNaN
+        QVariant(qInf()),              // ValueInf
+    };
+
+    static const StaticMapping staticMappings[] = { // keep this sorted for bsearch !!
+        { "",      ValueNull },
+        { ".INF",  ValueInf },
+        { ".Inf",  ValueInf },
+        { ".NAN",  ValueNaN },
+        { ".NaN",  ValueNaN },
+        { ".inf",  ValueInf },
+        { ".nan",  ValueNaN },
+        { "FALSE", ValueFalse },
+        { "False", ValueFalse },
+        { "N",     ValueFalse },
+        { "NO",    ValueFalse },
+        { "NULL",  ValueNull },
+        { "No",    ValueFalse },
+        { "Null",  ValueNull },
+        { "OFF",   ValueFalse },
+        { "Off",   ValueFalse },
+        { "ON",    ValueTrue },
+        { "On",    ValueTrue },
+        { "TRUE",  ValueTrue },
+        { "True",  ValueTrue },
+        { "Y",     ValueTrue },
+        { "YES",   ValueTrue },
+        { "Yes",   ValueTrue },
+        { "false", ValueFalse },
+        { "n",     ValueFalse },
+        { "no",    ValueFalse },
+        { "null",  ValueNull },
+        { "off",   ValueFalse },
+        { "on",    ValueTrue },
+        { "true",  ValueTrue },
+        { "y",     ValueTrue },
+        { "yes",   ValueTrue },
+        { "~",     ValueNull }
+    };
+
+    static const char *firstCharStaticMappings = ".FNOTYfnoty~";
+    char firstChar = ba.isEmpty() ? 0 : ba.at(0);
+
+    if (strchr(firstCharStaticMappings, firstChar)) { // cheap check to avoid expensive bsearch
+        StaticMapping key { ba.constData(), ValueNull };
+        auto found = bsearch(&key,
+                             staticMappings,
+                             sizeof(staticMappings)/sizeof(staticMappings[0]),
+                sizeof(staticMappings[0]),
+                [](const void *m1, const void *m2) {
+            return strcmp(static_cast<const StaticMapping *>(m1)->text,
+                          static_cast<const StaticMapping *>(m2)->text); });
+
+        if (found)
+            return staticValues[static_cast<StaticMapping *>(found)->index];
+    }
 
-        static const StaticMapping staticMappings[] = { // keep this sorted for bsearch !!
-            { "",      ValueNull },
-            { ".INF",  ValueInf },
-            { ".Inf",  ValueInf },
-            { ".NAN",  ValueNaN },
-            { ".NaN",  ValueNaN },
-            { ".inf",  ValueInf },
-            { ".nan",  ValueNaN },
-            { "FALSE", ValueFalse },
-            { "False", ValueFalse },
-            { "N",     ValueFalse },
-            { "NO",    ValueFalse },
-            { "NULL",  ValueNull },
-            { "No",    ValueFalse },
-            { "Null",  ValueNull },
-            { "OFF",   ValueFalse },
-            { "Off",   ValueFalse },
-            { "ON",    ValueTrue },
-            { "On",    ValueTrue },
-            { "TRUE",  ValueTrue },
-            { "True",  ValueTrue },
-            { "Y",     ValueTrue },
-            { "YES",   ValueTrue },
-            { "Yes",   ValueTrue },
-            { "false", ValueFalse },
-            { "n",     ValueFalse },
-            { "no",    ValueFalse },
-            { "null",  ValueNull },
-            { "off",   ValueFalse },
-            { "on",    ValueTrue },
-            { "true",  ValueTrue },
-            { "y",     ValueTrue },
-            { "yes",   ValueTrue },
-            { "~",     ValueNull }
+    QString str = QString::fromUtf8(ba);
+    QVariant result = str;
+
+    if ((firstChar >= '0' && firstChar <= '9')   // cheap check to avoid expensive regexps
+            || firstChar == '+' || firstChar == '-' || firstChar == '.') {
+        static const QRegExp numberRegExps[] = {
+            QRegExp(qSL("[-+]?0b[0-1_]+")),        // binary
+            QRegExp(qSL("[-+]?0x[0-9a-fA-F_]+")),  // hexadecimal
+            QRegExp(qSL("[-+]?0[0-7_]+")),         // octal
+            QRegExp(qSL("[-+]?(0|[1-9][0-9_]*)")), // decimal
+            QRegExp(qSL("[-+]?([0-9][0-9_]*)?\\.[0-9.]*([eE][-+][0-9]+)?")), // float
+            QRegExp()
         };
 
-        static const char *firstCharStaticMappings = ".FNOTYfnoty~";
-        char firstChar = ba.isEmpty() ? 0 : ba.at(0);
-
-        if (strchr(firstCharStaticMappings, firstChar)) { // cheap check to avoid expensive bsearch
-            StaticMapping key { ba.constData(), ValueNull };
-            auto found = bsearch(&key,
-                                 staticMappings,
-                                 sizeof(staticMappings)/sizeof(staticMappings[0]),
-                    sizeof(staticMappings[0]),
-                    [](const void *m1, const void *m2) {
-                return strcmp(static_cast<const StaticMapping *>(m1)->text,
-                              static_cast<const StaticMapping *>(m2)->text); });
-
-            if (found) {
-                result = staticValues[static_cast<StaticMapping *>(found)->index];
-                break;
-            }
-        }
+        for (int numberIndex = 0; !numberRegExps[numberIndex].isEmpty(); ++numberIndex) {
+            if (numberRegExps[numberIndex].exactMatch(str)) {
+                bool ok = false;
+                QVariant val;
+
+                // YAML allows _ as a grouping separator
+                if (str.contains(qL1C('_')))
+                    str = str.replace(qL1C('_'), qSL(""));
+
+                if (numberIndex == 4) {
+                    val = str.toDouble(&ok);
+                } else {
+                    int base = 10;
+
+                    switch (numberIndex) {
+                    case 0: base = 2; str.replace(qSL("0b"), qSL("")); break; // Qt chokes on 0b
+                    case 1: base = 16; break;
+                    case 2: base = 8; break;
+                    case 3: base = 10; break;
+                    }
 
-        QString str = QString::fromUtf8(ba);
-        result = str;
-
-        if ((firstChar >= '0' && firstChar <= '9')   // cheap check to avoid expensive regexps
-                || firstChar == '+' || firstChar == '-' || firstChar == '.') {
-            static const QRegExp numberRegExps[] = {
-                QRegExp(qSL("[-+]?0b[0-1_]+")),        // binary
-                QRegExp(qSL("[-+]?0x[0-9a-fA-F_]+")),  // hexadecimal
-                QRegExp(qSL("[-+]?0[0-7_]+")),         // octal
-                QRegExp(qSL("[-+]?(0|[1-9][0-9_]*)")), // decimal
-                QRegExp(qSL("[-+]?([0-9][0-9_]*)?\\.[0-9.]*([eE][-+][0-9]+)?")), // float
-                QRegExp()
-            };
-
-            for (int numberIndex = 0; !numberRegExps[numberIndex].isEmpty(); ++numberIndex) {
-                if (numberRegExps[numberIndex].exactMatch(str)) {
-                    bool ok = false;
-                    QVariant val;
-
-                    // YAML allows _ as a grouping separator
-                    if (str.contains(qL1C('_')))
-                        str = str.replace(qL1C('_'), qSL(""));
-
-                    if (numberIndex == 4) {
-                        val = str.toDouble(&ok);
+                    qint64 s64 = str.toLongLong(&ok, base);
+                    if (ok && (s64 <= std::numeric_limits<qint32>::max())) {
+                        val = qint32(s64);
+                    } else if (ok) {
+                        val = s64;
                     } else {
-                        int base = 10;
-
-                        switch (numberIndex) {
-                        case 0: base = 2; str.replace(qSL("0b"), qSL("")); break; // Qt chokes on 0b
-                        case 1: base = 16; break;
-                        case 2: base = 8; break;
-                        case 3: base = 10; break;
-                        }
-
-                        qint64 s64 = str.toLongLong(&ok, base);
-                        if (ok && (s64 <= std::numeric_limits<qint32>::max())) {
-                            val = qint32(s64);
-                        } else if (ok) {
-                            val = s64;
-                        } else {
-                            quint64 u64 = str.toULongLong(&ok, base);
-
-                            if (ok && (u64 <= std::numeric_limits<quint32>::max()))
-                                val = quint32(u64);
-                            else if (ok)
-                                val = u64;
-                        }
-                    }
-                    if (ok) {
-                        result = val;
-                        break;
+                        quint64 u64 = str.toULongLong(&ok, base);
+
+                        if (ok && (u64 <= std::numeric_limits<quint32>::max()))
+                            val = quint32(u64);
+                        else if (ok)
+                            val = u64;
                     }
                 }
+                if (ok) {
+                    result = val;
+                    break;
+                }
             }
         }
-        break;
     }
-    case YAML_SEQUENCE_NODE: {
-        QVariantList array;
-        for (auto seq = node->data.sequence.items.start; seq < node->data.sequence.items.top; ++seq) {
-            yaml_node_t *seqNode = yaml_document_get_node(doc, *seq);
-            if (seqNode)
-                array.append(convertYamlNodeToVariant(doc, seqNode, filter));
-            else
-                array.append(QVariant());
+    return result;
+}
+
+static ParseError parseErrorFromParser(const yaml_parser_t *p)
+{
+    switch (p->error) {
+    case YAML_READER_ERROR:
+        return ParseError(QString::fromLocal8Bit(p->problem), -1, -1, int(p->problem_offset));
+    case YAML_SCANNER_ERROR:
+    case YAML_PARSER_ERROR:
+        return ParseError(QString::fromLocal8Bit(p->problem), int(p->problem_mark.line + 1), int(p->problem_mark.column), int(p->problem_mark.index));
+    case YAML_MEMORY_ERROR:
+        return ParseError(qSL("out of memory"));
+    default:
+        return ParseError(qSL("unknown YAML parser error"));
+    }
+}
+
+
+class YamlParserPrivate
+{
+public:
+    QByteArray data;
+    yaml_parser_t parser;
+    yaml_event_t event;
+    bool parserInitialized = false;
+    bool haveEvent = false;
+    quint64 eventCounter = 0;
+    QHash<QByteArray, QVariant> anchors;
+    std::function<QVariant(const QVariant &)> filter;
+
+    void nextEvent() Q_DECL_NOEXCEPT_EXPR(false)
+    {
+        if (haveEvent) {
+            yaml_event_delete(&event);
+            haveEvent = false;
         }
-        result = array;
-        break;
+        if (!yaml_parser_parse(&parser, &event))
+            throw parseErrorFromParser(&parser);
+        haveEvent = true;
+        ++eventCounter;
     }
-    case YAML_MAPPING_NODE: {
-        QVariantMap object;
-        for (auto map = node->data.mapping.pairs.start; map < node->data.mapping.pairs.top; ++map) {
-            yaml_node_t *keyNode = yaml_document_get_node(doc, map->key);
-            yaml_node_t *valueNode = yaml_document_get_node(doc, map->value);
-            if (keyNode && valueNode) {
-                QVariant key = convertYamlNodeToVariant(doc, keyNode, filter);
-                QString keyStr = key.toString();
-
-                if (key.type() != QVariant::String)
-                    qWarning() << "YAML Parser: converting non-string mapping key to string for JSON compatibility";
-                if (object.contains(keyStr))
-                    qWarning() << "YAML Parser: duplicate key" << keyStr << "found in mapping";
-
-                object.insert(keyStr, convertYamlNodeToVariant(doc, valueNode, filter));
-            }
+
+    ParseError error(const char *message) const
+    {
+        return ParseError(QString::fromLatin1(message), int(event.start_mark.line + 1),
+                          int(event.start_mark.column), int(event.start_mark.index));
+    }
+
+    QVariant filtered(const QVariant &value) const
+    {
+        return filter ? filter(value) : value;
+    }
+
+    void registerAnchor(const yaml_char_t *anchor, const QVariant &value)
+    {
+        if (anchor)
+            anchors.insert(QByteArray(reinterpret_cast<const char *>(anchor)), value);
+    }
+};
+
+YamlParser::YamlParser(const QByteArray &data)
+    : d(new YamlParserPrivate)
+{
+    d->data = data;
+    if (!yaml_parser_initialize(&d->parser))
+        return;
+    d->parserInitialized = true;
+    yaml_parser_set_input_string(&d->parser, reinterpret_cast<const uchar *>(d->data.constData()),
+                                 size_t(d->data.size()));
+}
+
+YamlParser::~YamlParser()
+{
+    if (d->haveEvent)
+        yaml_event_delete(&d->event);
+    if (d->parserInitialized)
+        yaml_parser_delete(&d->parser);
+    delete d;
+}
+
+void YamlParser::setFilter(const std::function<QVariant(const QVariant &)> &filter)
+{
+    d->filter = filter;
+}
+
+bool YamlParser::nextDocument()
+{
+    if (!d->parserInitialized)
+        throw ParseError(qSL("could not initialize YAML parser"));
+    if (!d->haveEvent)
+        d->nextEvent();
+
+    forever {
+        switch (d->event.type) {
+        case YAML_DOCUMENT_START_EVENT:
+            d->anchors.clear();
+            d->nextEvent();
+            return true;
+        case YAML_STREAM_END_EVENT:
+            return false;
+        case YAML_SCALAR_EVENT:
+        case YAML_ALIAS_EVENT:
+        case YAML_SEQUENCE_START_EVENT:
+        case YAML_MAPPING_START_EVENT:
+            skipValue(); // the previous document was not completely consumed by the caller
+            break;
+        default:
+            d->nextEvent();
+            break;
         }
-        result = object;
-        break;
+    }
+}
+
+bool YamlParser::isScalar() const
+{
+    return d->haveEvent && (d->event.type == YAML_SCALAR_EVENT);
+}
+
+bool YamlParser::isMap() const
+{
+    return d->haveEvent && (d->event.type == YAML_MAPPING_START_EVENT);
+}
+
+bool YamlParser::isList() const
+{
+    return d->haveEvent && (d->event.type == YAML_SEQUENCE_START_EVENT);
+}
+
+bool YamlParser::isAlias() const
+{
+    return d->haveEvent && (d->event.type == YAML_ALIAS_EVENT);
+}
+
+QVariant YamlParser::parseValue()
+{
+    if (!d->haveEvent)
+        throw ParseError(qSL("parseValue() called before nextDocument()"));
+
+    switch (d->event.type) {
+    case YAML_SCALAR_EVENT: {
+        QVariant result = d->filtered(convertYamlScalarToVariant(d->event.data.scalar.value,
+                                                                 d->event.data.scalar.length,
+                                                                 d->event.data.scalar.style));
+        d->registerAnchor(d->event.data.scalar.anchor, result);
+        d->nextEvent();
+        return result;
+    }
+    case YAML_ALIAS_EVENT: {
+        auto it = d->anchors.constFind(QByteArray(reinterpret_cast<const char *>(d->event.data.alias.anchor)));
+        if (it == d->anchors.cend())
+            throw d->error("reference to an unknown anchor");
+        QVariant result = it.value();
+        d->nextEvent();
+        return result;
+    }
+    case YAML_SEQUENCE_START_EVENT: {
+        QByteArray anchor;
+        if (d->event.data.sequence_start.anchor)
+            anchor = reinterpret_cast<const char *>(d->event.data.sequence_start.anchor);
+        d->nextEvent();
+
+        QVariantList list;
+        while (d->event.type != YAML_SEQUENCE_END_EVENT)
+            list.append(parseValue());
+        d->nextEvent();
+
+        QVariant result = d->filtered(list);
+        if (!anchor.isEmpty())
+            d->anchors.insert(anchor, result);
+        return result;
+    }
+    case YAML_MAPPING_START_EVENT: {
+        QByteArray anchor;
+        if (d->event.data.mapping_start.anchor)
+            anchor = reinterpret_cast<const char *>(d->event.data.mapping_start.anchor);
+
+        QVariantMap map;
+        parseFields([&map](YamlParser *parser, const QString &key) {
+            if (map.contains(key))
+                qWarning() << "YAML Parser: duplicate key" << key << "found in mapping";
+            map.insert(key, parser->parseValue());
+        });
+
+        QVariant result = d->filtered(map);
+        if (!anchor.isEmpty())
+            d->anchors.insert(anchor, result);
+        return result;
     }
     default:
-        break;
+        throw d->error("unexpected YAML event: expected a value");
     }
+}
 
-    return filter(result);
+QVariant YamlParser::parseScalar()
+{
+    if (!isScalar() && !isAlias())
+        throw d->error("expected a scalar value");
+    return parseValue();
 }
 
+QVariantMap YamlParser::parseMap()
+{
+    if (!isMap() && !isAlias())
+        throw d->error("expected a map");
+    return parseValue().toMap();
+}
+
+QVariantList YamlParser::parseList()
+{
+    if (!isList() && !isAlias())
+        throw d->error("expected a list");
+    return parseValue().toList();
+}
+
+void YamlParser::parseFields(const FieldCallback &callback)
+{
+    if (!isMap())
+        throw d->error("expected a map");
+    d->nextEvent();
+
+    while (d->event.type != YAML_MAPPING_END_EVENT) {
+        QVariant key = parseValue();
+        if (key.type() != QVariant::String)
+            qWarning() << "YAML Parser: converting non-string mapping key to string for JSON compatibility";
+
+        quint64 eventCounter = d->eventCounter;
+        callback(this, key.toString());
+        if (eventCounter == d->eventCounter) // the callback ignored the value
+            skipValue();
+    }
+    d->nextEvent();
+}
+
+void YamlParser::skipValue()
+{
+    int level = 0;
+    do {
+        switch (d->event.type) {
+        case YAML_SEQUENCE_START_EVENT:
+        case YAML_MAPPING_START_EVENT:
+            ++level;
+            break;
+        case YAML_SEQUENCE_END_EVENT:
+        case YAML_MAPPING_END_EVENT:
+            --level;
+            break;
+        case YAML_SCALAR_EVENT:
+        case YAML_ALIAS_EVENT:
+            break;
+        default:
+            throw d->error("unexpected YAML event: expected a value");
+        }
+        d->nextEvent();
+    } while (level > 0);
+}
+
+int YamlParser::line() const
+{
+    return d->haveEvent ? int(d->event.start_mark.line + 1) : -1;
+}
+
+int YamlParser::column() const
+{
+    return d->haveEvent ? int(d->event.start_mark.column) : -1;
+}
 
 
 QVector<QVariant> variantDocumentsFromYaml(const QByteArray &yaml, ParseError *error)
 {
-    auto noFilter = [](const QVariant &v) { return v; };
-    return variantDocumentsFromYamlFiltered(yaml, noFilter, error);
+    return variantDocumentsFromYamlFiltered(yaml, nullptr, error);
 }
 
 QVector<QVariant> variantDocumentsFromYamlFiltered(const QByteArray &yaml, std::function<QVariant(const QVariant &)> filter, ParseError *error)
@@ -262,37 +472,15 @@ QVector<QVariant> variantDocumentsFromYamlFiltered(const QByteArray &yaml, std::
     if (error)
         *error = ParseError();
 
-    yaml_parser_t p;
-    if (yaml_parser_initialize(&p)) {
-        yaml_parser_set_input_string(&p, (const uchar *) yaml.constData(), yaml.size());
-
-        yaml_document_t doc;
-        yaml_node_t *root;
-        do {
-            if (!yaml_parser_load(&p, &doc)) {
-                if (error) {
-                    switch (p.error) {
-                    case YAML_READER_ERROR:
-                        *error = ParseError(QString::fromLocal8Bit(p.problem), -1, -1, int(p.problem_offset));
-                        break;
-                    case YAML_SCANNER_ERROR:
-                    case YAML_PARSER_ERROR:
-                        *error = ParseError(QString::fromLocal8Bit(p.problem), int(p.problem_mark.line + 1), int(p.problem_mark.column), int(p.problem_mark.index));
-                        break;
-                    default:
-                        break;
-                    }
-                }
-            }
-            root = yaml_document_get_root_node(&doc);
-            if (root)
-                result.append(convertYamlNodeToVariant(&doc, root, filter));
-            yaml_document_delete(&doc);
-        } while (root);
-
-        yaml_parser_delete(&p);
-    } else if (error) {
-        *error = ParseError(qSL("could not initialize YAML parser"));
+    try {
+        YamlParser p(yaml);
+        p.setFilter(filter);
+
+        while (p.nextDocument())
+            result.append(p.parseValue());
+    } catch (const ParseError &e) {
+        if (error)
+            *error = e;
     }
     return result;
 }
@@ -80,6 +80,48 @@ private:
     QString m_errorString;
 };
 
+class YamlParserPrivate;
+
+// An event based (pull) parser: the QVariants are directly created from libyaml's event stream,
+// without building libyaml's intermediate document tree first. Callers can either get complete
+// values via the parse...() functions, or walk maps field by field via parseFields() to fill
+// their own data structures without creating an intermediate QVariantMap.
+// All functions throw a ParseError on failure.
+class YamlParser
+{
+public:
+    explicit YamlParser(const QByteArray &data);
+    ~YamlParser();
+
+    // the filter is applied to every value (including map keys) created by the parser
+    void setFilter(const std::function<QVariant(const QVariant &)> &filter);
+
+    bool nextDocument();
+
+    bool isScalar() const;
+    bool isMap() const;
+    bool isList() const;
+    bool isAlias() const;
+
+    QVariant parseValue();
+    QVariant parseScalar();
+    QVariantMap parseMap();
+    QVariantList parseList();
+
+    // the callback is called for each key and is expected to consume the value via one of the
+    // parse...() functions - values that are not consumed are skipped.
+    typedef std::function<void(YamlParser *parser, const QString &key)> FieldCallback;
+    void parseFields(const FieldCallback &callback);
+    void skipValue();
+
+    int line() const;
+    int column() const;
+
+private:
+    YamlParserPrivate *d;
+    Q_DISABLE_COPY(YamlParser)
+};
+
 QVector<QVariant> variantDocumentsFromYaml(const QByteArray &yaml, ParseError *error = nullptr);
 QVector<QVariant> variantDocumentsFromYamlFiltered(const QByteArray &yaml, std::function<QVariant(const QVariant &)> filter, ParseError *error = nullptr);
 
@@ -0,0 +1,634 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#include <QSocketNotifier>
+#include <QDataStream>
+#include <QAtomicInteger>
+#include <QStringList>
+#include <QVariantMap>
+
+#include <atomic>
+
+#include "global.h"
+#include "exception.h"
+#include "logging.h"
+#include "sharedmemoryring.h"
+
+#if defined(Q_OS_LINUX)
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/eventfd.h>
+#  include <sys/syscall.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+#  include <linux/memfd.h>
+#  if !defined(F_ADD_SEALS)
+#    define F_ADD_SEALS    (1024 + 9)
+#    define F_SEAL_SHRINK  0x0002
+#    define F_SEAL_GROW    0x0004
+#  endif
+#endif
+
+QT_BEGIN_NAMESPACE_AM
+
+// Both positions are only ever incremented (they will not overflow within the lifetime of
+// the universe), so the difference between them is the number of bytes in use.
+// Each side keeps its own position in a member variable and only publishes it here: the
+// position of the other side is never trusted without checking it against the capacity.
+struct SharedMemoryRingHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint64 capacity;
+    alignas(64) QAtomicInteger<quint64> writePosition; // only changed by the producer
+    alignas(64) QAtomicInteger<quint64> readPosition;  // only changed by the consumer
+    QAtomicInteger<quint32> producerWaiting;
+};
+
+static const quint32 RingMagic = 0x52474d53; // 'SMGR'
+static const quint32 RingVersion = 1;
+static const quint32 WrapMarker = 0xffffffff;
+static const size_t HeaderSize = 4096;
+
+static inline quint64 alignedSize(quint64 size)
+{
+    return (size + 7) & ~quint64(7);
+}
+
+bool SharedMemoryRing::isSupported()
+{
+#if defined(Q_OS_LINUX) && defined(SYS_memfd_create)
+    return true;
+#else
+    return false;
+#endif
+}
+
+SharedMemoryRing::SharedMemoryRing(bool producer, QObject *parent)
+    : QObject(parent)
+    , m_producer(producer)
+{ }
+
+SharedMemoryRing *SharedMemoryRing::create(Role role, int capacity, QObject *parent) Q_DECL_NOEXCEPT_EXPR(false)
+{
+#if defined(Q_OS_LINUX) && defined(SYS_memfd_create)
+    QScopedPointer<SharedMemoryRing> ring(new SharedMemoryRing(role == Producer, parent));
+    ring->m_capacity = alignedSize(quint64(qMax(capacity, 4096)));
+
+    // glibc only got a memfd_create() wrapper in 2.27
+    ring->m_memoryFd = int(::syscall(SYS_memfd_create, "appman-ipc-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (ring->m_memoryFd < 0)
+        throw Exception(errno, "could not create a memfd for the IPC ring buffer");
+    if (::ftruncate(ring->m_memoryFd, off_t(HeaderSize + ring->m_capacity)) < 0)
+        throw Exception(errno, "could not resize the IPC ring buffer");
+    // the other side must not be able to crash us by shrinking the memfd
+    ::fcntl(ring->m_memoryFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+
+    ring->m_dataEventFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ring->m_spaceEventFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring->m_dataEventFd < 0 || ring->m_spaceEventFd < 0)
+        throw Exception(errno, "could not create the eventfds for the IPC ring buffer");
+
+    ring->map();
+
+    SharedMemoryRingHeader *header = new (ring->m_header) SharedMemoryRingHeader;
+    header->magic = RingMagic;
+    header->version = RingVersion;
+    header->capacity = ring->m_capacity;
+    header->writePosition.storeRelease(0);
+    header->readPosition.storeRelease(0);
+    header->producerWaiting.storeRelease(0);
+
+    return ring.take();
+#else
+    Q_UNUSED(role)
+    Q_UNUSED(capacity)
+    Q_UNUSED(parent)
+    throw Exception("shared memory IPC ring buffers are not supported on this platform");
+#endif
+}
+
+SharedMemoryRing *SharedMemoryRing::attach(Role role, int memoryFd, int dataEventFd, int spaceEventFd,
+                                           QObject *parent) Q_DECL_NOEXCEPT_EXPR(false)
+{
+#if defined(Q_OS_LINUX)
+    QScopedPointer<SharedMemoryRing> ring(new SharedMemoryRing(role == Producer, parent));
+
+    ring->m_memoryFd = ::fcntl(memoryFd, F_DUPFD_CLOEXEC, 0);
+    ring->m_dataEventFd = ::fcntl(dataEventFd, F_DUPFD_CLOEXEC, 0);
+    ring->m_spaceEventFd = ::fcntl(spaceEventFd, F_DUPFD_CLOEXEC, 0);
+    if (ring->m_memoryFd < 0 || ring->m_dataEventFd < 0 || ring->m_spaceEventFd < 0)
+        throw Exception(errno, "could not duplicate the file descriptors of the IPC ring buffer");
+
+    struct stat st;
+    if ((::fstat(ring->m_memoryFd, &st) < 0) || (size_t(st.st_size) <= HeaderSize))
+        throw Exception("the IPC ring buffer has an invalid size");
+
+    ring->m_capacity = quint64(st.st_size) - HeaderSize;
+    ring->map();
+
+    if ((ring->m_header->magic != RingMagic) || (ring->m_header->version != RingVersion)
+            || (ring->m_header->capacity != ring->m_capacity)) {
+        throw Exception("the IPC ring buffer has an invalid header");
+    }
+    ring->m_position = ring->m_producer ? ring->m_header->writePosition.loadAcquire()
+                                        : ring->m_header->readPosition.loadAcquire();
+    return ring.take();
+#else
+    Q_UNUSED(role)
+    Q_UNUSED(memoryFd)
+    Q_UNUSED(dataEventFd)
+    Q_UNUSED(spaceEventFd)
+    Q_UNUSED(parent)
+    throw Exception("shared memory IPC ring buffers are not supported on this platform");
+#endif
+}
+
+void SharedMemoryRing::map() Q_DECL_NOEXCEPT_EXPR(false)
+{
+#if defined(Q_OS_LINUX)
+    m_mappedSize = HeaderSize + m_capacity;
+    void *mapping = ::mmap(nullptr, m_mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_memoryFd, 0);
+    if (mapping == MAP_FAILED) {
+        m_mappedSize = 0;
+        throw Exception(errno, "could not map the IPC ring buffer");
+    }
+    m_header = static_cast<SharedMemoryRingHeader *>(mapping);
+    m_data = static_cast<uchar *>(mapping) + HeaderSize;
+
+    // the producer waits for space, the consumer for data
+    m_notifier = new QSocketNotifier(m_producer ? m_spaceEventFd : m_dataEventFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &SharedMemoryRing::onEventFd);
+#endif
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+#if defined(Q_OS_LINUX)
+    delete m_notifier;
+    if (m_mappedSize)
+        ::munmap(m_header, m_mappedSize);
+    for (int fd : { m_memoryFd, m_dataEventFd, m_spaceEventFd }) {
+        if (fd >= 0)
+            ::close(fd);
+    }
+#endif
+}
+
+bool SharedMemoryRing::isProducer() const
+{
+    return m_producer;
+}
+
+int SharedMemoryRing::capacity() const
+{
+    return int(m_capacity);
+}
+
+int SharedMemoryRing::memoryFd() const
+{
+    return m_memoryFd;
+}
+
+int SharedMemoryRing::dataEventFd() const
+{
+    return m_dataEventFd;
+}
+
+int SharedMemoryRing::spaceEventFd() const
+{
+    return m_spaceEventFd;
+}
+
+bool SharedMemoryRing::write(const QByteArray &message)
+{
+    if (!m_producer || !m_header)
+        return false;
+
+    const quint64 needed = alignedSize(sizeof(quint32) + quint64(message.size()));
+    if (needed > m_capacity)
+        return false;
+
+    quint64 writePos = m_position;
+    quint64 offset = writePos % m_capacity;
+    // messages are never split: if it does not fit at the end, we skip to the start
+    quint64 skip = (m_capacity - offset < needed) ? m_capacity - offset : 0;
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        quint64 readPos = m_header->readPosition.loadAcquire();
+        if (writePos - readPos > m_capacity) {
+            qCWarning(LogQmlIpc) << "The consumer of an IPC ring buffer corrupted the read position";
+            return false;
+        }
+        if (writePos + skip + needed - readPos <= m_capacity)
+            break;
+        if (attempt)
+            return false;
+        // ask the consumer to wake us up and check again, since it might have read everything
+        // in the meantime, without seeing the flag. The fence pairs with the one in read():
+        // either we see the new read position, or the consumer sees the flag.
+        m_header->producerWaiting.storeRelease(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    if (skip) {
+        *reinterpret_cast<quint32 *>(m_data + offset) = WrapMarker;
+        writePos += skip;
+        offset = 0;
+    }
+    *reinterpret_cast<quint32 *>(m_data + offset) = quint32(message.size());
+    memcpy(m_data + offset + sizeof(quint32), message.constData(), size_t(message.size()));
+
+    m_position = writePos + needed;
+    m_header->writePosition.storeRelease(m_position);
+    return true;
+}
+
+void SharedMemoryRing::notify()
+{
+#if defined(Q_OS_LINUX)
+    if (m_producer && m_dataEventFd >= 0) {
+        quint64 one = 1;
+        while (::write(m_dataEventFd, &one, sizeof(one)) < 0 && errno == EINTR)
+            ;
+    }
+#endif
+}
+
+bool SharedMemoryRing::read(QByteArray *message)
+{
+    if (m_producer || !m_header)
+        return false;
+
+    quint64 readPos = m_position;
+    quint64 writePos = m_header->writePosition.loadAcquire();
+    if (readPos == writePos)
+        return false;
+
+    quint64 offset = readPos % m_capacity;
+    quint32 size = 0;
+    bool valid = (writePos - readPos <= m_capacity);
+    if (valid) {
+        size = *reinterpret_cast<const quint32 *>(m_data + offset);
+        if (size == WrapMarker) {
+            readPos += m_capacity - offset;
+            offset = 0;
+            size = *reinterpret_cast<const quint32 *>(m_data);
+        }
+        valid = (writePos - readPos <= m_capacity)
+                && (sizeof(quint32) + quint64(size) <= m_capacity - offset)
+                && (alignedSize(sizeof(quint32) + quint64(size)) <= writePos - readPos);
+    }
+    if (!valid) {
+        // we cannot trust the other side - better drop everything than crash
+        qCWarning(LogQmlIpc) << "The producer of an IPC ring buffer corrupted the buffer: dropping all messages";
+        m_position = writePos;
+        m_header->readPosition.storeRelease(m_position);
+        message->clear();
+        return false;
+    }
+    *message = QByteArray(reinterpret_cast<const char *>(m_data + offset + sizeof(quint32)), int(size));
+    m_position = readPos + alignedSize(sizeof(quint32) + size);
+    m_header->readPosition.storeRelease(m_position);
+
+#if defined(Q_OS_LINUX)
+    // pairs with the fence in write(): a producer that did not see our new read position is
+    // guaranteed to have its waiting flag visible to us
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_header->producerWaiting.testAndSetOrdered(1, 0)) {
+        quint64 one = 1;
+        while (::write(m_spaceEventFd, &one, sizeof(one)) < 0 && errno == EINTR)
+            ;
+    }
+#endif
+    return true;
+}
+
+void SharedMemoryRing::onEventFd()
+{
+#if defined(Q_OS_LINUX)
+    quint64 counter;
+    while (::read(m_notifier->socket(), &counter, sizeof(counter)) < 0 && errno == EINTR)
+        ;
+    if (m_producer)
+        emit spaceAvailable();
+    else
+        emit readyRead();
+#endif
+}
+
+// The messages are read from untrusted processes, so the wire format does not use the generic
+// QVariant serialization (which would deserialize any registered metatype), but only supports the
+// types that can also be sent via the D-Bus.
+namespace {
+
+enum WireType : quint8 {
+    WireBool = 1,
+    WireInt,
+    WireUInt,
+    WireLongLong,
+    WireULongLong,
+    WireDouble,
+    WireString,
+    WireStringList,
+    WireByteArray,
+    WireList,
+    WireMap
+};
+
+enum { MaxNestingDepth = 16 };
+
+void writeBytes(QDataStream &ds, const QByteArray &bytes)
+{
+    ds << quint32(bytes.size());
+    ds.writeRawData(bytes.constData(), bytes.size());
+}
+
+// every item needs at least one byte, so this also limits the size of the containers
+bool readSize(QDataStream &ds, int *size)
+{
+    quint32 s;
+    ds >> s;
+    if ((ds.status() != QDataStream::Ok) || (s > quint64(ds.device()->bytesAvailable())))
+        return false;
+    *size = int(s);
+    return true;
+}
+
+bool readBytes(QDataStream &ds, QByteArray *bytes)
+{
+    int size;
+    if (!readSize(ds, &size))
+        return false;
+    bytes->resize(size);
+    return ds.readRawData(bytes->data(), size) == size;
+}
+
+bool readString(QDataStream &ds, QString *string)
+{
+    QByteArray utf8;
+    if (!readBytes(ds, &utf8))
+        return false;
+    *string = QString::fromUtf8(utf8);
+    return true;
+}
+
+bool encodeValue(QDataStream &ds, const QVariant &value, int depth)
+{
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        ds << quint8(WireBool) << value.toBool();
+        return true;
+    case QMetaType::Int:
+        ds << quint8(WireInt) << qint32(value.toInt());
+        return true;
+    case QMetaType::UInt:
+        ds << quint8(WireUInt) << quint32(value.toUInt());
+        return true;
+    case QMetaType::LongLong:
+        ds << quint8(WireLongLong) << qint64(value.toLongLong());
+        return true;
+    case QMetaType::ULongLong:
+        ds << quint8(WireULongLong) << quint64(value.toULongLong());
+        return true;
+    case QMetaType::Double:
+        ds << quint8(WireDouble) << value.toDouble();
+        return true;
+    case QMetaType::QString:
+        ds << quint8(WireString);
+        writeBytes(ds, value.toString().toUtf8());
+        return true;
+    case QMetaType::QStringList: {
+        const QStringList list = value.toStringList();
+        ds << quint8(WireStringList) << quint32(list.size());
+        for (const QString &string : list)
+            writeBytes(ds, string.toUtf8());
+        return true;
+    }
+    case QMetaType::QByteArray:
+        ds << quint8(WireByteArray);
+        writeBytes(ds, value.toByteArray());
+        return true;
+    case QMetaType::QVariantList: {
+        if (depth >= MaxNestingDepth)
+            return false;
+        const QVariantList list = value.toList();
+        ds << quint8(WireList) << quint32(list.size());
+        for (const QVariant &item : list) {
+            if (!encodeValue(ds, item, depth + 1))
+                return false;
+        }
+        return true;
+    }
+    case QMetaType::QVariantMap: {
+        if (depth >= MaxNestingDepth)
+            return false;
+        const QVariantMap map = value.toMap();
+        ds << quint8(WireMap) << quint32(map.size());
+        for (auto it = map.cbegin(); it != map.cend(); ++it) {
+            writeBytes(ds, it.key().toUtf8());
+            if (!encodeValue(ds, it.value(), depth + 1))
+                return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool decodeValue(QDataStream &ds, QVariant *value, int depth)
+{
+    quint8 type;
+    ds >> type;
+    if (ds.status() != QDataStream::Ok)
+        return false;
+
+    switch (type) {
+    case WireBool: {
+        bool b;
+        ds >> b;
+        *value = b;
+        break;
+    }
+    case WireInt: {
+        qint32 i;
+        ds >> i;
+        *value = int(i);
+        break;
+    }
+    case WireUInt: {
+        quint32 u;
+        ds >> u;
+        *value = uint(u);
+        break;
+    }
+    case WireLongLong: {
+        qint64 ll;
+        ds >> ll;
+        *value = qlonglong(ll);
+        break;
+    }
+    case WireULongLong: {
+        quint64 ull;
+        ds >> ull;
+        *value = qulonglong(ull);
+        break;
+    }
+    case WireDouble: {
+        double d;
+        ds >> d;
+        *value = d;
+        break;
+    }
+    case WireString: {
+        QString string;
+        if (!readString(ds, &string))
+            return false;
+        *value = string;
+        break;
+    }
+    case WireStringList: {
+        int size;
+        if (!readSize(ds, &size))
+            return false;
+        QStringList list;
+        list.reserve(size);
+        for (int i = 0; i < size; ++i) {
+            QString string;
+            if (!readString(ds, &string))
+                return false;
+            list << string;
+        }
+        *value = list;
+        break;
+    }
+    case WireByteArray: {
+        QByteArray bytes;
+        if (!readBytes(ds, &bytes))
+            return false;
+        *value = bytes;
+        break;
+    }
+    case WireList: {
+        int size;
+        if ((depth >= MaxNestingDepth) || !readSize(ds, &size))
+            return false;
+        QVariantList list;
+        list.reserve(size);
+        for (int i = 0; i < size; ++i) {
+            QVariant item;
+            if (!decodeValue(ds, &item, depth + 1))
+                return false;
+            list << item;
+        }
+        *value = list;
+        break;
+    }
+    case WireMap: {
+        int size;
+        if ((depth >= MaxNestingDepth) || !readSize(ds, &size))
+            return false;
+        QVariantMap map;
+        for (int i = 0; i < size; ++i) {
+            QString key;
+            QVariant item;
+            if (!readString(ds, &key) || !decodeValue(ds, &item, depth + 1))
+                return false;
+            map.insert(key, item);
+        }
+        *value = map;
+        break;
+    }
+    default:
+        return false;
+    }
+    return ds.status() == QDataStream::Ok;
+}
+
+} // anonymous namespace
+
+/*! \internal
+    Returns a null QByteArray, if any of the \a arguments is not of a type that the wire format
+    supports: bool, int, uint, qlonglong, qulonglong, double, QString, QStringList, QByteArray and
+    QVariantList or QVariantMap of those.
+*/
+QByteArray SharedMemoryRing::encodeMessage(int member, const QVariantList &arguments)
+{
+    QByteArray message;
+    QDataStream ds(&message, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_6);
+    ds << quint16(member) << quint32(arguments.size());
+    for (const QVariant &argument : arguments) {
+        if (!encodeValue(ds, argument, 0))
+            return QByteArray();
+    }
+    return message;
+}
+
+/*! \internal
+    Returns \c false for any malformed \a message, including messages with trailing data.
+*/
+bool SharedMemoryRing::decodeMessage(const QByteArray &message, int *member, QVariantList *arguments)
+{
+    QDataStream ds(message);
+    ds.setVersion(QDataStream::Qt_5_6);
+    quint16 m;
+    ds >> m;
+    int count;
+    if ((ds.status() != QDataStream::Ok) || !readSize(ds, &count))
+        return false;
+
+    arguments->clear();
+    arguments->reserve(count);
+    for (int i = 0; i < count; ++i) {
+        QVariant argument;
+        if (!decodeValue(ds, &argument, 0))
+            return false;
+        *arguments << argument;
+    }
+    *member = m;
+    return (ds.status() == QDataStream::Ok) && ds.atEnd();
+}
+
+QT_END_NAMESPACE_AM
@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QVariantList>
+#include <QtAppManCommon/global.h>
+
+QT_FORWARD_DECLARE_CLASS(QSocketNotifier)
+
+QT_BEGIN_NAMESPACE_AM
+
+struct SharedMemoryRingHeader;
+
+// A single-producer, single-consumer ring buffer for variable sized messages, living in a memfd
+// that can be shared with another process. The producer wakes the consumer via an eventfd and
+// the consumer in turn wakes the producer via a second eventfd, if the buffer ran full.
+// Either side can create the buffer, while the other one attaches to it.
+// This is only available on Linux.
+class SharedMemoryRing : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Role { Producer, Consumer };
+
+    static bool isSupported();
+
+    // creates a new buffer, that can hold at least capacity bytes
+    static SharedMemoryRing *create(Role role, int capacity, QObject *parent = nullptr) Q_DECL_NOEXCEPT_EXPR(false);
+    // the file descriptors are duplicated, so the caller still owns them
+    static SharedMemoryRing *attach(Role role, int memoryFd, int dataEventFd, int spaceEventFd,
+                                    QObject *parent = nullptr) Q_DECL_NOEXCEPT_EXPR(false);
+    ~SharedMemoryRing();
+
+    bool isProducer() const;
+    int capacity() const;
+    int memoryFd() const;
+    int dataEventFd() const;
+    int spaceEventFd() const;
+
+    // producer
+    bool write(const QByteArray &message);
+    void notify();
+
+    // consumer
+    bool read(QByteArray *message);
+
+    // the wire format of the messages used by the IPC interfaces: only D-Bus compatible types
+    static QByteArray encodeMessage(int member, const QVariantList &arguments);
+    static bool decodeMessage(const QByteArray &message, int *member, QVariantList *arguments);
+
+signals:
+    void readyRead();
+    void spaceAvailable();
+
+private:
+    SharedMemoryRing(bool producer, QObject *parent);
+    void map() Q_DECL_NOEXCEPT_EXPR(false);
+    void onEventFd();
+
+    bool m_producer;
+    int m_memoryFd = -1;
+    int m_dataEventFd = -1;
+    int m_spaceEventFd = -1;
+    SharedMemoryRingHeader *m_header = nullptr;
+    uchar *m_data = nullptr;
+    quint64 m_capacity = 0;
+    quint64 m_position = 0; // the write position for producers, the read position for consumers
+    size_t m_mappedSize = 0;
+    QSocketNotifier *m_notifier = nullptr;
+};
+
+QT_END_NAMESPACE_AM
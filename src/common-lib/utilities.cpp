@@ -393,6 +393,28 @@ int timeoutFactor()
     return tf;
 }
 
+static QAtomicInt s_processEnvironmentGeneration;
+
+/*! \internal
+    Sets the environment variable \a name to \a value, just like qputenv() would. In addition,
+    the environment generation is incremented, so that cached copies of the environment
+    (e.g. the one in ProcessContainer) are re-created before the next child process is started.
+
+    Use this function instead of qputenv() for every variable that is set after the start-up
+    phase, e.g. WAYLAND_DISPLAY after the compositor has been created.
+*/
+bool setProcessEnvironmentVariable(const char *name, const QByteArray &value)
+{
+    bool result = qputenv(name, value);
+    s_processEnvironmentGeneration.fetchAndAddOrdered(1);
+    return result;
+}
+
+int processEnvironmentGeneration()
+{
+    return s_processEnvironmentGeneration.loadAcquire();
+}
+
 bool recursiveOperation(const QString &path, const std::function<bool (const QString &, RecursiveOperationType)> &operation)
 {
     QFileInfo pathInfo(path);
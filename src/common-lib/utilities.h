@@ -56,6 +56,12 @@ QT_BEGIN_NAMESPACE_AM
 
 int timeoutFactor();
 
+// qputenv() for the application-manager's own environment, which is inherited by all child
+// processes: callers that cache a snapshot of this environment compare the generation to
+// find out whether their snapshot is still valid.
+bool setProcessEnvironmentVariable(const char *name, const QByteArray &value);
+int processEnvironmentGeneration();
+
 void checkYamlFormat(const QVector<QVariant> &docs, int numberOfDocuments,
                      const QVector<QByteArray> &formatTypes, int formatVersion) Q_DECL_NOEXCEPT_EXPR(false);
 
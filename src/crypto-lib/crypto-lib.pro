@@ -11,10 +11,12 @@ CONFIG *= static internal_module
 
 SOURCES += \
     cryptography.cpp \
+    digest.cpp \
     signature.cpp \
 
 HEADERS += \
     cryptography.h \
+    digest.h \
     signature.h \
     signature_p.h \
 
@@ -98,16 +98,29 @@ QByteArray Cryptography::generateRandomBytes(int size)
 
 
 void Cryptography::initialize()
+{
+    if (!tryInitialize())
+        qFatal("Could not load libcrypto");
+}
+
+/*! \internal
+  Same as initialize(), but returns \c false instead of aborting, if the platform's crypto
+  library cannot be loaded. Loading is only attempted once.
+*/
+bool Cryptography::tryInitialize()
 {
 #if defined(AM_USE_LIBCRYPTO)
+    static bool openSslTried = false;
     static bool openSslInitialized = false;
 
     QMutexLocker locker(initMutex());
-    if (!openSslInitialized) {
-        if (!LibCryptoFunctionBase::initialize())
-            qFatal("Could not load libcrypto");
-        openSslInitialized = true;
+    if (!openSslTried) {
+        openSslInitialized = LibCryptoFunctionBase::initialize();
+        openSslTried = true;
     }
+    return openSslInitialized;
+#else
+    return true;
 #endif
 }
 
@@ -52,6 +52,7 @@ namespace Cryptography {
 QByteArray generateRandomBytes(int size);
 
 void initialize();
+bool tryInitialize();
 
 QString errorString(qint64 osCryptoError, const char *errorDescription = nullptr);
 
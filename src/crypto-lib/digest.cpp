@@ -0,0 +1,215 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+#include <QCryptographicHash>
+
+#include "digest.h"
+
+#if defined(AM_USE_LIBCRYPTO)
+#  include "cryptography.h"
+#  include "libcryptofunction.h"
+
+QT_BEGIN_NAMESPACE_AM
+
+// clazy:excludeall=non-pod-global-static
+
+// dummy structures
+struct EVP_MD;
+struct EVP_MD_CTX;
+struct ENGINE;
+
+// these are the OpenSSL 1.0 names: EVP_MD_CTX_create/destroy were renamed in 1.1
+static AM_LIBCRYPTO_FUNCTION(EVP_sha256, const EVP_MD *(*)(), nullptr);
+static AM_LIBCRYPTO_FUNCTION(EVP_MD_CTX_create, EVP_MD_CTX *(*)(), nullptr);
+static AM_LIBCRYPTO_FUNCTION(EVP_MD_CTX_destroy, void(*)(EVP_MD_CTX *));
+static AM_LIBCRYPTO_FUNCTION(EVP_MD_CTX_copy_ex, int(*)(EVP_MD_CTX *, const EVP_MD_CTX *), 0);
+static AM_LIBCRYPTO_FUNCTION(EVP_DigestInit_ex, int(*)(EVP_MD_CTX *, const EVP_MD *, ENGINE *), 0);
+static AM_LIBCRYPTO_FUNCTION(EVP_DigestUpdate, int(*)(EVP_MD_CTX *, const void *, size_t), 0);
+static AM_LIBCRYPTO_FUNCTION(EVP_DigestFinal_ex, int(*)(EVP_MD_CTX *, unsigned char *, unsigned int *), 0);
+
+/*! \internal
+  Digests are used from the installer's worker threads, but resolving libcrypto symbols is not
+  thread-safe: we resolve everything exactly once here instead.
+*/
+static bool libCryptoDigestAvailable()
+{
+    static const bool available = []() {
+        if (!Cryptography::tryInitialize())
+            return false;
+        return am_EVP_sha256.functionPointer()
+                && am_EVP_MD_CTX_create.functionPointer()
+                && am_EVP_MD_CTX_destroy.functionPointer()
+                && am_EVP_MD_CTX_copy_ex.functionPointer()
+                && am_EVP_DigestInit_ex.functionPointer()
+                && am_EVP_DigestUpdate.functionPointer()
+                && am_EVP_DigestFinal_ex.functionPointer();
+    }();
+    return available;
+}
+
+QT_END_NAMESPACE_AM
+
+#endif // AM_USE_LIBCRYPTO
+
+QT_BEGIN_NAMESPACE_AM
+
+/*! \internal
+  \class Sha256Digest
+
+  A drop-in replacement for QCryptographicHash(QCryptographicHash::Sha256), which is used for
+  calculating package digests.
+
+  If libcrypto is available, its EVP implementation is used. This is a lot faster than Qt's
+  generic C implementation, since OpenSSL uses the CPU's SHA extensions (x86 SHA-NI or ARMv8
+  crypto extensions) or at least hand-optimized SIMD code. QCryptographicHash is used as a
+  fallback otherwise. Both implementations produce exactly the same digests.
+*/
+
+class Sha256DigestPrivate
+{
+public:
+#if defined(AM_USE_LIBCRYPTO)
+    EVP_MD_CTX *ctx = nullptr;
+#endif
+    QCryptographicHash *fallback = nullptr;
+};
+
+Sha256Digest::Sha256Digest()
+    : d(new Sha256DigestPrivate)
+{
+#if defined(AM_USE_LIBCRYPTO)
+    if (libCryptoDigestAvailable()) {
+        d->ctx = am_EVP_MD_CTX_create();
+        if (d->ctx && !am_EVP_DigestInit_ex(d->ctx, am_EVP_sha256(), nullptr)) {
+            am_EVP_MD_CTX_destroy(d->ctx);
+            d->ctx = nullptr;
+        }
+    }
+    if (!d->ctx)
+#endif
+        d->fallback = new QCryptographicHash(QCryptographicHash::Sha256);
+}
+
+Sha256Digest::~Sha256Digest()
+{
+#if defined(AM_USE_LIBCRYPTO)
+    if (d->ctx)
+        am_EVP_MD_CTX_destroy(d->ctx);
+#endif
+    delete d->fallback;
+    delete d;
+}
+
+void Sha256Digest::reset()
+{
+#if defined(AM_USE_LIBCRYPTO)
+    if (d->ctx) {
+        am_EVP_DigestInit_ex(d->ctx, am_EVP_sha256(), nullptr);
+        return;
+    }
+#endif
+    d->fallback->reset();
+}
+
+void Sha256Digest::addData(const char *data, int length)
+{
+    if (length <= 0)
+        return;
+#if defined(AM_USE_LIBCRYPTO)
+    if (d->ctx) {
+        am_EVP_DigestUpdate(d->ctx, data, size_t(length));
+        return;
+    }
+#endif
+    d->fallback->addData(data, length);
+}
+
+void Sha256Digest::addData(const QByteArray &data)
+{
+    addData(data.constData(), data.size());
+}
+
+/*! \internal
+  Just like QCryptographicHash::result(), this does not finalize the digest: you can still add
+  more data afterwards.
+*/
+QByteArray Sha256Digest::result() const
+{
+#if defined(AM_USE_LIBCRYPTO)
+    if (d->ctx) {
+        QByteArray result;
+        EVP_MD_CTX *copy = am_EVP_MD_CTX_create();
+        if (copy) {
+            if (am_EVP_MD_CTX_copy_ex(copy, d->ctx)) {
+                unsigned char md[32];
+                unsigned int mdLength = 0;
+                if (am_EVP_DigestFinal_ex(copy, md, &mdLength) && (mdLength == sizeof(md)))
+                    result = QByteArray(reinterpret_cast<const char *>(md), int(mdLength));
+            }
+            am_EVP_MD_CTX_destroy(copy);
+        }
+        return result;
+    }
+#endif
+    return d->fallback->result();
+}
+
+QByteArray Sha256Digest::hash(const QByteArray &data)
+{
+    Sha256Digest digest;
+    digest.addData(data);
+    return digest.result();
+}
+
+/*! \internal
+  Returns \c true if the digests are calculated by libcrypto, or \c false if QCryptographicHash is
+  used as a fallback.
+*/
+bool Sha256Digest::isUsingLibCrypto()
+{
+#if defined(AM_USE_LIBCRYPTO)
+    return libCryptoDigestAvailable();
+#else
+    return false;
+#endif
+}
+
+QT_END_NAMESPACE_AM
@@ -13,6 +13,7 @@ CONFIG *= static internal_module dbus-adaptors-xml
 
 HEADERS += \
     dbuspolicy.h \
+    dbuspolicy_p.h \
     dbusdaemon.h \
     abstractdbuscontextadaptor.h \
     applicationmanagerdbuscontextadaptor.h \
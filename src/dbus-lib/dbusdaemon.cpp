@@ -101,7 +101,7 @@ void DBusDaemonProcess::start() Q_DECL_NOEXCEPT_EXPR(false)
                 .arg(dbusDaemon->program(), dbusDaemon->errorString());
     }
     QByteArray busAddress = dbusDaemon->readAllStandardOutput().trimmed();
-    qputenv("DBUS_SESSION_BUS_ADDRESS", busAddress);
+    setProcessEnvironmentVariable("DBUS_SESSION_BUS_ADDRESS", busAddress);
     qCInfo(LogSystem, "NOTICE: running on private D-Bus session bus to avoid conflicts:");
     qCInfo(LogSystem, "        DBUS_SESSION_BUS_ADDRESS=%s", busAddress.constData());
 }
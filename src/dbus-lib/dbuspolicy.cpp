@@ -42,9 +42,12 @@
 #include <QDebug>
 #include <QFileInfo>
 #include <QPointer>
+#include <QHash>
+#include <QSet>
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
 #include <QDBusMessage>
+#include <QDBusReply>
 #include <QDBusContext>
 #include <QDBusAbstractAdaptor>
 #include <QMetaMethod>
@@ -52,17 +55,11 @@
 
 #include "utilities.h"
 #include "dbuspolicy.h"
+#include "dbuspolicy_p.h"
 #include "applicationmanager.h"
 
 QT_BEGIN_NAMESPACE_AM
 
-struct DBusPolicyEntry
-{
-    QList<uint> m_uids;
-    QStringList m_executables;
-    QStringList m_capabilities;
-};
-
 static QMap<QPointer<QDBusAbstractAdaptor>, QMap<QByteArray, DBusPolicyEntry> > policies;
 
 
@@ -108,6 +105,179 @@ bool DBusPolicy::add(QDBusAbstractAdaptor *dbusAdaptor, const QVariantMap &yamlF
 }
 
 
+// connection name -> unique bus name -> credentials
+static QHash<QString, QHash<QString, DBusCredentials>> credentialCache;
+
+DBusCredentials *DBusCredentialCache::find(const QString &connectionName, const QString &uniqueName)
+{
+    auto ic = credentialCache.find(connectionName);
+    if (ic == credentialCache.end())
+        return nullptr;
+    auto it = ic->find(uniqueName);
+    return (it != ic->end()) ? &it.value() : nullptr;
+}
+
+DBusCredentials *DBusCredentialCache::insert(const QString &connectionName, const QString &uniqueName,
+                                             const DBusCredentials &credentials)
+{
+    return &credentialCache[connectionName].insert(uniqueName, credentials).value();
+}
+
+void DBusCredentialCache::removePeer(const QString &connectionName, const QString &uniqueName)
+{
+    auto ic = credentialCache.find(connectionName);
+    if (ic != credentialCache.end())
+        ic->remove(uniqueName);
+}
+
+// An application's capabilities may change on an update and its pid is gone after a removal:
+// both have to be resolved again on the next call
+void DBusCredentialCache::invalidateApplication(const QString &applicationId)
+{
+    for (auto ic = credentialCache.begin(); ic != credentialCache.end(); ++ic) {
+        for (auto it = ic->begin(); it != ic->end(); ++it) {
+            if (it->applicationResolved && (it->applicationId == applicationId)) {
+                it->applicationResolved = false;
+                it->applicationId.clear();
+                it->capabilities.clear();
+            }
+        }
+    }
+}
+
+void DBusCredentialCache::clear()
+{
+    credentialCache.clear();
+}
+
+
+#if defined(Q_OS_UNIX)
+
+static DBusCredentials *lookupCredentials(const QDBusConnection &connection, const QString &uniqueName)
+{
+    QDBusConnectionInterface *iface = connection.interface();
+    if (!iface || uniqueName.isEmpty())
+        return nullptr;
+
+    const QString connectionName = connection.name();
+    if (DBusCredentials *creds = DBusCredentialCache::find(connectionName, uniqueName))
+        return creds;
+
+    static QSet<QString> watchedConnections;
+    if (!watchedConnections.contains(connectionName)) {
+        // first call on this bus: make sure we get rid of stale entries
+        QObject::connect(iface, &QDBusConnectionInterface::serviceOwnerChanged, iface,
+                         [connectionName](const QString &name, const QString &oldOwner, const QString &newOwner) {
+            Q_UNUSED(oldOwner)
+            if (newOwner.isEmpty())
+                DBusCredentialCache::removePeer(connectionName, name);
+        });
+        watchedConnections.insert(connectionName);
+    }
+
+    static bool watchingApplications = false;
+    if (!watchingApplications) {
+        ApplicationManager *am = ApplicationManager::instance();
+        QObject::connect(am, &ApplicationManager::applicationAboutToBeRemoved,
+                         am, &DBusCredentialCache::invalidateApplication);
+        QObject::connect(am, &ApplicationManager::applicationChanged,
+                         am, [](const QString &id, const QStringList &changedRoles) {
+            // an empty list of roles means that the application was (re)installed or updated
+            if (changedRoles.isEmpty())
+                DBusCredentialCache::invalidateApplication(id);
+        });
+        watchingApplications = true;
+    }
+
+    DBusCredentials creds;
+
+    QDBusMessage message = QDBusMessage::createMethodCall(qSL("org.freedesktop.DBus"), qSL("/org/freedesktop/DBus"),
+                                                          qSL("org.freedesktop.DBus"), qSL("GetConnectionCredentials"));
+    message << uniqueName;
+    QDBusReply<QVariantMap> reply = connection.call(message);
+
+    if (reply.isValid()) {
+        const QVariantMap map = reply.value();
+        bool ok;
+        uint pid = map.value(qSL("ProcessID")).toUInt(&ok);
+        if (ok)
+            creds.pid = pid;
+        uint uid = map.value(qSL("UnixUserID")).toUInt(&ok);
+        if (ok)
+            creds.uid = uid;
+    } else {
+        // older bus daemons do not implement GetConnectionCredentials
+        QDBusReply<uint> pidReply = iface->servicePid(uniqueName);
+        if (pidReply.isValid())
+            creds.pid = pidReply.value();
+        QDBusReply<uint> uidReply = iface->serviceUid(uniqueName);
+        if (uidReply.isValid())
+            creds.uid = uidReply.value();
+    }
+
+    // do not cache anything for a peer that vanished before we could ask the bus about it:
+    // we would never get a NameOwnerChanged signal to remove it again
+    if (creds.pid <= 0 || creds.uid == uint(-1))
+        return nullptr;
+
+    return DBusCredentialCache::insert(connectionName, uniqueName, creds);
+}
+
+#endif // defined(Q_OS_UNIX)
+
+static const QStringList &applicationCapabilities(DBusCredentials *creds)
+{
+    // a process that is not known as an application (yet) is checked again on the next call
+    if (!creds->applicationResolved) {
+        creds->applicationId = ApplicationManager::instance()->identifyApplication(creds->pid);
+        if (!creds->applicationId.isEmpty()) {
+            creds->capabilities = ApplicationManager::instance()->capabilities(creds->applicationId);
+            creds->capabilities.sort();
+            creds->applicationResolved = true;
+        }
+    }
+    return creds->capabilities;
+}
+
+static const QString &executable(DBusCredentials *creds)
+{
+    if (!creds->executableResolved) {
+#if defined(Q_OS_LINUX)
+        creds->executable = QFileInfo(qSL("/proc/") + QString::number(creds->pid) + qSL("/exe")).symLinkTarget();
+#endif
+        creds->executableResolved = true;
+    }
+    return creds->executable;
+}
+
+const char *checkDBusPolicyEntry(const DBusPolicyEntry &entry, DBusCredentials *creds)
+{
+    if (!entry.m_capabilities.isEmpty()) {
+        const QStringList &appCaps = applicationCapabilities(creds);
+        bool match = false;
+        for (const QString &cap : entry.m_capabilities)
+            match = match && std::binary_search(appCaps.cbegin(), appCaps.cend(), cap);
+        if (!match)
+            return "insufficient capabilities";
+    }
+    if (!entry.m_executables.isEmpty()) {
+#if defined(Q_OS_LINUX)
+        const QString &exe = executable(creds);
+        if (exe.isEmpty())
+            return "cannot get executable";
+        if (std::binary_search(entry.m_executables.cbegin(), entry.m_executables.cend(), exe))
+            return "executable blocked";
+#else
+        return "executable checks are not supported on this platform";
+#endif
+    }
+    if (!entry.m_uids.isEmpty()) {
+        if (std::binary_search(entry.m_uids.cbegin(), entry.m_uids.cend(), creds->uid))
+            return "uid blocked";
+    }
+    return nullptr;
+}
+
 bool DBusPolicy::check(QDBusAbstractAdaptor *dbusAdaptor, const QByteArray &function)
 {
 #if !defined(Q_OS_UNIX)
@@ -134,45 +304,18 @@ bool DBusPolicy::check(QDBusAbstractAdaptor *dbusAdaptor, const QByteArray &func
     if (ip == (*ia).cend())
         return true;
 
-    try {
-        uint pid = uint(-1);
-
-        if (!ip->m_capabilities.isEmpty()) {
-            pid = dbusContext->connection().interface()->servicePid(dbusContext->message().service());
-            QStringList appCaps = ApplicationManager::instance()->capabilities(ApplicationManager::instance()->identifyApplication(pid));
-            bool match = false;
-            for (const QString &cap : ip->m_capabilities)
-                match = match && std::binary_search(appCaps.cbegin(), appCaps.cend(), cap);
-            if (!match)
-                throw "insufficient capabilities";
-        }
-        if (!ip->m_executables.isEmpty()) {
-#  if defined(Q_OS_LINUX)
-            if (pid == uint(-1))
-                pid = dbusContext->connection().interface()->servicePid(dbusContext->message().service());
-            QString executable = QFileInfo(qSL("/proc/") + QString::number(pid) + qSL("/exe")).symLinkTarget();
-            if (executable.isEmpty())
-                throw "cannot get executable";
-            if (std::binary_search(ip->m_executables.cbegin(), ip->m_executables.cend(), executable))
-                throw "executable blocked";
-#  else
-            throw false;
-#  endif // defined(Q_OS_LINUX)
-        }
-        if (!ip->m_uids.isEmpty()) {
-            uint uid = dbusContext->connection().interface()->serviceUid(dbusContext->message().service());
-            if (std::binary_search(ip->m_uids.cbegin(), ip->m_uids.cend(), uid))
-                throw "uid blocked";
-        }
+    if (ip->m_capabilities.isEmpty() && ip->m_executables.isEmpty() && ip->m_uids.isEmpty())
+        return true;
 
+    const char *msg = "cannot get credentials";
+    if (DBusCredentials *creds = lookupCredentials(dbusContext->connection(), dbusContext->message().service()))
+        msg = checkDBusPolicyEntry(*ip, creds);
+    if (!msg)
         return true;
 
-    } catch (const char *msg) {
-        dbusContext->sendErrorReply(QDBusError::AccessDenied, QString::fromLatin1("Protected function call (%1)").arg(qL1S(msg)));
-        return false;
-    }
+    dbusContext->sendErrorReply(QDBusError::AccessDenied, QString::fromLatin1("Protected function call (%1)").arg(qL1S(msg)));
+    return false;
 #endif // !defined(Q_OS_UNIX)
-
 }
 
 QT_END_NAMESPACE_AM
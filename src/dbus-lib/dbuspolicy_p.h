@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+#pragma once
+
+#include <QtAppManCommon/global.h>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE_AM
+
+struct DBusPolicyEntry
+{
+    QList<uint> m_uids;          // sorted
+    QStringList m_executables;   // sorted
+    QStringList m_capabilities;  // sorted
+};
+
+// Everything we know about a D-Bus peer: D-Bus guarantees that unique connection names are never
+// reused, so we can safely cache this until the name vanishes from the bus. The application
+// specific part is resolved again, whenever that application is updated or removed.
+struct DBusCredentials
+{
+    qint64 pid = -1;
+    uint uid = uint(-1);
+    bool executableResolved = false;
+    QString executable;
+    bool applicationResolved = false;
+    QString applicationId;
+    QStringList capabilities; // sorted
+};
+
+// Not thread-safe: all D-Bus adaptors are living in the main thread.
+class DBusCredentialCache
+{
+public:
+    static DBusCredentials *find(const QString &connectionName, const QString &uniqueName);
+    static DBusCredentials *insert(const QString &connectionName, const QString &uniqueName,
+                                   const DBusCredentials &credentials);
+    static void removePeer(const QString &connectionName, const QString &uniqueName);
+    static void invalidateApplication(const QString &applicationId);
+    static void clear();
+};
+
+// Returns a nullptr if the credentials pass the policy entry's checks, or the reason otherwise.
+const char *checkDBusPolicyEntry(const DBusPolicyEntry &entry, DBusCredentials *credentials);
+
+QT_END_NAMESPACE_AM
@@ -43,6 +43,8 @@
 #include <QDir>
 #include <QUuid>
 
+#include <algorithm>
+
 #include "logging.h"
 #include "application.h"
 #include "applicationinstaller.h"
@@ -109,6 +111,20 @@
     \c executing \unicode{0x2192} \c awaitingAcknowledge (this state may be skipped if
     acknowledgePackageInstallation() was called already) \unicode{0x2192} \c installing
     \unicode{0x2192} \c cleanup \unicode{0x2192} \c finished. Again, the task can fail at any point.
+
+    By default, only one task is executed at a time. If the \c installer/maximumConcurrentTasks
+    configuration option is set to a larger value, independent tasks are executed in parallel,
+    which speeds up batch updates considerably. The installer still makes sure that:
+    \list
+    \li only one task at a time is handling a specific application: tasks for the same application
+        are executed in the order they were started.
+    \li tasks for removable installation locations are not executed in parallel.
+    \li queued tasks are started in order, but a task that has to wait for another task does not
+        hold up independent tasks that were queued after it.
+    \endlist
+    Please note that an installation task only knows its application id after the package header
+    has been downloaded, so it might already be \c executing while waiting for another task
+    handling the same application to finish.
 */
 
 // THIS IS MISSING AN EXAMPLE!
@@ -284,8 +300,25 @@ bool ApplicationInstaller::enableApplicationUserIdSeparation(uint minUserId, uin
     return true;
 }
 
+int ApplicationInstaller::maximumConcurrentTasks() const
+{
+    return d->maximumConcurrentTasks;
+}
+
+void ApplicationInstaller::setMaximumConcurrentTasks(int maximumConcurrentTasks)
+{
+    d->maximumConcurrentTasks = qMax(1, maximumConcurrentTasks);
+    triggerExecuteNextTask();
+}
+
+/*! \internal
+  This needs to run in the main thread: it is only race-free, because the returned uid is
+  immediately used by the ApplicationManager in startingApplicationInstallation().
+*/
 uint ApplicationInstaller::findUnusedUserId() const Q_DECL_NOEXCEPT_EXPR(false)
 {
+    Q_ASSERT(QThread::currentThread() == thread());
+
     if (!isApplicationUserIdSeparationEnabled())
         return uint(-1);
 
@@ -375,9 +408,9 @@ void ApplicationInstaller::cleanupBrokenInstallations() const Q_DECL_NOEXCEPT_EX
 
     const auto allApps = am->applications();
     for (const Application *app : allApps) {
-        const InstallationReport *ir = app->installationReport();
-        if (ir) {
-            const InstallationLocation &il = installationLocationFromId(ir->installationLocationId());
+        // only the raw location id is needed: this avoids decoding every report at start-up
+        if (app->hasInstallationReport()) {
+            const InstallationLocation &il = installationLocationFromId(app->installationLocationId());
 
             bool valid = il.isValid();
 
@@ -497,8 +530,8 @@ const InstallationLocation &ApplicationInstaller::installationLocationFromId(con
 const InstallationLocation &ApplicationInstaller::installationLocationFromApplication(const QString &id) const
 {
     if (const Application *a = ApplicationManager::instance()->fromId(id)) {
-        if (const InstallationReport *report = a->installationReport())
-            return installationLocationFromId(report->installationLocationId());
+        if (a->hasInstallationReport())
+            return installationLocationFromId(a->installationLocationId());
     }
     return d->invalidInstallationLocation;
 }
@@ -693,7 +726,7 @@ void ApplicationInstaller::acknowledgePackageInstallation(const QString &taskId)
     AM_TRACE(LogInstaller, taskId)
 
     auto allTasks = d->taskQueue;
-    allTasks.append(d->activeTask);
+    allTasks.append(d->activeTasks);
 
     for (AsynchronousTask *task : qAsConst(allTasks)) {
         if (qobject_cast<InstallationTask *>(task) && (task->id() == taskId)) {
@@ -747,10 +780,10 @@ QString ApplicationInstaller::removePackage(const QString &id, bool keepDocument
 QString ApplicationInstaller::taskState(const QString &taskId)
 {
     auto allTasks = d->taskQueue;
-    allTasks.append(d->activeTask);
+    allTasks.append(d->activeTasks);
 
     for (const AsynchronousTask *task : qAsConst(allTasks)) {
-        if (task && (task->id() == taskId))
+        if (task->id() == taskId)
             return AsynchronousTask::stateToString(task->state());
     }
     return QString();
@@ -769,10 +802,10 @@ QString ApplicationInstaller::taskState(const QString &taskId)
 QString ApplicationInstaller::taskApplicationId(const QString &taskId)
 {
     auto allTasks = d->taskQueue;
-    allTasks.append(d->activeTask);
+    allTasks.append(d->activeTasks);
 
     for (const AsynchronousTask *task : qAsConst(allTasks)) {
-        if (task && (task->id() == taskId))
+        if (task->id() == taskId)
             return task->applicationId();
     }
     return QString();
@@ -789,8 +822,10 @@ bool ApplicationInstaller::cancelTask(const QString &taskId)
 {
     AM_TRACE(LogInstaller, taskId)
 
-    if (d->activeTask && d->activeTask->id() == taskId)
-        return d->activeTask->cancel();
+    for (AsynchronousTask *task : qAsConst(d->activeTasks)) {
+        if (task->id() == taskId)
+            return task->cancel();
+    }
 
     for (AsynchronousTask *task : qAsConst(d->taskQueue)) {
         if (task->id() == taskId) {
@@ -800,6 +835,7 @@ bool ApplicationInstaller::cancelTask(const QString &taskId)
             handleFailure(task);
 
             d->taskQueue.removeOne(task);
+            removePendingTask(task);
             triggerExecuteNextTask();
             return true;
         }
@@ -1090,6 +1126,10 @@ bool ApplicationInstaller::deactivatePackage(const QString &id)
 
 QString ApplicationInstaller::enqueueTask(AsynchronousTask *task)
 {
+    {
+        QMutexLocker locker(&d->applicationIdMutex);
+        d->pendingTasks.append(task);
+    }
     d->taskQueue.enqueue(task);
     triggerExecuteNextTask();
     return task->id();
@@ -1101,23 +1141,57 @@ void ApplicationInstaller::triggerExecuteNextTask()
         qCCritical(LogSystem) << "ERROR: failed to invoke method checkQueue";
 }
 
+static const InstallationLocation *installationLocationOfTask(const AsynchronousTask *task)
+{
+    if (auto installationTask = qobject_cast<const InstallationTask *>(task))
+        return &installationTask->installationLocation();
+    else if (auto deinstallationTask = qobject_cast<const DeinstallationTask *>(task))
+        return &deinstallationTask->installationLocation();
+    return nullptr;
+}
+
 void ApplicationInstaller::executeNextTask()
 {
-    if (d->activeTask || d->taskQueue.isEmpty())
-        return;
+    // Start as many queued tasks as we are allowed to. A task that conflicts with an active task
+    // keeps its place in the queue, but does not block the independent tasks queued after it.
+    // Tasks on the same removable location are always started in queue order though, since
+    // a running installation might be waiting in claimApplicationId() for a task queued before it.
+    // (we cannot use iterators here, since the signals emitted below could modify the queue)
+    QVector<const InstallationLocation *> skippedRemovableLocations;
 
-    AsynchronousTask *task = d->taskQueue.dequeue();
+    for (int i = 0; (i < d->taskQueue.size()) && (d->activeTasks.size() < d->maximumConcurrentTasks); ) {
+        AsynchronousTask *task = d->taskQueue.at(i);
 
-    if (task->hasFailed()) {
-        task->setState(AsynchronousTask::Failed);
+        if (task->hasFailed()) {
+            d->taskQueue.removeAt(i);
+            removePendingTask(task);
+            task->setState(AsynchronousTask::Failed);
 
-        handleFailure(task);
+            handleFailure(task);
 
-        task->deleteLater();
-        triggerExecuteNextTask();
-        return;
+            task->deleteLater();
+            continue;
+        }
+
+        const InstallationLocation *il = installationLocationOfTask(task);
+        bool removable = il && il->isRemovable();
+
+        if ((removable && std::any_of(skippedRemovableLocations.cbegin(), skippedRemovableLocations.cend(),
+                                      [il](const InstallationLocation *skipped) { return *skipped == *il; }))
+                || !canStartTask(task)) {
+            if (removable)
+                skippedRemovableLocations << il;
+            ++i;
+            continue;
+        }
+
+        d->taskQueue.removeAt(i);
+        startTask(task);
     }
+}
 
+void ApplicationInstaller::startTask(AsynchronousTask *task)
+{
     connect(task, &AsynchronousTask::started, this, [this, task]() {
         emit taskStarted(task->id());
     });
@@ -1145,8 +1219,7 @@ void ApplicationInstaller::executeNextTask()
             emit taskFinished(task->id());
         }
 
-        if (d->activeTask == task)
-            d->activeTask = nullptr;
+        releaseApplicationId(task);
 
         //task->deleteLater();
         delete task;
@@ -1160,12 +1233,155 @@ void ApplicationInstaller::executeNextTask()
         });
     }
 
+    {
+        QMutexLocker locker(&d->applicationIdMutex);
+        d->activeTasks.append(task);
+
+        // deinstallations know their application id right away: canStartTask() made sure that
+        // nobody else is handling this application at the moment
+        if (!task->applicationId().isEmpty())
+            d->claimedApplicationIds.insert(task, task->applicationId());
+    }
 
-    d->activeTask = task;
     task->setState(AsynchronousTask::Executing);
     task->start();
 }
 
+/*! \internal
+  Checks whether the queued \a task can be started in parallel to the currently active tasks.
+*/
+bool ApplicationInstaller::canStartTask(AsynchronousTask *task) const
+{
+    const InstallationLocation *il = installationLocationOfTask(task);
+
+    QMutexLocker locker(&d->applicationIdMutex);
+
+    for (AsynchronousTask *active : qAsConst(d->activeTasks)) {
+        // Removable locations need exclusive access to the medium, the loopback devices and the
+        // image mount-points, so we never run two tasks on them in parallel.
+        const InstallationLocation *activeIl = installationLocationOfTask(active);
+        if (il && activeIl && il->isRemovable() && (*il == *activeIl))
+            return false;
+
+        // The application id is only known upfront for deinstallations: these have to wait for
+        // active tasks handling the same application, as well as for active installations that
+        // were queued before them and do not know their application id yet, so that the order of
+        // requests is kept. Installations queued after them wait in claimApplicationId() instead.
+        if (!task->applicationId().isEmpty()) {
+            auto it = d->claimedApplicationIds.constFind(active);
+            if (it == d->claimedApplicationIds.cend()) {
+                if (qobject_cast<InstallationTask *>(active)
+                        && (d->pendingTasks.indexOf(active) < d->pendingTasks.indexOf(task))) {
+                    return false;
+                }
+            } else if (*it == task->applicationId()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*! \internal
+  Called by running installation tasks as soon as they know the application \a id they are
+  installing. This blocks until no other task is handling this application anymore, all
+  installation tasks that were queued before \a task have claimed their ids and all tasks for
+  the same application that were queued before \a task are done, so that tasks for the same
+  application are always processed in order.
+  Returns \c false, if the waiting was aborted, because \a isCanceled returned \c true.
+
+  This function is thread-safe.
+*/
+bool ApplicationInstaller::claimApplicationId(AsynchronousTask *task, const QString &id,
+                                              const std::function<bool()> &isCanceled)
+{
+    QMutexLocker locker(&d->applicationIdMutex);
+
+    forever {
+        if (isCanceled())
+            return false;
+
+        bool blocked = false;
+        for (AsynchronousTask *pending : qAsConst(d->pendingTasks)) {
+            if (pending == task)
+                break;
+            if (d->activeTasks.contains(pending)) {
+                // an installation that was queued before us could turn out to be for the same app
+                if (!d->claimedApplicationIds.contains(pending) && qobject_cast<InstallationTask *>(pending)) {
+                    blocked = true;
+                    break;
+                }
+            } else if (pending->applicationId() == id) {
+                // a deinstallation that was queued before us, but could not be started yet
+                blocked = true;
+                break;
+            }
+        }
+        if (!blocked) {
+            for (auto it = d->claimedApplicationIds.cbegin(); it != d->claimedApplicationIds.cend(); ++it) {
+                if ((it.key() != task) && (it.value() == id)) {
+                    blocked = true;
+                    break;
+                }
+            }
+        }
+        if (!blocked) {
+            d->claimedApplicationIds.insert(task, id);
+            return true;
+        }
+        d->applicationIdReleased.wait(&d->applicationIdMutex);
+    }
+}
+
+void ApplicationInstaller::releaseApplicationId(AsynchronousTask *task)
+{
+    QMutexLocker locker(&d->applicationIdMutex);
+    d->activeTasks.removeOne(task);
+    d->claimedApplicationIds.remove(task);
+    d->pendingTasks.removeOne(task);
+    d->applicationIdReleased.wakeAll();
+}
+
+/*! \internal
+  Needs to be called for tasks that are removed from the queue without ever being started.
+*/
+void ApplicationInstaller::removePendingTask(AsynchronousTask *task)
+{
+    QMutexLocker locker(&d->applicationIdMutex);
+    d->pendingTasks.removeOne(task);
+    d->applicationIdReleased.wakeAll();
+}
+
+/*! \internal
+  Needs to be called after canceling a task, since it might be waiting in claimApplicationId().
+*/
+void ApplicationInstaller::wakeApplicationIdWaiters()
+{
+    QMutexLocker locker(&d->applicationIdMutex);
+    d->applicationIdReleased.wakeAll();
+}
+
+/*! \internal
+  Called by installation tasks via a blocking queued connection, so this always runs in the main
+  thread: finding a free user-id and registering the application with the ApplicationManager has
+  to be one atomic step, since multiple installations can be running concurrently.
+  The ownership of \a installApp is transferred to the ApplicationManager. The assigned user-id
+  is returned in \a uid.
+*/
+bool ApplicationInstaller::startingApplicationInstallation(Application *installApp, uint *uid)
+{
+    QScopedPointer<Application> app(installApp);
+
+    try {
+        app->m_uid = findUnusedUserId();
+    } catch (const Exception &e) {
+        qCWarning(LogInstaller) << "Cannot install application" << app->id() << ":" << e.errorString();
+        return false;
+    }
+    *uid = app->m_uid;
+    return ApplicationManager::instance()->startingApplicationInstallation(app.take());
+}
+
 void ApplicationInstaller::handleFailure(AsynchronousTask *task)
 {
     qCDebug(LogInstaller) << "emit failed" << task->id() << task->errorCode() << task->errorString();
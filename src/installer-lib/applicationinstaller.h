@@ -46,6 +46,7 @@
 #include <QUrl>
 #include <QStringList>
 #include <QDir>
+#include <functional>
 #include <QtAppManCommon/error.h>
 #include <QtAppManInstaller/installationlocation.h>
 
@@ -54,6 +55,7 @@ QT_FORWARD_DECLARE_CLASS(QJSEngine)
 
 QT_BEGIN_NAMESPACE_AM
 
+class Application;
 class ApplicationManager;
 class ApplicationInstallerPrivate;
 class AsynchronousTask;
@@ -92,6 +94,9 @@ public:
 
     bool enableApplicationUserIdSeparation(uint minUserId, uint maxUserId, uint commonGroupId);
 
+    int maximumConcurrentTasks() const;
+    void setMaximumConcurrentTasks(int maximumConcurrentTasks);
+
     QDir manifestDirectory() const;
     QDir applicationImageMountDirectory() const;
 
@@ -150,11 +155,19 @@ signals:
 
 private slots:
     void executeNextTask();
+    bool startingApplicationInstallation(QT_PREPEND_NAMESPACE_AM(Application *) installApp, uint *uid);
 
 private:
     void triggerExecuteNextTask();
     QString enqueueTask(AsynchronousTask *task);
     void handleFailure(AsynchronousTask *task);
+    bool canStartTask(AsynchronousTask *task) const;
+    void startTask(AsynchronousTask *task);
+
+    bool claimApplicationId(AsynchronousTask *task, const QString &id, const std::function<bool()> &isCanceled);
+    void releaseApplicationId(AsynchronousTask *task);
+    void removePendingTask(AsynchronousTask *task);
+    void wakeApplicationIdWaiters();
 
     QList<QByteArray> caCertificates() const;
 
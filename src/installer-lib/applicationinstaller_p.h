@@ -42,6 +42,8 @@
 #pragma once
 
 #include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
 #include <QQueue>
 #include <QSet>
 #include <QThread>
@@ -74,7 +76,16 @@ public:
     QList<QByteArray> chainOfTrust;
 
     QQueue<AsynchronousTask *> taskQueue;
-    AsynchronousTask *activeTask = nullptr;
+    QList<AsynchronousTask *> activeTasks; // in the order they were started
+    int maximumConcurrentTasks = 1;
+
+    // Tasks are running in their own threads, but each application id may only be handled by one
+    // task at a time. Installation tasks only know their application id after they extracted the
+    // package header, so they need to claim it while already running.
+    QMutex applicationIdMutex;
+    QWaitCondition applicationIdReleased;
+    QHash<AsynchronousTask *, QString> claimedApplicationIds;
+    QList<AsynchronousTask *> pendingTasks; // queued and active, in the order they were queued
 
     QMutex activationLock;
     QMap<QString, QString> activatedPackages; // id -> installationPath
@@ -118,6 +118,8 @@ bool AsynchronousTask::forceCancel()
 
 QString AsynchronousTask::applicationId() const
 {
+    // installation tasks only set this while running (protected by m_mutex)
+    QMutexLocker locker(&m_mutex);
     return m_applicationId;
 }
 
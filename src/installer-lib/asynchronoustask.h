@@ -93,7 +93,7 @@ protected:
     void run() override final;
 
 protected:
-    QMutex m_mutex;
+    mutable QMutex m_mutex;
 
     QString m_id;
     QString m_applicationId;
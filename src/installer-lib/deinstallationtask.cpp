@@ -62,6 +62,11 @@ DeinstallationTask::DeinstallationTask(const Application *app, const Installatio
     m_applicationId = m_app->id(); // in base class
 }
 
+const InstallationLocation &DeinstallationTask::installationLocation() const
+{
+    return m_installationLocation;
+}
+
 void DeinstallationTask::execute()
 {
     // these have been checked in ApplicationInstaller::removePackage() already
@@ -55,6 +55,9 @@ class DeinstallationTask : public AsynchronousTask
 public:
     DeinstallationTask(const Application *app, const InstallationLocation &installationLocation,
                        bool forceDeinstallation, bool keepDocuments, QObject *parent = nullptr);
+
+    const InstallationLocation &installationLocation() const;
+
 protected:
     void execute() override;
 
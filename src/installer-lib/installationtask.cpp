@@ -157,6 +157,11 @@ InstallationTask::InstallationTask(const InstallationLocation &installationLocat
 InstallationTask::~InstallationTask()
 { }
 
+const InstallationLocation &InstallationTask::installationLocation() const
+{
+    return m_installationLocation;
+}
+
 bool InstallationTask::cancel()
 {
     QMutexLocker locker(&m_mutex);
@@ -169,6 +174,11 @@ bool InstallationTask::cancel()
     if (m_extractor)
         m_extractor->cancel();
     m_installationAcknowledgeWaitCondition.wakeAll();
+    locker.unlock();
+
+    // we might be waiting for another task handling the same application
+    // (this needs to be done without holding m_mutex - see checkExtractedFile())
+    m_ai->wakeApplicationIdWaiters();
     return true;
 }
 
@@ -249,8 +259,8 @@ void InstallationTask::execute()
 
         setState(Installing);
 
-        // if we would allow parallel installations - this would be the place to serialize them
-
+        // parallel installations of the same application have already been serialized in
+        // checkExtractedFile(), so we are free to finish the installation now
         finishInstallation();
 
         // At this point, the installation is done, so we cannot throw anymore.
@@ -311,7 +321,21 @@ void InstallationTask::checkExtractedFile(const QString &file) Q_DECL_NOEXCEPT_E
         }
 
         m_app->m_builtIn = false;
-        m_applicationId = m_app->id();
+
+        // Other tasks could be handling the same application right now: wait for them to finish,
+        // before we start to touch anything that belongs to this application.
+        // (the wait is aborted by cancel(), which wakes us up after setting m_canceled)
+        bool claimed = m_ai->claimApplicationId(this, m_app->id(), [this]() {
+            QMutexLocker locker(&m_mutex);
+            return m_canceled;
+        });
+        if (!claimed)
+            throw Exception(Error::Canceled, "canceled");
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_applicationId = m_app->id();
+        }
 
         m_foundInfo = true;
     } else if (file == qL1S("icon.png")) {
@@ -348,22 +372,21 @@ void InstallationTask::checkExtractedFile(const QString &file) Q_DECL_NOEXCEPT_E
             else
                 m_app->setCodeDir(path);
         }
-        // we need to find a free uid before we call startingApplicationInstallation
-        m_app->m_uid = m_ai->findUnusedUserId();
-        m_applicationUid = m_app->m_uid;
-
-        // we need to call those ApplicationManager methods in the correct thread
-        // this will also exclusively lock the application for us
+        // we need to call those ApplicationInstaller/ApplicationManager methods in the correct
+        // thread: this will find a free uid (race-free, even with concurrent installations) and
+        // also exclusively lock the application for us
         // m_app ownership is transferred to the ApplicationManager
-        m_app->moveToThread(ApplicationManager::instance()->thread());
-        QMetaObject::invokeMethod(ApplicationManager::instance(),
+        QString appId = m_app->id();
+        m_app->moveToThread(m_ai->thread());
+        QMetaObject::invokeMethod(m_ai,
                                   "startingApplicationInstallation",
                                   Qt::BlockingQueuedConnection,
                                   Q_RETURN_ARG(bool, m_managerApproval),
                                   // ugly, but Q_ARG chokes on QT_PREPEND_NAMESPACE_AM...
-                                  QArgument<QT_PREPEND_NAMESPACE_AM(Application *)>(QT_STRINGIFY(QT_PREPEND_NAMESPACE_AM(Application *)), m_app.take()));
+                                  QArgument<QT_PREPEND_NAMESPACE_AM(Application *)>(QT_STRINGIFY(QT_PREPEND_NAMESPACE_AM(Application *)), m_app.take()),
+                                  Q_ARG(uint *, &m_applicationUid));
         if (!m_managerApproval)
-            throw Exception("Application Manager declined the installation of %1").arg(m_app->id());
+            throw Exception("Application Manager declined the installation of %1").arg(appId);
 
         // we're not interested in any other files from here on...
         m_extractor->setFileExtractedCallback(nullptr);
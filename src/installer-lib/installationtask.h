@@ -65,6 +65,8 @@ public:
                      QObject *parent = nullptr);
     ~InstallationTask();
 
+    const InstallationLocation &installationLocation() const;
+
     void acknowledge();
     bool cancel() override;
 
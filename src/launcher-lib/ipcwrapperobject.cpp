@@ -43,13 +43,22 @@
 #include <QMetaMethod>
 #include <QDBusInterface>
 #include <QDBusArgument>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusUnixFileDescriptor>
+#include <QXmlStreamReader>
+#include <QTimer>
 #include <private/qmetaobjectbuilder_p.h>
 #include <QDebug>
 #include <QJSValue>
 #include <QUrl>
 
 #include "global.h"
+#include "logging.h"
 #include "dbus-utilities.h"
+#include "exception.h"
+#include "sharedmemoryring.h"
 #include "ipcwrapperobject.h"
 #include "ipcwrapperobject_p.h"
 
@@ -170,6 +179,8 @@ static QString stringify(const QVariant &value, int level, bool indentFirstLine)
 
 QT_BEGIN_NAMESPACE_AM
 
+static const int sharedMemoryMaxBacklog = 64 * 1024;
+
 QVector<QMetaObject *> IpcWrapperObject::s_allMetaObjects;
 
 IpcWrapperObject::IpcWrapperObject(const QString &service, const QString &path, const QString &interface, const QDBusConnection &connection, QObject *parent)
@@ -246,6 +257,8 @@ IpcWrapperObject::IpcWrapperObject(const QString &service, const QString &path,
         atexit([]() { std::for_each(s_allMetaObjects.cbegin(), s_allMetaObjects.cend(), free); });
     }
     s_allMetaObjects << m_metaObject;
+
+    initPropertyCache();
 }
 
 IpcWrapperObject::~IpcWrapperObject()
@@ -264,6 +277,38 @@ QDBusError IpcWrapperObject::lastDBusError() const
     return m_dbusInterface->lastError();
 }
 
+QDBusPendingCall IpcWrapperObject::asyncCall(const QString &method, const QVariantList &args)
+{
+    const QMetaObject *dbusmo = m_dbusInterface->metaObject();
+    const QByteArray name = method.toUtf8();
+
+    for (int i = dbusmo->methodOffset(); i < dbusmo->methodCount(); ++i) {
+        QMetaMethod mm = dbusmo->method(i);
+        if ((mm.methodType() == QMetaMethod::Signal) || (mm.name() != name)
+                || (mm.parameterCount() != args.size())) {
+            continue;
+        }
+
+        QList<QVariant> dbusArgs;
+        for (int ai = 0; ai < args.size(); ++ai) {
+            QVariant value = convertFromJSVariant(args.at(ai));
+            int type = mm.parameterType(ai);
+
+            if (type == qMetaTypeId<QDBusVariant>()) {
+                value = QVariant::fromValue(QDBusVariant(value));
+            } else if ((value.userType() != type) && !value.convert(type)) {
+                return QDBusPendingCall::fromError(QDBusError(QDBusError::InvalidArgs,
+                    qSL("cannot convert parameter %1 of %2 to %3").arg(ai + 1).arg(method)
+                                                                  .arg(qL1S(QMetaType::typeName(type)))));
+            }
+            dbusArgs << value;
+        }
+        return m_dbusInterface->asyncCallWithArgumentList(method, dbusArgs);
+    }
+    return QDBusPendingCall::fromError(QDBusError(QDBusError::UnknownMethod,
+                                                  qSL("no method %1 taking %2 parameters").arg(method).arg(args.size())));
+}
+
 const QMetaObject *IpcWrapperObject::metaObject() const
 {
     return m_metaObject;
@@ -287,11 +332,19 @@ int IpcWrapperObject::qt_metacall(QMetaObject::Call _c, int _id, void **_a)
 
     switch (_c) {
     case QMetaObject::ReadProperty: {
-        QMetaProperty dbusmp = dbusmo->property(dbusmo->propertyOffset() + _id);
         QMetaProperty mp = metaObject()->property(metaObject()->propertyOffset() + _id);
-        QVariant value = dbusmp.read(m_dbusInterface);
-        value = convertFromDBusVariant(value);
-        QMetaType::construct(mp.type(), _a[0], value.data());
+        QVariant value;
+        if (m_propertyCached.testBit(_id)) {
+            value = m_propertyCache.at(_id);
+        } else {
+            // not cached (yet) - the only option is a synchronous round-trip
+            QMetaProperty dbusmp = dbusmo->property(dbusmo->propertyOffset() + _id);
+            value = convertFromDBusVariant(dbusmp.read(m_dbusInterface));
+        }
+        if (mp.userType() == QMetaType::QVariant)
+            *reinterpret_cast<QVariant *>(_a[0]) = value;
+        else
+            QMetaType::construct(mp.type(), _a[0], value.data());
         break;
     }
     case QMetaObject::WriteProperty: {
@@ -301,15 +354,38 @@ int IpcWrapperObject::qt_metacall(QMetaObject::Call _c, int _id, void **_a)
             valueType = QMetaType::QVariant;
         QVariant value(valueType, _a[0]);
         value = convertFromJSVariant(value);
-        if (mp.userType() == qMetaTypeId<QDBusVariant>()) {
-            QDBusVariant dbv = QDBusVariant(value);
-            value = QVariant::fromValue(dbv);
+        bool written;
+        int inputMember = m_sharedMemoryInputRing ? m_sharedMemoryInputProperties.value(_id, -1) : -1;
+        if (inputMember >= 0) {
+            written = sendSharedMemoryMessage(inputMember, { value });
+        } else {
+            if (mp.userType() == qMetaTypeId<QDBusVariant>()) {
+                QDBusVariant dbv = QDBusVariant(value);
+                value = QVariant::fromValue(dbv);
+            }
+            written = mp.write(m_dbusInterface, value);
         }
+        // the server will only tell us, if the value actually changed, so we have to remember
+        // what we wrote. Any late PropertiesChanged signals will still arrive in order.
+        if (written && m_propertyCacheable.testBit(_id))
+            updatePropertyCache(_id, value);
         // the boolean 'was-successful' return code is stored in _a[1]
-        _a[1] = mp.write(m_dbusInterface, value) ? (void *) 1 : (void *) 0;
+        _a[1] = written ? (void *) 1 : (void *) 0;
         break;
     }
     case QMetaObject::InvokeMetaMethod: {
+        int inputMember = m_sharedMemoryInputRing
+                ? m_sharedMemoryInputMethods.value(metaObject()->methodOffset() + _id, -1) : -1;
+        if (inputMember >= 0) {
+            // void methods do not need to wait for a reply
+            QMetaMethod mm = metaObject()->method(metaObject()->methodOffset() + _id);
+            QVariantList args;
+            for (int i = 0; i < mm.parameterCount(); ++i)
+                args << convertFromJSVariant(QVariant(mm.parameterType(i), _a[i + 1]));
+            sendSharedMemoryMessage(inputMember, args);
+            break;
+        }
+
         QByteArray name = metaObject()->method(metaObject()->methodOffset() + _id).methodSignature();
         QMetaMethod mm = dbusmo->method(dbusmo->indexOfMethod(name));
 
@@ -336,23 +412,385 @@ int IpcWrapperObject::qt_metacall(QMetaObject::Call _c, int _id, void **_a)
 
 void IpcWrapperObject::onPropertiesChanged(const QString &interfaceName, const QVariantMap &changed, const QStringList &invalidated)
 {
-    auto emitSignal = [this](const QString &propertyName) {
-        int idx = metaObject()->indexOfProperty(propertyName.toUtf8());
-        if (idx == -1)
-            return;
-
-        QMetaProperty prop = metaObject()->property(idx);
+    auto emitSignal = [this](int index) {
+        QMetaProperty prop = metaObject()->property(metaObject()->propertyOffset() + index);
         if (prop.hasNotifySignal())
             metaObject()->activate(this, prop.notifySignalIndex(), nullptr);
     };
 
-
     if (interfaceName == m_dbusInterface->interface()) {
-        for (auto it = changed.cbegin(); it != changed.cend(); ++it)
-            emitSignal(it.key());
-        for (auto it = invalidated.cbegin(); it != invalidated.cend(); ++it)
-            emitSignal(*it);
+        for (auto it = changed.cbegin(); it != changed.cend(); ++it) {
+            int index = propertyIndex(it.key());
+            if (index < 0)
+                continue;
+            // a server sending us the value obviously emits change signals for this property
+            m_propertyCacheable.setBit(index);
+            updatePropertyCache(index, it.value());
+            emitSignal(index);
+        }
+        for (auto it = invalidated.cbegin(); it != invalidated.cend(); ++it) {
+            int index = propertyIndex(*it);
+            if (index < 0)
+                continue;
+            m_propertyCached.clearBit(index);
+            m_propertyCache[index] = QVariant();
+            if (m_propertyCacheable.testBit(index))
+                fetchProperty(index);
+            emitSignal(index);
+        }
+    }
+}
+
+/*! \internal
+    The property cache is only ever filled from messages that are delivered via the event loop
+    (GetAll and Get replies, PropertiesChanged signals): the D-Bus guarantees that these arrive in
+    the order the server sent them, so a newer value can never be overwritten by an older one.
+    This is not true for the synchronous fallback in qt_metacall(): signals that were received
+    while blocking are only delivered afterwards, so these values are never cached.
+
+    Properties are only cached, if the server announces that it is emitting change signals for
+    them: this is the default for D-Bus, but can be overridden per property via the
+    \c{org.freedesktop.DBus.Property.EmitsChangedSignal} annotation.
+
+    The introspection data also tells us, if the server is able to send some signals and
+    property changes via a shared memory ring buffer instead of the D-Bus.
+*/
+void IpcWrapperObject::initPropertyCache()
+{
+    int count = m_metaObject->propertyCount() - m_metaObject->propertyOffset();
+    m_propertyCache.resize(count);
+    m_propertyCached.resize(count);
+    m_propertyCacheable.resize(count);
+    m_propertyFetching.resize(count);
+
+    QDBusMessage introspect = QDBusMessage::createMethodCall(m_dbusInterface->service(), m_dbusInterface->path(),
+                                                             qSL("org.freedesktop.DBus.Introspectable"),
+                                                             qSL("Introspect"));
+    auto watcher = new QDBusPendingCallWatcher(m_dbusInterface->connection().asyncCall(introspect), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     this, [this](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+
+        QDBusPendingReply<QString> reply = *watcher;
+        if (reply.isError()) {
+            qCWarning(LogQmlIpc) << "Could not introspect" << m_dbusInterface->interface()
+                                 << "- all property reads will be synchronous:" << reply.error().message();
+            return;
+        }
+        parseIntrospection(reply.value());
+        if (!m_propertyCache.isEmpty())
+            fetchAllProperties();
+        // the Open call is queued after GetAll, so the ring buffer can only contain newer values
+        if (m_sharedMemoryOffered && SharedMemoryRing::isSupported())
+            openSharedMemoryTransport();
+    });
+}
+
+void IpcWrapperObject::parseIntrospection(const QString &xml)
+{
+    QXmlStreamReader reader(xml);
+    bool inInterface = false;
+    int index = -1;
+
+    while (!reader.atEnd()) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::StartElement: {
+            const QXmlStreamAttributes attributes = reader.attributes();
+
+            if (reader.name() == qL1S("interface")) {
+                inInterface = (attributes.value(qL1S("name")) == m_dbusInterface->interface());
+            } else if (inInterface && (reader.name() == qL1S("property"))) {
+                index = propertyIndex(attributes.value(qL1S("name")).toString());
+                if (index >= 0)
+                    m_propertyCacheable.setBit(index);
+            } else if (inInterface && (reader.name() == qL1S("annotation"))
+                       && (attributes.value(qL1S("name")) == qL1S("io.qt.ApplicationManager.Transport"))) {
+                if (attributes.value(qL1S("value")) == qL1S("shared-memory"))
+                    m_sharedMemoryOffered = true;
+            } else if ((index >= 0) && (reader.name() == qL1S("annotation"))
+                       && (attributes.value(qL1S("name")) == qL1S("org.freedesktop.DBus.Property.EmitsChangedSignal"))
+                       && (attributes.value(qL1S("value")) == qL1S("false"))) {
+                m_propertyCacheable.clearBit(index);
+            }
+            break;
+        }
+        case QXmlStreamReader::EndElement:
+            if (reader.name() == qL1S("property"))
+                index = -1;
+            else if (reader.name() == qL1S("interface"))
+                inInterface = false;
+            break;
+        default:
+            break;
+        }
+    }
+    if (reader.hasError()) {
+        qCWarning(LogQmlIpc) << "Could not parse the introspection data of" << m_dbusInterface->interface()
+                             << "- all property reads will be synchronous:" << reader.errorString();
+        m_propertyCacheable.fill(false);
+    }
+}
+
+void IpcWrapperObject::fetchAllProperties()
+{
+    QDBusMessage getAll = QDBusMessage::createMethodCall(m_dbusInterface->service(), m_dbusInterface->path(),
+                                                         qSL("org.freedesktop.DBus.Properties"), qSL("GetAll"));
+    getAll << m_dbusInterface->interface();
+
+    auto watcher = new QDBusPendingCallWatcher(m_dbusInterface->connection().asyncCall(getAll), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     this, [this](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+
+        QDBusPendingReply<QVariantMap> reply = *watcher;
+        if (reply.isError()) {
+            // older servers do not implement GetAll, so we fall back to fetching one by one
+            for (int index = 0; index < m_propertyCacheable.size(); ++index) {
+                if (m_propertyCacheable.testBit(index))
+                    fetchProperty(index);
+            }
+            return;
+        }
+        const QVariantMap values = reply.value();
+        for (auto it = values.cbegin(); it != values.cend(); ++it) {
+            int index = propertyIndex(it.key());
+            if ((index >= 0) && m_propertyCacheable.testBit(index))
+                updatePropertyCache(index, it.value());
+        }
+    });
+}
+
+void IpcWrapperObject::fetchProperty(int index)
+{
+    if (m_propertyFetching.testBit(index))
+        return;
+    m_propertyFetching.setBit(index);
+
+    QDBusMessage get = QDBusMessage::createMethodCall(m_dbusInterface->service(), m_dbusInterface->path(),
+                                                      qSL("org.freedesktop.DBus.Properties"), qSL("Get"));
+    get << m_dbusInterface->interface()
+        << qL1S(m_metaObject->property(m_metaObject->propertyOffset() + index).name());
+
+    auto watcher = new QDBusPendingCallWatcher(m_dbusInterface->connection().asyncCall(get), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     this, [this, index](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+        m_propertyFetching.clearBit(index);
+
+        QDBusPendingReply<QDBusVariant> reply = *watcher;
+        if (!reply.isError())
+            updatePropertyCache(index, QVariant::fromValue(reply.value()));
+    });
+}
+
+void IpcWrapperObject::updatePropertyCache(int index, const QVariant &dbusValue)
+{
+    QVariant value = convertFromDBusVariant(dbusValue);
+    int type = m_metaObject->property(m_metaObject->propertyOffset() + index).userType();
+    if ((type != QMetaType::QVariant) && (value.userType() != type))
+        value.convert(type);
+
+    m_propertyCache[index] = value;
+    m_propertyCached.setBit(index);
+}
+
+int IpcWrapperObject::propertyIndex(const QString &name) const
+{
+    int index = m_metaObject->indexOfProperty(name.toUtf8());
+    return (index < m_metaObject->propertyOffset()) ? -1 : index - m_metaObject->propertyOffset();
+}
+
+/*! \internal
+    The server only opens a shared memory transport on request: the reply contains the file
+    descriptors of two memfds and their eventfds, plus the names of the members that will be sent
+    via the first ring buffer from now on and the names of the void methods and writable
+    properties we can call and set via the second one. Everything else stays on the D-Bus.
+    If anything goes wrong here, both sides will simply continue to use the D-Bus.
+*/
+void IpcWrapperObject::openSharedMemoryTransport()
+{
+    if (!m_dbusInterface->connection().connectionCapabilities().testFlag(QDBusConnection::UnixFileDescriptorPassing))
+        return;
+
+    QDBusMessage open = QDBusMessage::createMethodCall(m_dbusInterface->service(), m_dbusInterface->path(),
+                                                       qSL("io.qt.ApplicationManager.SharedMemoryTransport"),
+                                                       qSL("Open"));
+    auto watcher = new QDBusPendingCallWatcher(m_dbusInterface->connection().asyncCall(open), this);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished,
+                     this, [this](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+
+        const QDBusMessage reply = watcher->reply();
+        if (reply.type() != QDBusMessage::ReplyMessage) {
+            qCWarning(LogQmlIpc) << "Could not open the shared memory transport of" << m_dbusInterface->interface()
+                                 << ":" << reply.errorMessage();
+            return;
+        }
+        const QVariantList arguments = reply.arguments();
+        if (arguments.size() != 8) {
+            qCWarning(LogQmlIpc) << "Could not open the shared memory transport of" << m_dbusInterface->interface()
+                                 << ": invalid reply";
+            return;
+        }
+        auto fd = [&arguments](int i) { return arguments.at(i).value<QDBusUnixFileDescriptor>().fileDescriptor(); };
+
+        try {
+            QScopedPointer<SharedMemoryRing> ring(SharedMemoryRing::attach(SharedMemoryRing::Consumer,
+                                                                           fd(0), fd(1), fd(2), this));
+            QScopedPointer<SharedMemoryRing> inputRing(SharedMemoryRing::attach(SharedMemoryRing::Producer,
+                                                                                fd(3), fd(4), fd(5), this));
+            delete m_sharedMemoryRing;
+            delete m_sharedMemoryInputRing;
+            m_sharedMemoryRing = ring.take();
+            m_sharedMemoryInputRing = inputRing.take();
+            m_sharedMemoryBacklog.clear();
+        } catch (const Exception &e) {
+            qCWarning(LogQmlIpc) << "Could not attach to the shared memory transport of"
+                                 << m_dbusInterface->interface() << ":" << e.errorString();
+            return;
+        }
+
+        const QStringList names = arguments.at(6).toStringList();
+        m_sharedMemoryMembers.clear();
+        for (const QString &name : names) {
+            SharedMemoryMember member;
+            member.propertyIndex = propertyIndex(name);
+
+            const QByteArray signalName = name.toUtf8();
+            for (int i = m_metaObject->methodOffset(); i < m_metaObject->methodCount(); ++i) {
+                QMetaMethod mm = m_metaObject->method(i);
+                if ((mm.methodType() == QMetaMethod::Signal) && (mm.name() == signalName)) {
+                    member.signalIndex = i;
+                    break;
+                }
+            }
+            m_sharedMemoryMembers << member;
+        }
+
+        const QStringList inputNames = arguments.at(7).toStringList();
+        m_sharedMemoryInputMethods.clear();
+        m_sharedMemoryInputProperties.clear();
+        for (int member = 0; member < inputNames.size(); ++member) {
+            const QString &name = inputNames.at(member);
+            int index = propertyIndex(name);
+            if (index >= 0) {
+                m_sharedMemoryInputProperties.insert(index, member);
+                continue;
+            }
+            const QByteArray methodName = name.toUtf8();
+            for (int i = m_metaObject->methodOffset(); i < m_metaObject->methodCount(); ++i) {
+                QMetaMethod mm = m_metaObject->method(i);
+                if ((mm.methodType() != QMetaMethod::Signal) && (mm.name() == methodName)
+                        && (mm.returnType() == QMetaType::Void)) {
+                    m_sharedMemoryInputMethods.insert(i, member);
+                }
+            }
+        }
+
+        QObject::connect(m_sharedMemoryRing, &SharedMemoryRing::readyRead,
+                         this, [this]() { readSharedMemoryTransport(); });
+        QObject::connect(m_sharedMemoryInputRing, &SharedMemoryRing::spaceAvailable,
+                         this, [this]() {
+            if (writeSharedMemoryBacklog())
+                m_sharedMemoryInputRing->notify();
+        });
+        // the server might have been quicker than us
+        readSharedMemoryTransport();
+    });
+}
+
+void IpcWrapperObject::readSharedMemoryTransport()
+{
+    QByteArray data;
+    while (m_sharedMemoryRing && m_sharedMemoryRing->read(&data)) {
+        int memberId;
+        QVariantList arguments;
+        if (!SharedMemoryRing::decodeMessage(data, &memberId, &arguments)
+                || (memberId < 0) || (memberId >= m_sharedMemoryMembers.size())) {
+            qCWarning(LogQmlIpc) << "Received an invalid message via the shared memory transport of"
+                                 << m_dbusInterface->interface();
+            continue;
+        }
+        const SharedMemoryMember &member = m_sharedMemoryMembers.at(memberId);
+
+        if ((member.propertyIndex >= 0) && (arguments.size() == 1)) {
+            m_propertyCacheable.setBit(member.propertyIndex);
+            updatePropertyCache(member.propertyIndex, arguments.constFirst());
+            QMetaProperty prop = m_metaObject->property(m_metaObject->propertyOffset() + member.propertyIndex);
+            if (prop.hasNotifySignal())
+                QMetaObject::activate(this, prop.notifySignalIndex(), nullptr);
+        } else if (member.signalIndex >= 0) {
+            QMetaMethod mm = m_metaObject->method(member.signalIndex);
+            if (mm.parameterCount() != arguments.size())
+                continue;
+
+            QVector<void *> argv(arguments.size() + 1, nullptr);
+            for (int i = 0; i < arguments.size(); ++i) {
+                QVariant &value = arguments[i];
+                value = convertFromDBusVariant(value);
+                int type = mm.parameterType(i);
+                if (type == QMetaType::QVariant) {
+                    argv[i + 1] = &value;
+                } else {
+                    if ((value.userType() != type) && !value.convert(type))
+                        value = QVariant(type, nullptr);
+                    argv[i + 1] = value.data();
+                }
+            }
+            QMetaObject::activate(this, member.signalIndex, argv.data());
+        }
+    }
+}
+
+/*! \internal
+    Messages are queued in the ring buffer right away, but the server is only woken up once per
+    event loop iteration. Since there is no reply, the only errors we can report are an overflow
+    and arguments that the wire format does not support.
+*/
+bool IpcWrapperObject::sendSharedMemoryMessage(int member, const QVariantList &arguments)
+{
+    // do not only rely on spaceAvailable: the server might have caught up in the meantime
+    writeSharedMemoryBacklog();
+
+    const QByteArray message = SharedMemoryRing::encodeMessage(member, arguments);
+    if (message.isNull()) {
+        qCWarning(LogQmlIpc) << "Could not send a message via the shared memory transport of"
+                             << m_dbusInterface->interface() << ": unsupported argument type";
+        return false;
+    }
+    // the backlog keeps the message order intact, while the server is catching up
+    if (!m_sharedMemoryBacklog.isEmpty() || !m_sharedMemoryInputRing->write(message)) {
+        if (m_sharedMemoryBacklog.size() >= sharedMemoryMaxBacklog) {
+            qCWarning(LogQmlIpc) << "The shared memory transport of" << m_dbusInterface->interface()
+                                 << "is overflowing: dropping a message";
+            return false;
+        }
+        m_sharedMemoryBacklog << message;
+    }
+    if (!m_sharedMemoryFlushScheduled) {
+        m_sharedMemoryFlushScheduled = true;
+        QTimer::singleShot(0, this, [this]() { flushSharedMemoryTransport(); });
+    }
+    return true;
+}
+
+bool IpcWrapperObject::writeSharedMemoryBacklog()
+{
+    bool written = false;
+    while (!m_sharedMemoryBacklog.isEmpty() && m_sharedMemoryInputRing->write(m_sharedMemoryBacklog.constFirst())) {
+        m_sharedMemoryBacklog.removeFirst();
+        written = true;
     }
+    return written;
+}
+
+void IpcWrapperObject::flushSharedMemoryTransport()
+{
+    m_sharedMemoryFlushScheduled = false;
+    if (!m_sharedMemoryInputRing)
+        return;
+    writeSharedMemoryBacklog();
+    m_sharedMemoryInputRing->notify();
 }
 
 
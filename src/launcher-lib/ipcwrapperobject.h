@@ -43,6 +43,11 @@
 
 #include <QObject>
 #include <QDBusError>
+#include <QDBusPendingCall>
+#include <QBitArray>
+#include <QVector>
+#include <QHash>
+#include <QVariant>
 #include <QtAppManCommon/global.h>
 
 QT_FORWARD_DECLARE_CLASS(QDBusInterface)
@@ -55,6 +60,7 @@ QT_FORWARD_DECLARE_CLASS(QDBusConnection)
 QT_BEGIN_NAMESPACE_AM
 
 class IpcWrapperSignalRelay;
+class SharedMemoryRing;
 
 class IpcWrapperObject : public QObject // clazy:exclude=missing-qobject-macro
 {
@@ -67,6 +73,8 @@ public:
     bool isDBusValid() const;
     QDBusError lastDBusError() const;
 
+    QDBusPendingCall asyncCall(const QString &method, const QVariantList &args);
+
     const QMetaObject *metaObject() const override;
     int qt_metacall(QMetaObject::Call _c, int _id, void **_a) override;
 
@@ -76,10 +84,45 @@ public:
                              const QStringList &invalidated);
 
 private:
+    void initPropertyCache();
+    void parseIntrospection(const QString &xml);
+    void fetchAllProperties();
+    void fetchProperty(int index);
+    void updatePropertyCache(int index, const QVariant &dbusValue);
+    int propertyIndex(const QString &name) const;
+    void openSharedMemoryTransport();
+    void readSharedMemoryTransport();
+    bool sendSharedMemoryMessage(int member, const QVariantList &arguments);
+    bool writeSharedMemoryBacklog();
+    void flushSharedMemoryTransport();
+
     QMetaObject *m_metaObject;
     IpcWrapperSignalRelay *m_wrapperHelper;
     QDBusInterface *m_dbusInterface;
 
+    // all of these are indexed by the property index relative to the property offset
+    QVector<QVariant> m_propertyCache;
+    QBitArray m_propertyCached;
+    QBitArray m_propertyCacheable;
+    QBitArray m_propertyFetching;
+
+    // signals and properties the server wants to send via a shared memory ring buffer
+    struct SharedMemoryMember
+    {
+        int propertyIndex = -1; // relative, like above
+        int signalIndex = -1;   // absolute
+    };
+    bool m_sharedMemoryOffered = false;
+    SharedMemoryRing *m_sharedMemoryRing = nullptr;
+    QVector<SharedMemoryMember> m_sharedMemoryMembers;
+
+    // void methods and writable properties we can call / set via a second ring buffer
+    SharedMemoryRing *m_sharedMemoryInputRing = nullptr;
+    QHash<int, int> m_sharedMemoryInputMethods;    // method index (absolute) -> member
+    QHash<int, int> m_sharedMemoryInputProperties; // property index (relative) -> member
+    QList<QByteArray> m_sharedMemoryBacklog;       // used when the ring buffer is full
+    bool m_sharedMemoryFlushScheduled = false;
+
     static QVector<QMetaObject *> s_allMetaObjects;
 };
 
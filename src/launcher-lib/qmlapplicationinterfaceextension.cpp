@@ -40,8 +40,11 @@
 ****************************************************************************/
 
 #include <QDBusInterface>
+#include <QDBusPendingCallWatcher>
+#include <QQmlEngine>
 
 #include "logging.h"
+#include "dbus-utilities.h"
 #include "qmlapplicationinterfaceextension.h"
 #include "qmlapplicationinterface.h"
 #include "ipcwrapperobject.h"
@@ -153,6 +156,46 @@ void QmlApplicationInterfaceExtension::tryInit()
     emit readyChanged();
 }
 
+void QmlApplicationInterfaceExtension::callAsync(const QString &method, const QVariantList &args,
+                                                 const QJSValue &callback)
+{
+    if (!m_object) {
+        qCWarning(LogQmlIpc) << "Cannot call" << method << "on ApplicationInterfaceExtension" << m_name
+                             << "before it is ready.";
+        return;
+    }
+
+    auto ext = static_cast<IpcWrapperObject *>(m_object);
+    auto watcher = new QDBusPendingCallWatcher(ext->asyncCall(method, args), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, [this, method, callback](QDBusPendingCallWatcher *watcher) mutable {
+        watcher->deleteLater();
+
+        if (watcher->isError()) {
+            if (callback.isCallable()) {
+                callback.call({ QJSValue(QJSValue::UndefinedValue), QJSValue(watcher->error().message()) });
+            } else {
+                qCWarning(LogQmlIpc) << "Asynchronous call of" << method << "on ApplicationInterfaceExtension"
+                                     << m_name << "failed:" << watcher->error().message();
+            }
+            return;
+        }
+        if (!callback.isCallable())
+            return;
+
+        QVariant result;
+        const QList<QVariant> replyArgs = watcher->reply().arguments();
+        if (!replyArgs.isEmpty())
+            result = convertFromDBusVariant(replyArgs.at(0));
+
+        QJSEngine *engine = qmlEngine(this);
+        QJSValue jsResult = callback.call({ engine ? engine->toScriptValue(result)
+                                                   : QJSValue(QJSValue::UndefinedValue) });
+        if (jsResult.isError())
+            qCWarning(LogQmlIpc) << "The callback for" << method << "threw an exception:" << jsResult.toString();
+    });
+}
+
 void QmlApplicationInterfaceExtension::setName(const QString &name)
 {
     if (!m_complete) {
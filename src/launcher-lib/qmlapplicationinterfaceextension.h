@@ -43,6 +43,7 @@
 
 #include <QQmlParserStatus>
 #include <QObject>
+#include <QJSValue>
 #include <QtAppManCommon/global.h>
 
 QT_FORWARD_DECLARE_CLASS(QDBusConnection)
@@ -71,6 +72,9 @@ public:
     bool isReady() const;
     QObject *object() const;
 
+    Q_INVOKABLE void callAsync(const QString &method, const QVariantList &args = QVariantList(),
+                               const QJSValue &callback = QJSValue());
+
 protected:
     void classBegin() override;
     void componentComplete() override;
@@ -0,0 +1,369 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#include "launcherforkserver.h"
+
+#if !defined(Q_OS_LINUX)
+
+QT_BEGIN_NAMESPACE_AM
+
+void LauncherForkServer::runIfRequested(int &, char **&, const std::function<void()> &)
+{ }
+
+QT_END_NAMESPACE_AM
+
+#else
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLibraryInfo>
+#include <QStringList>
+#include <QVector>
+
+#include "global.h"
+#include "logging.h"
+#include "utilities.h"
+#include "qtyaml.h"
+#include "processtitle.h"
+#include "forkserverprotocol.h"
+
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+QT_BEGIN_NAMESPACE_AM
+
+// same lookup order as the QML engine: the most specific version first
+static QStringList qmlPluginLibraries(const QString &import, const QStringList &importPaths)
+{
+    const QStringList parts = import.simplified().split(qL1C(' '));
+    const QString uriPath = QString(parts.value(0)).replace(qL1C('.'), qL1C('/'));
+    const QStringList version = parts.value(1).split(qL1C('.'));
+
+    QStringList candidates;
+    if (version.size() >= 2)
+        candidates << uriPath + qL1C('.') + version.at(0) + qL1C('.') + version.at(1);
+    if (!version.at(0).isEmpty())
+        candidates << uriPath + qL1C('.') + version.at(0);
+    candidates << uriPath;
+
+    for (const QString &importPath : importPaths) {
+        for (const QString &candidate : qAsConst(candidates)) {
+            const QString dir = importPath + qL1C('/') + candidate;
+            QFile qmldir(dir + qSL("/qmldir"));
+            if (!qmldir.open(QIODevice::ReadOnly))
+                continue;
+
+            QStringList libraries;
+            while (!qmldir.atEnd()) {
+                QStringList tokens = QString::fromUtf8(qmldir.readLine()).simplified().split(qL1C(' '));
+                if (tokens.value(0) == qL1S("optional"))
+                    tokens.removeFirst();
+                if ((tokens.value(0) != qL1S("plugin")) || (tokens.size() < 2))
+                    continue;
+
+                QString pluginDir = dir;
+                if (tokens.size() >= 3)
+                    pluginDir = QDir(dir).absoluteFilePath(tokens.at(2));
+                const QString library = pluginDir + qSL("/lib") + tokens.at(1) + qSL(".so");
+                if (QFile::exists(library))
+                    libraries << library;
+            }
+            return libraries;
+        }
+    }
+    return QStringList();
+}
+
+// Everything that is loaded before the first fork() is shared between all children: the Qt
+// libraries are linked already, but we can also map the plugins of the QML imports that the
+// quick-launchers would preload anyway (see quicklaunchImports), plus the startup plugins.
+// The plugins are only loaded and relocated here - they are initialized in the children, when
+// the QML engine imports them.
+static void preloadLibraries()
+{
+    QVariantMap configuration;
+    const auto docs = QtYaml::variantDocumentsFromYaml(qgetenv("AM_RUNTIME_CONFIGURATION"));
+    if (docs.size() == 1)
+        configuration = docs.first().toMap();
+
+    const QString baseDir = QString::fromLocal8Bit(qgetenv("AM_BASE_DIR") + "/");
+
+    QStringList importPaths;
+    const QStringList configuredImportPaths = variantToStringList(configuration.value(qSL("importPaths")));
+    for (const QString &path : configuredImportPaths)
+        importPaths << (QFileInfo(path).isRelative() ? baseDir + path : path);
+    importPaths << QString::fromLocal8Bit(qgetenv("QML2_IMPORT_PATH")).split(qL1C(':'), QString::SkipEmptyParts);
+    importPaths << QLibraryInfo::location(QLibraryInfo::Qml2ImportsPath);
+
+    QStringList libraries;
+    const QStringList imports = variantToStringList(configuration.value(qSL("quicklaunchImports")));
+    for (const QString &import : imports)
+        libraries << qmlPluginLibraries(import, importPaths);
+    libraries << variantToStringList(configuration.value(qSL("plugins")).toMap().value(qSL("startup")));
+
+    for (const QString &library : qAsConst(libraries)) {
+        // the handles are never closed on purpose
+        if (!dlopen(QFile::encodeName(library).constData(), RTLD_NOW | RTLD_LOCAL))
+            qCWarning(LogQmlRuntime) << "Fork-server could not preload" << library << ":" << dlerror();
+    }
+}
+
+static int childSignalPipe[2] = { -1, -1 };
+
+static void childSignalHandler(int)
+{
+    int savedErrno = errno;
+    char c = 0;
+    while ((::write(childSignalPipe[1], &c, 1) < 0) && (errno == EINTR))
+        ;
+    errno = savedErrno;
+}
+
+static void closeAll(const QVector<int> &fds)
+{
+    for (int fd : fds)
+        ::close(fd);
+}
+
+static bool reapChildren(int socket)
+{
+    int status;
+    pid_t pid;
+    while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+        // same semantics as QProcess: the exit code is the signal number for crashes
+        bool crashed = WIFSIGNALED(status);
+        int exitCode = crashed ? WTERMSIG(status) : WEXITSTATUS(status);
+
+        QByteArray message;
+        QDataStream ds(&message, QIODevice::WriteOnly);
+        ds.setVersion(QDataStream::Qt_5_6);
+        ds << quint8(ForkServerProtocol::Finished) << qint64(pid) << exitCode << crashed;
+        if (!ForkServerProtocol::sendMessage(socket, message))
+            return false;
+    }
+    return true;
+}
+
+void LauncherForkServer::runIfRequested(int &argc, char **&argv, const std::function<void()> &preInitialize)
+{
+    const QByteArray fdString = qgetenv(ForkServerProtocol::EnvironmentVariable);
+    if (fdString.isNull())
+        return;
+    unsetenv(ForkServerProtocol::EnvironmentVariable);
+
+    bool ok;
+    int socket = fdString.toInt(&ok);
+    if (!ok || (socket < 0) || (fcntl(socket, F_SETFD, FD_CLOEXEC) < 0)) {
+        qCCritical(LogQmlRuntime) << "ERROR: the fork-server socket is not valid:" << fdString;
+        _exit(2);
+    }
+
+    if (preInitialize)
+        preInitialize();
+    preloadLibraries();
+
+    ProcessTitle::setTitle("%s", "fork-server");
+
+    struct sigaction childAction;
+    struct sigaction oldChildAction;
+    memset(&childAction, 0, sizeof(childAction));
+    childAction.sa_handler = childSignalHandler;
+    childAction.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    if ((pipe2(childSignalPipe, O_CLOEXEC | O_NONBLOCK) < 0)
+            || (sigaction(SIGCHLD, &childAction, &oldChildAction) < 0)) {
+        qCCritical(LogQmlRuntime) << "ERROR: could not set up the fork-server:" << strerror(errno);
+        _exit(2);
+    }
+
+    forever {
+        struct pollfd pfd[2] = { { socket, POLLIN, 0 }, { childSignalPipe[0], POLLIN, 0 } };
+        if (::poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            _exit(3);
+        }
+
+        if (pfd[1].revents & POLLIN) {
+            char buffer[64];
+            while (::read(childSignalPipe[0], buffer, sizeof(buffer)) > 0)
+                ;
+            if (!reapChildren(socket))
+                _exit(0);
+        }
+        if (!(pfd[0].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+        QByteArray message;
+        QVector<int> fds;
+        if (!ForkServerProtocol::receiveMessage(socket, &message, &fds)) {
+            if (errno == EMSGSIZE)
+                continue;
+            // the application-manager is gone: our children will get killed via PDEATHSIG
+            _exit(0);
+        }
+
+        QDataStream ds(message);
+        ds.setVersion(QDataStream::Qt_5_6);
+        quint8 type = 0;
+        quint32 id = 0;
+        QStringList arguments;
+        QStringList environment;
+        QString workingDirectory;
+        quint8 stdioMask = 0;
+        ds >> type >> id >> arguments >> environment >> workingDirectory >> stdioMask;
+
+        if ((ds.status() != QDataStream::Ok) || (type != ForkServerProtocol::Spawn)) {
+            closeAll(fds);
+            continue;
+        }
+
+        // the child must not do anything before the application-manager knows its pid
+        int syncPipe[2];
+        pid_t pid = -1;
+        if (pipe2(syncPipe, O_CLOEXEC) == 0) {
+            pid = fork();
+            if (pid < 0) {
+                int savedErrno = errno;
+                ::close(syncPipe[0]);
+                ::close(syncPipe[1]);
+                errno = savedErrno;
+            }
+        }
+
+        if (pid == 0) {
+            // child
+            sigaction(SIGCHLD, &oldChildAction, nullptr);
+            ::close(socket);
+            ::close(childSignalPipe[0]);
+            ::close(childSignalPipe[1]);
+            ::close(syncPipe[1]);
+
+            pid_t forkServerPid = getppid();
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != forkServerPid)
+                _exit(1);
+
+            char c;
+            while ((::read(syncPipe[0], &c, 1) < 0) && (errno == EINTR))
+                ;
+            ::close(syncPipe[0]);
+
+            int fdIndex = 0;
+            for (int i = 0; i < 3; ++i) {
+                if (stdioMask & (1 << i)) {
+                    int fd = fds.value(fdIndex++, -1);
+                    if ((fd >= 0) && (fd != i)) {
+                        dup2(fd, i);
+                        ::close(fd);
+                    }
+                }
+            }
+
+            clearenv();
+            for (const QString &variable : qAsConst(environment)) {
+                // putenv() takes ownership of the string
+                putenv(strdup(variable.toLocal8Bit().constData()));
+            }
+
+            if (!workingDirectory.isEmpty() && (chdir(QFile::encodeName(workingDirectory).constData()) < 0)) {
+                qCWarning(LogQmlRuntime) << "Could not change the working directory to" << workingDirectory
+                                         << ":" << strerror(errno);
+            }
+
+            // argv needs to stay valid for the lifetime of the process
+            static QVector<QByteArray> argumentStorage;
+            static QVector<char *> argumentPointers;
+            argumentStorage << QByteArray(argv[0]);
+            for (const QString &argument : qAsConst(arguments))
+                argumentStorage << argument.toLocal8Bit();
+            for (QByteArray &argument : argumentStorage)
+                argumentPointers << argument.data();
+            argumentPointers << nullptr;
+
+            argc = argumentStorage.size();
+            argv = argumentPointers.data();
+
+            ProcessTitle::setTitle(nullptr);
+            return;
+        }
+
+        // fork-server
+        int forkErrno = errno;
+        closeAll(fds);
+
+        QByteArray reply;
+        QDataStream rds(&reply, QIODevice::WriteOnly);
+        rds.setVersion(QDataStream::Qt_5_6);
+        rds << quint8(ForkServerProtocol::Started) << id << qint64((pid > 0) ? pid : -forkErrno)
+            << ((pid > 0) ? QString() : QString::fromLocal8Bit(strerror(forkErrno)));
+        bool sent = ForkServerProtocol::sendMessage(socket, reply);
+
+        if (pid > 0) {
+            ::close(syncPipe[0]);
+            if (sent) {
+                char c = 0;
+                while ((::write(syncPipe[1], &c, 1) < 0) && (errno == EINTR))
+                    ;
+            } else {
+                ::kill(pid, SIGKILL);
+            }
+            ::close(syncPipe[1]);
+        }
+        if (!sent)
+            _exit(0);
+    }
+}
+
+QT_END_NAMESPACE_AM
+
+#endif // Q_OS_LINUX
@@ -52,6 +52,8 @@
 #include <QDir>
 #include <QtEndian>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
 #include <QRegularExpression>
 #include <QCommandLineParser>
 
@@ -68,6 +70,7 @@
 #  include <QQuickItem>
 #  include <QQuickView>
 #  include <QQuickWindow>
+#  include <QScreen>
 
 #  include <QtAppManLauncher/private/applicationmanagerwindow_p.h>
 #else
@@ -78,6 +81,7 @@
 #include "qmlapplicationinterfaceextension.h"
 #include "qmlnotification.h"
 #include "notification.h"
+#include "launcherforkserver.h"
 #include "qtyaml.h"
 #include "global.h"
 #include "logging.h"
@@ -93,24 +97,159 @@
 
 QT_BEGIN_NAMESPACE_AM
 
-// maybe make this configurable for specific workloads?
+// Returns the per-frame incubation budget in msec from the runtime configuration, or 0 if the
+// budget should be derived from the measured frame times
+static int configuredIncubationBudget(const QVariantMap &configuration)
+{
+    const QVariant budget = configuration.value(qSL("incubationBudget"));
+    if (!budget.isValid() || (budget.toString() == qL1S("auto")))
+        return 0;
+    bool ok;
+    int msec = budget.toInt(&ok);
+    if (!ok || (msec <= 0)) {
+        qCWarning(LogQmlRuntime) << "Ignoring invalid incubationBudget:" << budget.toString();
+        return 0;
+    }
+    return msec;
+}
+
+// Used for reporting how much time incubation took per frame (or timer tick)
+class IncubationStatistics
+{
+public:
+    void add(qint64 nsec)
+    {
+        ++m_frames;
+        m_total += nsec;
+        m_max = qMax(m_max, nsec);
+    }
+
+    void report()
+    {
+        if (m_frames) {
+            qCDebug(LogQmlRuntime, "Incubation finished: %d frames, %.2f ms/frame on average, %.2f ms max",
+                    m_frames, double(m_total) / m_frames / 1000000, double(m_max) / 1000000);
+        }
+        m_frames = 0;
+        m_total = m_max = 0;
+    }
+
+private:
+    int m_frames = 0;
+    qint64 m_total = 0;
+    qint64 m_max = 0;
+};
+
 class HeadlessIncubationController : public QObject, public QQmlIncubationController // clazy:exclude=missing-qobject-macro
 {
 public:
-    HeadlessIncubationController(QObject *parent)
+    HeadlessIncubationController(int budget, QObject *parent)
         : QObject(parent)
+        , m_budget(budget > 0 ? budget : 25)
     {
         startTimer(50);
     }
 
 protected:
+    void incubatingObjectCountChanged(int count) override
+    {
+        if (!count)
+            m_statistics.report();
+    }
+
     void timerEvent(QTimerEvent *) override
     {
-        incubateFor(25);
+        if (!incubatingObjectCount())
+            return;
+
+        QElapsedTimer timer;
+        timer.start();
+        incubateFor(m_budget);
+        m_statistics.add(timer.nsecsElapsed());
     }
+
+private:
+    int m_budget;
+    IncubationStatistics m_statistics;
 };
 
+#if !defined(AM_HEADLESS)
 
+// Incubates in the gap between a frame being swapped and the next frame being due. Unless a
+// fixed budget is configured, the budget is the frame interval of the screen minus the (averaged)
+// time the last frames needed from animating to swapping.
+class FrameIncubationController : public QObject, public QQmlIncubationController
+{
+    Q_OBJECT
+
+public:
+    FrameIncubationController(QQuickWindow *window, int budget, QObject *parent)
+        : QObject(parent)
+        , m_window(window)
+        , m_fixedBudget(budget)
+    {
+        m_clock.start();
+        connect(window, &QQuickWindow::afterAnimating, this, [this]() {
+            m_frameStart = m_clock.nsecsElapsed();
+        });
+        // the frameSwapped signal is emitted by the render thread, so this is a queued connection
+        // for the threaded render-loop
+        connect(window, &QQuickWindow::frameSwapped, this, &FrameIncubationController::incubate);
+    }
+
+protected:
+    void incubatingObjectCountChanged(int count) override
+    {
+        if (count) {
+            if (m_window)
+                m_window->update();
+        } else {
+            m_statistics.report();
+        }
+    }
+
+private:
+    int budget() const
+    {
+        if (m_fixedBudget > 0)
+            return m_fixedBudget;
+
+        qreal refreshRate = m_window->screen() ? m_window->screen()->refreshRate() : 0;
+        int frameInterval = int(1000 / (refreshRate > 1 ? refreshRate : 60));
+        int frameTime = int(m_averageFrameTime / 1000000);
+        return qBound(1, frameInterval - frameTime, qMax(1, frameInterval / 2));
+    }
+
+    void incubate()
+    {
+        if (m_frameStart >= 0) {
+            qint64 frameTime = m_clock.nsecsElapsed() - m_frameStart;
+            m_averageFrameTime = m_averageFrameTime ? (m_averageFrameTime * 7 + frameTime) / 8 : frameTime;
+            m_frameStart = -1;
+        }
+
+        if (!m_window || !incubatingObjectCount())
+            return;
+
+        QElapsedTimer timer;
+        timer.start();
+        incubateFor(budget());
+        m_statistics.add(timer.nsecsElapsed());
+
+        // keep the frames (and with them the incubation) going
+        if (incubatingObjectCount())
+            m_window->update();
+    }
+
+    QPointer<QQuickWindow> m_window;
+    int m_fixedBudget;
+    QElapsedTimer m_clock;
+    qint64 m_frameStart = -1;
+    qint64 m_averageFrameTime = 0;
+    IncubationStatistics m_statistics;
+};
+
+#endif // !AM_HEADLESS
 
 // copied straight from Qt 5.1.0 qmlscene/main.cpp for now - needs to be revised
 static void loadDummyDataFiles(QQmlEngine &engine, const QString& directory)
@@ -148,7 +287,17 @@ public slots:
                           const QString &mimeType, const QVariantMap &application, const QVariantMap systemProperties);
 
 private:
+    void schedulePreload(const QString &baseDir);
+    void preloadNext();
+    void finishPreload();
+
     QQmlApplicationEngine m_engine;
+    // quick-launch preloading: import statements and the code of the most likely applications
+    QStringList m_preloadImports;
+    QList<QUrl> m_preloadUrls;
+    QQmlComponent *m_preloadComponent = nullptr;
+    QHash<QUrl, QQmlComponent *> m_preloadedComponents;
+    QList<QQmlComponent *> m_failedPreloads; // their errors are cached by the type loader
     QmlApplicationInterface *m_applicationInterface = nullptr;
     QVariantMap m_configuration;
     bool m_launched = false;
@@ -171,8 +320,25 @@ QT_END_NAMESPACE_AM
 QT_USE_NAMESPACE_AM
 
 
+static void registerQmlTypes()
+{
+    static bool registered = false;
+    if (registered)
+        return;
+    registered = true;
+
+#if !defined(AM_HEADLESS)
+    qmlRegisterType<ApplicationManagerWindow>("QtApplicationManager", 1, 0, "ApplicationManagerWindow");
+#endif
+    qmlRegisterType<QmlNotification>("QtApplicationManager", 1, 0, "Notification");
+    qmlRegisterType<QmlApplicationInterfaceExtension>("QtApplicationManager", 1, 0, "ApplicationInterfaceExtension");
+}
+
 int main(int argc, char *argv[])
 {
+    // only returns in the forked children, if we were started as a fork-server
+    LauncherForkServer::runIfRequested(argc, argv, registerQmlTypes);
+
     StartupTimer::instance()->checkpoint("entered main");
 
     if (qEnvironmentVariableIsSet("AM_NO_DLT_LOGGING"))
@@ -219,11 +385,9 @@ int main(int argc, char *argv[])
 #endif
     }
 
-    qmlRegisterType<ApplicationManagerWindow>("QtApplicationManager", 1, 0, "ApplicationManagerWindow");
 #endif
 
-    qmlRegisterType<QmlNotification>("QtApplicationManager", 1, 0, "Notification");
-    qmlRegisterType<QmlApplicationInterfaceExtension>("QtApplicationManager", 1, 0, "ApplicationInterfaceExtension");
+    registerQmlTypes();
 
     StartupTimer::instance()->checkpoint("after logging and qml register initialization");
 
@@ -333,6 +497,9 @@ Controller::Controller(QCoreApplication *a, bool quickLaunched, const QString &d
         }
     }
 
+    if (m_quickLaunched && directLoad.isEmpty())
+        schedulePreload(baseDir);
+
     if (directLoad.isEmpty()) {
         m_applicationInterface = new QmlApplicationInterface(p2pBusName, notificationBusName, this);
         connect(m_applicationInterface, &QmlApplicationInterface::startApplication,
@@ -358,6 +525,105 @@ Controller::Controller(QCoreApplication *a, bool quickLaunched, const QString &d
     StartupTimer::instance()->checkpoint("after application interface initialization");
 }
 
+/*! \internal
+    While the quick-launcher is waiting for an application, it compiles the configured imports and
+    the code of the applications that are most likely to be started next (the System-UI passes the
+    main QML files of all preloaded and important built-in applications). One component is compiled per
+    event loop iteration - asynchronously in the type loader thread - so a startApplication() call
+    is never delayed by more than a single component.
+    Keeping the compiled components around means that startApplication() will only have to
+    instantiate them. As a side-effect, the QML disk cache (.qmlc) is populated as well.
+
+    Precompiling has to happen in an engine that is set up exactly like the one that will load the
+    application later: the System-UI does not pass applications with their own import paths or
+    dummy data, and there is nothing to precompile if startup plugins can change the engine in
+    beforeQmlEngineLoad(). startApplication() makes sure that neither a failed compilation nor a
+    component compiled under different conditions ends up being used.
+*/
+void Controller::schedulePreload(const QString &baseDir)
+{
+    const QVariantList imports = qdbus_cast<QVariantList>(m_configuration.value(qSL("quicklaunchImports")));
+    for (const QVariant &import : imports) {
+        QString statement = import.toString().trimmed();
+        if (!statement.isEmpty())
+            m_preloadImports << statement;
+    }
+
+    bool precompile = m_configuration.value(qSL("quicklaunchPrecompile"), true).toBool()
+            && !m_configuration.value(qSL("loadDummydata")).toBool()
+            && variantToStringList(m_configuration.value(qSL("plugins")).toMap().value(qSL("startup"))).isEmpty();
+
+    if (precompile) {
+        auto docs = QtYaml::variantDocumentsFromYaml(qgetenv("AM_QUICKLAUNCH_PRELOAD"));
+        if (docs.size() == 1) {
+            const QStringList files = variantToStringList(docs.first());
+            for (QString file : files) {
+                if (QFileInfo(file).isRelative())
+                    file.prepend(baseDir);
+                if (QFile::exists(file))
+                    m_preloadUrls << QUrl::fromLocalFile(file);
+            }
+        }
+    }
+
+    if (!m_preloadImports.isEmpty() || !m_preloadUrls.isEmpty())
+        QTimer::singleShot(0, this, &Controller::preloadNext);
+}
+
+void Controller::preloadNext()
+{
+    if (m_launched || m_preloadComponent)
+        return;
+
+    if (!m_preloadImports.isEmpty()) {
+        // all imports of a component are resolved when it is compiled, so this is enough to load
+        // and initialize the QML plugins and modules
+        const QString statement = m_preloadImports.takeFirst();
+        QByteArray qml = "import " + statement.toUtf8() + "\nimport QtQml 2.0\nQtObject { }\n";
+        QQmlComponent importComp(&m_engine);
+        importComp.setData(qml, QUrl());
+        if (importComp.isError()) {
+            qCWarning(LogQmlRuntime) << "Could not preload the import" << statement << ":" << importComp.errorString();
+        } else {
+            QScopedPointer<QObject> dummy(importComp.create());
+            qCDebug(LogQmlRuntime) << "Preloaded the import" << statement;
+        }
+        QTimer::singleShot(0, this, &Controller::preloadNext);
+        return;
+    }
+
+    if (m_preloadUrls.isEmpty())
+        return;
+
+    const QUrl url = m_preloadUrls.takeFirst();
+    m_preloadComponent = new QQmlComponent(&m_engine, url, QQmlComponent::Asynchronous, this);
+    if (m_preloadComponent->isLoading()) {
+        connect(m_preloadComponent, &QQmlComponent::statusChanged, this, &Controller::finishPreload);
+    } else {
+        finishPreload();
+    }
+}
+
+void Controller::finishPreload()
+{
+    QQmlComponent *comp = m_preloadComponent;
+    if (!comp || comp->isLoading())
+        return;
+    m_preloadComponent = nullptr;
+
+    if (comp->isReady() && !m_launched) {
+        qCDebug(LogQmlRuntime) << "Precompiled" << comp->url().toLocalFile();
+        m_preloadedComponents.insert(comp->url(), comp);
+    } else if (comp->isError() && !m_launched) {
+        qCWarning(LogQmlRuntime) << "Could not precompile" << comp->url().toLocalFile()
+                                 << ":" << comp->errorString();
+        m_failedPreloads << comp;
+    } else {
+        comp->deleteLater();
+    }
+    QTimer::singleShot(0, this, &Controller::preloadNext);
+}
+
 void Controller::startApplication(const QString &baseDir, const QString &qmlFile, const QString &document,
                                   const QString &mimeType, const QVariantMap &application,
                                   const QVariantMap systemProperties)
@@ -475,9 +741,36 @@ void Controller::startApplication(const QString &baseDir, const QString &qmlFile
 
     QUrl qmlFileUrl = QUrl::fromLocalFile(qmlFile);
     m_engine.rootContext()->setContextProperty(qSL("StartupTimer"), StartupTimer::instance());
+
+    // the type loader reuses the compiled data of a precompiled component, so loading boils down
+    // to the instantiation. This is only valid, if the engine has not been changed since then.
+    bool precompiled = m_preloadedComponents.contains(QUrl::fromLocalFile(QFileInfo(qmlFile).absoluteFilePath()));
+    bool engineChanged = !vl.isEmpty() || loadDummyData || !startupPlugins.isEmpty();
+    bool trimCache = !m_failedPreloads.isEmpty() || (precompiled && engineChanged);
+    precompiled = precompiled && !engineChanged;
+
+    // everything else is only wasting memory from now on
+    if (!precompiled) {
+        qDeleteAll(m_preloadedComponents);
+        m_preloadedComponents.clear();
+    }
+    qDeleteAll(m_failedPreloads);
+    m_failedPreloads.clear();
+    m_preloadImports.clear();
+    m_preloadUrls.clear();
+
+    // the type loader caches failed compilations as well as components compiled without the
+    // import paths and context properties set up above: get rid of them, so they are recompiled
+    if (trimCache)
+        m_engine.trimComponentCache();
+
     m_engine.load(qmlFileUrl);
 
-    StartupTimer::instance()->checkpoint("after engine loading main qml file");
+    qDeleteAll(m_preloadedComponents);
+    m_preloadedComponents.clear();
+
+    StartupTimer::instance()->checkpoint(precompiled ? "after engine loading main qml file (precompiled)"
+                                                     : "after engine loading main qml file");
 
     auto topLevels = m_engine.rootObjects();
 
@@ -501,9 +794,10 @@ void Controller::startApplication(const QString &baseDir, const QString &qmlFile
             m_window = view;
             view->setContent(qmlFileUrl, nullptr, topLevel);
         }
-    } else {
-        if (!m_engine.incubationController())
-            m_engine.setIncubationController(m_window->incubationController());
+    }
+    if (m_window) {
+        m_engine.setIncubationController(new FrameIncubationController(m_window, configuredIncubationBudget(m_configuration),
+                                                                       &m_engine));
     }
 
     StartupTimer::instance()->checkpoint("after creating and setting application window");
@@ -542,7 +836,8 @@ void Controller::startApplication(const QString &baseDir, const QString &qmlFile
     }
 
 #else
-    m_engine.setIncubationController(new HeadlessIncubationController(&m_engine));
+    m_engine.setIncubationController(new HeadlessIncubationController(configuredIncubationBudget(m_configuration),
+                                                                      &m_engine));
 #endif
     qCDebug(LogQmlRuntime) << "component loading and creating complete.";
 
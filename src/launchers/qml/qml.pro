@@ -14,6 +14,10 @@ QT *= \
 
 SOURCES += \
     main.cpp \
+    launcherforkserver.cpp \
+
+HEADERS += \
+    launcherforkserver.h \
 
 load(qt_tool)
 
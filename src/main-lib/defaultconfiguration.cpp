@@ -152,6 +152,16 @@ bool DefaultConfiguration::recreateDatabase() const
     return value<bool>("recreate-database");
 }
 
+bool DefaultConfiguration::noCache() const
+{
+    return value<bool>("no-config-cache");
+}
+
+bool DefaultConfiguration::clearCache() const
+{
+    return value<bool>("clear-config-cache");
+}
+
 QStringList DefaultConfiguration::builtinAppsManifestDirs() const
 {
     return value<QStringList>("builtin-apps-manifest-dir", { "applications", "builtinAppsManifestDir" });
@@ -374,6 +384,22 @@ int DefaultConfiguration::quickLaunchRuntimesPerContainer() const
     return qBound(0, rpc, 10);
 }
 
+int DefaultConfiguration::quickLaunchMaximumRuntimesPerContainer() const
+{
+    QVariant max = value<QVariant>(nullptr, { "quicklaunch", "maximumRuntimesPerContainer" });
+    if (!max.isValid())
+        return quickLaunchRuntimesPerContainer();
+
+    // same reasoning as above
+    return qBound(0, max.toInt(), 10);
+}
+
+int DefaultConfiguration::processMonitorSamplingThreads() const
+{
+    QVariant threads = value<QVariant>(nullptr, { "monitoring", "samplingThreads" });
+    return threads.isValid() ? threads.toInt() : 1;
+}
+
 QString DefaultConfiguration::waylandSocketName() const
 {
     return value<QString>("wayland-socket-name");
@@ -402,6 +428,12 @@ QStringList DefaultConfiguration::caCertificates() const
     return value<QStringList>(nullptr, { "installer", "caCertificates" });
 }
 
+int DefaultConfiguration::installerMaximumConcurrentTasks() const
+{
+    QVariant max = value<QVariant>(nullptr, { "installer", "maximumConcurrentTasks" });
+    return max.isValid() ? qBound(1, max.toInt(), 16) : 1;
+}
+
 QStringList DefaultConfiguration::pluginFilePaths(const char *type) const
 {
     return value<QStringList>(nullptr, { "plugins", type });
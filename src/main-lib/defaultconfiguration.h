@@ -62,6 +62,8 @@ public:
     QString mainQmlFile() const;
     QString database() const;
     bool recreateDatabase() const;
+    bool noCache() const;
+    bool clearCache() const;
 
     QStringList builtinAppsManifestDirs() const;
     QString installedAppsManifestDir() const;
@@ -101,6 +103,9 @@ public:
 
     qreal quickLaunchIdleLoad() const;
     int quickLaunchRuntimesPerContainer() const;
+    int quickLaunchMaximumRuntimesPerContainer() const;
+
+    int processMonitorSamplingThreads() const;
 
     QString waylandSocketName() const;
 
@@ -110,6 +115,7 @@ public:
     QVariantMap managerCrashAction() const;
 
     QStringList caCertificates() const;
+    int installerMaximumConcurrentTasks() const;
 
     QStringList pluginFilePaths(const char *type) const;
 
@@ -68,6 +68,8 @@
 #include <QProcess>
 #include <QQmlDebuggingEnabler>
 #include <QNetworkInterface>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
 #include <private/qabstractanimation_p.h>
 
 #if !defined(AM_HEADLESS)
@@ -95,6 +97,7 @@
 #include "applicationdatabase.h"
 #include "installationreport.h"
 #include "yamlapplicationscanner.h"
+#include "applicationmanifestcache.h"
 #if !defined(AM_DISABLE_INSTALLER)
 #  include "applicationinstaller.h"
 #  include "sudo.h"
@@ -128,6 +131,7 @@
 #include "startuptimer.h"
 #include "systemmonitor.h"
 #include "processmonitor.h"
+#include "samplingengine.h"
 #include "applicationipcmanager.h"
 #include "unixsignalhandler.h"
 
@@ -214,13 +218,16 @@ void Main::setup(const DefaultConfiguration *cfg) Q_DECL_NOEXCEPT_EXPR(false)
     setupRuntimesAndContainers(cfg->runtimeConfigurations(), cfg->containerConfigurations(),
                                cfg->pluginFilePaths("container"));
     setupInstallationLocations(cfg->installationLocations());
-    loadApplicationDatabase(cfg->database(), cfg->recreateDatabase(), cfg->singleApp());
+    loadApplicationDatabase(cfg->database(), cfg->recreateDatabase(), cfg->singleApp(),
+                            cfg->noCache(), cfg->clearCache());
+    SamplingEngine::setThreadCount(cfg->processMonitorSamplingThreads());
     setupSingletons(cfg->containerSelectionConfiguration(), cfg->quickLaunchRuntimesPerContainer(),
-                    cfg->quickLaunchIdleLoad());
+                    cfg->quickLaunchIdleLoad(), cfg->quickLaunchMaximumRuntimesPerContainer());
 
     setupInstaller(cfg->appImageMountDir(), cfg->caCertificates(),
                    std::bind(&DefaultConfiguration::applicationUserIdSeparation, cfg,
-                             std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+                             std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+                   cfg->installerMaximumConcurrentTasks());
 
     setupQmlEngine(cfg->importPaths(), cfg->style());
     setupWindowTitle(QString(), cfg->windowIcon());
@@ -299,7 +306,7 @@ void Main::setupLoggingRules(bool verbose, const QStringList &loggingRules)
     QLoggingCategory::setFilterRules(rules);
 
     // setting this for child processes //TODO: use a more generic IPC approach
-    qputenv("AM_LOGGING_RULES", rules.toUtf8());
+    setProcessEnvironmentVariable("AM_LOGGING_RULES", rules.toUtf8());
     StartupTimer::instance()->checkpoint("after logging setup");
 }
 
@@ -399,7 +406,7 @@ void Main::setupInstallationLocations(const QVariantList &installationLocations)
 }
 
 void Main::loadApplicationDatabase(const QString &databasePath, bool recreateDatabase,
-                                   const QString &singleApp) Q_DECL_NOEXCEPT_EXPR(false)
+                                   const QString &singleApp, bool noCache, bool clearCache) Q_DECL_NOEXCEPT_EXPR(false)
 {
     if (singleApp.isEmpty()) {
         if (recreateDatabase) {
@@ -417,15 +424,37 @@ void Main::loadApplicationDatabase(const QString &databasePath, bool recreateDat
             .arg(m_applicationDatabase->name(), m_applicationDatabase->errorString());
     }
 
+    if (m_applicationDatabase->isValid() && !recreateDatabase && m_applicationDatabase->isOutdated()) {
+        qCWarning(LogSystem) << "The application database" << m_applicationDatabase->name()
+                             << "was written by a different version of the application-manager:"
+                             << "recreating it from the manifests";
+        recreateDatabase = true;
+    }
+
     if (!m_applicationDatabase->isValid() || recreateDatabase) {
         QVector<const Application *> apps;
 
         if (!singleApp.isEmpty()) {
             apps = scanForApplication(singleApp, m_builtinAppsManifestDirs);
         } else {
+            // only manifests that changed since the last scan need to be parsed again
+            std::unique_ptr<ApplicationManifestCache> cache;
+            if (!noCache) {
+                const QDir cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+                cache.reset(new ApplicationManifestCache(cacheLocation.absoluteFilePath(qSL("appman-manifest.cache"))));
+                if (!clearCache)
+                    cache->load();
+            }
+
             apps = scanForApplications(m_builtinAppsManifestDirs,
                                        m_installedAppsManifestDir,
-                                       m_installationLocations);
+                                       m_installationLocations,
+                                       cache.get());
+            if (cache) {
+                qCDebug(LogSystem) << "Application manifest cache:" << cache->hits() << "hits,"
+                                   << cache->misses() << "misses";
+                cache->save();
+            }
         }
 
         if (LogSystem().isDebugEnabled()) {
@@ -442,7 +471,8 @@ void Main::loadApplicationDatabase(const QString &databasePath, bool recreateDat
 }
 
 void Main::setupSingletons(const QList<QPair<QString, QString>> &containerSelectionConfiguration,
-                           qreal quickLaunchRuntimesPerContainer, int quickLaunchIdleLoad) Q_DECL_NOEXCEPT_EXPR(false)
+                           int quickLaunchRuntimesPerContainer, qreal quickLaunchIdleLoad,
+                           int quickLaunchMaximumRuntimesPerContainer) Q_DECL_NOEXCEPT_EXPR(false)
 {
     QString error;
     m_applicationManager = ApplicationManager::createInstance(m_applicationDatabase.take(),
@@ -467,12 +497,18 @@ void Main::setupSingletons(const QList<QPair<QString, QString>> &containerSelect
     StartupTimer::instance()->checkpoint("after SystemMonitor instantiation");
 
     m_quickLauncher = QuickLauncher::instance();
-    m_quickLauncher->initialize(quickLaunchRuntimesPerContainer, quickLaunchIdleLoad);
+    connect(m_applicationManager, &ApplicationManager::memoryLowWarning,
+            m_quickLauncher, &QuickLauncher::onMemoryLowWarning);
+    connect(m_applicationManager, &ApplicationManager::memoryCriticalWarning,
+            m_quickLauncher, &QuickLauncher::onMemoryCriticalWarning);
+    m_quickLauncher->initialize(quickLaunchRuntimesPerContainer, quickLaunchIdleLoad,
+                                quickLaunchMaximumRuntimesPerContainer);
     StartupTimer::instance()->checkpoint("after quick-launcher setup");
 }
 
 void Main::setupInstaller(const QString &appImageMountDir, const QStringList &caCertificatePaths,
-                          const std::function<bool(uint *, uint *, uint *)> &userIdSeparation) Q_DECL_NOEXCEPT_EXPR(false)
+                          const std::function<bool(uint *, uint *, uint *)> &userIdSeparation,
+                          int maximumConcurrentTasks) Q_DECL_NOEXCEPT_EXPR(false)
 {
 #if !defined(AM_DISABLE_INSTALLER)
     if (!Package::checkCorrectLocale()) {
@@ -527,6 +563,8 @@ void Main::setupInstaller(const QString &appImageMountDir, const QStringList &ca
 #  endif // Q_OS_LINUX
     }
 
+    m_applicationInstaller->setMaximumConcurrentTasks(maximumConcurrentTasks);
+
     //TODO: this could be delayed, but needs to have a lock on the app-db in this case
     m_applicationInstaller->cleanupBrokenInstallations();
 
@@ -537,7 +575,7 @@ void Main::setupInstaller(const QString &appImageMountDir, const QStringList &ca
 void Main::setupQmlEngine(const QStringList &importPaths, const QString &quickControlsStyle)
 {
     if (!quickControlsStyle.isEmpty())
-        qputenv("QT_QUICK_CONTROLS_STYLE", quickControlsStyle.toLocal8Bit());
+        setProcessEnvironmentVariable("QT_QUICK_CONTROLS_STYLE", quickControlsStyle.toLocal8Bit());
 
     qmlRegisterType<QmlInProcessNotification>("QtApplicationManager", 1, 0, "Notification");
     qmlRegisterType<QmlInProcessApplicationInterfaceExtension>("QtApplicationManager", 1, 0, "ApplicationInterfaceExtension");
@@ -942,12 +980,23 @@ QVector<const Application *> Main::scanForApplication(const QString &singleAppIn
 }
 
 QVector<const Application *> Main::scanForApplications(const QStringList &builtinAppsDirs, const QString &installedAppsDir,
-                                                        const QVector<InstallationLocation> &installationLocations) Q_DECL_NOEXCEPT_EXPR(false)
+                                                        const QVector<InstallationLocation> &installationLocations,
+                                                        ApplicationManifestCache *cache) Q_DECL_NOEXCEPT_EXPR(false)
 {
-    QVector<const Application *> result;
-    YamlApplicationScanner yas;
+    // The directories are listed serially, but the manifests are then parsed and validated in
+    // parallel: every job only touches its own data, so the result can be merged in the
+    // original (deterministic) directory order afterwards.
+    struct ScanJob
+    {
+        QDir appDir;
+        bool builtIn;
+        std::unique_ptr<Application> app;
+        std::vector<std::unique_ptr<Application>> aliases;
+        std::unique_ptr<Exception> error; // the first error in directory order is re-thrown after the scan
+    };
+    std::vector<ScanJob> jobs;
 
-    auto scan = [&result, &yas, &installationLocations](const QDir &baseDir, bool scanningBuiltinApps) {
+    auto collect = [&jobs](const QDir &baseDir, bool scanningBuiltinApps) {
         auto flags = scanningBuiltinApps ? QDir::Dirs | QDir::NoDotAndDotDot
                                          : QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks;
         const QStringList appDirNames = baseDir.entryList(flags);
@@ -961,23 +1010,33 @@ QVector<const Application *> Main::scanForApplications(const QStringList &builti
                                    << ": not a valid application-id:" << qPrintable(appIdError);
                 continue;
             }
-            QDir appDir = baseDir.absoluteFilePath(appDirName);
+            jobs.push_back(ScanJob { baseDir.absoluteFilePath(appDirName), scanningBuiltinApps, nullptr, { }, nullptr });
+        }
+    };
+
+    auto scan = [&installationLocations, cache](ScanJob &job) {
+        try {
+            const QDir &appDir = job.appDir;
+            const QString appDirName = appDir.dirName();
+
             if (!appDir.exists())
-                continue;
+                return;
             if (!appDir.exists(qSL("info.yaml"))) {
                 qCDebug(LogSystem) << "Couldn't find a info.yaml in:" << appDir;
-                continue;
+                return;
             }
-            if (!scanningBuiltinApps && !appDir.exists(qSL("installation-report.yaml")))
-                continue;
+            if (!job.builtIn && !appDir.exists(qSL("installation-report.yaml")))
+                return;
 
-            QScopedPointer<Application> a(yas.scan(appDir.absoluteFilePath(qSL("info.yaml"))));
+            YamlApplicationScanner yas;
+            yas.setCache(cache);
+            std::unique_ptr<Application> a(yas.scan(appDir.absoluteFilePath(qSL("info.yaml"))));
             Q_ASSERT(a);
 
             AbstractRuntimeManager *runtimeManager = RuntimeFactory::instance()->manager(a->runtimeName());
             if (!runtimeManager) {
                 qCDebug(LogSystem) << "Ignoring application" << a->id() << ", because it uses an unknown runtime:" << a->runtimeName();
-                continue;
+                return;
             }
             if (runtimeManager->supportsQuickLaunch()) {
                 if (a->supportsApplicationInterface())
@@ -990,31 +1049,28 @@ QVector<const Application *> Main::scanForApplications(const QStringList &builti
                                               "that has the same name as the application's id: found %1 in %2")
                     .arg(a->id(), appDirName);
             }
-            if (scanningBuiltinApps) {
+            if (job.builtIn) {
                 a->setBuiltIn(true);
                 QStringList aliasPaths = appDir.entryList(QStringList(qSL("info-*.yaml")));
-                std::vector<std::unique_ptr<Application>> aliases;
 
                 for (int i = 0; i < aliasPaths.size(); ++i) {
-                    std::unique_ptr<Application> alias(yas.scanAlias(appDir.absoluteFilePath(aliasPaths.at(i)), a.data()));
+                    std::unique_ptr<Application> alias(yas.scanAlias(appDir.absoluteFilePath(aliasPaths.at(i)), a.get()));
 
                     Q_ASSERT(alias);
                     Q_ASSERT(alias->isAlias());
-                    Q_ASSERT(alias->nonAliased() == a.data());
+                    Q_ASSERT(alias->nonAliased() == a.get());
 
-                    aliases.push_back(std::move(alias));
+                    alias->moveToThread(QCoreApplication::instance()->thread());
+                    job.aliases.push_back(std::move(alias));
                 }
-                result << a.take();
-                for (auto &&alias : aliases)
-                    result << alias.release();
             } else { // 3rd-party apps
                 QFile f(appDir.absoluteFilePath(qSL("installation-report.yaml")));
                 if (!f.open(QFile::ReadOnly))
-                    continue;
+                    return;
 
                 QScopedPointer<InstallationReport> report(new InstallationReport(a->id()));
                 if (!report->deserialize(&f))
-                    continue;
+                    return;
 
 #if !defined(AM_DISABLE_INSTALLER)
                 // fix the basedir of the application
@@ -1024,18 +1080,44 @@ QVector<const Application *> Main::scanForApplications(const QStringList &builti
                         break;
                     }
                 }
+#else
+                Q_UNUSED(installationLocations)
 #endif
                 a->setInstallationReport(report.take());
-                result << a.take();
             }
+            // the objects were created in a worker thread, but will be used in the main thread
+            a->moveToThread(QCoreApplication::instance()->thread());
+            job.app = std::move(a);
+        } catch (const Exception &e) {
+            job.aliases.clear();
+            job.error.reset(e.clone());
         }
     };
 
     for (const QString &dir : builtinAppsDirs)
-        scan(dir, true);
+        collect(dir, true);
 #if !defined(AM_DISABLE_INSTALLER)
-    scan(installedAppsDir, false);
+    collect(installedAppsDir, false);
 #endif
+
+    StartupTimer::instance()->checkpoint("after application directory scan");
+
+    QtConcurrent::blockingMap(jobs, scan);
+
+    StartupTimer::instance()->checkpoint("after parallel application manifest parsing");
+
+    QVector<const Application *> result;
+    for (ScanJob &job : jobs) {
+        if (job.error) {
+            qDeleteAll(result);
+            job.error->raise();
+        }
+        if (!job.app)
+            continue;
+        result << job.app.release();
+        for (auto &&alias : job.aliases)
+            result << alias.release();
+    }
     return result;
 }
 
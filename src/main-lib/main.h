@@ -68,6 +68,7 @@ class Application;
 class StartupTimer;
 class ApplicationIPCManager;
 class ApplicationDatabase;
+class ApplicationManifestCache;
 class ApplicationManager;
 class ApplicationInstaller;
 class NotificationManager;
@@ -109,11 +110,14 @@ protected:
                                     const QStringList &containerPluginPaths);
     void setupInstallationLocations(const QVariantList &installationLocations);
     void loadApplicationDatabase(const QString &databasePath, bool recreateDatabase,
-                                 const QString &singleApp) Q_DECL_NOEXCEPT_EXPR(false);
+                                 const QString &singleApp, bool noCache = false,
+                                 bool clearCache = false) Q_DECL_NOEXCEPT_EXPR(false);
     void setupSingletons(const QList<QPair<QString, QString>> &containerSelectionConfiguration,
-                         qreal quickLaunchRuntimesPerContainer, int quickLaunchIdleLoad) Q_DECL_NOEXCEPT_EXPR(false);
+                         int quickLaunchRuntimesPerContainer, qreal quickLaunchIdleLoad,
+                         int quickLaunchMaximumRuntimesPerContainer) Q_DECL_NOEXCEPT_EXPR(false);
     void setupInstaller(const QString &appImageMountDir, const QStringList &caCertificatePaths,
-                        const std::function<bool(uint *, uint *, uint *)> &userIdSeparation) Q_DECL_NOEXCEPT_EXPR(false);
+                        const std::function<bool(uint *, uint *, uint *)> &userIdSeparation,
+                        int maximumConcurrentTasks = 1) Q_DECL_NOEXCEPT_EXPR(false);
 
     void setupQmlEngine(const QStringList &importPaths, const QString &quickControlsStyle = QString());
     void setupWindowTitle(const QString &title, const QString &iconPath);
@@ -142,7 +146,8 @@ private:
                                                            const QStringList &builtinAppsDirs) Q_DECL_NOEXCEPT_EXPR(false);
     static QVector<const Application *> scanForApplications(const QStringList &builtinAppsDirs,
                                                             const QString &installedAppsDir,
-                                                            const QVector<InstallationLocation> &installationLocations) Q_DECL_NOEXCEPT_EXPR(false);
+                                                            const QVector<InstallationLocation> &installationLocations,
+                                                            ApplicationManifestCache *cache = nullptr) Q_DECL_NOEXCEPT_EXPR(false);
 
 private:
     QVector<InstallationLocation> m_installationLocations;
@@ -75,11 +75,11 @@ public:
     virtual AbstractRuntime *create(AbstractContainer *container, const Application *app) = 0;
 
     QVariantMap configuration() const;
-    void setConfiguration(const QVariantMap &configuration);
+    virtual void setConfiguration(const QVariantMap &configuration);
 
     QVariantMap systemPropertiesBuiltIn() const;
     QVariantMap systemProperties3rdParty() const;
-    void setSystemProperties(const QVariantMap &thirdParty, const QVariantMap &builtIn);
+    virtual void setSystemProperties(const QVariantMap &thirdParty, const QVariantMap &builtIn);
 
 private:
     QString m_id;
@@ -133,6 +133,8 @@ public:
 
 signals:
     void stateChanged(QT_PREPEND_NAMESPACE_AM(AbstractRuntime::State) newState);
+    // the pid can change without a state change, e.g. when it is only known after the start
+    void applicationProcessIdChanged(qint64 pid);
     void finished(int exitCode, QProcess::ExitStatus status);
 
 #if !defined(AM_HEADLESS)
@@ -40,25 +40,118 @@
 ****************************************************************************/
 
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QDataStream>
 #include <QTemporaryFile>
 #include <QScopedPointer>
+#include <QSharedPointer>
+
+#include <algorithm>
+#include <errno.h>
+#if defined(Q_OS_UNIX)
+#  include <unistd.h>
+#endif
 
 #include "application.h"
 #include "applicationdatabase.h"
 #include "exception.h"
+#include "logging.h"
+
+/*
+ * The database file is memory-mapped on read(). Its layout is:
+ *
+ *   Header        magic, format version and the number of applications
+ *   Entry[count]  offsets and sizes of the application and installation-report records
+ *   records       the QDataStream serialized Application objects (without their reports) and
+ *                 the serialized InstallationReports
+ *
+ * The Application objects are created right away, since the ApplicationManager needs all of
+ * them for its model anyway, but the installation reports are only deserialized from the
+ * mapping, when they are accessed for the first time.
+ *
+ * Files without the magic header (written in the old, purely sequential QDataStream format) or
+ * with a different format version are not read at all: their records cannot be decoded reliably,
+ * so isOutdated() tells the caller to recreate the database from the manifests instead.
+ *
+ * Single applications are not updated by rewriting the whole database, but by appending
+ * an upsert or remove record to the journal file next to it (<database>.journal), which is
+ * replayed on read(). Every journal entry is fsync'ed and checksummed, so a power loss can at
+ * most lose the entry that was being written. The journal header references the generation of
+ * the database it belongs to: once the journal gets too big, the database is compacted by a
+ * complete (atomic) write(), which bumps the generation and thereby invalidates the old journal.
+ */
 
 QT_BEGIN_NAMESPACE_AM
 
+namespace {
+
+static const char databaseMagic[8] = { 'A', 'M', 'A', 'P', 'P', 'D', 'B', '\0' };
+static const char journalMagic[8] = { 'A', 'M', 'A', 'P', 'P', 'J', 'N', 'L' };
+enum { DatabaseVersion = 1 };
+
+// the records are serialized Application objects, so their format is part of the version
+static const quint32 FormatVersion = (quint32(DatabaseVersion) << 16) | quint32(Application::DataStreamVersion);
+
+// compact the database, if the journal has more entries than this or is bigger than the database
+enum { MaxJournalEntries = 64 };
+
+struct Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 dataStreamVersion;
+    quint32 count;       // always 0 for journals
+    quint32 generation;  // incremented on every write()
+};
+
+struct Entry
+{
+    quint32 recordOffset;
+    quint32 recordSize;
+    quint32 reportOffset;
+    quint32 reportSize;
+};
+
+enum JournalEntryType : quint32 {
+    JournalUpsert = 1,   // record: application, report: installation report
+    JournalRemove = 2    // record: application id
+};
+
+struct JournalEntry
+{
+    quint32 type;
+    quint32 recordSize;
+    quint32 reportSize;
+    quint16 recordChecksum;
+    quint16 reportChecksum;
+};
+
+} // anonymous namespace
+
 class ApplicationDatabasePrivate
 {
 public:
     QFile *file = nullptr;
+    quint32 generation = 0; // 0: not known (yet) or a legacy database
+    int journalEntries = 0;
+    qint64 journalSize = 0; // only the valid part
 
     ApplicationDatabasePrivate()
     { }
     ~ApplicationDatabasePrivate()
     { delete file; }
+
+    QString journalFileName() const
+    { return file->fileName() + qSL(".journal"); }
+
+    QVector<const Application *> readDatabase();
+    QVector<const Application *> readMapped(const uchar *base, qint64 size, const QSharedPointer<QObject> &mapping);
+    bool readHeader(Header *header) const;
+    void replayJournal(QVector<const Application *> &apps);
+    quint32 generationOnDisk() const;
+    bool needsCompaction() const;
+    void appendToJournal(JournalEntryType type, const QByteArray &record, const QByteArray &report);
 };
 
 ApplicationDatabase::ApplicationDatabase(const QString &fileName)
@@ -100,47 +193,357 @@ QString ApplicationDatabase::name() const
     return d->file->fileName();
 }
 
+/*! \internal
+    Returns \c true, if the database has been written by a different version of the
+    application-manager (including the old, header-less format): it cannot be read() and has to
+    be recreated from the application manifests. An empty database is not outdated.
+*/
+bool ApplicationDatabase::isOutdated() const
+{
+    if (!isValid() || (d->file->size() == 0))
+        return false;
+
+    Header header;
+    return !d->readHeader(&header) || (header.version != FormatVersion);
+}
+
 QVector<const Application *> ApplicationDatabase::read() Q_DECL_NOEXCEPT_EXPR(false)
 {
     if (!d->file || !d->file->isOpen() || !d->file->isReadable())
         throw Exception("application database %1 is not opened for reading").arg(d->file ? d->file->fileName() : qSL("<null>"));
 
+    QVector<const Application *> apps = d->readDatabase();
+    try {
+        d->replayJournal(apps);
+    } catch (...) {
+        qDeleteAll(apps);
+        throw;
+    }
+    return apps;
+}
+
+QVector<const Application *> ApplicationDatabasePrivate::readDatabase()
+{
+    generation = 0;
+
+    // a new, empty database
+    if (file->size() == 0)
+        return QVector<const Application *>();
+
+    Header header;
+    if (!readHeader(&header) || (header.version != FormatVersion)) {
+        throw Exception("application database %1 has an outdated format and needs to be recreated")
+            .arg(file->fileName());
+    }
+
+    // The mapping has to outlive this function (and d->file, which is replaced on every write()),
+    // since the Application objects reference the installation reports directly in the mapping.
+    // A separate QFile is used, because it unmaps everything when being closed.
+    QSharedPointer<QFile> mappedFile(new QFile(file->fileName()));
+    const uchar *base = nullptr;
+    qint64 size = 0;
+    if (QFileInfo(file->fileName()).isFile() && mappedFile->open(QFile::ReadOnly)) {
+        size = mappedFile->size();
+        if (size >= qint64(sizeof(Header)))
+            base = mappedFile->map(0, size);
+    }
+    if (!base)
+        throw Exception(*mappedFile, "could not map the application database");
+
+    return readMapped(base, size, mappedFile);
+}
+
+QVector<const Application *> ApplicationDatabasePrivate::readMapped(const uchar *base, qint64 size,
+                                                                   const QSharedPointer<QObject> &mapping)
+{
+    Header header;
+    memcpy(&header, base, sizeof(Header));
+
+    if (header.version != FormatVersion)
+        throw Exception("application database %1 has an unsupported format version (%2)").arg(file->fileName()).arg(header.version);
+    if (qint64(sizeof(Header)) + qint64(header.count) * qint64(sizeof(Entry)) > size)
+        throw Exception("application database %1 is corrupt: the record table is truncated").arg(file->fileName());
+
+    const char *data = reinterpret_cast<const char *>(base);
     QVector<const Application *> apps;
+    apps.reserve(int(header.count));
+
+    try {
+        for (quint32 i = 0; i < header.count; ++i) {
+            Entry entry;
+            memcpy(&entry, data + sizeof(Header) + i * sizeof(Entry), sizeof(Entry));
 
-    if (d->file->seek(0)) {
-        QDataStream ds(d->file);
+            if ((qint64(entry.recordOffset) + entry.recordSize > size)
+                    || (qint64(entry.reportOffset) + entry.reportSize > size)) {
+                throw Exception("application database %1 is corrupt: record %2 is out of bounds").arg(file->fileName()).arg(i);
+            }
+
+            // no copies: both the stream and the report are referencing the mapped file directly
+            const QByteArray record = QByteArray::fromRawData(data + entry.recordOffset, int(entry.recordSize));
+            QDataStream ds(record);
+            ds.setVersion(int(header.dataStreamVersion));
 
-        forever {
             QScopedPointer<Application> app(Application::readFromDataStream(ds, apps));
+            if (ds.status() != QDataStream::Ok)
+                throw Exception("could not read record %2 from application database %1").arg(file->fileName()).arg(i);
 
-            if (ds.status() != QDataStream::Ok) {
-                if (ds.status() != QDataStream::ReadPastEnd) {
-                    qDeleteAll(apps);
-                    throw Exception("could not read from application database %1").arg(d->file->fileName());
-                }
-                break;
+            if (entry.reportSize) {
+                app->setSerializedInstallationReport(QByteArray::fromRawData(data + entry.reportOffset,
+                                                                             int(entry.reportSize)), mapping);
             }
             apps << app.take();
         }
+    } catch (...) {
+        qDeleteAll(apps);
+        throw;
     }
-
+    generation = header.generation;
     return apps;
 }
 
+void ApplicationDatabasePrivate::replayJournal(QVector<const Application *> &apps)
+{
+    journalEntries = 0;
+    journalSize = 0;
+
+    QFile journal(journalFileName());
+    if (!generation || !journal.open(QFile::ReadOnly))
+        return;
+
+    const QByteArray data = journal.readAll();
+    Header header;
+    if (data.size() < int(sizeof(Header)))
+        return;
+    memcpy(&header, data.constData(), sizeof(Header));
+    if ((memcmp(header.magic, journalMagic, sizeof(journalMagic)) != 0)
+            || (header.version != FormatVersion)
+            || (header.generation != generation)) {
+        return; // stale journal of an older, already compacted database
+    }
+
+    int pos = int(sizeof(Header));
+    forever {
+        JournalEntry entry;
+        if (pos + int(sizeof(JournalEntry)) > data.size())
+            break;
+        memcpy(&entry, data.constData() + pos, sizeof(JournalEntry));
+        const int recordPos = pos + int(sizeof(JournalEntry));
+        const int reportPos = recordPos + int(entry.recordSize);
+        const int endPos = reportPos + int(entry.reportSize);
+
+        // anything after a truncated or damaged entry (e.g. due to a power loss) is ignored
+        if ((entry.recordSize > quint32(data.size())) || (entry.reportSize > quint32(data.size()))
+                || (endPos > data.size())
+                || (qChecksum(data.constData() + recordPos, entry.recordSize) != entry.recordChecksum)
+                || (qChecksum(data.constData() + reportPos, entry.reportSize) != entry.reportChecksum)) {
+            qCWarning(LogSystem) << "Ignoring damaged entries at the end of the application database journal"
+                                 << journal.fileName();
+            break;
+        }
+
+        const QByteArray record = QByteArray::fromRawData(data.constData() + recordPos, int(entry.recordSize));
+        QDataStream ds(record);
+        ds.setVersion(int(header.dataStreamVersion));
+
+        if (entry.type == JournalUpsert) {
+            QScopedPointer<Application> app(Application::readFromDataStream(ds, apps));
+            if (ds.status() != QDataStream::Ok)
+                throw Exception("could not read entry %2 from application database journal %1").arg(journal.fileName()).arg(journalEntries);
+            app->setSerializedInstallationReport(data.mid(reportPos, int(entry.reportSize)), QSharedPointer<QObject>());
+
+            auto it = std::find_if(apps.begin(), apps.end(), [&app](const Application *a) { return a->id() == app->id(); });
+            if (it != apps.end()) {
+                const Application *oldApp = *it;
+                for (const Application *a : qAsConst(apps)) {
+                    if (a->m_nonAliased == oldApp)
+                        const_cast<Application *>(a)->m_nonAliased = app.data();
+                }
+                *it = app.take();
+                delete oldApp;
+            } else {
+                apps << app.take();
+            }
+        } else if (entry.type == JournalRemove) {
+            QString id;
+            ds >> id;
+            for (int i = apps.size() - 1; i >= 0; --i) {
+                const Application *a = apps.at(i);
+                if (a->id() == id || (a->m_nonAliased && a->m_nonAliased->id() == id)) {
+                    apps.removeAt(i);
+                    delete a;
+                }
+            }
+        }
+        ++journalEntries;
+        pos = endPos;
+    }
+    journalSize = pos;
+}
+
+// returns false, if the file does not start with a database header
+bool ApplicationDatabasePrivate::readHeader(Header *header) const
+{
+    return file->seek(0)
+            && (file->read(reinterpret_cast<char *>(header), sizeof(Header)) == qint64(sizeof(Header)))
+            && (memcmp(header->magic, databaseMagic, sizeof(databaseMagic)) == 0);
+}
+
+quint32 ApplicationDatabasePrivate::generationOnDisk() const
+{
+    Header header;
+    return readHeader(&header) ? header.generation : 0;
+}
+
+bool ApplicationDatabasePrivate::needsCompaction() const
+{
+    return !generation || (journalEntries >= MaxJournalEntries) || (journalSize > file->size());
+}
+
+void ApplicationDatabasePrivate::appendToJournal(JournalEntryType type, const QByteArray &record, const QByteArray &report)
+{
+    QFile journal(journalFileName());
+    if (!journal.open(QFile::ReadWrite))
+        throw Exception(journal, "could not open the application database journal");
+
+    // cut off anything that was not successfully replayed (e.g. a partially written entry)
+    if (!journal.resize(journalEntries ? journalSize : 0) || !journal.seek(journal.size()))
+        throw Exception(journal, "could not truncate the application database journal");
+
+    QByteArray data;
+    if (!journalEntries) {
+        Header header;
+        memcpy(header.magic, journalMagic, sizeof(journalMagic));
+        header.version = FormatVersion;
+        header.dataStreamVersion = quint32(QDataStream().version());
+        header.count = 0;
+        header.generation = generation;
+        data.append(reinterpret_cast<const char *>(&header), sizeof(Header));
+    }
+    JournalEntry entry;
+    entry.type = type;
+    entry.recordSize = quint32(record.size());
+    entry.reportSize = quint32(report.size());
+    entry.recordChecksum = qChecksum(record.constData(), uint(record.size()));
+    entry.reportChecksum = qChecksum(report.constData(), uint(report.size()));
+    data.append(reinterpret_cast<const char *>(&entry), sizeof(JournalEntry));
+    data.append(record);
+    data.append(report);
+
+    if ((journal.write(data) != data.size()) || !journal.flush())
+        throw Exception(journal, "could not write to the application database journal");
+#if defined(Q_OS_UNIX)
+    if (::fsync(journal.handle()) != 0)
+        throw Exception(errno, "could not sync the application database journal to disk");
+#endif
+    journalSize = journal.size();
+    ++journalEntries;
+}
+
 void ApplicationDatabase::write(const QVector<const Application *> &apps) Q_DECL_NOEXCEPT_EXPR(false)
 {
     if (!d->file || !d->file->isOpen() || !d->file->isWritable())
         throw Exception("application database %1 is not opened for writing").arg(d->file ? d->file->fileName() : qSL("<null>"));
-    if (!d->file->seek(0))
-        throw Exception(*d->file, "could not not seek to position 0 in the application database");
-    if (!d->file->resize(0))
-        throw Exception(*d->file, "could not truncate the application database");
-
-    QDataStream ds(d->file);
-    for (const Application *app : apps)
-        app->writeToDataStream(ds, apps);
+
+    const QString fileName = d->file->fileName();
+    if (!QFileInfo(fileName).isFile())
+        throw Exception("application database %1 is not a regular file").arg(fileName);
+
+    Header header;
+    memcpy(header.magic, databaseMagic, sizeof(databaseMagic));
+    header.version = FormatVersion;
+    header.dataStreamVersion = quint32(QDataStream().version());
+    header.count = quint32(apps.size());
+    header.generation = qMax(d->generation, d->generationOnDisk()) + 1;
+
+    QVector<Entry> entries(apps.size());
+    QByteArray records;
+    quint32 offset = quint32(sizeof(Header) + entries.size() * sizeof(Entry));
+
+    for (int i = 0; i < apps.size(); ++i) {
+        const Application *app = apps.at(i);
+        Entry &entry = entries[i];
+
+        QByteArray record;
+        QDataStream ds(&record, QIODevice::WriteOnly);
+        ds.setVersion(int(header.dataStreamVersion));
+        app->writeToDataStream(ds, apps, false);
+        if (ds.status() != QDataStream::Ok)
+            throw Exception("could not serialize application %1 for the application database").arg(app->id());
+        const QByteArray report = app->serializedInstallationReport();
+
+        entry.recordOffset = offset;
+        entry.recordSize = quint32(record.size());
+        offset += entry.recordSize;
+        entry.reportOffset = offset;
+        entry.reportSize = quint32(report.size());
+        offset += entry.reportSize;
+
+        records.append(record);
+        records.append(report);
+    }
+
+    // The new database is written to a separate file, which then atomically replaces the old
+    // one: a crash cannot leave a half-written database behind and existing mappings of the
+    // old file stay valid.
+    QSaveFile saveFile(fileName);
+    if (!saveFile.open(QIODevice::WriteOnly))
+        throw Exception("could not create application database %1: %2").arg(fileName, saveFile.errorString());
+    if ((saveFile.write(reinterpret_cast<const char *>(&header), sizeof(Header)) != qint64(sizeof(Header)))
+            || (saveFile.write(reinterpret_cast<const char *>(entries.constData()), entries.size() * sizeof(Entry))
+                != qint64(entries.size() * sizeof(Entry)))
+            || (saveFile.write(records) != records.size())) {
+        throw Exception("could not write to application database %1: %2").arg(fileName, saveFile.errorString());
+    }
+    if (!saveFile.commit())
+        throw Exception("could not write to application database %1: %2").arg(fileName, saveFile.errorString());
+
+    // everything in the journal is now part of the database (the generation check would
+    // prevent a replay anyway, if the removal fails)
+    QFile::remove(d->journalFileName());
+    d->generation = header.generation;
+    d->journalEntries = 0;
+    d->journalSize = 0;
+
+    // reopen, so that d->file refers to the new file
+    d->file->close();
+    if (!d->file->open(QFile::ReadWrite))
+        throw Exception(*d->file, "could not re-open the application database");
+}
+
+void ApplicationDatabase::update(const Application *app, const QVector<const Application *> &apps) Q_DECL_NOEXCEPT_EXPR(false)
+{
+    if (!d->file || !d->file->isOpen() || !d->file->isWritable())
+        throw Exception("application database %1 is not opened for writing").arg(d->file ? d->file->fileName() : qSL("<null>"));
+
+    if (isTemporary() || d->needsCompaction()) {
+        write(apps);
+        return;
+    }
+
+    QByteArray record;
+    QDataStream ds(&record, QIODevice::WriteOnly);
+    app->writeToDataStream(ds, apps, false);
     if (ds.status() != QDataStream::Ok)
-        throw Exception(*d->file, "could not write to application database");
+        throw Exception("could not serialize application %1 for the application database").arg(app->id());
+
+    d->appendToJournal(JournalUpsert, record, app->serializedInstallationReport());
+}
+
+void ApplicationDatabase::remove(const QString &id, const QVector<const Application *> &apps) Q_DECL_NOEXCEPT_EXPR(false)
+{
+    if (!d->file || !d->file->isOpen() || !d->file->isWritable())
+        throw Exception("application database %1 is not opened for writing").arg(d->file ? d->file->fileName() : qSL("<null>"));
+
+    if (isTemporary() || d->needsCompaction()) {
+        write(apps);
+        return;
+    }
+
+    QByteArray record;
+    QDataStream ds(&record, QIODevice::WriteOnly);
+    ds << id;
+
+    d->appendToJournal(JournalRemove, record, QByteArray());
 }
 
 void ApplicationDatabase::invalidate()
@@ -148,6 +551,7 @@ void ApplicationDatabase::invalidate()
     if (d->file) {
         if (d->file->isOpen())
             d->file->close();
+        QFile::remove(d->journalFileName());
         d->file->remove();
         d->file = nullptr;
     }
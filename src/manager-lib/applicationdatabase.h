@@ -61,9 +61,12 @@ public:
     bool isTemporary() const;
     QString errorString() const;
     QString name() const;
+    bool isOutdated() const;
 
     QVector<const Application *> read() Q_DECL_NOEXCEPT_EXPR(false);
     void write(const QVector<const Application *> &apps) Q_DECL_NOEXCEPT_EXPR(false);
+    void update(const Application *app, const QVector<const Application *> &apps) Q_DECL_NOEXCEPT_EXPR(false);
+    void remove(const QString &id, const QVector<const Application *> &apps) Q_DECL_NOEXCEPT_EXPR(false);
 
     void invalidate();
 
@@ -44,10 +44,12 @@
 #  include <QDBusMessage>
 #  include <QDBusConnection>
 #  include <QDBusArgument>
+#  include <QDBusUnixFileDescriptor>
 #endif
 
 #include <QMetaObject>
 #include <QMetaMethod>
+#include <QTimer>
 
 #include <QJSValue>
 #include <QUrl>
@@ -58,6 +60,8 @@
 #include "application.h"
 #include "utilities.h"
 #include "dbus-utilities.h"
+#include "exception.h"
+#include "sharedmemoryring.h"
 #include "applicationipcinterface.h"
 #include "applicationipcinterface_p.h"
 
@@ -135,6 +139,12 @@ bool ApplicationIPCInterface::dbusUnregister(QDBusConnection connection)
 #endif
 
 #define TYPE_ANNOTATION_PREFIX "_decltype_"
+#define TRANSPORT_ANNOTATION_PREFIX "_transport_"
+
+static const char *sharedMemoryTransportInterface = "io.qt.ApplicationManager.SharedMemoryTransport";
+static const char *transportAnnotation = "io.qt.ApplicationManager.Transport";
+static const int sharedMemoryRingCapacity = 1024 * 1024;
+static const int sharedMemoryMaxBacklog = 64 * 1024;
 
 QVector<IpcProxyObject *> IpcProxyObject::s_proxies;
 
@@ -221,7 +231,7 @@ IpcProxyObject::IpcProxyObject(QObject *object, const QString &serviceName, cons
         switch (mm.methodType()) {
         case QMetaMethod::Signal: {
             // ignore the unavoidable changed signals for our annotation properties
-            if (mm.name().startsWith(TYPE_ANNOTATION_PREFIX))
+            if (mm.name().startsWith(TYPE_ANNOTATION_PREFIX) || mm.name().startsWith(TRANSPORT_ANNOTATION_PREFIX))
                 continue;
 
             int propertyIndex = mo->propertyOffset();
@@ -249,10 +259,19 @@ IpcProxyObject::IpcProxyObject(QObject *object, const QString &serviceName, cons
             continue;
         }
     }
+    QList<QPair<QByteArray, QString>> transportAnnotations;
+
     for (int i = mo->propertyOffset(); i < mo->propertyCount(); ++i) {
         QMetaProperty mp = mo->property(i);
         QByteArray propName = mp.name();
 
+        // handle our annotation mechanism to select the transport for signals and properties
+        if (propName.startsWith(TRANSPORT_ANNOTATION_PREFIX)) {
+            transportAnnotations << qMakePair(propName.mid(qstrlen(TRANSPORT_ANNOTATION_PREFIX)),
+                                              mp.read(object).toString());
+            continue;
+        }
+
         // handle our annotation mechanism to add types to method parameters
         if (propName.startsWith(TYPE_ANNOTATION_PREFIX)) {
             QByteArray slotName = propName.mid(qstrlen(TYPE_ANNOTATION_PREFIX));
@@ -319,6 +338,11 @@ IpcProxyObject::IpcProxyObject(QObject *object, const QString &serviceName, cons
         }
     }
 
+    createDispatchTable();
+#if defined(QT_DBUS_LIB)
+    resolveSharedMemoryMembers(transportAnnotations);
+#endif
+
     QByteArray xml = createIntrospectionXml();
     m_xmlIntrospection = QLatin1String(xml);
 
@@ -350,15 +374,35 @@ QByteArray IpcProxyObject::createIntrospectionXml()
         if (mp.isWritable())
             readWrite += "write";
 
+        // clients are caching property values, so they need to know about properties that
+        // will never tell them about changes
+        QByteArray annotations;
+        if (mp.isConstant()) {
+            annotations += "    <annotation name=\"org.freedesktop.DBus.Property.EmitsChangedSignal\" value=\"const\"/>\n";
+        } else if (m_signalsToProperties.value(mp.notifySignalIndex(), -1) != i) {
+            annotations += "    <annotation name=\"org.freedesktop.DBus.Property.EmitsChangedSignal\" value=\"false\"/>\n";
+        }
+#if defined(QT_DBUS_LIB)
+        if (m_sharedMemoryProperties.contains(i) || m_sharedMemoryInputProperties.contains(i))
+            annotations = annotations + "    <annotation name=\"" + transportAnnotation + "\" value=\"shared-memory\"/>\n";
+#endif
+
         xml = xml + "  <property name=\"" + mp.name()
                 + "\" type=\"" + dbusType(mp.type())
-                + "\" access=\"" + readWrite
-                + "\" />\n";
+                + "\" access=\"" + readWrite;
+        if (annotations.isEmpty())
+            xml += "\" />\n";
+        else
+            xml = xml + "\">\n" + annotations + "  </property>\n";
     }
     for (int i : qAsConst(m_signals)) {
         QMetaMethod mm = mo->method(i);
 
         xml = xml + "  <signal name=\"" + mm.name() + "\">\n";
+#if defined(QT_DBUS_LIB)
+        if (m_sharedMemorySignals.contains(i))
+            xml = xml + "    <annotation name=\"" + transportAnnotation + "\" value=\"shared-memory\"/>\n";
+#endif
         for (int pi = 0; pi < mm.parameterCount(); ++pi) {
             xml = xml + "    <arg name=\"" + mm.parameterNames().at(pi)
                     + "\" type=\"" + dbusType(mm.parameterType(pi))
@@ -382,6 +426,11 @@ QByteArray IpcProxyObject::createIntrospectionXml()
         }
 
         xml = xml + "  <method name=\"" + mm.name() + "\">\n";
+#if defined(QT_DBUS_LIB)
+        int inputMember = m_sharedMemoryInputMembers.indexOf(QString::fromLatin1(mm.name()));
+        if ((inputMember >= 0) && (m_sharedMemoryInputProperties.at(inputMember) < 0) && (types.at(0) == QMetaType::Void))
+            xml = xml + "    <annotation name=\"" + transportAnnotation + "\" value=\"shared-memory\"/>\n";
+#endif
         for (int pi = 0; pi < types.count(); ++pi) {
             if (pi == 0 && types.at(0) == QMetaType::Void)
                 continue;
@@ -404,6 +453,116 @@ QByteArray IpcProxyObject::createIntrospectionXml()
     return xml;
 }
 
+void IpcProxyObject::createDispatchTable()
+{
+    const QMetaObject *mo = m_object->metaObject();
+
+    for (int mi : qAsConst(m_slots)) {
+        QMetaMethod mm = mo->method(mi);
+
+        if (mm.parameterCount() > 10) {
+            qCWarning(LogQmlIpc) << "Ignoring method" << mm.methodSignature()
+                                 << "since it has more than 10 parameters";
+            continue;
+        }
+
+        MethodDispatch md;
+        md.methodIndex = mi;
+        md.returnType = mm.returnType();
+
+        QList<int> types = m_slotSignatures.value(mi);
+        if (types.isEmpty()) {
+            // there was no TYPE_ANNOTATION_PREFIX<mm.name()> property - just use Qt's introspection
+            types << mm.returnType();
+            for (int i = 0; i < mm.parameterCount(); ++i)
+                types << mm.parameterType(i);
+        }
+        md.voidResult = (types.at(0) == QMetaType::Void);
+
+        for (int i = 0; i < mm.parameterCount(); ++i) {
+            md.expectedTypes << types.at(i + 1);
+            md.parameterTypes << mm.parameterType(i);
+            md.parameterTypeNames << QMetaType::typeName(mm.parameterType(i));
+        }
+
+        m_dispatchTable[qMakePair(QString::fromLatin1(mm.name()), mm.parameterCount())] << md;
+    }
+
+    for (int pi : qAsConst(m_properties))
+        m_propertiesByName.insert(QString::fromLatin1(mo->property(pi).name()), pi);
+}
+
+#if defined(QT_DBUS_LIB)
+
+void IpcProxyObject::resolveSharedMemoryMembers(const QList<QPair<QByteArray, QString>> &annotations)
+{
+    const QMetaObject *mo = m_object->metaObject();
+
+    for (const auto &annotation : annotations) {
+        const QByteArray &name = annotation.first;
+        const QString &transport = annotation.second;
+
+        if (transport == qL1S("dbus"))
+            continue;
+        if (transport != qL1S("shared-memory")) {
+            qCWarning(LogQmlIpc) << "Found special annotation property" << TRANSPORT_ANNOTATION_PREFIX + name
+                                 << "but the transport" << transport << "is unknown";
+            continue;
+        }
+
+        int member = m_sharedMemoryMembers.size();
+        bool found = false;
+
+        for (int si : qAsConst(m_signals)) {
+            if (mo->method(si).name() == name) {
+                m_sharedMemorySignals.insert(si, member);
+                found = true;
+            }
+        }
+        for (int pi : qAsConst(m_properties)) {
+            if ((mo->property(pi).name() == name) && m_signalsToProperties.values().contains(pi)) {
+                m_sharedMemoryProperties.insert(pi, member);
+                found = true;
+            }
+        }
+
+        if (found)
+            m_sharedMemoryMembers << QString::fromLatin1(name);
+
+        // the other direction: calls to void methods and writes to properties do not need a
+        // reply, so they can be sent by the clients via the input ring buffer
+        int inputProperty = -1;
+        for (int pi : qAsConst(m_properties)) {
+            if ((mo->property(pi).name() == name) && mo->property(pi).isWritable())
+                inputProperty = pi;
+        }
+        bool inputMethod = false;
+        for (auto it = m_dispatchTable.cbegin(); it != m_dispatchTable.cend(); ++it) {
+            if (it.key().first == QLatin1String(name)) {
+                for (const MethodDispatch &md : it.value())
+                    inputMethod = inputMethod || md.voidResult;
+            }
+        }
+        if ((inputProperty >= 0) || inputMethod) {
+            m_sharedMemoryInputMembers << QString::fromLatin1(name);
+            m_sharedMemoryInputProperties << inputProperty;
+            found = true;
+        }
+
+        if (!found) {
+            qCWarning(LogQmlIpc) << "Found special annotation property" << TRANSPORT_ANNOTATION_PREFIX + name
+                                 << "but there is no signal, property or void function named" << name;
+        }
+    }
+    if ((!m_sharedMemoryMembers.isEmpty() || !m_sharedMemoryInputMembers.isEmpty())
+            && !SharedMemoryRing::isSupported()) {
+        qCWarning(LogQmlIpc) << "The shared memory transport is not supported on this platform:"
+                             << (m_sharedMemoryMembers + m_sharedMemoryInputMembers) << "will be sent via D-Bus";
+    }
+}
+
+#endif // QT_DBUS_LIB
+
 QObject *IpcProxyObject::object() const
 {
     return m_object;
@@ -473,6 +632,8 @@ bool IpcProxyObject::dbusRegister(const Application *app, QDBusConnection connec
 bool IpcProxyObject::dbusUnregister(QDBusConnection connection)
 {
     if (m_connectionNamesToApplicationIds.remove(connection.name())) {
+        m_outgoingQueues.remove(connection.name());
+        closeSharedMemoryTransport(connection.name());
         connection.unregisterObject(m_pathNamePrefixForConnection.value(connection.name()) + m_pathName);
         return true;
     }
@@ -498,8 +659,8 @@ QString IpcProxyObject::introspect(const QString &path) const
 bool IpcProxyObject::handleMessage(const QDBusMessage &message, const QDBusConnection &connection)
 {
     QString interface = message.interface();
-    QByteArray function = message.member().toLatin1();
-    const QMetaObject *mo = m_object->metaObject();
+    QString function = message.member();
+    const QList<QVariant> arguments = message.arguments();
 
     m_sender = m_connectionNamesToApplicationIds.value(connection.name());
     struct ClearSender {
@@ -509,110 +670,81 @@ bool IpcProxyObject::handleMessage(const QDBusMessage &message, const QDBusConne
     } clearSender(m_sender);
 
     if (interface == m_interfaceName) {
-        // find in registered slots only - not in all methods
-        for (int mi : qAsConst(m_slots)) {
-            QMetaMethod mm = mo->method(mi);
-            if (mm.name() == function) {
-                if (mm.parameterCount() == message.arguments().count()) {
-                    bool matched = true;
-                    QVariant argsCopy[10]; // we need to convert QDBusVariants
-                    QGenericArgument args[10];
-                    QList<int> expectedTypes = m_slotSignatures.value(mi);
-
-                    if (expectedTypes.isEmpty()) {
-                        // there was no TYPE_ANNOTATION_PREFIX<mm.name()> property - just use Qt's introspection
-                        expectedTypes << mm.returnType();
-                        for (int i = 0; i < mm.parameterCount(); ++i)
-                            expectedTypes << mm.parameterType(i);
-                    }
-                    for (int ai = 0; ai < mm.parameterCount(); ++ai) {
-                        // QDBusVariants have to be converted to plain QVariants first
-                        argsCopy[ai] = convertFromDBusVariant(message.arguments().at(ai));
-
-                        // parameter types need to match - the only exception is if we expect
-                        // a QVariant, since we can convert the parameter implicitly
-                        if (argsCopy[ai].typeName() != QMetaType::typeName(expectedTypes.at(ai + 1))) {
-                            if (expectedTypes.at(ai + 1) != QMetaType::QVariant) {
-                                matched = false;
-                                qWarning() << "MISMATCHED PARAMETER" << ai + 1 << "ON FUNCTION" << function
-                                           << "- EXPECTED" << QMetaType::typeName(expectedTypes.at(ai + 1))
-                                           << "- RECEIVED" << argsCopy[ai].typeName();
-                                break;
-                            }
-                        }
-                        // this is why we need the argsCopy array - args[] saves the data()
-                        // pointers of all the parameter QVariants
-                        args[ai] = QGenericArgument(argsCopy[ai].typeName(), argsCopy[ai].data());
-                    }
-                    if (matched) {
-                        QVariant result;
-                        if (mm.invoke(m_object, Q_RETURN_ARG(QVariant, result),
-                                      args[0], args[1], args[2], args[3], args[4],
-                                      args[5], args[6], args[7], args[8], args[9])) {
-
-                            if (expectedTypes.at(0) == QMetaType::Void || !result.isValid()) {
-                                connection.call(message.createReply(), QDBus::NoBlock);
-                            } else {
-                                // if we get back a JS value, we need to convert it to a C++
-                                // QVariant first.
-                                result = convertFromJSVariant(result);
-
-                                connection.call(message.createReply(result), QDBus::NoBlock);
-                            }
-                            return true;
-                        }
-                    }
-                }
-            }
+        QVariant result;
+        const MethodDispatch *md = invokeMethod(function, arguments, &result);
+        if (!md)
+            return false;
+
+        // the client has to see all changes caused by this call before the reply
+        flushOutgoingQueue(connection.name());
+
+        if (md->voidResult || !result.isValid()) {
+            connection.call(message.createReply(), QDBus::NoBlock);
+        } else {
+            // if we get back a JS value, we need to convert it to a C++
+            // QVariant first.
+            result = convertFromJSVariant(result);
+
+            connection.call(message.createReply(result), QDBus::NoBlock);
         }
+        return true;
+
+    } else if (interface == qL1S(sharedMemoryTransportInterface)) {
+        if (function == qL1S("Open") && arguments.isEmpty())
+            return openSharedMemoryTransport(message, connection);
 
     } else if (interface == qL1S("org.freedesktop.DBus.Properties")) {
-        if (message.arguments().at(0) != m_interfaceName)
+        if (arguments.isEmpty() || arguments.at(0) != m_interfaceName)
             return false;
 
         const QMetaObject *mo = m_object->metaObject();
 
-        if (function == "Get") {
-            QByteArray name = message.arguments().at(1).toString().toLatin1();
-            QVariant result;
+        if (function == qL1S("Get") && arguments.count() == 2) {
+            int pi = m_propertiesByName.value(arguments.at(1).toString(), -1);
+            if (pi < 0) {
+                connection.call(message.createErrorReply(QDBusError::UnknownProperty, qL1S("unknown property")));
+                return true;
+            }
+
+            QVariant result = convertFromJSVariant(mo->property(pi).read(m_object));
+            // this seems counter-intuitive, but we have to wrap the QVariant into
+            // QDBusVariant, which has to be wrapped into a QVariant again.
+            QDBusVariant dbusResult = QDBusVariant(result);
 
+            flushOutgoingQueue(connection.name());
+            connection.call(message.createReply(QVariant::fromValue(dbusResult)), QDBus::NoBlock);
+            return true;
+
+        } else if (function == qL1S("GetAll") && arguments.count() == 1) {
+            QVariantMap result;
             for (int pi : qAsConst(m_properties)) {
                 QMetaProperty mp = mo->property(pi);
-                if (mp.name() == name) {
-                    result = convertFromJSVariant(mp.read(m_object));
-                    // this seems counter-intuitive, but we have to wrap the QVariant into
-                    // QDBusVariant, which has to be wrapped into a QVariant again.
-                    QDBusVariant dbusResult = QDBusVariant(result);
-
-                    connection.call(message.createReply(QVariant::fromValue(dbusResult)), QDBus::NoBlock);
-                    return true;
-                }
+                result.insert(qL1S(mp.name()), convertFromJSVariant(mp.read(m_object)));
             }
-            connection.call(message.createErrorReply(QDBusError::UnknownProperty, qL1S("unknown property")));
-            return true;
 
-        } else if (function == "GetAll") {
-            //TODO
-        } else if (function == "Set") {
-            QByteArray name = message.arguments().at(1).toString().toLatin1();
+            flushOutgoingQueue(connection.name());
+            connection.call(message.createReply(QVariant(result)), QDBus::NoBlock);
+            return true;
 
-            for (int pi : qAsConst(m_properties)) {
-                QMetaProperty mp = mo->property(pi);
-                if (mp.name() == name) {
-                    if (mp.isWritable()) {
-                        QVariant value = convertFromDBusVariant(message.arguments().at(2));
-                        if (mp.write(m_object, value))
-                            connection.call(message.createReply(), QDBus::NoBlock);
-                        else
-                            connection.call(message.createErrorReply(QDBusError::InvalidArgs, qL1S("calling QMetaProperty::write() failed")));
-                    } else {
-                        connection.call(message.createErrorReply(QDBusError::PropertyReadOnly, qL1S("property is read-only")));
-                    }
+        } else if (function == qL1S("Set") && arguments.count() == 3) {
+            int pi = m_propertiesByName.value(arguments.at(1).toString(), -1);
+            if (pi < 0) {
+                connection.call(message.createErrorReply(QDBusError::UnknownProperty, qL1S("unknown property")));
+                return true;
+            }
 
-                    return true;
+            QMetaProperty mp = mo->property(pi);
+            if (mp.isWritable()) {
+                QVariant value = convertFromDBusVariant(arguments.at(2));
+                if (mp.write(m_object, value)) {
+                    flushOutgoingQueue(connection.name());
+                    connection.call(message.createReply(), QDBus::NoBlock);
+                } else {
+                    connection.call(message.createErrorReply(QDBusError::InvalidArgs, qL1S("calling QMetaProperty::write() failed")));
                 }
+            } else {
+                connection.call(message.createErrorReply(QDBusError::PropertyReadOnly, qL1S("property is read-only")));
             }
-            connection.call(message.createErrorReply(QDBusError::UnknownProperty, qL1S("unknown property")));
             return true;
         }
     }
@@ -620,16 +752,102 @@ bool IpcProxyObject::handleMessage(const QDBusMessage &message, const QDBusConne
     return false;
 }
 
+/*! \internal
+    Calls the first slot of the dispatch table, that matches \a function and the types of
+    \a arguments. Returns the matching entry, or \c nullptr if none could be called.
+*/
+const IpcProxyObject::MethodDispatch *IpcProxyObject::invokeMethod(const QString &function,
+                                                                   const QVariantList &arguments,
+                                                                   QVariant *result)
+{
+    // only registered slots are in the dispatch table - not all methods
+    auto it = m_dispatchTable.constFind(qMakePair(function, arguments.count()));
+    if (it == m_dispatchTable.cend())
+        return nullptr;
+
+    for (const MethodDispatch &md : *it) {
+        bool matched = true;
+        QVariant argsCopy[10]; // we need to convert QDBusVariants
+        QGenericArgument args[10];
+
+        for (int ai = 0; ai < arguments.count(); ++ai) {
+            // QDBusVariants have to be converted to plain QVariants first
+            argsCopy[ai] = convertFromDBusVariant(arguments.at(ai));
+
+            // parameter types need to match - the only exception is if we expect
+            // a QVariant, since we can convert the parameter implicitly
+            int expectedType = md.expectedTypes.at(ai);
+            if ((argsCopy[ai].userType() != expectedType) && (expectedType != QMetaType::QVariant)) {
+                matched = false;
+                qWarning() << "MISMATCHED PARAMETER" << ai + 1 << "ON FUNCTION" << function
+                           << "- EXPECTED" << QMetaType::typeName(expectedType)
+                           << "- RECEIVED" << argsCopy[ai].typeName();
+                break;
+            }
+
+            // this is why we need the argsCopy array - args[] saves the data()
+            // pointers of all the parameter QVariants
+            int parameterType = md.parameterTypes.at(ai);
+            if (parameterType == QMetaType::QVariant) {
+                args[ai] = QGenericArgument("QVariant", &argsCopy[ai]);
+            } else if ((argsCopy[ai].userType() == parameterType) || argsCopy[ai].convert(parameterType)) {
+                args[ai] = QGenericArgument(md.parameterTypeNames.at(ai), argsCopy[ai].data());
+            } else {
+                matched = false;
+                break;
+            }
+        }
+        if (!matched)
+            continue;
+
+        QGenericReturnArgument returnArg;
+        *result = QVariant();
+        if (md.returnType == QMetaType::QVariant) {
+            returnArg = QGenericReturnArgument("QVariant", result);
+        } else if (md.returnType != QMetaType::Void) {
+            *result = QVariant(md.returnType, nullptr);
+            returnArg = QGenericReturnArgument(QMetaType::typeName(md.returnType), result->data());
+        }
+
+        const QMetaMethod mm = m_object->metaObject()->method(md.methodIndex);
+        if (mm.invoke(m_object, Qt::DirectConnection, returnArg,
+                      args[0], args[1], args[2], args[3], args[4],
+                      args[5], args[6], args[7], args[8], args[9])) {
+            return &md;
+        }
+    }
+    return nullptr;
+}
+
 #endif // QT_DBUS_LIB
 
 void IpcProxyObject::relaySignal(int signalIndex, void **argv)
 {
 #if defined(QT_DBUS_LIB)
-    QMapIterator<QString, QString> it(m_connectionNamesToApplicationIds);
-    while (it.hasNext()) {
-        it.next();
-        QString connectionName = it.key();
-        QString applicationId = it.value();
+    int propertyIndex = m_signalsToProperties.value(signalIndex, -1);
+    QList<QVariant> args;
+    QString member;
+
+    if (propertyIndex >= 0) {
+        // the value is read lazily, when the next PropertiesChanged signal is actually created
+        m_propertyValues.remove(propertyIndex);
+    } else {
+        const QMetaMethod mm = m_object->metaObject()->method(signalIndex);
+        member = qL1S(mm.name());
+
+        for (int i = 0; i < mm.parameterCount(); ++i)
+            args << convertFromJSVariant(QVariant(mm.parameterType(i), argv[i + 1]));
+    }
+
+    int sharedMemoryMember = (propertyIndex >= 0) ? m_sharedMemoryProperties.value(propertyIndex, -1)
+                                                  : m_sharedMemorySignals.value(signalIndex, -1);
+    QByteArray sharedMemoryMessage;
+    bool sharedMemoryEncoded = false;
+    bool sharedMemoryPending = false;
+
+    for (auto it = m_connectionNamesToApplicationIds.cbegin(); it != m_connectionNamesToApplicationIds.cend(); ++it) {
+        const QString &connectionName = it.key();
+        const QString &applicationId = it.value();
 
         // check if we have a receiver filter
         if (!m_receivers.isEmpty()) {
@@ -637,36 +855,49 @@ void IpcProxyObject::relaySignal(int signalIndex, void **argv)
                 continue;
         }
 
-        QDBusConnection connection(connectionName);
-        if (connection.isConnected()) {
-            int propertyIndex = m_signalsToProperties.value(signalIndex, -1);
-            QString pathName = m_pathNamePrefixForConnection.value(connection.name()) + m_pathName;
-
-            if (propertyIndex >= 0) {
-                const QMetaProperty mp = m_object->metaObject()->property(propertyIndex);
-
-                QDBusMessage message = QDBusMessage::createSignal(pathName, qSL("org.freedesktop.DBus.Properties"), qSL("PropertiesChanged"));
-                message << m_interfaceName
-                        << QVariantMap() // { { qL1S(mp.name()), QVariant::fromValue(QDBusVariant(convertFromJSVariant(mp.read(m_object)))) } };
-                        << QStringList(qL1S(mp.name()));
-
-                connection.send(message);
-
-            } else {
-                const QMetaMethod mm = m_object->metaObject()->method(signalIndex);
-
-                QList<QVariant> args;
-                for (int i = 0; i < mm.parameterCount(); ++i) {
-                    args << convertFromJSVariant(QVariant(mm.parameterType(i), argv[i + 1]));
+        // clients that opened a shared memory transport get these members via the ring buffer
+        if (sharedMemoryMember >= 0) {
+            auto tit = m_sharedMemoryTransports.find(connectionName);
+            if (tit != m_sharedMemoryTransports.end()) {
+                if (!sharedMemoryEncoded) {
+                    sharedMemoryEncoded = true;
+                    sharedMemoryMessage = SharedMemoryRing::encodeMessage(sharedMemoryMember, (propertyIndex >= 0)
+                                                                          ? QVariantList { propertyValue(propertyIndex) }
+                                                                          : args);
+                    if (sharedMemoryMessage.isNull()) {
+                        qCWarning(LogQmlIpc) << "Could not send" << m_object->metaObject()->method(signalIndex).name()
+                                             << "of" << m_pathName << "via the shared memory transport:"
+                                             << "unsupported argument type";
+                    }
                 }
+                if (!sharedMemoryMessage.isNull()) {
+                    sendSharedMemoryMessage(*tit, sharedMemoryMessage);
+                    sharedMemoryPending = true;
+                }
+                continue;
+            }
+        }
 
-                QDBusMessage message = QDBusMessage::createSignal(pathName, m_interfaceName, qL1S(mm.name()));
-                message.setArguments(args);
+        OutgoingQueue &queue = m_outgoingQueues[connectionName];
 
-                connection.send(message);
-            }
+        if (propertyIndex >= 0) {
+            if (!queue.changedProperties.contains(propertyIndex))
+                queue.changedProperties << propertyIndex;
+        } else {
+            // signals have to be delivered after all property changes that happened before
+            closePropertyBatch(connectionName, queue);
+
+            QString pathName = m_pathNamePrefixForConnection.value(connectionName) + m_pathName;
+            QDBusMessage message = QDBusMessage::createSignal(pathName, m_interfaceName, member);
+            message.setArguments(args);
+            queue.messages << message;
         }
     }
+
+    if (!m_flushScheduled && (sharedMemoryPending || !m_outgoingQueues.isEmpty())) {
+        m_flushScheduled = true;
+        QTimer::singleShot(0, this, [this]() { flushOutgoingQueues(); });
+    }
 #else
     Q_UNUSED(signalIndex)
     Q_UNUSED(argv)
@@ -675,6 +906,216 @@ void IpcProxyObject::relaySignal(int signalIndex, void **argv)
     m_receivers.clear();
 }
 
+#if defined(QT_DBUS_LIB)
+
+void IpcProxyObject::closePropertyBatch(const QString &connectionName, OutgoingQueue &queue)
+{
+    if (queue.changedProperties.isEmpty())
+        return;
+
+    // send the new values along, so clients can keep their property caches up-to-date
+    // without having to call Get
+    QVariantMap changed;
+    const QMetaObject *mo = m_object->metaObject();
+    for (int propertyIndex : qAsConst(queue.changedProperties))
+        changed.insert(qL1S(mo->property(propertyIndex).name()), propertyValue(propertyIndex));
+    queue.changedProperties.clear();
+
+    QString pathName = m_pathNamePrefixForConnection.value(connectionName) + m_pathName;
+    QDBusMessage message = QDBusMessage::createSignal(pathName, qSL("org.freedesktop.DBus.Properties"), qSL("PropertiesChanged"));
+    message << m_interfaceName << changed << QStringList();
+    queue.messages << message;
+}
+
+void IpcProxyObject::flushOutgoingQueues()
+{
+    m_flushScheduled = false;
+
+    const QStringList connectionNames = m_outgoingQueues.keys();
+    for (const QString &connectionName : connectionNames)
+        flushOutgoingQueue(connectionName);
+    m_propertyValues.clear();
+
+    // wake up the readers only once per event loop iteration
+    for (SharedMemoryTransport &transport : m_sharedMemoryTransports) {
+        if (writeSharedMemoryBacklog(transport))
+            transport.notify = true;
+        if (transport.notify) {
+            transport.notify = false;
+            transport.ring->notify();
+        }
+    }
+}
+
+void IpcProxyObject::flushOutgoingQueue(const QString &connectionName)
+{
+    auto it = m_outgoingQueues.find(connectionName);
+    if (it == m_outgoingQueues.end())
+        return;
+
+    OutgoingQueue queue = it.value();
+    m_outgoingQueues.erase(it);
+
+    if (!m_object)
+        return;
+    closePropertyBatch(connectionName, queue);
+
+    QDBusConnection connection(connectionName);
+    if (connection.isConnected()) {
+        for (const QDBusMessage &message : qAsConst(queue.messages))
+            connection.send(message);
+    }
+}
+
+QVariant IpcProxyObject::propertyValue(int propertyIndex)
+{
+    auto it = m_propertyValues.constFind(propertyIndex);
+    if (it != m_propertyValues.cend())
+        return *it;
+
+    QVariant value = convertFromJSVariant(m_object->metaObject()->property(propertyIndex).read(m_object));
+    m_propertyValues.insert(propertyIndex, value);
+    return value;
+}
+
+bool IpcProxyObject::openSharedMemoryTransport(const QDBusMessage &message, const QDBusConnection &connection)
+{
+    if ((m_sharedMemoryMembers.isEmpty() && m_sharedMemoryInputMembers.isEmpty())
+            || !SharedMemoryRing::isSupported()
+            || !connection.connectionCapabilities().testFlag(QDBusConnection::UnixFileDescriptorPassing)) {
+        connection.send(message.createErrorReply(QDBusError::NotSupported,
+                                                 qSL("The shared memory transport is not available")));
+        return true;
+    }
+
+    try {
+        const QString connectionName = connection.name();
+        QScopedPointer<SharedMemoryRing> ring(SharedMemoryRing::create(SharedMemoryRing::Producer,
+                                                                       sharedMemoryRingCapacity, this));
+        QScopedPointer<SharedMemoryRing> inputRing(SharedMemoryRing::create(SharedMemoryRing::Consumer,
+                                                                            sharedMemoryRingCapacity, this));
+        connect(ring.data(), &SharedMemoryRing::spaceAvailable,
+                this, [this, connectionName]() { drainSharedMemoryBacklog(connectionName); });
+        connect(inputRing.data(), &SharedMemoryRing::readyRead,
+                this, [this, connectionName]() { readSharedMemoryInput(connectionName); });
+
+        // a client re-opening the transport gets fresh ring buffers
+        closeSharedMemoryTransport(connectionName);
+        SharedMemoryTransport &transport = m_sharedMemoryTransports[connectionName];
+        transport.ring = ring.take();
+        transport.inputRing = inputRing.take();
+
+        // anything already queued for D-Bus has to arrive before the reply
+        flushOutgoingQueue(connectionName);
+
+        QDBusMessage reply = message.createReply();
+        for (const SharedMemoryRing *r : { transport.ring, transport.inputRing }) {
+            reply << QVariant::fromValue(QDBusUnixFileDescriptor(r->memoryFd()))
+                  << QVariant::fromValue(QDBusUnixFileDescriptor(r->dataEventFd()))
+                  << QVariant::fromValue(QDBusUnixFileDescriptor(r->spaceEventFd()));
+        }
+        reply << m_sharedMemoryMembers << m_sharedMemoryInputMembers;
+        connection.send(reply);
+    } catch (const Exception &e) {
+        qCWarning(LogQmlIpc) << "Could not open a shared memory transport for" << m_pathName << ":" << e.errorString();
+        connection.send(message.createErrorReply(QDBusError::Failed, e.errorString()));
+    }
+    return true;
+}
+
+void IpcProxyObject::closeSharedMemoryTransport(const QString &connectionName)
+{
+    SharedMemoryTransport transport = m_sharedMemoryTransports.take(connectionName);
+    delete transport.ring;
+    // we might be called from within readSharedMemoryInput()
+    if (transport.inputRing)
+        transport.inputRing->deleteLater();
+}
+
+void IpcProxyObject::sendSharedMemoryMessage(SharedMemoryTransport &transport, const QByteArray &message)
+{
+    // do not only rely on spaceAvailable: the reader might have caught up in the meantime
+    writeSharedMemoryBacklog(transport);
+
+    // the backlog keeps the message order intact, while the reader is catching up
+    if (!transport.backlog.isEmpty() || !transport.ring->write(message)) {
+        if (transport.backlog.size() >= sharedMemoryMaxBacklog) {
+            qCWarning(LogQmlIpc) << "The shared memory transport for" << m_pathName
+                                 << "is overflowing: dropping a message";
+            return;
+        }
+        transport.backlog << message;
+    }
+    transport.notify = true;
+}
+
+bool IpcProxyObject::writeSharedMemoryBacklog(SharedMemoryTransport &transport)
+{
+    bool written = false;
+    while (!transport.backlog.isEmpty() && transport.ring->write(transport.backlog.constFirst())) {
+        transport.backlog.removeFirst();
+        written = true;
+    }
+    return written;
+}
+
+void IpcProxyObject::drainSharedMemoryBacklog(const QString &connectionName)
+{
+    auto it = m_sharedMemoryTransports.find(connectionName);
+    if (it == m_sharedMemoryTransports.end())
+        return;
+
+    if (writeSharedMemoryBacklog(*it))
+        it->ring->notify();
+}
+
+/*! \internal
+    Calls and property writes from the client arrive in order, but without any ordering
+    guarantees relative to the ones sent via the D-Bus. Since there is no reply, errors can
+    only be logged. A client sending malformed messages gets its transport closed.
+*/
+void IpcProxyObject::readSharedMemoryInput(const QString &connectionName)
+{
+    m_sender = m_connectionNamesToApplicationIds.value(connectionName);
+
+    QByteArray data;
+    forever {
+        // the transport might be closed by one of the calls
+        auto it = m_sharedMemoryTransports.constFind(connectionName);
+        if (!m_object || (it == m_sharedMemoryTransports.cend()) || !it->inputRing->read(&data))
+            break;
+
+        int member;
+        QVariantList arguments;
+        if (!SharedMemoryRing::decodeMessage(data, &member, &arguments)
+                || (member < 0) || (member >= m_sharedMemoryInputMembers.size())) {
+            qCWarning(LogQmlIpc) << "Received an invalid message via the shared memory transport of" << m_pathName
+                                 << "- closing the transport";
+            closeSharedMemoryTransport(connectionName);
+            break;
+        }
+
+        int propertyIndex = m_sharedMemoryInputProperties.at(member);
+        if (propertyIndex >= 0) {
+            QMetaProperty mp = m_object->metaObject()->property(propertyIndex);
+            if ((arguments.size() != 1) || !mp.write(m_object, convertFromDBusVariant(arguments.constFirst()))) {
+                qCWarning(LogQmlIpc) << "Could not set the property" << mp.name() << "of" << m_pathName
+                                     << "via the shared memory transport";
+            }
+        } else {
+            QVariant result;
+            if (!invokeMethod(m_sharedMemoryInputMembers.at(member), arguments, &result)) {
+                qCWarning(LogQmlIpc) << "Could not call" << m_sharedMemoryInputMembers.at(member)
+                                     << "of" << m_pathName << "via the shared memory transport";
+            }
+        }
+    }
+
+    m_sender.clear();
+}
+
+#endif // QT_DBUS_LIB
+
 
 IpcProxySignalRelay::IpcProxySignalRelay(IpcProxyObject *proxyObject)
     : QObject(proxyObject)
@@ -44,10 +44,12 @@
 #include <QtGlobal>
 #include <QVector>
 #include <QMap>
+#include <QHash>
 #include <QPointer>
 #include <QVariant>
 #if defined(QT_DBUS_LIB)
 #  include <QDBusVirtualObject>
+#  include <QDBusMessage>
 #endif
 #include <QtAppManCommon/global.h>
 
@@ -55,6 +57,7 @@ QT_BEGIN_NAMESPACE_AM
 
 class Application;
 class IpcProxySignalRelay;
+class SharedMemoryRing;
 
 class IpcProxyObject // clazy:exclude=missing-qobject-macro
 #if defined(QT_DBUS_LIB)
@@ -87,6 +90,65 @@ public:
 private:
     void relaySignal(int signalIndex, void **argv);
     QByteArray createIntrospectionXml();
+    void createDispatchTable();
+
+    // everything needed to call a slot, without having to look at the meta-object again
+    struct MethodDispatch
+    {
+        int methodIndex;
+        int returnType;                           // what the slot actually returns
+        bool voidResult;                          // the D-Bus signature has no result
+        QVector<int> expectedTypes;               // what the D-Bus signature says
+        QVector<int> parameterTypes;              // what the slot actually takes
+        QVector<const char *> parameterTypeNames;
+    };
+
+#if defined(QT_DBUS_LIB)
+    // signals are not sent immediately, but queued per connection and sent as soon as the event
+    // loop is idle again: property changes are coalesced into a single PropertiesChanged signal
+    struct OutgoingQueue
+    {
+        QVector<QDBusMessage> messages;
+        QVector<int> changedProperties;
+    };
+
+    void closePropertyBatch(const QString &connectionName, OutgoingQueue &queue);
+    void flushOutgoingQueues();
+    void flushOutgoingQueue(const QString &connectionName);
+    QVariant propertyValue(int propertyIndex);
+
+    QHash<QString, OutgoingQueue> m_outgoingQueues;
+    QHash<int, QVariant> m_propertyValues; // read once and shared between all connections
+    bool m_flushScheduled = false;
+
+    const MethodDispatch *invokeMethod(const QString &function, const QVariantList &arguments, QVariant *result);
+
+    // members that are annotated via TRANSPORT_ANNOTATION_PREFIX are sent via a shared memory
+    // ring buffer to all clients that opened one. Clients can use a second ring buffer to call
+    // void methods and to set writable properties.
+    struct SharedMemoryTransport
+    {
+        SharedMemoryRing *ring = nullptr;      // we are the producer
+        SharedMemoryRing *inputRing = nullptr; // we are the consumer
+        QList<QByteArray> backlog; // used when the ring buffer is full
+        bool notify = false;
+    };
+
+    void resolveSharedMemoryMembers(const QList<QPair<QByteArray, QString>> &annotations);
+    bool openSharedMemoryTransport(const QDBusMessage &message, const QDBusConnection &connection);
+    void closeSharedMemoryTransport(const QString &connectionName);
+    void sendSharedMemoryMessage(SharedMemoryTransport &transport, const QByteArray &message);
+    bool writeSharedMemoryBacklog(SharedMemoryTransport &transport);
+    void drainSharedMemoryBacklog(const QString &connectionName);
+    void readSharedMemoryInput(const QString &connectionName);
+
+    QStringList m_sharedMemoryMembers;
+    QHash<int, int> m_sharedMemorySignals;    // signal index -> member
+    QHash<int, int> m_sharedMemoryProperties; // property index -> member
+    QStringList m_sharedMemoryInputMembers;
+    QVector<int> m_sharedMemoryInputProperties; // input member -> property index, -1 for methods
+    QHash<QString, SharedMemoryTransport> m_sharedMemoryTransports;
+#endif
 
     friend class IpcProxySignalRelay;
 
@@ -109,6 +171,8 @@ private:
     QVector<int> m_slots;
     QMap<int, QList<int>> m_slotSignatures;
     QMap<int, int> m_signalsToProperties;
+    QHash<QPair<QString, int>, QVector<MethodDispatch>> m_dispatchTable; // name and arity
+    QHash<QString, int> m_propertiesByName;
 
     QString m_sender;
     QStringList m_receivers;
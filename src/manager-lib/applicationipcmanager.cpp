@@ -157,6 +157,21 @@ ApplicationIPCManager::ApplicationIPCManager(QObject *parent)
     }
     \endcode
 
+    On Linux, signals and properties that change at a high rate can be sent to applications via a
+    shared memory ring buffer instead of the D-Bus. This is opt-in per signal or property, again
+    via a special annotation property:
+
+    \c{readonly property string _transport_<signal-or-property-name>: "shared-memory"}
+
+    The same annotation on a function without a return value or on a writable property lets
+    applications call or set it via a second ring buffer in the opposite direction. Since these
+    calls are not answered, errors are only logged on the System-UI side.
+
+    Applications that are able to attach to the ring buffers will receive and send these members
+    in order, but without any ordering guarantees relative to the rest of the interface, which is
+    still transported via the D-Bus. Applications that cannot use the shared memory transport are
+    served via the D-Bus as usual.
+
     You can restrict the availability of the interface in applications via the \a filter parameter:
     either pass an empty JavaScript object (\c{{}}) or use any combination of these available
     field names:
@@ -383,6 +383,75 @@ ApplicationManagerPrivate::~ApplicationManagerPrivate()
     qDeleteAll(apps);
 }
 
+int ApplicationManagerPrivate::rowOf(const Application *app) const
+{
+    if (!app)
+        return -1;
+    int row = rowById.value(app->id(), -1);
+    return (row >= 0 && apps.at(row) == app) ? row : -1;
+}
+
+void ApplicationManagerPrivate::updateIndices()
+{
+    rowById.clear();
+    mimeTypeHandlers.clear();
+    schemeHandlers.clear();
+    rowById.reserve(apps.size());
+
+    for (int row = 0; row < apps.size(); ++row) {
+        const Application *app = apps.at(row);
+        rowById.insert(app->id(), row);
+
+        if (app->isAlias())
+            continue;
+
+        const auto mimeTypes = app->supportedMimeTypes();
+        for (const QString &mime : mimeTypes) {
+            mimeTypeHandlers[mime].append(app);
+
+            int pos = mime.indexOf(QLatin1Char('/'));
+            if ((pos > 0) && (mime.leftRef(pos) == qL1S("x-scheme-handler")))
+                schemeHandlers[mime.mid(pos + 1)].append(app);
+        }
+    }
+
+    // remove stale runtime entries for applications that are gone
+    for (auto it = appByProcessId.begin(); it != appByProcessId.end(); ) {
+        if (rowOf(it.value()) < 0)
+            it = appByProcessId.erase(it);
+        else
+            ++it;
+    }
+    for (auto it = appBySecurityToken.begin(); it != appBySecurityToken.end(); ) {
+        if (rowOf(it.value()) < 0)
+            it = appBySecurityToken.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ApplicationManagerPrivate::updateRuntimeIndices(const Application *app, AbstractRuntime *runtime)
+{
+    // aliases share the runtime of the non-aliased application
+    if (app->isAlias())
+        app = app->nonAliased();
+
+    for (auto it = appByProcessId.begin(); it != appByProcessId.end(); ) {
+        if (it.value() == app)
+            it = appByProcessId.erase(it);
+        else
+            ++it;
+    }
+    appBySecurityToken.remove(runtime->securityToken());
+
+    if (runtime->state() != AbstractRuntime::Inactive && app->currentRuntime() == runtime) {
+        qint64 pid = runtime->applicationProcessId();
+        if (pid > 0)
+            appByProcessId.insert(pid, app);
+        appBySecurityToken.insert(runtime->securityToken(), app);
+    }
+}
+
 ApplicationManager *ApplicationManager::s_instance = nullptr;
 
 ApplicationManager *ApplicationManager::createInstance(ApplicationDatabase *adb, bool singleProcess, QString *error)
@@ -401,6 +470,7 @@ ApplicationManager *ApplicationManager::createInstance(ApplicationDatabase *adb,
             for (auto &app : am->d->apps)
                 const_cast<Application *>(app)->setParent(am.data());
         }
+        am->d->updateIndices();
         am->registerMimeTypes();
     } catch (const Exception &e) {
         if (error)
@@ -513,23 +583,21 @@ QVector<const Application *> ApplicationManager::applications() const
 
 const Application *ApplicationManager::fromId(const QString &id) const
 {
-    for (const Application *app : d->apps) {
-        if (app->id() == id)
-            return app;
-    }
-    return 0;
+    int row = d->rowById.value(id, -1);
+    return (row >= 0) ? d->apps.at(row) : nullptr;
 }
 
 const Application *ApplicationManager::fromProcessId(qint64 pid) const
 {
+    if (d->appByProcessId.isEmpty())
+        return nullptr;
+
     // pid could be an indirect child (e.g. when started via gdbserver)
     qint64 appmanPid = QCoreApplication::applicationPid();
 
     while ((pid > 1) && (pid != appmanPid)) {
-        for (const Application *app : d->apps) {
-            if (app->currentRuntime() && (app->currentRuntime()->applicationProcessId() == pid))
-                return app;
-        }
+        if (const Application *app = d->appByProcessId.value(pid))
+            return app;
         pid = getParentPid(pid);
     }
     return nullptr;
@@ -540,47 +608,17 @@ const Application *ApplicationManager::fromSecurityToken(const QByteArray &secur
     if (securityToken.size() != AbstractRuntime::SecurityTokenSize)
         return 0;
 
-    for (const Application *app : d->apps) {
-        if (app->currentRuntime() && app->currentRuntime()->securityToken() == securityToken)
-            return app;
-    }
-    return 0;
+    return d->appBySecurityToken.value(securityToken);
 }
 
 QVector<const Application *> ApplicationManager::schemeHandlers(const QString &scheme) const
 {
-    QVector<const Application *> handlers;
-
-    for (const Application *app : d->apps) {
-        if (app->isAlias())
-            continue;
-
-        const auto mimeTypes = app->supportedMimeTypes();
-        for (const QString &mime : mimeTypes) {
-            int pos = mime.indexOf(QLatin1Char('/'));
-
-            if ((pos > 0)
-                    && (mime.left(pos) == qL1S("x-scheme-handler"))
-                    && (mime.mid(pos + 1) == scheme)) {
-                handlers << app;
-            }
-        }
-    }
-    return handlers;
+    return d->schemeHandlers.value(scheme);
 }
 
 QVector<const Application *> ApplicationManager::mimeTypeHandlers(const QString &mimeType) const
 {
-    QVector<const Application *> handlers;
-
-    for (const Application *app : d->apps) {
-        if (app->isAlias())
-            continue;
-
-        if (app->supportedMimeTypes().contains(mimeType))
-            handlers << app;
-    }
-    return handlers;
+    return d->mimeTypeHandlers.value(mimeType);
 }
 
 void ApplicationManager::registerMimeTypes()
@@ -588,18 +626,8 @@ void ApplicationManager::registerMimeTypes()
     QVector<QString> schemes;
     schemes << qSL("file") << qSL("http") << qSL("https");
 
-    for (const Application *app : qAsConst(d->apps)) {
-        if (app->isAlias())
-            continue;
-
-        const auto mimeTypes = app->supportedMimeTypes();
-        for (const QString &mime : mimeTypes) {
-            int pos = mime.indexOf(QLatin1Char('/'));
-
-            if ((pos > 0) && (mime.left(pos) == qL1S("x-scheme-handler")))
-                schemes << mime.mid(pos + 1);
-        }
-    }
+    for (auto it = d->schemeHandlers.cbegin(); it != d->schemeHandlers.cend(); ++it)
+        schemes << it.key();
 #if defined(QT_GUI_LIB)
     for (const QString &scheme : qAsConst(schemes))
         QDesktopServices::setUrlHandler(scheme, this, "openUrlRelay");
@@ -711,6 +739,8 @@ bool ApplicationManager::startApplication(const Application *app, const QString
             throw Exception("No ContainerManager found for container: %1").arg(containerId);
     }
     bool attachRuntime = false;
+    bool triedQuickLaunch = false;
+    bool containerFromPool = false;
 
     if (!runtime) {
         if (!inProcess) {
@@ -728,6 +758,8 @@ bool ApplicationManager::startApplication(const Application *app, const QString
                         QuickLauncher::instance()->take(containerId, app->m_runtimeName);
                 container = quickLaunch.first;
                 runtime = quickLaunch.second;
+                triedQuickLaunch = true;
+                containerFromPool = (container != nullptr);
 
                 qCDebug(LogSystem) << "Found a quick-launch entry for container" << containerId
                                    << "and runtime" << app->m_runtimeName << "->" << container << runtime;
@@ -766,7 +798,15 @@ bool ApplicationManager::startApplication(const Application *app, const QString
         return false;
     }
 
-    connect(runtime, &AbstractRuntime::stateChanged, this, [this, app](AbstractRuntime::State newState) {
+    // feed the quick-launch statistics
+    if (triedQuickLaunch)
+        QuickLauncher::instance()->observeStart(containerId, app->m_runtimeName, runtime, containerFromPool, attachRuntime);
+
+    d->updateRuntimeIndices(app, runtime);
+
+    connect(runtime, &AbstractRuntime::stateChanged, this, [this, app, runtime](AbstractRuntime::State newState) {
+        d->updateRuntimeIndices(app, runtime);
+
         QVector<const Application *> apps;
         //Always emit the actual starting app/alias first
         apps.append(app);
@@ -790,6 +830,10 @@ bool ApplicationManager::startApplication(const Application *app, const QString
         }
     });
 
+    connect(runtime, &AbstractRuntime::applicationProcessIdChanged, this, [this, app, runtime]() {
+        d->updateRuntimeIndices(app, runtime);
+    });
+
     connect(runtime, static_cast<void(AbstractRuntime::*)(int, QProcess::ExitStatus)>
             (&AbstractRuntime::finished), this, [app](int code, QProcess::ExitStatus status) {
         if (code != app->m_lastExitCode) {
@@ -1169,6 +1213,7 @@ bool ApplicationManager::startingApplicationInstallation(Application *installApp
         newapp->mergeInto(const_cast<Application *>(app));
         app->m_state = Application::BeingUpdated;
         app->m_progress = 0;
+        d->updateIndices(); // the supported mime-types might have changed
     } else { // installation
         newapp->setParent(this);
         newapp->block();
@@ -1177,6 +1222,7 @@ bool ApplicationManager::startingApplicationInstallation(Application *installApp
         app = newapp.take();
         beginInsertRows(QModelIndex(), d->apps.count(), d->apps.count());
         d->apps << app;
+        d->updateIndices();
         endInsertRows();
         emit applicationAdded(app->id());
     }
@@ -1238,7 +1284,7 @@ bool ApplicationManager::finishedApplicationInstall(const QString &id)
 
         try {
             if (d->database)
-                d->database->write(d->apps);
+                d->database->update(app, d->apps);
         } catch (const Exception &e) {
             qCCritical(LogInstaller) << "ERROR: Application" << app->id() << "was installed, but writing the "
                                         "updated application database to disk failed:" << e.errorString();
@@ -1251,19 +1297,20 @@ bool ApplicationManager::finishedApplicationInstall(const QString &id)
         break;
     }
     case Application::BeingRemoved: {
-        int row = d->apps.indexOf(app);
+        int row = d->rowOf(app);
         if (row >= 0) {
             emit applicationAboutToBeRemoved(app->id());
             beginRemoveRows(QModelIndex(), row, row);
             d->apps.removeAt(row);
+            d->updateIndices();
             endRemoveRows();
         }
         delete app;
         try {
             if (d->database)
-                d->database->write(d->apps);
+                d->database->remove(id, d->apps);
         } catch (const Exception &e) {
-            qCCritical(LogInstaller) << "ERROR: Application" << app->id() << "was removed, but writing the "
+            qCCritical(LogInstaller) << "ERROR: Application" << id << "was removed, but writing the "
                                         "updated application database to disk failed:" << e.errorString();
             d->database->invalidate(); // make sure that the next AM start will re-read the DB
             return false;
@@ -1286,11 +1333,12 @@ bool ApplicationManager::canceledApplicationInstall(const QString &id)
         return false;
 
     case Application::BeingInstalled: {
-        int row = d->apps.indexOf(app);
+        int row = d->rowOf(app);
         if (row >= 0) {
             emit applicationAboutToBeRemoved(app->id());
             beginRemoveRows(QModelIndex(), row, row);
             d->apps.removeAt(row);
+            d->updateIndices();
             endRemoveRows();
         }
         delete app;
@@ -1357,7 +1405,7 @@ void ApplicationManager::openUrlRelay(const QUrl &url)
 
 void ApplicationManager::emitDataChanged(const Application *app, const QVector<int> &roles)
 {
-    int row = d->apps.indexOf(app);
+    int row = d->rowOf(app);
     if (row >= 0) {
         emit dataChanged(index(row), index(row), roles);
 
@@ -1544,11 +1592,7 @@ const Application *ApplicationManager::application(const QString &id) const
 */
 int ApplicationManager::indexOfApplication(const QString &id) const
 {
-    for (int i = 0; i < d->apps.size(); ++i) {
-        if (d->apps.at(i)->id() == id)
-            return i;
-    }
-    return -1;
+    return d->rowById.value(id, -1);
 }
 
 /*!
@@ -44,11 +44,13 @@
 #include <QStringList>
 #include <QVariantMap>
 #include <QJSValue>
+#include <QHash>
 #include <QtAppManCommon/global.h>
 
 QT_BEGIN_NAMESPACE_AM
 
 class ApplicationDatabase;
+class AbstractRuntime;
 
 class ApplicationManagerPrivate
 {
@@ -61,6 +63,15 @@ public:
 
     QVector<const Application *> apps;
 
+    // secondary indices into apps: the static ones are rebuilt via updateIndices() whenever
+    // apps changes, while the runtime ones are maintained via AbstractRuntime::stateChanged
+    // and AbstractRuntime::applicationProcessIdChanged
+    QHash<QString, int> rowById;
+    QHash<QString, QVector<const Application *>> mimeTypeHandlers;
+    QHash<QString, QVector<const Application *>> schemeHandlers;
+    QHash<qint64, const Application *> appByProcessId;
+    QHash<QByteArray, const Application *> appBySecurityToken;
+
     QString currentLocale;
     QHash<int, QByteArray> roleNames;
 
@@ -81,6 +92,10 @@ public:
 
     ApplicationManagerPrivate();
     ~ApplicationManagerPrivate();
+
+    int rowOf(const Application *app) const;
+    void updateIndices();
+    void updateRuntimeIndices(const Application *app, AbstractRuntime *runtime);
 };
 
 QT_END_NAMESPACE_AM
@@ -0,0 +1,457 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "global.h"
+#include "logging.h"
+#include "utilities.h"
+#include "forkserverprotocol.h"
+#include "forkserver.h"
+
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+
+QT_BEGIN_NAMESPACE_AM
+
+namespace {
+
+class ForkServerQProcess : public QProcess // clazy:exclude=missing-qobject-macro
+{
+public:
+    ForkServerQProcess(int socket, QObject *parent)
+        : QProcess(parent)
+        , m_socket(socket)
+    { }
+
+protected:
+    void setupChildProcess() override
+    {
+        // the fork-server's end of the socket pair has to survive the exec
+        int flags = fcntl(m_socket, F_GETFD);
+        if (flags & FD_CLOEXEC)
+            fcntl(m_socket, F_SETFD, flags & ~FD_CLOEXEC);
+    }
+
+private:
+    int m_socket;
+};
+
+} // anonymous namespace
+
+QHash<QString, ForkServer *> ForkServer::s_instances;
+
+ForkServer::ForkServer(const QString &program, QObject *parent)
+    : QObject(parent)
+    , m_program(program)
+{ }
+
+ForkServer::~ForkServer()
+{
+    // a retired fork-server has already been replaced
+    if (s_instances.value(m_program) == this)
+        s_instances.remove(m_program);
+    if (m_process) {
+        m_process->disconnect(this);
+        // closing the socket tells the fork-server to quit
+        delete m_notifier;
+        ::close(m_socket);
+        m_process->waitForFinished(1000);
+    }
+}
+
+bool ForkServer::isSupportedProgram(const QString &program)
+{
+    // only the QML launcher knows how to act as a fork-server
+    return QFileInfo(program).fileName() == qSL("appman-launcher-qml");
+}
+
+ForkServer *ForkServer::instance(const QString &program)
+{
+    ForkServer *fs = s_instances.value(program);
+    if (fs && fs->m_process && (fs->m_environmentGeneration != processEnvironmentGeneration())) {
+        // the application-manager's environment changed (e.g. WAYLAND_DISPLAY has been set
+        // after the compositor was created), so this fork-server is outdated: it cannot be
+        // restarted right away though, because its children would be killed along with it.
+        fs->retire();
+        fs = nullptr;
+    }
+    if (!fs) {
+        fs = new ForkServer(program, QCoreApplication::instance());
+        s_instances.insert(program, fs);
+    }
+    return fs;
+}
+
+/*! \internal
+    The fork-server is started lazily with the environment of the first spawn request, which
+    gives it access to the runtime configuration it needs for preloading. Every child gets the
+    complete environment of its own request though.
+    The fork-server is replaced by a new one as soon as the application-manager's own
+    environment changes: see instance() and retire().
+*/
+bool ForkServer::ensureRunning(const QProcessEnvironment &environment)
+{
+    if (m_process)
+        return true;
+
+    int ourSocket, serverSocket;
+    if (!ForkServerProtocol::createSocketPair(&ourSocket, &serverSocket)) {
+        qCWarning(LogSystem) << "Could not create a socket pair for the fork-server" << m_program
+                             << ":" << strerror(errno);
+        return false;
+    }
+
+    QProcessEnvironment env = environment;
+    env.insert(qL1S(ForkServerProtocol::EnvironmentVariable), QString::number(serverSocket));
+
+    m_process = new ForkServerQProcess(serverSocket, this);
+    m_process->setProcessChannelMode(QProcess::ForwardedChannels);
+    m_process->setProcessEnvironment(env);
+    connect(m_process, static_cast<void (QProcess::*)(int,QProcess::ExitStatus)>(&QProcess::finished),
+            this, &ForkServer::serverFinished);
+    connect(m_process, static_cast<void (QProcess::*)(QProcess::ProcessError)>(&QProcess::error),
+            this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            serverFinished();
+    });
+    m_process->start(m_program, QStringList());
+    ::close(serverSocket);
+    m_environmentGeneration = processEnvironmentGeneration();
+
+    m_socket = ourSocket;
+    m_notifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &ForkServer::readMessages);
+
+    qCDebug(LogSystem) << "Started the fork-server" << m_program;
+    return true;
+}
+
+ForkServerProcess *ForkServer::spawn(const QStringList &arguments, const QProcessEnvironment &environment,
+                                     const QString &workingDirectory, const QVector<int> &stdioRedirections)
+{
+    ForkServerProcess *process = new ForkServerProcess(this);
+
+    // we own the redirected fds, just like HostProcess does
+    auto closeRedirections = [stdioRedirections]() {
+        for (int fd : stdioRedirections) {
+            if (fd >= 0)
+                ::close(fd);
+        }
+    };
+
+    if (!ensureRunning(environment)) {
+        closeRedirections();
+        // the caller has no chance to connect to the signals before we return
+        QTimer::singleShot(0, process, [process]() { process->setFailed(qSL("could not start the fork-server")); });
+        return process;
+    }
+
+    quint32 id = ++m_lastRequestId;
+    quint8 stdioMask = 0;
+    QVector<int> fds;
+    for (int i = 0; i < 3; ++i) {
+        int fd = stdioRedirections.value(i, -1);
+        if (fd >= 0) {
+            stdioMask |= (1 << i);
+            fds << fd;
+        }
+    }
+
+    QByteArray message;
+    QDataStream ds(&message, QIODevice::WriteOnly);
+    ds.setVersion(QDataStream::Qt_5_6);
+    ds << quint8(ForkServerProtocol::Spawn) << id << arguments << environment.toStringList()
+       << workingDirectory << stdioMask;
+
+    bool sent = ForkServerProtocol::sendMessage(m_socket, message, fds);
+    QString errorString = sent ? QString() : QString::fromLocal8Bit(strerror(errno));
+    closeRedirections();
+
+    if (!sent) {
+        QTimer::singleShot(0, process, [process, errorString]() {
+            process->setFailed(qSL("could not send a request to the fork-server: ") + errorString);
+        });
+    } else {
+        process->m_requestId = id;
+        m_pendingRequests.insert(id, process);
+    }
+    return process;
+}
+
+// returns false, if the fork-server is gone
+bool ForkServer::receiveMessages()
+{
+    if (m_socket < 0)
+        return true;
+
+    QByteArray message;
+    QVector<int> fds;
+
+    forever {
+        if (!ForkServerProtocol::receiveMessage(m_socket, &message, &fds, true))
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        for (int fd : qAsConst(fds))
+            ::close(fd);
+        m_receivedMessages << message;
+    }
+}
+
+void ForkServer::readMessages()
+{
+    m_readScheduled = false;
+
+    bool alive = receiveMessages();
+    dispatchMessages();
+    if (!alive)
+        serverFinished();
+}
+
+void ForkServer::dispatchMessages()
+{
+    // the signals emitted below might lead to calls to receivedPid(), which appends to the list
+    while (!m_receivedMessages.isEmpty()) {
+        QDataStream ds(m_receivedMessages.takeFirst());
+        ds.setVersion(QDataStream::Qt_5_6);
+        quint8 type;
+        ds >> type;
+
+        switch (type) {
+        case ForkServerProtocol::Started: {
+            quint32 id;
+            qint64 pid;
+            QString errorString;
+            ds >> id >> pid >> errorString;
+            if (ds.status() != QDataStream::Ok)
+                break;
+
+            QPointer<ForkServerProcess> process = m_pendingRequests.take(id);
+            if (pid > 0) {
+                if (process) {
+                    m_processes.insert(pid, process);
+                    process->setStarted(pid);
+                } else {
+                    // nobody is interested in this process anymore
+                    ::kill(pid_t(pid), SIGKILL);
+                }
+            } else if (process) {
+                process->setFailed(errorString);
+            }
+            break;
+        }
+        case ForkServerProtocol::Finished: {
+            qint64 pid;
+            int exitCode;
+            bool crashed;
+            ds >> pid >> exitCode >> crashed;
+            if (ds.status() != QDataStream::Ok)
+                break;
+
+            QPointer<ForkServerProcess> process = m_processes.take(pid);
+            if (process)
+                process->setFinished(exitCode, crashed ? QProcess::CrashExit : QProcess::NormalExit);
+            break;
+        }
+        default:
+            qCWarning(LogSystem) << "Received an invalid message from the fork-server" << m_program;
+            break;
+        }
+    }
+    deleteIfRetiredAndIdle();
+}
+
+/*! \internal
+    Takes this fork-server out of service: instance() will create a new one for the next spawn
+    request, while this one stays alive until all of its children have exited.
+*/
+void ForkServer::retire()
+{
+    qCDebug(LogSystem) << "Replacing the fork-server" << m_program
+                       << "after a change of the environment";
+
+    s_instances.remove(m_program);
+    m_retired = true;
+    deleteIfRetiredAndIdle();
+}
+
+void ForkServer::deleteIfRetiredAndIdle()
+{
+    if (m_retired && m_pendingRequests.isEmpty() && m_processes.isEmpty())
+        deleteLater();
+}
+
+/*! \internal
+    Looks for the Started reply to \a requestId, without dispatching anything: this is called
+    from ForkServerProcess::processId(), which must not emit signals for other processes.
+    Everything received here is dispatched from the event loop later on.
+    Returns 0, if the reply has not arrived yet.
+*/
+qint64 ForkServer::receivedPid(quint32 requestId)
+{
+    bool alive = receiveMessages();
+    if ((!alive || !m_receivedMessages.isEmpty()) && !m_readScheduled) {
+        m_readScheduled = true;
+        QTimer::singleShot(0, this, &ForkServer::readMessages);
+    }
+
+    for (const QByteArray &message : qAsConst(m_receivedMessages)) {
+        QDataStream ds(message);
+        ds.setVersion(QDataStream::Qt_5_6);
+        quint8 type;
+        quint32 id;
+        qint64 pid;
+        ds >> type >> id >> pid;
+        if ((ds.status() == QDataStream::Ok) && (type == ForkServerProtocol::Started) && (id == requestId))
+            return qMax(pid, qint64(0));
+    }
+    return 0;
+}
+
+void ForkServer::serverFinished()
+{
+    if (!m_process)
+        return;
+
+    qCWarning(LogSystem) << "The fork-server" << m_program << "exited unexpectedly";
+
+    delete m_notifier;
+    m_notifier = nullptr;
+    ::close(m_socket);
+    m_socket = -1;
+    m_process->disconnect(this);
+    m_process->deleteLater();
+    m_process = nullptr;
+    m_receivedMessages.clear();
+
+    // the children are killed by the kernel, as soon as the fork-server is gone
+    const auto pending = m_pendingRequests;
+    const auto processes = m_processes;
+    m_pendingRequests.clear();
+    m_processes.clear();
+
+    for (const auto &process : pending) {
+        if (process)
+            process->setFailed(qSL("the fork-server exited"));
+    }
+    for (const auto &process : processes) {
+        if (process)
+            process->setFinished(SIGKILL, QProcess::CrashExit);
+    }
+    deleteIfRetiredAndIdle();
+}
+
+
+ForkServerProcess::ForkServerProcess(ForkServer *server)
+    : m_server(server)
+{ }
+
+ForkServerProcess::~ForkServerProcess()
+{ }
+
+qint64 ForkServerProcess::processId() const
+{
+    // the reply might already be waiting in the socket: the child will not do anything
+    // (e.g. connect to the D-Bus) before the fork-server has sent it. The state only changes
+    // when the reply is dispatched from the event loop.
+    if ((m_state == QProcess::Starting) && m_server && m_requestId)
+        return m_server->receivedPid(m_requestId);
+    return m_pid;
+}
+
+QProcess::ProcessState ForkServerProcess::state() const
+{
+    return m_state;
+}
+
+void ForkServerProcess::kill()
+{
+    if (m_state == QProcess::Running)
+        ::kill(pid_t(m_pid), SIGKILL);
+    else if (m_state == QProcess::Starting)
+        m_killRequested = true;
+}
+
+void ForkServerProcess::terminate()
+{
+    if (m_state == QProcess::Running)
+        ::kill(pid_t(m_pid), SIGTERM);
+    else if (m_state == QProcess::Starting)
+        m_terminateRequested = true;
+}
+
+void ForkServerProcess::setStarted(qint64 pid)
+{
+    m_pid = pid;
+    m_state = QProcess::Running;
+    emit stateChanged(m_state);
+    emit started();
+
+    if (m_killRequested)
+        kill();
+    else if (m_terminateRequested)
+        terminate();
+}
+
+void ForkServerProcess::setFailed(const QString &errorString)
+{
+    qCWarning(LogSystem) << "Could not start a process via the fork-server:" << errorString;
+
+    m_state = QProcess::NotRunning;
+    emit errorOccured(QProcess::FailedToStart);
+    emit stateChanged(m_state);
+}
+
+void ForkServerProcess::setFinished(int exitCode, QProcess::ExitStatus status)
+{
+    m_state = QProcess::NotRunning;
+    emit stateChanged(m_state);
+    emit finished(exitCode, status);
+}
+
+QT_END_NAMESPACE_AM
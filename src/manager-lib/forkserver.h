@@ -0,0 +1,132 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QProcessEnvironment>
+#include <QtAppManManager/abstractcontainer.h>
+
+QT_FORWARD_DECLARE_CLASS(QSocketNotifier)
+
+QT_BEGIN_NAMESPACE_AM
+
+class ForkServerProcess;
+
+// A pre-initialized runtime launcher process (a "zygote"), that forks new launcher processes on
+// request. The children are sharing all the pages that have been mapped and relocated before the
+// fork, so they do not have to go through exec and dynamic linking.
+// This is only available on Linux.
+class ForkServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~ForkServer();
+
+    static bool isSupportedProgram(const QString &program);
+    static ForkServer *instance(const QString &program);
+
+    ForkServerProcess *spawn(const QStringList &arguments, const QProcessEnvironment &environment,
+                             const QString &workingDirectory, const QVector<int> &stdioRedirections);
+
+private:
+    ForkServer(const QString &program, QObject *parent);
+    bool ensureRunning(const QProcessEnvironment &environment);
+    bool receiveMessages();
+    void readMessages();
+    void dispatchMessages();
+    qint64 receivedPid(quint32 requestId);
+    void serverFinished();
+    void retire();
+    void deleteIfRetiredAndIdle();
+
+    QString m_program;
+    QProcess *m_process = nullptr;
+    int m_socket = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    quint32 m_lastRequestId = 0;
+    QHash<quint32, QPointer<ForkServerProcess>> m_pendingRequests;
+    QHash<qint64, QPointer<ForkServerProcess>> m_processes;
+    QList<QByteArray> m_receivedMessages; // received, but not dispatched yet
+    bool m_readScheduled = false;
+    int m_environmentGeneration = -1; // of the environment the fork-server was started with
+    bool m_retired = false;
+
+    static QHash<QString, ForkServer *> s_instances;
+
+    friend class ForkServerProcess;
+};
+
+class ForkServerProcess : public AbstractContainerProcess
+{
+    Q_OBJECT
+
+public:
+    ~ForkServerProcess();
+
+    qint64 processId() const override;
+    QProcess::ProcessState state() const override;
+
+public slots:
+    void kill() override;
+    void terminate() override;
+
+private:
+    ForkServerProcess(ForkServer *server);
+    void setStarted(qint64 pid);
+    void setFailed(const QString &errorString);
+    void setFinished(int exitCode, QProcess::ExitStatus status);
+
+    QPointer<ForkServer> m_server;
+    quint32 m_requestId = 0;
+    qint64 m_pid = 0;
+    QProcess::ProcessState m_state = QProcess::Starting;
+    bool m_killRequested = false;
+    bool m_terminateRequested = false;
+
+    friend class ForkServer;
+};
+
+QT_END_NAMESPACE_AM
@@ -40,6 +40,7 @@ HEADERS += \
 
 linux:HEADERS += \
     sysfsreader.h \
+    forkserver.h \
 
 !headless:HEADERS += \
     fakeapplicationmanagerwindow.h \
@@ -71,6 +72,7 @@ SOURCES += \
 
 linux:SOURCES += \
     sysfsreader.cpp \
+    forkserver.cpp \
 
 !headless:SOURCES += \
     fakeapplicationmanagerwindow.cpp \
@@ -170,6 +170,7 @@ bool NativeRuntime::attachApplicationToQuickLauncher(const Application *app)
     m_isQuickLauncher = false;
     m_app = app;
     m_app->setCurrentRuntime(this);
+    emit applicationProcessIdChanged(applicationProcessId());
 
     setState(Startup);
 
@@ -254,27 +255,49 @@ bool NativeRuntime::start()
         break;
     }
 
-    QMap<QString, QString> env = {
-        { qSL("QT_QPA_PLATFORM"), qSL("wayland") },
-        { qSL("QT_IM_MODULE"), QString() },     // Applications should use wayland text input
-        { qSL("AM_SECURITY_TOKEN"), qL1S(securityToken().toHex()) },
-        { qSL("AM_DBUS_PEER_ADDRESS"), applicationInterfaceServer()->address() },
-        { qSL("AM_DBUS_NOTIFICATION_BUS_ADDRESS"), NotificationManager::instance()->property("_am_dbus_name").toString() },
-        { qSL("AM_RUNTIME_CONFIGURATION"), QString::fromUtf8(QtYaml::yamlFromVariantDocuments({ configuration() })) },
-        { qSL("AM_BASE_DIR"), QDir::currentPath() }
-    };
+    auto nativeManager = static_cast<NativeRuntimeManager *>(manager());
+
+    // the invariant parts are only computed once per runtime manager and are implicitly shared
+    QMap<QString, QString> env = nativeManager->staticEnvironment();
+    env.insert(qSL("AM_SECURITY_TOKEN"), qL1S(securityToken().toHex()));
+    env.insert(qSL("AM_DBUS_PEER_ADDRESS"), applicationInterfaceServer()->address());
+    env.insert(qSL("AM_DBUS_NOTIFICATION_BUS_ADDRESS"), NotificationManager::instance()->property("_am_dbus_name").toString());
 
     if (!m_needsLauncher && !m_isQuickLauncher)
-        env.insert(qSL("AM_RUNTIME_SYSTEM_PROPERTIES"), QString::fromUtf8(QtYaml::yamlFromVariantDocuments({ systemProperties() })));
+        env.insert(qSL("AM_RUNTIME_SYSTEM_PROPERTIES"), nativeManager->systemPropertiesYaml(m_app && m_app->isBuiltIn()));
     if (!Logging::isDltEnabled())
         env.insert(qSL("AM_NO_DLT_LOGGING"), qSL("1"));
 
-    for (QMapIterator<QString, QVariant> it(configuration().value(qSL("environmentVariables")).toMap()); it.hasNext(); ) {
-        it.next();
-        if (!it.key().isEmpty())
-            env.insert(it.key(), it.value().toString());
+    if (m_isQuickLauncher && m_needsLauncher) {
+        // give the quick-launcher a chance to compile the code of the applications that are most
+        // likely to be started next, while it is idle
+        QVariantList preload;
+        const auto apps = ApplicationManager::instance()->applications();
+        for (const Application *app : apps) {
+            if (app->isAlias() || (app->runtimeName() != manager()->identifier()))
+                continue;
+            if (!app->isPreloaded() && (app->importance() <= 0))
+                continue;
+            // compiling can load the application's own QML plugins, which must never end up in a
+            // process that might later run a different application: only trust built-in ones
+            if (!app->isBuiltIn())
+                continue;
+            // the quick-launcher compiles in an engine without the application's own set-up
+            const QVariantMap runtimeParameters = app->runtimeParameters();
+            if (runtimeParameters.contains(qSL("importPaths")) || runtimeParameters.value(qSL("loadDummyData")).toBool())
+                continue;
+            QString codeFile = app->absoluteCodeFilePath();
+            if (!preload.contains(codeFile))
+                preload << codeFile;
+        }
+        if (!preload.isEmpty())
+            env.insert(qSL("AM_QUICKLAUNCH_PRELOAD"), QString::fromUtf8(QtYaml::yamlFromVariantDocuments({ QVariant(preload) })));
     }
 
+    const QMap<QString, QString> &configuredEnv = nativeManager->configuredEnvironment();
+    for (auto it = configuredEnv.cbegin(); it != configuredEnv.cend(); ++it)
+        env.insert(it.key(), it.value());
+
     if (m_app && !m_app->environmentVariables().isEmpty()) {
         if (ApplicationManager::instance()->securityChecksEnabled()) {
             qCWarning(LogSystem) << "Due to enabled security checks, the environmentVariables for"
@@ -344,6 +367,9 @@ void NativeRuntime::stop(bool forceKill)
 
 void NativeRuntime::onProcessStarted()
 {
+    // the pid might not have been known before (e.g. when forked by a fork-server)
+    emit applicationProcessIdChanged(applicationProcessId());
+
     if (!m_needsLauncher && !application()->supportsApplicationInterface())
         setState(Active);
 }
@@ -553,4 +579,59 @@ AbstractRuntime *NativeRuntimeManager::create(AbstractContainer *container, cons
     return nrt.take();
 }
 
+void NativeRuntimeManager::setConfiguration(const QVariantMap &configuration)
+{
+    AbstractRuntimeManager::setConfiguration(configuration);
+    m_environmentGeneration = -1;
+}
+
+void NativeRuntimeManager::setSystemProperties(const QVariantMap &thirdParty, const QVariantMap &builtIn)
+{
+    AbstractRuntimeManager::setSystemProperties(thirdParty, builtIn);
+    m_systemPropertiesYaml[0].clear();
+    m_systemPropertiesYaml[1].clear();
+}
+
+const QMap<QString, QString> &NativeRuntimeManager::staticEnvironment() const
+{
+    // also rebuilt after the application-manager changed its own environment: everything
+    // derived from it has to be as current as the ProcessContainer's copy
+    if (m_environmentGeneration != processEnvironmentGeneration()) {
+        m_environmentGeneration = processEnvironmentGeneration();
+
+        const QVariantMap config = configuration();
+
+        m_staticEnvironment = {
+            { qSL("QT_QPA_PLATFORM"), qSL("wayland") },
+            { qSL("QT_IM_MODULE"), QString() },     // Applications should use wayland text input
+            { qSL("AM_RUNTIME_CONFIGURATION"), QString::fromUtf8(QtYaml::yamlFromVariantDocuments({ config })) },
+            { qSL("AM_BASE_DIR"), QDir::currentPath() }
+        };
+
+        m_configuredEnvironment.clear();
+        for (QMapIterator<QString, QVariant> it(config.value(qSL("environmentVariables")).toMap()); it.hasNext(); ) {
+            it.next();
+            if (!it.key().isEmpty())
+                m_configuredEnvironment.insert(it.key(), it.value().toString());
+        }
+    }
+    return m_staticEnvironment;
+}
+
+const QMap<QString, QString> &NativeRuntimeManager::configuredEnvironment() const
+{
+    staticEnvironment();
+    return m_configuredEnvironment;
+}
+
+QString NativeRuntimeManager::systemPropertiesYaml(bool builtIn) const
+{
+    QString &yaml = m_systemPropertiesYaml[builtIn ? 1 : 0];
+    if (yaml.isNull()) {
+        QVariantMap sysProps = builtIn ? systemPropertiesBuiltIn() : systemProperties3rdParty();
+        yaml = QString::fromUtf8(QtYaml::yamlFromVariantDocuments({ sysProps }));
+    }
+    return yaml;
+}
+
 QT_END_NAMESPACE_AM
@@ -76,6 +76,22 @@ public:
     bool supportsQuickLaunch() const override;
 
     AbstractRuntime *create(AbstractContainer *container, const Application *app) override;
+
+    void setConfiguration(const QVariantMap &configuration) override;
+    void setSystemProperties(const QVariantMap &thirdParty, const QVariantMap &builtIn) override;
+
+private:
+    // the parts of a runtime's environment that are the same for every launch
+    const QMap<QString, QString> &staticEnvironment() const;
+    const QMap<QString, QString> &configuredEnvironment() const;
+    QString systemPropertiesYaml(bool builtIn) const;
+
+    mutable QMap<QString, QString> m_staticEnvironment;
+    mutable QMap<QString, QString> m_configuredEnvironment;
+    mutable QString m_systemPropertiesYaml[2];
+    mutable int m_environmentGeneration = -1;
+
+    friend class NativeRuntime;
 };
 
 class NativeRuntime : public AbstractRuntime
@@ -46,6 +46,10 @@
 #include "processcontainer.h"
 #include "systemreader.h"
 #include "debugwrapper.h"
+#include "utilities.h"
+#if defined(Q_OS_LINUX)
+#  include "forkserver.h"
+#endif
 
 #if defined(Q_OS_UNIX)
 #  include <csignal>
@@ -219,7 +223,16 @@ AbstractContainerProcess *ProcessContainer::start(const QStringList &arguments,
     if (!QFile::exists(m_program))
         return nullptr;
 
-    QProcessEnvironment penv = QProcessEnvironment::systemEnvironment();
+    // The application-manager rarely changes its own environment after it has been set up, but
+    // e.g. WAYLAND_DISPLAY is only exported once the compositor exists. Parsing the environment
+    // only once per change saves a lot of allocations on every launch.
+    static QProcessEnvironment systemEnvironment;
+    static int systemEnvironmentGeneration = -1;
+    if (systemEnvironmentGeneration != processEnvironmentGeneration()) {
+        systemEnvironmentGeneration = processEnvironmentGeneration();
+        systemEnvironment = QProcessEnvironment::systemEnvironment();
+    }
+    QProcessEnvironment penv = systemEnvironment;
 
     for (auto it = runtimeEnvironment.cbegin(); it != runtimeEnvironment.cend(); ++it) {
         if (it.value().isEmpty())
@@ -234,10 +247,34 @@ AbstractContainerProcess *ProcessContainer::start(const QStringList &arguments,
             penv.insert(it.key(), it.value());
     }
 
+    bool stopBeforeExec = configuration().value(qSL("stopBeforeExec")).toBool();
+    QString defaultControlGroup = configuration().value(qSL("defaultControlGroup")).toString();
+
+#if defined(Q_OS_LINUX)
+    // debug-wrappers and stopped processes need a real exec
+    if (configuration().value(qSL("forkServer")).toBool() && !stopBeforeExec
+            && m_debugWrapperCommand.isEmpty() && ForkServer::isSupportedProgram(m_program)) {
+        qCDebug(LogSystem) << "Forking command:" << m_program << "arguments:" << arguments;
+
+        ForkServerProcess *process = ForkServer::instance(m_program)->spawn(arguments, penv, m_baseDirectory,
+                                                                            m_stdioRedirections);
+        m_process = process;
+
+        // we only know the pid, after the fork-server has replied
+        if (process->processId() > 0) {
+            setControlGroup(defaultControlGroup);
+        } else {
+            connect(process, &AbstractContainerProcess::started,
+                    this, [this, defaultControlGroup]() { setControlGroup(defaultControlGroup); });
+        }
+        return process;
+    }
+#endif
+
     HostProcess *process = new HostProcess();
     process->setWorkingDirectory(m_baseDirectory);
     process->setProcessEnvironment(penv);
-    process->setStopBeforeExec(configuration().value(qSL("stopBeforeExec")).toBool());
+    process->setStopBeforeExec(stopBeforeExec);
     process->setStdioRedirections(m_stdioRedirections);
 
     QString command = m_program;
@@ -254,7 +291,7 @@ AbstractContainerProcess *ProcessContainer::start(const QStringList &arguments,
     process->start(command, args);
     m_process = process;
 
-    setControlGroup(configuration().value(qSL("defaultControlGroup")).toString());
+    setControlGroup(defaultControlGroup);
     return process;
 }
 
@@ -41,6 +41,8 @@
 
 #include <QQmlEngine>
 #include <QQmlExpression>
+#include <QMetaMethod>
+#include <QTimer>
 
 #include "logging.h"
 #include "qmlinprocessapplicationinterface.h"
@@ -245,6 +247,41 @@ uint QmlInProcessNotification::libnotifyShow()
 
     The actual IPC object, which has all the signals, slots and properties exported from the server
     side. Will be null, until ready becomes \c true.
+
+    In multi-process setups, the values of all properties are cached locally: the System-UI sends
+    the new values along with its change notifications, so reading a property does not result in
+    a blocking D-Bus round-trip. Calling a function on this object on the other hand will block
+    until the System-UI has replied - use callAsync() for calls that might take a while or for
+    interfaces that are used very often.
+*/
+
+/*!
+    \qmlmethod ApplicationInterfaceExtension::callAsync(string method, list args, function callback)
+
+    Calls the function \a method on the remote object with the parameters given in \a args, but
+    without waiting for the System-UI to reply. Once the reply has been received, the optional \a
+    callback is called with the return value of the function as its first parameter. In case of an
+    error, the first parameter is \c undefined and a second parameter with the error message is
+    passed.
+
+    In single-process setups, the function is called directly, but still only after control has
+    returned to the event loop, so that the behavior is the same in both setups.
+
+    \qml
+    ApplicationInterfaceExtension {
+        id: testInterface
+        name: "io.qt.test.interface"
+
+        onReadyChanged: {
+            if (ready) {
+                callAsync("testFunction", [ 42, "string" ], function(result, error) {
+                    if (error)
+                        console.log("testFunction failed: " + error)
+                })
+            }
+        }
+    }
+    \endqml
 */
 
 QmlInProcessApplicationInterfaceExtension::QmlInProcessApplicationInterfaceExtension(QObject *parent)
@@ -295,6 +332,87 @@ void QmlInProcessApplicationInterfaceExtension::resolveObject()
     }
 }
 
+void QmlInProcessApplicationInterfaceExtension::callAsync(const QString &method, const QVariantList &args,
+                                                          const QJSValue &callback)
+{
+    QPointer<QObject> object = m_object;
+
+    QTimer::singleShot(0, this, [this, object, method, args, callback]() mutable {
+        QVariant result;
+        QString error;
+
+        if (!object) {
+            error = qSL("ApplicationInterfaceExtension %1 is not ready").arg(m_name);
+        } else {
+            const QMetaObject *mo = object->metaObject();
+            const QByteArray name = method.toUtf8();
+            int methodIndex = mo->methodOffset();
+            for ( ; methodIndex < mo->methodCount(); ++methodIndex) {
+                QMetaMethod mm = mo->method(methodIndex);
+                if ((mm.methodType() != QMetaMethod::Signal) && (mm.name() == name)
+                        && (mm.parameterCount() == args.size())) {
+                    break;
+                }
+            }
+
+            if (methodIndex == mo->methodCount() || args.size() > 10) {
+                error = qSL("no method %1 taking %2 parameters").arg(method).arg(args.size());
+            } else {
+                QMetaMethod mm = mo->method(methodIndex);
+                QVariant argsCopy[10];
+                QGenericArgument genericArgs[10];
+
+                for (int ai = 0; ai < args.size() && error.isEmpty(); ++ai) {
+                    int type = mm.parameterType(ai);
+                    argsCopy[ai] = args.at(ai);
+                    if (type == QMetaType::QVariant) {
+                        genericArgs[ai] = QGenericArgument("QVariant", &argsCopy[ai]);
+                    } else if ((argsCopy[ai].userType() == type) || argsCopy[ai].convert(type)) {
+                        genericArgs[ai] = QGenericArgument(QMetaType::typeName(type), argsCopy[ai].data());
+                    } else {
+                        error = qSL("cannot convert parameter %1 of %2 to %3").arg(ai + 1).arg(method)
+                                .arg(qL1S(QMetaType::typeName(type)));
+                    }
+                }
+
+                if (error.isEmpty()) {
+                    QGenericReturnArgument returnArg;
+                    if (mm.returnType() == QMetaType::QVariant) {
+                        returnArg = QGenericReturnArgument("QVariant", &result);
+                    } else if (mm.returnType() != QMetaType::Void) {
+                        result = QVariant(mm.returnType(), nullptr);
+                        returnArg = QGenericReturnArgument(mm.typeName(), result.data());
+                    }
+
+                    if (!mm.invoke(object, Qt::DirectConnection, returnArg,
+                                   genericArgs[0], genericArgs[1], genericArgs[2], genericArgs[3],
+                                   genericArgs[4], genericArgs[5], genericArgs[6], genericArgs[7],
+                                   genericArgs[8], genericArgs[9])) {
+                        error = qSL("calling %1 failed").arg(method);
+                    }
+                }
+            }
+        }
+
+        if (!callback.isCallable()) {
+            if (!error.isEmpty())
+                qCWarning(LogQmlIpc) << "Asynchronous call of" << method << "failed:" << error;
+            return;
+        }
+
+        QJSValue jsResult;
+        if (!error.isEmpty()) {
+            jsResult = callback.call({ QJSValue(QJSValue::UndefinedValue), QJSValue(error) });
+        } else {
+            QJSEngine *engine = qmlEngine(this);
+            jsResult = callback.call({ engine ? engine->toScriptValue(result)
+                                              : QJSValue(QJSValue::UndefinedValue) });
+        }
+        if (jsResult.isError())
+            qCWarning(LogQmlIpc) << "The callback for" << method << "threw an exception:" << jsResult.toString();
+    });
+}
+
 void QmlInProcessApplicationInterfaceExtension::setName(const QString &name)
 {
     if (!m_complete) {
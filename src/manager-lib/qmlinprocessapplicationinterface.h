@@ -43,6 +43,7 @@
 
 #include <QVector>
 #include <QPointer>
+#include <QJSValue>
 
 #include <QtAppManApplication/applicationinterface.h>
 #include <QtAppManNotification/notification.h>
@@ -116,6 +117,9 @@ public:
     bool isReady() const;
     QObject *object() const;
 
+    Q_INVOKABLE void callAsync(const QString &method, const QVariantList &args = QVariantList(),
+                               const QJSValue &callback = QJSValue());
+
 protected:
     void classBegin() override;
     void componentComplete() override;
@@ -42,6 +42,7 @@
 #include <QQmlEngine>
 #include <QQmlContext>
 #include <QQmlComponent>
+#include <QQmlIncubator>
 #include <QCoreApplication>
 #include <QTimer>
 
@@ -96,12 +97,42 @@ static void loadDummyDataFiles(QQmlEngine &engine, const QString& directory)
 }
 
 
+// Creating the application's root object is done via an incubator, so that the System-UI's
+// incubation controller can spread the object creation over multiple frames. The controller
+// is installed by the System-UI's window and gives the incubator a time budget per frame.
+class QmlInProcessIncubator : public QQmlIncubator
+{
+public:
+    QmlInProcessIncubator(QmlInProcessRuntime *runtime, IncubationMode mode)
+        : QQmlIncubator(mode)
+        , m_runtime(runtime)
+    { }
+
+protected:
+    void setInitialState(QObject *obj) override
+    {
+        m_runtime->initializeRootObject(obj);
+    }
+
+    void statusChanged(Status status) override
+    {
+        if (status == Ready || status == Error)
+            m_runtime->incubationFinished(status == Ready);
+    }
+
+private:
+    QmlInProcessRuntime *m_runtime;
+};
+
+
 QmlInProcessRuntime::QmlInProcessRuntime(const Application *app, QmlInProcessRuntimeManager *manager)
     : AbstractRuntime(nullptr, app, manager)
 { }
 
 QmlInProcessRuntime::~QmlInProcessRuntime()
 {
+    cleanupComponent();
+
 #if !defined(AM_HEADLESS)
     // if there is still a window present at this point, fire the 'closing' signal (probably) again,
     // because it's still the duty of WindowManager together with qml-ui to free and delete this item!!
@@ -129,6 +160,9 @@ bool QmlInProcessRuntime::start()
         return false;
     }
 
+    if (m_component) // still loading from a previous start() call
+        return true;
+
     if (m_app->runtimeParameters().value(qSL("loadDummyData")).toBool()) {
         qCDebug(LogSystem) << "Loading dummy-data";
         loadDummyDataFiles(*m_inProcessQmlEngine, QFileInfo(m_app->absoluteCodeFilePath()).path());
@@ -144,34 +178,59 @@ bool QmlInProcessRuntime::start()
         qCDebug(LogSystem) << "Updated Qml import paths:" << m_inProcessQmlEngine->importPathList();
     }
 
-    QQmlComponent *component = new QQmlComponent(m_inProcessQmlEngine, m_app->absoluteCodeFilePath());
+    // Compiling the application's QML files (and loading the imports) is done in a background
+    // thread, so starting an application does not block the System-UI's rendering
+    m_component = new QQmlComponent(m_inProcessQmlEngine, m_app->absoluteCodeFilePath(),
+                                    QQmlComponent::Asynchronous);
 
-    if (!component->isReady()) {
-        qCDebug(LogSystem) << "qml-file (" << m_app->absoluteCodeFilePath() << "): component not ready:\n" << component->errorString();
+    if (m_component->isLoading()) {
+        connect(m_component, &QQmlComponent::statusChanged, this, [this](QQmlComponent::Status status) {
+            if (status != QQmlComponent::Loading)
+                componentLoaded();
+        });
+        return true;
+    }
+    if (!m_component->isReady()) {
+        qCDebug(LogSystem) << "qml-file (" << m_app->absoluteCodeFilePath() << "): component not ready:\n" << m_component->errorString();
+        cleanupComponent();
         return false;
     }
+    // Can happen, if the component was already cached by the engine: make sure that we are
+    // only reporting the outcome after returning from start(), same as in the asynchronous case
+    QTimer::singleShot(0, this, [this]() { componentLoaded(); });
+    return true;
+}
+
+void QmlInProcessRuntime::componentLoaded()
+{
+    if (!m_component || (state() != Startup))
+        return;
+
+    if (!m_component->isReady()) {
+        qCCritical(LogSystem) << "qml-file (" << m_app->absoluteCodeFilePath() << "): component not ready:\n" << m_component->errorString();
+        incubationFinished(false);
+        return;
+    }
 
     // We are running each application in it's own, separate Qml context.
     // This way, we can export an unique ApplicationInterface object for each app
-    QQmlContext *appContext = new QQmlContext(m_inProcessQmlEngine->rootContext());
+    m_appContext = new QQmlContext(m_inProcessQmlEngine->rootContext());
     m_applicationIf = new QmlInProcessApplicationInterface(this);
-    appContext->setContextProperty(qSL("ApplicationInterface"), m_applicationIf);
+    m_appContext->setContextProperty(qSL("ApplicationInterface"), m_applicationIf);
     connect(m_applicationIf, &QmlInProcessApplicationInterface::quitAcknowledged,
             this, [=]() { finish(0, QProcess::NormalExit); });
 
-    QObject *obj = component->beginCreate(appContext);
-
-    if (!obj) {
-        qCCritical(LogSystem) << "could not load" << m_app->absoluteCodeFilePath() << ": no root object";
-        delete obj;
-        delete appContext;
-        delete m_applicationIf;
-        m_applicationIf = nullptr;
-        return false;
-    }
+    // without an incubation controller (e.g. in a headless System-UI), asynchronous incubation
+    // would never make any progress
+    auto mode = m_inProcessQmlEngine->incubationController() ? QQmlIncubator::Asynchronous
+                                                             : QQmlIncubator::Synchronous;
+    m_incubator = new QmlInProcessIncubator(this, mode);
+    m_component->create(*m_incubator, m_appContext);
+}
 
+void QmlInProcessRuntime::initializeRootObject(QObject *obj)
+{
 #if !defined(AM_HEADLESS)
-
     FakeApplicationManagerWindow *window = qobject_cast<FakeApplicationManagerWindow*>(obj);
     if (window) {
         window->m_runtime = this;
@@ -184,17 +243,56 @@ bool QmlInProcessRuntime::start()
     if (obj->setProperty("AM-RUNTIME", QVariant::fromValue(this)))
         qCritical() << "ApplicationManagerWindow must not have an AM-RUNTIME property";
     m_rootObject = obj;
-
+#else
+    Q_UNUSED(obj)
 #endif
+}
+
+void QmlInProcessRuntime::incubationFinished(bool success)
+{
+    // we must not delete the incubator from within one of its callbacks
+    QTimer::singleShot(0, this, [this, success]() {
+        if (!m_component)
+            return;
+
+        if (success && m_incubator && m_incubator->object()) {
+            cleanupComponent();
+            if (!m_document.isEmpty())
+                openDocument(m_document, QString());
+            setState(Active);
+            return;
+        }
 
-    QTimer::singleShot(0, this, [component, this]() {
-        component->completeCreate();
-        if (!m_document.isEmpty())
-            openDocument(m_document, QString());
-        setState(Active);
-        delete component;
+        if (m_incubator) {
+            const QList<QQmlError> errors = m_incubator->errors();
+            for (const QQmlError &error : errors)
+                qCCritical(LogSystem) << "could not load" << m_app->absoluteCodeFilePath() << ":" << error;
+        }
+#if !defined(AM_HEADLESS)
+        for (int i = m_windows.size(); i; --i)
+            emit inProcessSurfaceItemClosing(m_windows.at(i-1));
+        m_windows.clear();
+        m_rootObject = nullptr;
+#endif
+        cleanupComponent();
+        delete m_appContext;
+        m_appContext = nullptr;
+        delete m_applicationIf;
+        m_applicationIf = nullptr;
+        finish(1, QProcess::CrashExit);
     });
-    return true;
+}
+
+void QmlInProcessRuntime::cleanupComponent()
+{
+    if (m_incubator) {
+        // this aborts a running incubation, but a successfully created object has been
+        // handed over to us at this point and is not affected
+        delete m_incubator;
+        m_incubator = nullptr;
+    }
+    delete m_component;
+    m_component = nullptr;
 }
 
 void QmlInProcessRuntime::stop(bool forceKill)
@@ -202,6 +300,9 @@ void QmlInProcessRuntime::stop(bool forceKill)
     setState(Shutdown);
     emit aboutToStop();
 
+    // stop any pending component loading or incubation
+    cleanupComponent();
+
 #if !defined(AM_HEADLESS)
     for (int i = m_windows.size(); i; --i)
         emit inProcessSurfaceItemClosing(m_windows.at(i-1));
@@ -43,10 +43,14 @@
 
 #include <QtAppManManager/abstractruntime.h>
 
+QT_FORWARD_DECLARE_CLASS(QQmlComponent)
+QT_FORWARD_DECLARE_CLASS(QQmlContext)
+
 QT_BEGIN_NAMESPACE_AM
 
 class FakeApplicationManagerWindow;
 class QmlInProcessApplicationInterface;
+class QmlInProcessIncubator;
 
 class QmlInProcessRuntimeManager : public AbstractRuntimeManager
 {
@@ -91,8 +95,18 @@ private slots:
     void finish(int exitCode, QProcess::ExitStatus status);
 
 private:
+    void componentLoaded();
+    void initializeRootObject(QObject *obj);
+    void incubationFinished(bool success);
+    void cleanupComponent();
+
     QString m_document;
     QmlInProcessApplicationInterface *m_applicationIf = nullptr;
+    QQmlComponent *m_component = nullptr;
+    QQmlContext *m_appContext = nullptr;
+    QmlInProcessIncubator *m_incubator = nullptr;
+
+    friend class QmlInProcessIncubator;
 
 #if !defined(AM_HEADLESS)
     // used by FakeApplicationManagerWindow to register windows
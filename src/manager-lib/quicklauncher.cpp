@@ -41,6 +41,8 @@
 
 #include <QCoreApplication>
 #include <QTimer>
+#include <QSharedPointer>
+#include <algorithm>
 
 #include "logging.h"
 #include "abstractcontainer.h"
@@ -52,6 +54,14 @@
 
 QT_BEGIN_NAMESPACE_AM
 
+// launches within this time span count towards the expected demand
+static const qint64 launchStatisticsWindow = 60 * 1000;
+// the pool stays shrunk for this long after the last memory warning
+static const qint64 memoryPressureCooldown = 60 * 1000;
+// the pool is refilled one runtime at a time: fast after a miss, slowly otherwise
+static const int fastRebuildDelay = 100;
+static const int slowRebuildDelay = 1000;
+
 QuickLauncher *QuickLauncher::s_instance = nullptr;
 
 QuickLauncher *QuickLauncher::instance()
@@ -63,7 +73,11 @@ QuickLauncher *QuickLauncher::instance()
 
 QuickLauncher::QuickLauncher(QObject *parent)
     : QObject(parent)
-{ }
+{
+    m_clock.start();
+    m_rebuildTimer.setSingleShot(true);
+    connect(&m_rebuildTimer, &QTimer::timeout, this, &QuickLauncher::rebuild);
+}
 
 QuickLauncher::~QuickLauncher()
 {
@@ -72,12 +86,24 @@ QuickLauncher::~QuickLauncher()
     delete m_idleCpu;
 }
 
-void QuickLauncher::initialize(int runtimesPerContainer, qreal idleLoad)
+/*! \internal
+    The pool keeps at least \a runtimesPerContainer quick-launchers ready for every
+    container/runtime combination. If \a maximumRuntimesPerContainer is bigger than that, the
+    pool adapts to the demand: an entry keeps as many quick-launchers ready, as applications have
+    been started from it within the last minute (up to the maximum). Running out of
+    quick-launchers makes the pool refill a lot faster than usual.
+    Low memory warnings cap every entry at a single quick-launcher, critical ones stop all of them,
+    for a minute after the last warning.
+*/
+void QuickLauncher::initialize(int runtimesPerContainer, qreal idleLoad, int maximumRuntimesPerContainer)
 {
     ContainerFactory *cf = ContainerFactory::instance();
     RuntimeFactory *rf = RuntimeFactory::instance();
 
-    if (runtimesPerContainer <= 0) {
+    runtimesPerContainer = qMax(0, runtimesPerContainer);
+    maximumRuntimesPerContainer = qMax(runtimesPerContainer, maximumRuntimesPerContainer);
+
+    if (maximumRuntimesPerContainer <= 0) {
         qCDebug(LogSystem) << "Not setting up the quick-launch pool (runtimesPerContainer is 0)";
         return;
     }
@@ -96,7 +122,8 @@ void QuickLauncher::initialize(int runtimesPerContainer, qreal idleLoad)
 
             QuickLaunchEntry entry;
             entry.m_containerId = containerId;
-            entry.m_maximum = runtimesPerContainer;
+            entry.m_minimum = runtimesPerContainer;
+            entry.m_maximum = maximumRuntimesPerContainer;
 
             if (rf->manager(runtimeId)->supportsQuickLaunch())
                 entry.m_runtimeId = runtimeId;
@@ -105,7 +132,8 @@ void QuickLauncher::initialize(int runtimesPerContainer, qreal idleLoad)
 
             qCDebug(LogSystem).nospace().noquote() << " * " << entry.m_containerId << " / "
                                                    << (entry.m_runtimeId.isEmpty() ? qSL("(no runtime)") : entry.m_runtimeId)
-                                                   << " [at max: " << runtimesPerContainer << "]";
+                                                   << " [at min: " << runtimesPerContainer
+                                                   << ", at max: " << maximumRuntimesPerContainer << "]";
         }
     }
 
@@ -137,10 +165,15 @@ void QuickLauncher::rebuild()
 
     int todo = 0;
     int done = 0;
+    bool starving = false;
+    qint64 now = m_clock.elapsed();
 
     for (auto entry = m_quickLaunchPool.begin(); entry != m_quickLaunchPool.end(); ++entry) {
-        if (entry->m_containersAndRuntimes.size() < entry->m_maximum) {
-            todo += (entry->m_maximum - entry->m_containersAndRuntimes.size());
+        int target = targetSize(*entry);
+        if (entry->m_containersAndRuntimes.size() < target) {
+            todo += (target - entry->m_containersAndRuntimes.size());
+            if ((entry->m_lastMiss >= 0) && (now - entry->m_lastMiss < launchStatisticsWindow))
+                starving = true;
             if (done >= 1)
                 continue;
 
@@ -183,12 +216,20 @@ void QuickLauncher::rebuild()
         }
     }
     if (todo > done)
-        triggerRebuild(1000);
+        triggerRebuild(starving ? fastRebuildDelay : slowRebuildDelay);
+    // the pool has to grow back, once the memory pressure is gone
+    if ((m_memoryPressureUntil >= 0) && (now < m_memoryPressureUntil))
+        triggerRebuild(int(m_memoryPressureUntil - now));
 }
 
+/*! \internal
+    All rebuild requests are coalesced into a single timer: a pending rebuild is only moved,
+    if the new request is due earlier.
+*/
 void QuickLauncher::triggerRebuild(int delay)
 {
-    QTimer::singleShot(delay, this, &QuickLauncher::rebuild);
+    if (!m_rebuildTimer.isActive() || (m_rebuildTimer.remainingTime() > delay))
+        m_rebuildTimer.start(delay);
 }
 
 void QuickLauncher::removeEntry(AbstractContainer *container, AbstractRuntime *runtime)
@@ -216,9 +257,75 @@ void QuickLauncher::removeEntry(AbstractContainer *container, AbstractRuntime *r
         emit shutDownFinished();
 }
 
+QuickLauncher::QuickLaunchEntry *QuickLauncher::findEntry(const QString &containerId, const QString &runtimeId)
+{
+    QuickLaunchEntry *containerOnly = nullptr;
+
+    for (auto entry = m_quickLaunchPool.begin(); entry != m_quickLaunchPool.end(); ++entry) {
+        if (entry->m_containerId == containerId) {
+            if (entry->m_runtimeId == runtimeId)
+                return entry;
+            else if (entry->m_runtimeId.isEmpty())
+                containerOnly = entry;
+        }
+    }
+    return containerOnly;
+}
+
+int QuickLauncher::targetSize(const QuickLaunchEntry &entry) const
+{
+    qint64 now = m_clock.elapsed();
+    int recent = int(std::count_if(entry.m_recentLaunches.cbegin(), entry.m_recentLaunches.cend(),
+                                   [now](qint64 t) { return now - t < launchStatisticsWindow; }));
+    int target = qBound(entry.m_minimum, recent, entry.m_maximum);
+
+    if ((m_memoryPressureUntil >= 0) && (now < m_memoryPressureUntil))
+        target = qMin(target, m_memoryPressureLimit);
+    return target;
+}
+
+void QuickLauncher::trimPool()
+{
+    for (auto entry = m_quickLaunchPool.begin(); entry != m_quickLaunchPool.end(); ++entry) {
+        int target = targetSize(*entry);
+
+        while (entry->m_containersAndRuntimes.size() > target) {
+            auto car = entry->m_containersAndRuntimes.takeLast();
+            car.first->disconnect(this);
+            if (car.second) {
+                car.second->disconnect(this);
+                car.second->stop();
+            } else {
+                car.first->deleteLater();
+            }
+            qCDebug(LogSystem).noquote() << "Removed an entry from the quick-launch pool due to memory pressure:"
+                                         << entry->m_containerId << "/"
+                                         << (entry->m_runtimeId.isEmpty() ? qSL("(no runtime)") : entry->m_runtimeId);
+        }
+    }
+}
+
+void QuickLauncher::onMemoryLowWarning()
+{
+    if (m_memoryPressureUntil < 0 || m_clock.elapsed() >= m_memoryPressureUntil)
+        m_memoryPressureLimit = 1;
+    m_memoryPressureUntil = m_clock.elapsed() + memoryPressureCooldown;
+    trimPool();
+    triggerRebuild(int(memoryPressureCooldown));
+}
+
+void QuickLauncher::onMemoryCriticalWarning()
+{
+    m_memoryPressureLimit = 0;
+    m_memoryPressureUntil = m_clock.elapsed() + memoryPressureCooldown;
+    trimPool();
+    triggerRebuild(int(memoryPressureCooldown));
+}
+
 QPair<AbstractContainer *, AbstractRuntime *> QuickLauncher::take(const QString &containerId, const QString &runtimeId)
 {
     QPair<AbstractContainer *, AbstractRuntime *> result(nullptr, nullptr);
+    QuickLaunchEntry *servedBy = nullptr;
 
     // 1st pass: find entry with matching container and runtime
     // 2nd pass: find entry with matching container and no runtime
@@ -229,6 +336,7 @@ QPair<AbstractContainer *, AbstractRuntime *> QuickLauncher::take(const QString
                         || ((pass == 2) && (entry->m_runtimeId.isEmpty()))) {
                     if (!entry->m_containersAndRuntimes.isEmpty()) {
                         result = entry->m_containersAndRuntimes.takeFirst();
+                        servedBy = entry;
                         result.first->disconnect(this);
                         if (result.second)
                             result.second->disconnect(this);
@@ -242,9 +350,79 @@ QPair<AbstractContainer *, AbstractRuntime *> QuickLauncher::take(const QString
         }
     }
 
+    // a hit is credited to the entry that served it, which might be a container-only one
+    if (QuickLaunchEntry *entry = servedBy ? servedBy : findEntry(containerId, runtimeId)) {
+        qint64 now = m_clock.elapsed();
+        entry->m_recentLaunches.erase(std::remove_if(entry->m_recentLaunches.begin(), entry->m_recentLaunches.end(),
+                                                     [now](qint64 t) { return now - t >= launchStatisticsWindow; }),
+                                      entry->m_recentLaunches.end());
+        entry->m_recentLaunches << now;
+
+        if (result.first) {
+            ++entry->m_hits;
+        } else {
+            ++entry->m_misses;
+            entry->m_lastMiss = now;
+            triggerRebuild();
+        }
+    }
     return result;
 }
 
+void QuickLauncher::observeStart(const QString &containerId, const QString &runtimeId, AbstractRuntime *runtime,
+                                 bool containerFromPool, bool runtimeFromPool)
+{
+    // just like in take(): a container without a runtime can only come from a container-only entry
+    const QString entryRuntimeId = (containerFromPool && !runtimeFromPool) ? QString() : runtimeId;
+    const bool fromPool = containerFromPool;
+
+    if (!runtime || !findEntry(containerId, entryRuntimeId))
+        return;
+
+    qint64 started = m_clock.elapsed();
+    auto connection = QSharedPointer<QMetaObject::Connection>::create();
+    *connection = connect(runtime, &AbstractRuntime::stateChanged,
+                          this, [this, containerId, entryRuntimeId, fromPool, started, connection](AbstractRuntime::State state) {
+        if (state == AbstractRuntime::Active) {
+            if (QuickLaunchEntry *entry = findEntry(containerId, entryRuntimeId)) {
+                qint64 elapsed = m_clock.elapsed() - started;
+                if (fromPool) {
+                    entry->m_startTimeFromPool += elapsed;
+                    ++entry->m_startsFromPool;
+                } else {
+                    entry->m_startTimeWithoutPool += elapsed;
+                    ++entry->m_startsWithoutPool;
+                }
+            }
+        } else if (state != AbstractRuntime::Inactive) {
+            return;
+        }
+        QObject::disconnect(*connection);
+    });
+}
+
+QVariantList QuickLauncher::statistics() const
+{
+    QVariantList list;
+    for (const QuickLaunchEntry &entry : m_quickLaunchPool) {
+        list << QVariantMap {
+            { qSL("containerId"), entry.m_containerId },
+            { qSL("runtimeId"), entry.m_runtimeId },
+            { qSL("ready"), entry.m_containersAndRuntimes.size() },
+            { qSL("target"), targetSize(entry) },
+            { qSL("minimum"), entry.m_minimum },
+            { qSL("maximum"), entry.m_maximum },
+            { qSL("hits"), entry.m_hits },
+            { qSL("misses"), entry.m_misses },
+            { qSL("averageStartTimeFromPool"), entry.m_startsFromPool
+                                               ? qreal(entry.m_startTimeFromPool) / entry.m_startsFromPool : qreal(-1) },
+            { qSL("averageStartTimeWithoutPool"), entry.m_startsWithoutPool
+                                                  ? qreal(entry.m_startTimeWithoutPool) / entry.m_startsWithoutPool : qreal(-1) }
+        };
+    }
+    return list;
+}
+
 void QuickLauncher::shutDown()
 {
     m_shuttingDown = true;
@@ -44,6 +44,9 @@
 #include <QObject>
 #include <QPair>
 #include <QVector>
+#include <QVariantList>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QtAppManCommon/global.h>
 
 QT_BEGIN_NAMESPACE_AM
@@ -60,14 +63,20 @@ public:
     static QuickLauncher *instance();
     ~QuickLauncher();
 
-    void initialize(int runtimesPerContainer, qreal idleLoad = 0);
+    void initialize(int runtimesPerContainer, qreal idleLoad = 0, int maximumRuntimesPerContainer = -1);
 
     QPair<AbstractContainer *, AbstractRuntime *> take(const QString &containerId, const QString &runtimeId);
+    void observeStart(const QString &containerId, const QString &runtimeId, AbstractRuntime *runtime,
+                      bool containerFromPool, bool runtimeFromPool);
+
+    QVariantList statistics() const;
 
     void shutDown();
 
 public slots:
     void rebuild();
+    void onMemoryLowWarning();
+    void onMemoryCriticalWarning();
 
 signals:
     void shutDownFinished();
@@ -81,18 +90,36 @@ private:
     QuickLauncher &operator=(const QuickLauncher &);
     static QuickLauncher *s_instance;
 
-    void triggerRebuild(int delay = 0);
-    void removeEntry(AbstractContainer *container, AbstractRuntime *runtime);
-
     struct QuickLaunchEntry
     {
         QString m_containerId;
         QString m_runtimeId;
+        int m_minimum = 1;
         int m_maximum = 1;
         QList<QPair<AbstractContainer *, AbstractRuntime *>> m_containersAndRuntimes;
+
+        // launch statistics
+        QVector<qint64> m_recentLaunches; // msecs of m_clock
+        qint64 m_lastMiss = -1;
+        int m_hits = 0;
+        int m_misses = 0;
+        qint64 m_startTimeFromPool = 0;
+        int m_startsFromPool = 0;
+        qint64 m_startTimeWithoutPool = 0;
+        int m_startsWithoutPool = 0;
     };
 
+    void triggerRebuild(int delay = 0);
+    void removeEntry(AbstractContainer *container, AbstractRuntime *runtime);
+    QuickLaunchEntry *findEntry(const QString &containerId, const QString &runtimeId);
+    int targetSize(const QuickLaunchEntry &entry) const;
+    void trimPool();
+
     QVector<QuickLaunchEntry> m_quickLaunchPool;
+    QElapsedTimer m_clock;
+    QTimer m_rebuildTimer;
+    qint64 m_memoryPressureUntil = -1;
+    int m_memoryPressureLimit = 0;
     int m_idleTimerId = 0;
     CpuReader *m_idleCpu = nullptr;
     bool m_isIdle = false;
@@ -84,23 +84,37 @@ QByteArray SysFsReader::fileName() const
 }
 
 QByteArray SysFsReader::readValue() const
+{
+    return (readRaw(nullptr) < 0) ? QByteArray() : m_buffer;
+}
+
+/*! \internal
+    Reads the file into the internal buffer without allocating any memory (as long as no copy
+    returned by readValue() is still alive). Returns the number of bytes read or -1 on error. On
+    success, \a data points to the buffer, which stays valid until the next read.
+*/
+int SysFsReader::readRaw(const char **data) const
 {
     if (m_fd < 0)
-        return QByteArray();
+        return -1;
     if (EINTR_LOOP(QT_LSEEK(m_fd, 0, SEEK_SET)) != QT_OFF_T(0))
-        return QByteArray();
+        return -1;
 
+    char *buffer = m_buffer.data();
     int offset = 0;
     int read = 0;
     do {
-        read = EINTR_LOOP(QT_READ(m_fd, m_buffer.data() + offset, m_buffer.size() - offset));
+        read = EINTR_LOOP(QT_READ(m_fd, buffer + offset, m_buffer.size() - offset));
         if (read < 0)
-            return QByteArray();
+            return -1;
         else if (read < (m_buffer.size() - offset))
-            m_buffer[read + offset] = 0;
+            buffer[read + offset] = 0;
         offset += read;
     } while (read > 0 && offset < m_buffer.size());
-    return m_buffer;
+
+    if (data)
+        *data = buffer;
+    return offset;
 }
 
 QT_END_NAMESPACE_AM
@@ -54,6 +54,7 @@ public:
     bool isOpen() const;
     QByteArray fileName() const;
     QByteArray readValue() const;
+    int readRaw(const char **data) const;
 
 private:
     int m_fd = -1;
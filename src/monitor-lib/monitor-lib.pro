@@ -18,6 +18,7 @@ HEADERS += \
     systemmonitor.h \
     processmonitor.h \
     processmonitor_p.h \
+    samplingengine.h \
     xprocessmonitor.h \
     memorymonitor.h \
     frametimer.h
@@ -26,6 +27,7 @@ SOURCES += \
     systemmonitor.cpp \
     processmonitor.cpp \
     processmonitor_p.cpp \
+    samplingengine.cpp \
     xprocessmonitor.cpp \
     memorymonitor.cpp \
     frametimer.cpp
@@ -142,6 +142,9 @@
             memory (for example through \c malloc or \c mmap on Linux).
     \endtable
 
+    The \c text and \c heap keys are only guaranteed to be populated, if
+    detailedMemoryReportingEnabled is set to \c true.
+
     These are the supported keys in each entry of the frameRate list:
 
     \table
@@ -217,6 +220,18 @@
     A boolean value that determines whether periodic memory reporting is enabled.
 */
 
+/*!
+    \qmlproperty bool ProcessMonitor::detailedMemoryReportingEnabled
+
+    A boolean value that determines whether the \c text and \c heap keys of the memory maps are
+    populated. Calculating these values requires parsing every single memory mapping of the
+    process, which can take several milliseconds for big QML applications. If this property is
+    set to \c false, only the \c total values will be reported: on Linux 4.14 and later, these are
+    read from the much cheaper \c /proc/<pid>/smaps_rollup file. The default value is \c true.
+
+    \sa memoryReportingEnabled
+*/
+
 /*!
     \qmlproperty bool ProcessMonitor::frameRateReportingEnabled
 
@@ -399,6 +414,23 @@ void ProcessMonitor::setMemoryReportingEnabled(bool enabled)
     }
 }
 
+bool ProcessMonitor::isDetailedMemoryReportingEnabled() const
+{
+    Q_D(const ProcessMonitor);
+    return d->reportMemoryDetails;
+}
+
+void ProcessMonitor::setDetailedMemoryReportingEnabled(bool enabled)
+{
+    Q_D(ProcessMonitor);
+
+    if (enabled != d->reportMemoryDetails) {
+        d->reportMemoryDetails = enabled;
+        emit d->newReadMemDetails(enabled);
+        emit detailedMemoryReportingEnabledChanged();
+    }
+}
+
 bool ProcessMonitor::isCpuLoadReportingEnabled() const
 {
     Q_D(const ProcessMonitor);
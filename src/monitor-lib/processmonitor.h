@@ -63,6 +63,7 @@ class ProcessMonitor : public QAbstractListModel
     Q_PROPERTY(QString applicationId READ applicationId WRITE setApplicationId NOTIFY applicationIdChanged)
     Q_PROPERTY(int reportingInterval READ reportingInterval WRITE setReportingInterval NOTIFY reportingIntervalChanged)
     Q_PROPERTY(bool memoryReportingEnabled READ isMemoryReportingEnabled WRITE setMemoryReportingEnabled NOTIFY memoryReportingEnabledChanged)
+    Q_PROPERTY(bool detailedMemoryReportingEnabled READ isDetailedMemoryReportingEnabled WRITE setDetailedMemoryReportingEnabled NOTIFY detailedMemoryReportingEnabledChanged)
     Q_PROPERTY(bool cpuLoadReportingEnabled READ isCpuLoadReportingEnabled WRITE setCpuLoadReportingEnabled NOTIFY cpuLoadReportingEnabledChanged)
     Q_PROPERTY(bool frameRateReportingEnabled READ isFrameRateReportingEnabled WRITE setFrameRateReportingEnabled NOTIFY frameRateReportingEnabledChanged)
     Q_PROPERTY(QList<QObject *> monitoredWindows READ monitoredWindows WRITE setMonitoredWindows NOTIFY monitoredWindowsChanged)
@@ -91,6 +92,9 @@ public:
     bool isMemoryReportingEnabled() const;
     void setMemoryReportingEnabled(bool enabled);
 
+    bool isDetailedMemoryReportingEnabled() const;
+    void setDetailedMemoryReportingEnabled(bool enabled);
+
     bool isCpuLoadReportingEnabled() const;
     void setCpuLoadReportingEnabled(bool enabled);
 
@@ -107,6 +111,7 @@ signals:
     void reportingIntervalChanged(int reportingInterval);
 
     void memoryReportingEnabledChanged();
+    void detailedMemoryReportingEnabledChanged();
     void cpuLoadReportingEnabledChanged();
     void frameRateReportingEnabledChanged();
 
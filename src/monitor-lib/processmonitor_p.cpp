@@ -56,16 +56,17 @@
 QT_BEGIN_NAMESPACE_AM
 
 
-ReadingTask::ReadingTask(QMutex &mutex, ReadingTask::Results &res)
+ReadingTask::ReadingTask(QMutex &mutex, ReadingTask::Results &res, SamplingScheduler *scheduler)
     : m_mutex(mutex)
     , m_results(res)
+    , m_scheduler(scheduler)
 {}
 
-void ReadingTask::cancelTimer()
+void ReadingTask::unschedule()
 {
-    if (m_reportingTimerId) {
-        killTimer(m_reportingTimerId);
-        m_reportingTimerId = 0;
+    if (m_scheduled) {
+        m_scheduler->unsubscribe(this);
+        m_scheduled = false;
     }
 }
 
@@ -75,13 +76,15 @@ void ReadingTask::setupTimer(bool enabled, int interval)
         m_reportingInterval = interval;
 
     if (!enabled) {
-        cancelTimer();
+        unschedule();
     } else {
         if (interval != -1)
-            cancelTimer();
+            unschedule();
 
-        if (!m_reportingTimerId && m_reportingInterval >= 0)
-            m_reportingTimerId = startTimer(m_reportingInterval);
+        if (!m_scheduled && m_reportingInterval >= 0) {
+            m_scheduler->subscribe(this, m_reportingInterval);
+            m_scheduled = true;
+        }
     }
 }
 
@@ -91,6 +94,7 @@ void ReadingTask::setNewPid(qint64 pid)
     if (pid) {
         openLoad();
         readLoad();
+        openMemory();
     }
 }
 
@@ -106,35 +110,49 @@ void ReadingTask::setNewReadMem(bool enabled)
     m_readMem = enabled;
 }
 
+void ReadingTask::setNewReadMemDetails(bool enabled)
+{
+    m_readMemDetails = enabled;
+}
+
 void ReadingTask::reset(int sync)
 {
     m_sync = sync;
 }
 
-void ReadingTask::timerEvent(QTimerEvent *event)
+void ReadingTask::shutDown()
 {
-    if (event && event->timerId() == m_reportingTimerId && m_pid) {
-        ReadingTask::Results results;
-
-        if (m_readMem) {
-            if (!readMemory(results.memory))
-                results.memory = ReadingTask::Results::Memory();
-            results.memory.read =  true;
-        }
+    // after this, the scheduler will not call us anymore and we will not touch the
+    // ProcessMonitor's mutex and results anymore
+    unschedule();
+    deleteLater();
+}
 
-        if (m_readCpu) {
-            results.cpu.load = readLoad();
-            results.cpu.read = true;
-        }
+void ReadingTask::sample()
+{
+    if (!m_pid)
+        return;
 
-        results.sync = m_sync;
+    ReadingTask::Results results;
 
-        m_mutex.lock();
-        m_results = results;
-        m_mutex.unlock();
+    if (m_readMem) {
+        if (!readMemory(results.memory))
+            results.memory = ReadingTask::Results::Memory();
+        results.memory.read =  true;
+    }
 
-        emit newReadingAvailable();
+    if (m_readCpu) {
+        results.cpu.load = readLoad();
+        results.cpu.read = true;
     }
+
+    results.sync = m_sync;
+
+    m_mutex.lock();
+    m_results = results;
+    m_mutex.unlock();
+
+    emit newReadingAvailable();
 }
 
 
@@ -182,14 +200,84 @@ qreal ReadingTask::readLoad()
     return load;
 }
 
+void ReadingTask::openMemory()
+{
+    // smaps_rollup is only available since Linux 4.14: we fall back to the full smaps if it is
+    // missing. The rollup has no Size field, so the virtual size is taken from statm instead.
+    const QByteArray procDir = "/proc/" + QByteArray::number(m_pid);
+    m_smapsRollupReader.reset(new SysFsReader(procDir + "/smaps_rollup"));
+    m_statmReader.reset(new SysFsReader(procDir + "/statm", 256));
+}
+
+static inline quint32 parseKiloBytes(const char *pl, const char *end)
+{
+    while (pl < end && (*pl < '0' || *pl > '9'))
+        ++pl;
+    quint32 value = 0;
+    while (pl < end && *pl >= '0' && *pl <= '9')
+        value = value * 10 + quint32(*pl++ - '0');
+    return value;
+}
+
 bool ReadingTask::readMemory(ReadingTask::Results::Memory &results)
+{
+    if (!m_readMemDetails && m_smapsRollupReader && m_smapsRollupReader->isOpen()
+            && m_statmReader && m_statmReader->isOpen()) {
+        const char *data = nullptr;
+        int size = m_smapsRollupReader->readRaw(&data);
+        if (size > 0 && parseSmapsRollup(data, size, results)) {
+            static const quint32 pageSizeInKiB = quint32(sysconf(_SC_PAGESIZE)) >> 10;
+            size = m_statmReader->readRaw(&data);
+            if (size > 0)
+                results.totalVm = parseKiloBytes(data, data + size) * pageSizeInKiB;
+            return size > 0;
+        }
+    }
+    return readSmaps("/proc/" + QByteArray::number(m_pid) + "/smaps", results);
+}
+
+/*! \internal
+    Parses the content of a /proc/<pid>/smaps_rollup file. Only the totals for RSS and PSS are
+    available; the virtual size has to be read separately.
+*/
+bool ReadingTask::parseSmapsRollup(const char *data, int size, ReadingTask::Results::Memory &results)
+{
+    const char *end = data + size;
+
+    // skip the [rollup] header line
+    const char *pl = static_cast<const char *>(memchr(data, '\n', size));
+    if (!pl)
+        return false;
+
+    bool hasRss = false;
+    bool hasPss = false;
+
+    while (++pl < end && !(hasRss && hasPss)) {
+        const char *eol = static_cast<const char *>(memchr(pl, '\n', end - pl));
+        if (!eol)
+            eol = end;
+
+        if ((eol - pl) > 4 && pl[3] == ':') {
+            if (!memcmp(pl, "Rss", 3)) {
+                results.totalRss = parseKiloBytes(pl + 4, eol);
+                hasRss = true;
+            } else if (!memcmp(pl, "Pss", 3)) {
+                results.totalPss = parseKiloBytes(pl + 4, eol);
+                hasPss = true;
+            }
+        }
+        pl = eol;
+    }
+    return hasRss && hasPss;
+}
+
+bool ReadingTask::readSmaps(const QByteArray &fileName, ReadingTask::Results::Memory &results)
 {
     struct ScopedFile {
         ~ScopedFile() { if (file) fclose(file); }
         FILE *file = nullptr;
     };
 
-    const QByteArray fileName = "/proc/" + QByteArray::number(m_pid) + "/smaps";
 
     ScopedFile sf;
     sf.file = fopen(fileName.constData(), "r");
@@ -336,6 +424,10 @@ qreal ReadingTask::readLoad()
     return 0.0;
 }
 
+void ReadingTask::openMemory()
+{
+}
+
 bool ReadingTask::readMemory(ReadingTask::Results::Memory &results)
 {
     struct task_basic_info t_info;
@@ -363,6 +455,10 @@ qreal ReadingTask::readLoad()
     return 0.0;
 }
 
+void ReadingTask::openMemory()
+{
+}
+
 bool ReadingTask::readMemory(ReadingTask::Results::Memory &results)
 {
     Q_UNUSED(results)
@@ -378,22 +474,28 @@ ProcessMonitorPrivate::ProcessMonitorPrivate(ProcessMonitor *q)
     connect(ApplicationManager::instance(), &ApplicationManager::applicationRunStateChanged,
             this, &ProcessMonitorPrivate::appRuntimeChanged);
 
-    readingTask = new ReadingTask(mutex, readResults);
-    readingTask->moveToThread(&thread);
+    // all ProcessMonitors share the same (small) set of sampling threads
+    scheduler = SamplingEngine::instance()->acquireScheduler();
+    readingTask = new ReadingTask(mutex, readResults, scheduler);
+    readingTask->moveToThread(scheduler->thread());
     connect(this, &ProcessMonitorPrivate::newPid, readingTask, &ReadingTask::setNewPid);
     connect(this, &ProcessMonitorPrivate::setupTimer, readingTask, &ReadingTask::setupTimer);
     connect(this, &ProcessMonitorPrivate::newReadCpu, readingTask, &ReadingTask::setNewReadCpu);
     connect(this, &ProcessMonitorPrivate::newReadMem, readingTask, &ReadingTask::setNewReadMem);
+    connect(this, &ProcessMonitorPrivate::newReadMemDetails, readingTask, &ReadingTask::setNewReadMemDetails);
     connect(this, &ProcessMonitorPrivate::reset, readingTask, &ReadingTask::reset);
     connect(readingTask, &ReadingTask::newReadingAvailable, this, &ProcessMonitorPrivate::readingUpdate);
-    connect(&thread, &QThread::finished, readingTask, &ReadingTask::deleteLater);
-    thread.start();
 }
 
 ProcessMonitorPrivate::~ProcessMonitorPrivate()
 {
-    thread.quit();
-    thread.wait();
+    if (scheduler) {
+        QMetaObject::invokeMethod(readingTask, "shutDown", Qt::BlockingQueuedConnection);
+        SamplingEngine::instance()->releaseScheduler(scheduler);
+    } else {
+        // the SamplingEngine is already gone, together with its threads
+        delete readingTask;
+    }
 }
 
 void ProcessMonitorPrivate::appRuntimeChanged(const QString &id, ApplicationManager::RunState state)
@@ -54,8 +54,8 @@
 
 #include <QObject>
 #include <QElapsedTimer>
-#include <QThread>
 #include <QMutex>
+#include <QPointer>
 #include <QString>
 #include <QHash>
 #include <QVector>
@@ -69,6 +69,7 @@
 #endif
 #include "processmonitor.h"
 #include "frametimer.h"
+#include "samplingengine.h"
 #include "applicationmanager.h"
 
 QT_BEGIN_NAMESPACE_AM
@@ -102,25 +103,32 @@ public:
         } cpu;
     };
 
-    ReadingTask(QMutex &mutex, Results &res);
+    ReadingTask(QMutex &mutex, Results &res, SamplingScheduler *scheduler);
 
-protected:
-    void timerEvent(QTimerEvent *event) override;
+    void sample();
+
+#if defined(Q_OS_LINUX)
+    static bool readSmaps(const QByteArray &fileName, Results::Memory &results);
+    static bool parseSmapsRollup(const char *data, int size, Results::Memory &results);
+#endif
 
 public slots:
     void setupTimer(bool enabled, int interval);
     void setNewPid(qint64 pid);
     void setNewReadMem(bool enabled);
+    void setNewReadMemDetails(bool enabled);
     void setNewReadCpu(bool enabled);
     void reset(int sync);
+    void shutDown();
 
 signals:
     void newReadingAvailable();
 
 private:
-    void cancelTimer();
+    void unschedule();
     void openLoad();
     qreal readLoad();
+    void openMemory();
     bool readMemory(Results::Memory &results);
 
     QMutex &m_mutex;
@@ -129,17 +137,21 @@ private:
 
 #if defined(Q_OS_LINUX)
     QScopedPointer<SysFsReader> m_statReader;
+    QScopedPointer<SysFsReader> m_smapsRollupReader;
+    QScopedPointer<SysFsReader> m_statmReader;
 #endif
     QElapsedTimer m_elapsedTime;
     quint64 m_lastCpuUsage;
 
-    qint64 m_pid;
+    qint64 m_pid = 0;
 
     bool m_readCpu = false;
     bool m_readMem = false;
+    bool m_readMemDetails = true;
 
+    SamplingScheduler *m_scheduler;
     int m_reportingInterval = -1;
-    int m_reportingTimerId = 0;
+    bool m_scheduled = false;
 };
 
 
@@ -177,6 +189,7 @@ public:
     int reportPos = 0;
 
     bool reportMemory = false;
+    bool reportMemoryDetails = true;
     bool reportCpu = false;
     bool reportFps = false;
     int cpuTail = 0;
@@ -191,7 +204,7 @@ public:
 
     ReadingTask *readingTask;
     ReadingTask::Results readResults;
-    QThread thread;
+    QPointer<SamplingScheduler> scheduler;
     QMutex mutex;
     int sync = 0;
 
@@ -215,6 +228,7 @@ signals:
     void setupTimer(bool enabled, int interval);
     void newPid(qint64 pid);
     void newReadMem(bool enabled);
+    void newReadMemDetails(bool enabled);
     void newReadCpu(bool enabled);
     void newCount(int count);
     void reset(int sync);
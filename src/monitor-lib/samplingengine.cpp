@@ -0,0 +1,170 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QTimerEvent>
+
+#include "logging.h"
+#include "processmonitor_p.h"
+#include "samplingengine.h"
+
+QT_BEGIN_NAMESPACE_AM
+
+SamplingScheduler::SamplingScheduler()
+    : QObject()
+{ }
+
+void SamplingScheduler::subscribe(ReadingTask *task, int interval)
+{
+    Tick &tick = m_ticks[interval];
+    if (tick.tasks.contains(task))
+        return;
+    tick.tasks.append(task);
+    if (!tick.timerId)
+        tick.timerId = startTimer(interval);
+}
+
+void SamplingScheduler::unsubscribe(ReadingTask *task)
+{
+    for (auto it = m_ticks.begin(); it != m_ticks.end(); ) {
+        it->tasks.removeOne(task);
+        if (it->tasks.isEmpty()) {
+            killTimer(it->timerId);
+            it = m_ticks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SamplingScheduler::timerEvent(QTimerEvent *event)
+{
+    for (auto it = m_ticks.cbegin(); it != m_ticks.cend(); ++it) {
+        if (it->timerId == event->timerId()) {
+            const QVector<ReadingTask *> tasks = it->tasks;
+            for (ReadingTask *task : tasks)
+                task->sample();
+            return;
+        }
+    }
+    QObject::timerEvent(event);
+}
+
+
+SamplingEngine *SamplingEngine::s_instance = nullptr;
+int SamplingEngine::s_threadCount = 1;
+
+SamplingEngine::SamplingEngine(QObject *parent)
+    : QObject(parent)
+{
+    m_workers.resize(s_threadCount);
+}
+
+SamplingEngine::~SamplingEngine()
+{
+    for (const Worker &worker : qAsConst(m_workers)) {
+        if (worker.thread) {
+            worker.thread->quit();
+            worker.thread->wait();
+            delete worker.scheduler;
+            delete worker.thread;
+        }
+    }
+    s_instance = nullptr;
+}
+
+SamplingEngine *SamplingEngine::instance()
+{
+    // parented to the application object, so that the worker threads are stopped before
+    // QCoreApplication goes away
+    if (!s_instance)
+        s_instance = new SamplingEngine(QCoreApplication::instance());
+    return s_instance;
+}
+
+int SamplingEngine::threadCount()
+{
+    return s_threadCount;
+}
+
+void SamplingEngine::setThreadCount(int count)
+{
+    if (s_instance) {
+        qCWarning(LogSystem) << "The number of ProcessMonitor sampling threads cannot be changed after"
+                                " the first ProcessMonitor has been created";
+        return;
+    }
+    s_threadCount = qBound(1, count, QThread::idealThreadCount());
+}
+
+SamplingScheduler *SamplingEngine::acquireScheduler()
+{
+    int best = 0;
+    for (int i = 1; i < m_workers.size(); ++i) {
+        if (m_workers.at(i).taskCount < m_workers.at(best).taskCount)
+            best = i;
+    }
+
+    Worker &worker = m_workers[best];
+    if (!worker.thread) {
+        worker.thread = new QThread;
+        worker.thread->setObjectName(qSL("AM-Sampling-%1").arg(best));
+        worker.scheduler = new SamplingScheduler;
+        worker.scheduler->moveToThread(worker.thread);
+        worker.thread->start();
+    }
+    ++worker.taskCount;
+    return worker.scheduler;
+}
+
+void SamplingEngine::releaseScheduler(SamplingScheduler *scheduler)
+{
+    // the threads are kept running even if idle: they do not wake up without subscribers
+    for (Worker &worker : m_workers) {
+        if (worker.scheduler == scheduler) {
+            --worker.taskCount;
+            break;
+        }
+    }
+}
+
+QT_END_NAMESPACE_AM
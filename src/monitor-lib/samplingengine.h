@@ -0,0 +1,110 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:LGPL-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 3 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL3 included in the
+** packaging of this file. Please review the following information to
+** ensure the GNU Lesser General Public License version 3 requirements
+** will be met: https://www.gnu.org/licenses/lgpl-3.0.html.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 2.0 or (at your option) the GNU General
+** Public license version 3 or any later version approved by the KDE Free
+** Qt Foundation. The licenses are as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL2 and LICENSE.GPL3
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-2.0.html and
+** https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+** SPDX-License-Identifier: LGPL-3.0
+**
+****************************************************************************/
+
+
+#pragma once
+
+#include <QObject>
+#include <QMap>
+#include <QVector>
+#include <QtAppManCommon/global.h>
+
+QT_FORWARD_DECLARE_CLASS(QThread)
+
+QT_BEGIN_NAMESPACE_AM
+
+class ReadingTask;
+
+// Lives in one of the SamplingEngine's worker threads and multiplexes all ReadingTasks that have
+// been assigned to this thread: tasks sharing the same interval are sampled from a single timer,
+// so they all wake up on the same tick.
+class SamplingScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    SamplingScheduler();
+
+    void subscribe(ReadingTask *task, int interval);
+    void unsubscribe(ReadingTask *task);
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    struct Tick {
+        int timerId = 0;
+        QVector<ReadingTask *> tasks;
+    };
+    QMap<int, Tick> m_ticks; // interval -> tick
+};
+
+// Process-wide pool of sampling threads shared by all ProcessMonitor instances.
+class SamplingEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~SamplingEngine();
+    static SamplingEngine *instance();
+
+    static int threadCount();
+    static void setThreadCount(int count);
+
+    SamplingScheduler *acquireScheduler();
+    void releaseScheduler(SamplingScheduler *scheduler);
+
+private:
+    SamplingEngine(QObject *parent = nullptr);
+    Q_DISABLE_COPY(SamplingEngine)
+
+    struct Worker {
+        QThread *thread = nullptr;
+        SamplingScheduler *scheduler = nullptr;
+        int taskCount = 0;
+    };
+    QVector<Worker> m_workers;
+
+    static SamplingEngine *s_instance;
+    static int s_threadCount;
+};
+
+QT_END_NAMESPACE_AM
@@ -45,6 +45,8 @@
 #include <QHash>
 #include <QTimerEvent>
 #include <QElapsedTimer>
+#include <QVarLengthArray>
+#include <qnumeric.h>
 #include <vector>
 #include <QGuiApplication>
 #include <QQuickView>
@@ -53,6 +55,7 @@
 #include "logging.h"
 #include "qml-utilities.h"
 #include "applicationmanager.h"
+#include "quicklauncher.h"
 #include "systemmonitor.h"
 #include "systemreader.h"
 #include <QtAppManWindow/windowmanager.h>
@@ -274,6 +277,117 @@ enum Roles
 };
 }
 
+// A fixed-capacity ring buffer for the SystemMonitor's history, laid out as a struct of arrays.
+// It is only ever accessed from the GUI thread, which both samples and serves the model.
+// The io load of every device is stored in its own column; NaN marks a missing value.
+class SystemMonitorHistory
+{
+public:
+    struct Sample
+    {
+        qreal cpuLoad = 0;
+        quint64 memoryUsed = 0;
+        qreal fpsAvg = 0;
+        qreal fpsMin = 0;
+        qreal fpsMax = 0;
+        qreal fpsJitter = 0;
+    };
+
+    int capacity() const { return m_capacity; }
+    int ioColumnCount() const { return m_ioColumns; }
+
+    void reset(int capacity, int ioColumns)
+    {
+        m_capacity = capacity;
+        m_ioColumns = ioColumns;
+        m_head = 0;
+        m_cpuLoad.fill(0, capacity);
+        m_memoryUsed.fill(0, capacity);
+        m_fpsAvg.fill(0, capacity);
+        m_fpsMin.fill(0, capacity);
+        m_fpsMax.fill(0, capacity);
+        m_fpsJitter.fill(0, capacity);
+        m_ioLoad.fill(qQNaN(), capacity * ioColumns);
+    }
+
+    // keeps the newest min(old, new capacity) samples
+    void resize(int capacity)
+    {
+        SystemMonitorHistory resized;
+        resized.reset(capacity, m_ioColumns);
+
+        QVarLengthArray<qreal, 8> ioLoad(m_ioColumns);
+        for (int row = qMin(capacity, m_capacity) - 1; row >= 0; --row) {
+            Sample sample;
+            read(row, &sample, ioLoad.data());
+            resized.write(sample, ioLoad.constData());
+        }
+        *this = resized;
+    }
+
+    int addIoColumn()
+    {
+        m_ioLoad.insert(m_ioLoad.size(), m_capacity, qQNaN());
+        return m_ioColumns++;
+    }
+
+    // ioLoad needs to have ioColumnCount() entries
+    void write(const Sample &sample, const qreal *ioLoad)
+    {
+        if (!m_capacity)
+            return;
+
+        const int slot = m_head;
+        m_cpuLoad[slot] = sample.cpuLoad;
+        m_memoryUsed[slot] = sample.memoryUsed;
+        m_fpsAvg[slot] = sample.fpsAvg;
+        m_fpsMin[slot] = sample.fpsMin;
+        m_fpsMax[slot] = sample.fpsMax;
+        m_fpsJitter[slot] = sample.fpsJitter;
+        qreal *column = m_ioLoad.data() + slot;
+        for (int i = 0; i < m_ioColumns; ++i, column += m_capacity)
+            *column = ioLoad[i];
+
+        m_head = (slot + 1 == m_capacity) ? 0 : slot + 1;
+    }
+
+    // row 0 is the newest sample; ioLoad may be a nullptr, if the io values are not needed
+    bool read(int row, Sample *sample, qreal *ioLoad) const
+    {
+        if (row < 0 || row >= m_capacity)
+            return false;
+
+        int slot = m_head - row - 1;
+        if (slot < 0)
+            slot += m_capacity;
+
+        sample->cpuLoad = m_cpuLoad.at(slot);
+        sample->memoryUsed = m_memoryUsed.at(slot);
+        sample->fpsAvg = m_fpsAvg.at(slot);
+        sample->fpsMin = m_fpsMin.at(slot);
+        sample->fpsMax = m_fpsMax.at(slot);
+        sample->fpsJitter = m_fpsJitter.at(slot);
+        if (ioLoad) {
+            const qreal *column = m_ioLoad.constData() + slot;
+            for (int i = 0; i < m_ioColumns; ++i, column += m_capacity)
+                ioLoad[i] = *column;
+        }
+        return true;
+    }
+
+private:
+    int m_capacity = 0;
+    int m_ioColumns = 0;
+    int m_head = 0; // the slot that will be written next
+    QVector<qreal> m_cpuLoad;
+    QVector<quint64> m_memoryUsed;
+    QVector<qreal> m_fpsAvg;
+    QVector<qreal> m_fpsMin;
+    QVector<qreal> m_fpsMax;
+    QVector<qreal> m_fpsJitter;
+    QVector<qreal> m_ioLoad; // column-major: one column of m_capacity values per io device
+};
+
 class SystemMonitorPrivate : public QObject // clazy:exclude=missing-qobject-macro
 {
 public:
@@ -321,18 +435,8 @@ public:
     QMap<QString, int> ioTails;
     bool windowManagerConnectionCreated = false;
 
-    struct Report
-    {
-        qreal cpuLoad = 0;
-        qreal fpsAvg = 0;
-        qreal fpsMin = 0;
-        qreal fpsMax = 0;
-        qreal fpsJitter = 0;
-        quint64 memoryUsed = 0;
-        QVariantMap ioLoad;
-    };
-    QVector<Report> reports;
-    int reportPos = 0;
+    SystemMonitorHistory history;
+    QStringList ioColumns; // device names for the history's io columns
 
     // model
     QHash<int, QByteArray> roleNames;
@@ -417,7 +521,9 @@ public:
         Q_Q(SystemMonitor);
 
         if (te && te->timerId() == reportingTimerId) {
-            Report r;
+            SystemMonitorHistory::Sample r;
+            QVarLengthArray<qreal, 8> ioLoad(ioColumns.size());
+            std::fill(ioLoad.begin(), ioLoad.end(), qQNaN());
             QVector<int> roles;
             if (reportProcess) {
                 for (int i = 0; i < processMonitors.size(); i++)
@@ -449,18 +555,14 @@ public:
             for (auto it = ioHash.cbegin(); it != ioHash.cend(); ++it) {
                 qreal ioVal = it.value()->readLoadValue();
                 emit q->ioLoadReportingChanged(it.key(), ioVal);
-                r.ioLoad.insert(it.key(), ioVal);
+                ioLoad[ioColumns.indexOf(it.key())] = ioVal;
             }
-            if (!r.ioLoad.isEmpty())
+            if (!ioHash.isEmpty() || !ioTails.isEmpty())
                 roles.append(IoLoad);
-            if (!ioTails.isEmpty()) {
-                if (r.ioLoad.isEmpty())
-                    roles.append(IoLoad);
-                for (const auto &it : ioTails.keys()) {
-                    r.ioLoad.insert(it, 0.0);
-                    if (--ioTails[it] == 0)
-                        ioTails.remove(it);
-                }
+            for (const auto &it : ioTails.keys()) {
+                ioLoad[ioColumns.indexOf(it)] = 0.0;
+                if (--ioTails[it] == 0)
+                    ioTails.remove(it);
             }
 
             if (reportFps) {
@@ -486,14 +588,16 @@ public:
 
             // ring buffer handling
             // optimization: instead of sending a dataChanged for every item, we always move the
-            // last item to the front and change its data only
-            int last = reports.size() - 1;
-            q->beginMoveRows(QModelIndex(), last, last, QModelIndex(), 0);
-            reports[reportPos++] = r;
-            if (reportPos > last)
-                reportPos = 0;
-            q->endMoveRows();
-            q->dataChanged(q->index(0), q->index(0), roles);
+            // last item to the front and change its data only. Writing to the history overwrites
+            // the oldest sample, which then becomes row 0 - exactly what the move describes.
+            int last = history.capacity() - 1;
+            bool moveRows = (last > 0);
+            if (moveRows)
+                q->beginMoveRows(QModelIndex(), last, last, QModelIndex(), 0);
+            history.write(r, ioLoad.constData());
+            if (moveRows)
+                q->endMoveRows();
+            emit q->dataChanged(q->index(0), q->index(0), roles);
 
             setupTimer();  // we might be able to stop this timer, when end of tail reached
 
@@ -507,15 +611,18 @@ public:
         }
     }
 
-    const Report &reportForRow(int row) const
+    QVariantMap ioLoadForRow(int row) const
     {
-        // convert a visual row position to an index into the internal ringbuffer
-        int pos = reportPos - row - 1;
-        if (pos < 0)
-            pos += reports.size();
-        if (pos < 0 || pos >= reports.size())
-            return reports.first();
-        return reports.at(pos);
+        SystemMonitorHistory::Sample sample;
+        QVarLengthArray<qreal, 8> ioLoad(history.ioColumnCount());
+        QVariantMap map;
+        if (history.read(row, &sample, ioLoad.data())) {
+            for (int i = 0; i < ioLoad.size(); ++i) {
+                if (!qIsNaN(ioLoad.at(i)))
+                    map.insert(ioColumns.at(i), ioLoad.at(i));
+            }
+        }
+        return map;
     }
 
     void updateModel(bool clear)
@@ -530,27 +637,13 @@ public:
         }
 
         if (clear) {
-            reports.clear();
-            reports.resize(count);
-            reportPos = 0;
             cpuTail = memTail = fpsTail = 0;
             ioTails.clear();
+            ioColumns = ioHash.keys();
+            history.reset(count, ioColumns.size());
         } else {
-            int oldCount = reports.size();
-            int diff = count - oldCount;
-            if (diff > 0)
-                reports.insert(reportPos, diff, Report());
-            else {
-                if (reportPos <= count) {
-                    reports.remove(reportPos, -diff);
-                    if (reportPos == count)
-                        reportPos = 0;
-                } else {
-                    reports.remove(reportPos, oldCount - reportPos);
-                    reports.remove(0, reportPos - count);
-                    reportPos = 0;
-                }
-            }
+            int diff = count - history.capacity();
+            history.resize(count);
 
             if (cpuTail > 0)
                 cpuTail += diff;
@@ -632,25 +725,29 @@ int SystemMonitor::rowCount(const QModelIndex &parent) const
 
     if (parent.isValid())
         return 0;
-    return d->reports.count();
+    return d->history.capacity();
 }
 
 QVariant SystemMonitor::data(const QModelIndex &index, int role) const
 {
     Q_D(const SystemMonitor);
 
-    if (index.parent().isValid() || !index.isValid() || index.row() < 0 || index.row() >= d->reports.size())
+    if (index.parent().isValid() || !index.isValid() || index.row() < 0 || index.row() >= d->history.capacity())
         return QVariant();
 
-    const SystemMonitorPrivate::Report &r = d->reportForRow(index.row());
+    // the io load map is only created on demand
+    if (role == IoLoad)
+        return d->ioLoadForRow(index.row());
+
+    SystemMonitorHistory::Sample r;
+    if (!d->history.read(index.row(), &r, nullptr))
+        return QVariant();
 
     switch (role) {
     case CpuLoad:
         return r.cpuLoad;
     case MemoryUsed:
         return r.memoryUsed;
-    case IoLoad:
-        return r.ioLoad;
     case AverageFps:
         return r.fpsAvg;
     case MinimumFps:
@@ -742,6 +839,55 @@ bool SystemMonitor::setMemoryWarningThresholds(qreal lowWarning, qreal criticalW
     return true;
 }
 
+/*!
+    \qmlmethod list<object> SystemMonitor::quickLaunchStatistics()
+
+    Returns the current state and the launch statistics of the quick-launch pool: one object per
+    container/runtime combination, with these fields:
+
+    \table
+    \header
+        \li Name
+        \li Type
+        \li Description
+    \row
+        \li \c containerId
+        \li string
+        \li The id of the container.
+    \row
+        \li \c runtimeId
+        \li string
+        \li The id of the runtime (empty, if only the container is quick-launched).
+    \row
+        \li \c ready
+        \li int
+        \li The number of quick-launchers that are currently ready.
+    \row
+        \li \c target
+        \li int
+        \li The number of quick-launchers the pool is currently trying to keep ready, based on the
+            recent demand and the available memory.
+    \row
+        \li \c minimum, \c maximum
+        \li int
+        \li The configured bounds (\c quicklaunch/runtimesPerContainer and
+            \c quicklaunch/maximumRuntimesPerContainer).
+    \row
+        \li \c hits, \c misses
+        \li int
+        \li How many application starts were served from the pool and how many were not.
+    \row
+        \li \c averageStartTimeFromPool, \c averageStartTimeWithoutPool
+        \li real
+        \li The average time in milliseconds it took these applications to reach the running state,
+            or \c -1 if there is no data yet.
+    \endtable
+*/
+QVariantList SystemMonitor::quickLaunchStatistics() const
+{
+    return QuickLauncher::instance()->statistics();
+}
+
 /*!
     \qmlmethod real SystemMonitor::memoryLowWarningThreshold()
 
@@ -858,6 +1004,10 @@ bool SystemMonitor::addIoLoadReporting(const QString &deviceName)
         return false;
 
     d->ioTails.remove(deviceName);
+    if (!d->ioColumns.contains(deviceName)) {
+        d->ioColumns.append(deviceName);
+        d->history.addIoColumn();
+    }
 
     IoReader *ior = new IoReader(deviceName.toLocal8Bit().constData());
     d->ioHash.insert(deviceName, ior);
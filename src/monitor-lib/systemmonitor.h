@@ -118,6 +118,8 @@ public:
 
     Q_INVOKABLE QObject *getProcessMonitor(const QString &appId);  // experimental only!
 
+    Q_INVOKABLE QVariantList quickLaunchStatistics() const;
+
 signals:
     void countChanged();
     void idleChanged(bool idle);
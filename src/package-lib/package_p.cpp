@@ -42,11 +42,12 @@
 
 #include <QFileInfo>
 #include <QDataStream>
-#include <QCryptographicHash>
+#include <QStringList>
 
 #include <archive.h>
 
 #include "package_p.h"
+#include "digest.h"
 
 QT_BEGIN_NAMESPACE_AM
 
@@ -58,7 +59,7 @@ ArchiveException::ArchiveException(struct ::archive *ar, const char *errorString
 QVariantMap PackageUtilities::importantHeaderData = QVariantMap {
 };
 
-void PackageUtilities::addFileMetadataToDigest(const QString &entryFilePath, const QFileInfo &fi, QCryptographicHash &digest)
+void PackageUtilities::addFileMetadataToDigest(const QString &entryFilePath, const QFileInfo &fi, Sha256Digest &digest)
 {
     // (using QDataStream would be more readable, but it would make the algorithm Qt dependent)
     QByteArray addToDigest = ((fi.isDir()) ? "D/" : "F/")
@@ -67,7 +68,7 @@ void PackageUtilities::addFileMetadataToDigest(const QString &entryFilePath, con
     digest.addData(addToDigest);
 }
 
-void PackageUtilities::addImportantHeaderDataToDigest(const QVariantMap &header, QCryptographicHash &digest) Q_DECL_NOEXCEPT_EXPR(false)
+void PackageUtilities::addImportantHeaderDataToDigest(const QVariantMap &header, Sha256Digest &digest) Q_DECL_NOEXCEPT_EXPR(false)
 {
     for (auto it = importantHeaderData.constBegin(); it != importantHeaderData.constEnd(); ++it) {
         if (header.contains(it.key())) {
@@ -85,4 +86,61 @@ void PackageUtilities::addImportantHeaderDataToDigest(const QVariantMap &header,
     }
 }
 
+/*! \internal
+  Returns the package compressions that can be used with the libarchive version we are linked
+  against: \c gzip is always available, \c xz needs libarchive to be built with liblzma and
+  \c zstd needs at least libarchive 3.3.3 built against libzstd.
+  The result is determined once by probing libarchive's write filters.
+*/
+QStringList PackageUtilities::supportedCompressions()
+{
+    static const QStringList supported = []() {
+        QStringList result { qSL("gzip") };
+
+        auto probe = [](int (*addFilter)(struct ::archive *)) -> bool {
+            struct ::archive *ar = archive_write_new();
+            if (!ar)
+                return false;
+            // we do not want to fall back to external programs, so only ARCHIVE_OK is good enough
+            bool ok = (addFilter(ar) == ARCHIVE_OK);
+            archive_write_free(ar);
+            return ok;
+        };
+
+        if (probe(archive_write_add_filter_xz))
+            result << qSL("xz");
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+        if (probe(archive_write_add_filter_zstd))
+            result << qSL("zstd");
+#endif
+        return result;
+    }();
+    return supported;
+}
+
+int PackageUtilities::archiveFilterCode(const QString &compression)
+{
+    if (compression == qL1S("gzip"))
+        return ARCHIVE_FILTER_GZIP;
+    else if (compression == qL1S("xz"))
+        return ARCHIVE_FILTER_XZ;
+#if defined(ARCHIVE_FILTER_ZSTD)
+    else if (compression == qL1S("zstd"))
+        return ARCHIVE_FILTER_ZSTD;
+#endif
+    return -1;
+}
+
+QString PackageUtilities::compressionFromArchiveFilterCode(int filterCode)
+{
+    switch (filterCode) {
+    case ARCHIVE_FILTER_GZIP: return qSL("gzip");
+    case ARCHIVE_FILTER_XZ: return qSL("xz");
+#if defined(ARCHIVE_FILTER_ZSTD)
+    case ARCHIVE_FILTER_ZSTD: return qSL("zstd");
+#endif
+    default: return QString();
+    }
+}
+
 QT_END_NAMESPACE_AM
@@ -47,18 +47,25 @@
 
 struct archive;
 QT_FORWARD_DECLARE_CLASS(QFileInfo)
-QT_FORWARD_DECLARE_CLASS(QCryptographicHash)
 
 QT_BEGIN_NAMESPACE_AM
 
+class Sha256Digest;
+
 class PackageUtilities
 {
 public:
-    static void addFileMetadataToDigest(const QString &entryFilePath, const QFileInfo &fi, QCryptographicHash &digest);
-    static void addImportantHeaderDataToDigest(const QVariantMap &header, QCryptographicHash &digest) Q_DECL_NOEXCEPT_EXPR(false);
+    static void addFileMetadataToDigest(const QString &entryFilePath, const QFileInfo &fi, Sha256Digest &digest);
+    static void addImportantHeaderDataToDigest(const QVariantMap &header, Sha256Digest &digest) Q_DECL_NOEXCEPT_EXPR(false);
 
     // key == field name, value == type to choose correct hashing algorithm
     static QVariantMap importantHeaderData;
+
+    // the package compressions ("gzip", "xz", "zstd") that the linked libarchive can write
+    static QStringList supportedCompressions();
+    // maps between the compression names and libarchive's ARCHIVE_FILTER_* codes (-1 / null if unknown)
+    static int archiveFilterCode(const QString &compression);
+    static QString compressionFromArchiveFilterCode(int filterCode);
 };
 
 enum PackageEntryType {
@@ -44,7 +44,7 @@
 #include <QDir>
 #include <QFile>
 #include <QDebug>
-#include <QCryptographicHash>
+#include <QThread>
 #include <qplatformdefs.h>
 
 #include <archive.h>
@@ -56,6 +56,7 @@
 #include "exception.h"
 #include "error.h"
 #include "installationreport.h"
+#include "digest.h"
 #include "qtyaml.h"
 
 #ifndef S_IREAD
@@ -104,6 +105,20 @@ void PackageCreator::setSourceDirectory(const QDir &sourceDir)
     d->m_sourcePath = sourceDir.absolutePath() + QLatin1Char('/');
 }
 
+/*! \internal
+  The compression filter used for the package: \c gzip (the default), \c xz or \c zstd.
+  See PackageUtilities::supportedCompressions() for what is actually available at runtime.
+*/
+QString PackageCreator::compression() const
+{
+    return d->m_compression;
+}
+
+void PackageCreator::setCompression(const QString &compression)
+{
+    d->m_compression = compression.isEmpty() ? qSL("gzip") : compression;
+}
+
 bool PackageCreator::create()
 {
     if (!wasCanceled())
@@ -158,6 +173,7 @@ void PackageCreator::cancel()
 PackageCreatorPrivate::PackageCreatorPrivate(PackageCreator *creator, QIODevice *output, const InstallationReport &report)
     : q(creator)
     , m_output(output)
+    , m_compression(qSL("gzip"))
     , m_report(report)
 { }
 
@@ -170,7 +186,7 @@ bool PackageCreatorPrivate::create()
         if (m_report.applicationId().isNull())
             throw Exception("package identifier is null");
 
-        QCryptographicHash digest(QCryptographicHash::Sha256);
+        Sha256Digest digest;
 
         QVariantMap headerFormat {
             { qSL("formatType"), qSL("am-package-header") },
@@ -182,6 +198,11 @@ bool PackageCreatorPrivate::create()
             { qSL("diskSpaceUsed"), m_report.diskSpaceUsed() }
         };
 
+        // gzip is implied, so we only record the compression if it is something else: this keeps
+        // gzip packages identical to the ones created by older versions
+        if (m_compression != qL1S("gzip"))
+            headerData.insert(qSL("compression"), m_compression);
+
         PackageUtilities::addImportantHeaderDataToDigest(headerData, digest);
 
         emit q->progress(0);
@@ -193,11 +214,29 @@ bool PackageCreatorPrivate::create()
             throw ArchiveException(ar, "could not set the archive format to USTAR");
         if (archive_write_set_options(ar, "hdrcharset=UTF-8") != ARCHIVE_OK)
             throw ArchiveException(ar, "could not set the HDRCHARSET option");
-        if (archive_write_add_filter_gzip(ar) != ARCHIVE_OK)
-            throw ArchiveException(ar, "could not enable GZIP compression");
-// disabled for now -- see libarchive.pro
-//        if (archive_write_add_filter_xz(ar) != ARCHIVE_OK)
-//            throw ArchiveException(ar, "could not enable XZ compression");
+        if (!PackageUtilities::supportedCompressions().contains(m_compression))
+            throw Exception(Error::Package, "the package compression '%1' is not supported (available: %2)")
+                .arg(m_compression).arg(PackageUtilities::supportedCompressions().join(qSL(", ")));
+
+        if (m_compression == qL1S("xz")) {
+            if (archive_write_add_filter_xz(ar) != ARCHIVE_OK)
+                throw ArchiveException(ar, "could not enable XZ compression");
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+        } else if (m_compression == qL1S("zstd")) {
+            if (archive_write_add_filter_zstd(ar) != ARCHIVE_OK)
+                throw ArchiveException(ar, "could not enable ZSTD compression");
+#endif
+        } else {
+            if (archive_write_add_filter_gzip(ar) != ARCHIVE_OK)
+                throw ArchiveException(ar, "could not enable GZIP compression");
+        }
+
+        // xz and zstd can compress using multiple threads, if libarchive and the codec library
+        // are recent enough. Older versions simply do not know this option, which is fine.
+        if (m_compression != qL1S("gzip")) {
+            archive_write_set_filter_option(ar, nullptr, "threads",
+                                            QByteArray::number(QThread::idealThreadCount()).constData());
+        }
 
         auto dummyCallback = [](archive *, void *){ return ARCHIVE_OK; };
         auto writeCallback = [](archive *, void *user, const void *buffer, size_t size) {
@@ -66,6 +66,9 @@ public:
     QDir sourceDirectory() const;
     void setSourceDirectory(const QDir &sourceDir);
 
+    QString compression() const;
+    void setCompression(const QString &compression);
+
     bool create();
 
     QByteArray createdDigest() const;
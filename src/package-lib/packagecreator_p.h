@@ -63,6 +63,7 @@ private:
 
     QIODevice *m_output;
     QString m_sourcePath;
+    QString m_compression;
     bool m_failed = false;
     QAtomicInt m_canceled;
     Error m_errorCode = Error::None;
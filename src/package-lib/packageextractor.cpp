@@ -48,17 +48,23 @@
 #include <QDataStream>
 #include <QUrl>
 #include <QDebug>
-#include <QCryptographicHash>
 
 #include <archive.h>
 #include <archive_entry.h>
 
+#if defined(Q_OS_LINUX)
+#  include <fcntl.h>
+#  include <errno.h>
+#  include <string.h>
+#endif
+
 #include "package_p.h"
 #include "packageextractor.h"
 #include "packageextractor_p.h"
 #include "exception.h"
 #include "error.h"
 #include "installationreport.h"
+#include "digest.h"
 #include "utilities.h"
 #include "application.h"
 #include "qtyaml.h"
@@ -82,17 +88,30 @@ PackageExtractor::PackageExtractor(const QUrl &downloadUrl, const QDir &destinat
 
 QDir PackageExtractor::destinationDirectory() const
 {
-    return QDir(d->m_destinationPath);
+    return QDir(d->destinationPath());
 }
 
+/*! \internal
+  The destination can be changed from within the file-extracted callback: all entries following
+  the one the callback has been called for are then extracted into \a destinationDir.
+*/
 void PackageExtractor::setDestinationDirectory(const QDir &destinationDir)
 {
+    QMutexLocker locker(&d->m_callbackMutex);
     d->m_destinationPath = destinationDir.absolutePath() + qL1C('/');
 }
 
+/*! \internal
+  The \a callback is called for every extracted file or directory from the extraction's worker
+  thread, while extract() is running. It can throw an Exception to abort the extraction.
+  The pipeline is stalled after every file or directory until the callback has returned, so
+  it should be reset to \c nullptr as soon as it is not needed anymore.
+*/
 void PackageExtractor::setFileExtractedCallback(const std::function<void(const QString &)> &callback)
 {
+    QMutexLocker locker(&d->m_callbackMutex);
     d->m_fileExtractedCallback = callback;
+    d->m_callbackCondition.wakeAll();
 }
 
 const InstallationReport &PackageExtractor::installationReport() const
@@ -100,22 +119,45 @@ const InstallationReport &PackageExtractor::installationReport() const
     return d->m_report;
 }
 
+/*! \internal
+  The compression filter (\c gzip, \c xz or \c zstd) of the extracted package, as stated in its
+  header. Only valid after a successful extract().
+*/
+QString PackageExtractor::compression() const
+{
+    return d->m_compression;
+}
+
 bool PackageExtractor::extract()
 {
     if (!wasCanceled()) {
         d->m_failed = false;
 
-        d->download(d->m_url);
+        if (!d->openLocalFile(d->m_url))
+            d->download(d->m_url);
 
         QMetaObject::invokeMethod(d, "extract", Qt::QueuedConnection);
         d->m_loop.exec();
 
+        // the pipeline threads are done or have been aborted at this point
+        if (d->m_decompressThread) {
+            d->m_decompressThread->wait();
+            delete d->m_decompressThread;
+            d->m_decompressThread = nullptr;
+        }
+        if (d->m_writeThread) {
+            d->m_writeThread->wait();
+            delete d->m_writeThread;
+            d->m_writeThread = nullptr;
+        }
+
         delete d->m_reply;
         d->m_reply = nullptr;
+        d->m_localFile.close();
+        d->m_localReadBuffer.clear();
     }
     return !wasCanceled() && !hasFailed();
 }
-
 bool PackageExtractor::hasFailed() const
 {
     return d->m_failed || wasCanceled();
@@ -142,6 +184,7 @@ QString PackageExtractor::errorString() const
 void PackageExtractor::cancel()
 {
     if (!d->m_canceled.fetchAndStoreOrdered(1)) {
+        d->abortPipeline();
         if (d->m_loop.isRunning())
             d->m_loop.wakeUp();
     }
@@ -158,67 +201,218 @@ PackageExtractorPrivate::PackageExtractorPrivate(PackageExtractor *extractor, co
     , m_url(downloadUrl)
     , m_nam(new QNetworkAccessManager(this))
     , m_report(QString())
-{
-    m_buffer.resize(64 * 1024);
-}
+    , m_readQueue(16)  // 16 x up to 256KB
+    , m_writeQueue(16) // 16 x up to 1MB
+{ }
 
-qint64 PackageExtractorPrivate::readTar(struct archive *ar, const void **archiveBuffer)
+// The reading stage: runs in the extractor's thread, because that is where the network reply lives.
+void PackageExtractorPrivate::readFromReply()
 {
-    forever {
-        // the event loop is gone
-        if (!m_loop.isRunning()) {
-            archive_set_error(ar, -1, "no eventlopp");
-            return -1;
-        }
-        // we have been canceled
-        if (q->wasCanceled()) {
-            archive_set_error(ar, -1, "canceled");
-            return -1;
-        }
+    static const qint64 chunkSize = 256 * 1024;
+
+    while (m_reply && !q->wasCanceled() && !m_readQueue.isAborted()) {
+        // The decompression stage will call us again, as soon as it took a chunk out of the queue.
+        // The flag needs to be set before checking the queue, or we could miss this wake-up call.
+        m_readerThrottled.storeRelease(1);
+        if (m_readQueue.isFull())
+            return;
+        m_readerThrottled.storeRelease(0);
+
         qint64 bytesAvailable = m_reply->bytesAvailable();
 
         // there is something to read
         // (or this is a FIFO and we need this ugly hack - for testing only though!)
         if ((bytesAvailable > 0) || m_downloadingFromFIFO) {
-            qint64 bytesRead = m_reply->read(m_buffer.data(), m_buffer.size());
+            QByteArray chunk(int(m_downloadingFromFIFO ? chunkSize : qMin(bytesAvailable, chunkSize)), Qt::Uninitialized);
+            qint64 bytesRead = m_reply->read(chunk.data(), chunk.size());
 
             if (bytesRead < 0) {
                 // another FIFO hack: if the writer dies, we will get an -1 return from read()
                 if (m_downloadingFromFIFO && m_reply->atEnd()) {
-                    return 0;
+                    m_readQueue.close();
                 } else {
-                    archive_set_error(ar, -1, "could not read from tar archive");
-                    return -1;
+                    setError(Error::Archive, qSL("[libarchive] could not read from tar archive"));
+                    abortPipeline();
                 }
+                return;
+            } else if (bytesRead == 0) {
+                if (m_downloadingFromFIFO) {
+                    m_readQueue.close();
+                    return;
+                }
+                continue;
             }
+            chunk.resize(int(bytesRead));
 
             m_bytesReadTotal += bytesRead;
-            *archiveBuffer = m_buffer.constData();
+            m_readQueue.push(chunk);
 
             qint64 progress = m_downloadTotal ? (100 * m_bytesReadTotal / m_downloadTotal) : 0;
             if (progress != m_lastProgress) {
                 emit q->progress(qreal(progress) / 100);
                 m_lastProgress = progress;
             }
-
-            return bytesRead;
+            continue;
         }
 
-        // got an error while reading
-        if (m_reply->error() != QNetworkReply::NoError) {
-            archive_set_error(ar, -1, "%s", m_reply->errorString().toLocal8Bit().constData());
-            return -1;
-        }
+        // got an error while reading (this is handled in networkError())
+        if (m_reply->error() != QNetworkReply::NoError)
+            return;
 
         // we're done
         if (m_reply->isFinished())
-            return 0;
+            m_readQueue.close();
+
+        // otherwise wait for readyRead()
+        return;
+    }
+}
+
+// Called by libarchive in the decompression stage.
+qint64 PackageExtractorPrivate::readTar(struct archive *ar, const void **archiveBuffer)
+{
+    if (!m_readQueue.pop(&m_currentReadChunk)) {
+        if (q->wasCanceled() || m_readQueue.isAborted()) {
+            archive_set_error(ar, -1, "canceled");
+            return -1;
+        }
+        return 0; // we're done
+    }
+
+    if (m_readerThrottled.testAndSetOrdered(1, 0))
+        QMetaObject::invokeMethod(this, "readFromReply", Qt::QueuedConnection);
+
+    *archiveBuffer = m_currentReadChunk.constData();
+    return m_currentReadChunk.size();
+}
+
+// Called by libarchive in the decompression stage, if we are extracting a local package.
+qint64 PackageExtractorPrivate::readLocalFile(struct archive *ar, const void **archiveBuffer)
+{
+    if (q->wasCanceled() || m_writeQueue.isAborted()) {
+        archive_set_error(ar, -1, "canceled");
+        return -1;
+    }
 
-        m_loop.processEvents(QEventLoop::WaitForMoreEvents);
+    qint64 bytesRead = m_localFile.read(m_localReadBuffer.data(), m_localReadBuffer.size());
+    if (bytesRead < 0) {
+        archive_set_error(ar, -1, "could not read from %s: %s", qPrintable(m_localFile.fileName()),
+                          qPrintable(m_localFile.errorString()));
+        return -1;
+    }
+    m_bytesReadTotal += bytesRead;
+    *archiveBuffer = m_localReadBuffer.constData();
+
+    // the progress signal is always emitted from the extractor's thread
+    qint64 progress = m_downloadTotal ? (100 * m_bytesReadTotal / m_downloadTotal) : 0;
+    if (progress != m_lastProgress) {
+        QMetaObject::invokeMethod(this, "emitProgress", Qt::QueuedConnection, Q_ARG(qreal, qreal(progress) / 100));
+        m_lastProgress = progress;
     }
+    return bytesRead;
+}
+
+void PackageExtractorPrivate::emitProgress(qreal progress)
+{
+    if (!q->wasCanceled())
+        emit q->progress(progress);
 }
 
 void PackageExtractorPrivate::extract()
+{
+    m_readQueue.reset();
+    m_writeQueue.reset();
+    m_readerThrottled.storeRelease(0);
+    {
+        QMutexLocker locker(&m_callbackMutex);
+        m_extractedEntryCount = 0;
+        m_headerValidated = false;
+    }
+
+    // resetting the queues would otherwise lose a cancel() that happened before we got here
+    if (q->wasCanceled())
+        abortPipeline();
+
+    m_decompressThread = new PipelineThread([this]() { decompress(); });
+    m_writeThread = new PipelineThread([this]() { write(); });
+    m_decompressThread->start();
+    m_writeThread->start();
+
+    // local packages do not need the reading stage at all
+    if (!m_localFile.isOpen())
+        readFromReply();
+}
+
+void PackageExtractorPrivate::pipelineFinished()
+{
+    if (!q->hasFailed())
+        emit q->progress(1);
+    m_loop.quit();
+}
+
+void PackageExtractorPrivate::abortPipeline()
+{
+    m_readQueue.abort();
+    m_writeQueue.abort();
+
+    QMutexLocker locker(&m_callbackMutex);
+    m_callbackCondition.wakeAll();
+}
+
+QString PackageExtractorPrivate::destinationPath() const
+{
+    QMutexLocker locker(&m_callbackMutex);
+    return m_destinationPath;
+}
+
+// Called by the decompression stage after it has handed over the file or directory number
+// entryCount: blocks until the write stage has called the file-extracted callback for it.
+// Returns false, if the pipeline has been aborted in the meantime.
+bool PackageExtractorPrivate::waitForFileExtractedCallback(quint64 entryCount)
+{
+    QMutexLocker locker(&m_callbackMutex);
+    while (m_fileExtractedCallback && (m_extractedEntryCount < entryCount)) {
+        if (m_writeQueue.isAborted())
+            return false;
+        m_callbackCondition.wait(&m_callbackMutex);
+    }
+    return !m_writeQueue.isAborted();
+}
+
+// Called by the decompression stage after it has handed over the header: blocks until the write
+// stage has validated it. Returns false, if the pipeline has been aborted in the meantime.
+bool PackageExtractorPrivate::waitForHeaderValidation()
+{
+    QMutexLocker locker(&m_callbackMutex);
+    while (!m_headerValidated) {
+        if (m_writeQueue.isAborted())
+            return false;
+        m_callbackCondition.wait(&m_callbackMutex);
+    }
+    return !m_writeQueue.isAborted();
+}
+
+// Called by the write stage for every file or directory
+void PackageExtractorPrivate::fileExtracted(const QString &entryPath) Q_DECL_NOEXCEPT_EXPR(false)
+{
+    std::function<void(const QString &)> callback;
+    {
+        QMutexLocker locker(&m_callbackMutex);
+        callback = m_fileExtractedCallback;
+    }
+    // the callback may change the destination directory or reset itself, so we must not
+    // hold the mutex while calling it
+    if (callback)
+        callback(entryPath);
+
+    QMutexLocker locker(&m_callbackMutex);
+    ++m_extractedEntryCount;
+    m_callbackCondition.wakeAll();
+}
+
+// The decompression stage: decompresses and parses the tar archive, checks the entries and creates
+// the directories. Everything else is handed over to the write stage.
+void PackageExtractorPrivate::decompress()
 {
     struct archive *ar = nullptr;
 
@@ -226,224 +420,346 @@ void PackageExtractorPrivate::extract()
         ar = archive_read_new();
         if (!ar)
             throw Exception("[libarchive] could not create a new archive object");
-        if (archive_read_support_format_tar(ar) != ARCHIVE_OK)
-            throw ArchiveException(ar, "could not enable TAR support");
-// disabled for now -- see libarchive.pro
-//        if (archive_read_support_filter_xz(ar) != ARCHIVE_OK)
-//            throw ArchiveException(ar, "could not enable XZ support");
-        if (archive_read_support_filter_gzip(ar) != ARCHIVE_OK)
-            throw ArchiveException(ar, "could not enable GZIP support");
+        decompressEntries(ar);
+        m_writeQueue.close();
+
+    } catch (const Exception &e) {
+        if (!q->wasCanceled())
+            setError(e.errorCode(), e.errorString());
+        abortPipeline();
+    }
+
+    if (ar)
+        archive_read_free(ar);
+    m_currentReadChunk.clear();
+}
+
+void PackageExtractorPrivate::decompressEntries(struct archive *ar) Q_DECL_NOEXCEPT_EXPR(false)
+{
+    static const int writeChunkSize = 1024 * 1024;
+
+    if (archive_read_support_format_tar(ar) != ARCHIVE_OK)
+        throw ArchiveException(ar, "could not enable TAR support");
+    if (archive_read_support_filter_gzip(ar) != ARCHIVE_OK)
+        throw ArchiveException(ar, "could not enable GZIP support");
+    // Only enable the filters that are natively supported: libarchive would otherwise silently
+    // fall back to forking external decompressor programs.
+    const QStringList compressions = PackageUtilities::supportedCompressions();
+    if (compressions.contains(qSL("xz")) && (archive_read_support_filter_xz(ar) != ARCHIVE_OK))
+        throw ArchiveException(ar, "could not enable XZ support");
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+    if (compressions.contains(qSL("zstd")) && (archive_read_support_filter_zstd(ar) != ARCHIVE_OK))
+        throw ArchiveException(ar, "could not enable ZSTD support");
+#endif
 #if !defined(Q_OS_ANDROID)
-        if (archive_read_set_options(ar, "hdrcharset=UTF-8") != ARCHIVE_OK)
-            throw ArchiveException(ar, "could not set the HDRCHARSET option");
+    if (archive_read_set_options(ar, "hdrcharset=UTF-8") != ARCHIVE_OK)
+        throw ArchiveException(ar, "could not set the HDRCHARSET option");
 #endif
 
-        auto dummyCallback = [](archive *, void *){ return ARCHIVE_OK; };
-        auto readCallback = [](archive *ar, void *user, const void **buffer) { return (__LA_SSIZE_T) reinterpret_cast<PackageExtractorPrivate *>(user)->readTar(ar, buffer); };
+    auto dummyCallback = [](archive *, void *){ return ARCHIVE_OK; };
+    archive_read_callback *readCallback = [](archive *ar, void *user, const void **buffer) { return (__LA_SSIZE_T) reinterpret_cast<PackageExtractorPrivate *>(user)->readTar(ar, buffer); };
+    if (m_localFile.isOpen())
+        readCallback = [](archive *ar, void *user, const void **buffer) { return (__LA_SSIZE_T) reinterpret_cast<PackageExtractorPrivate *>(user)->readLocalFile(ar, buffer); };
+
+    if (archive_read_open(ar, this, dummyCallback, readCallback, dummyCallback) != ARCHIVE_OK)
+        throw ArchiveException(ar, "could not open archive");
+
+    // the writer stage checks this against the header: there is no synchronization needed, since
+    // nothing has been pushed to the write queue yet
+    m_archiveFilterCode = archive_filter_code(ar, 0);
+
+    bool seenHeader = false;
+    bool seenFooter = false;
+    quint64 entryCount = 0; // files and directories
+
+    auto pushToWriter = [this](const WriteItem &item) {
+        if (!m_writeQueue.push(item))
+            throw Exception(Error::Canceled, "canceled");
+    };
+
+    // Iterate over all entries in the archive
+    for (bool finished = false; !finished; ) {
+        archive_entry *entry = nullptr;
+
+        // Try to read the next entry from the archive
+
+        switch (archive_read_next_header(ar, &entry)) {
+        case ARCHIVE_EOF:
+            finished = true;
+            continue;
+        case ARCHIVE_OK:
+            break;
+        default:
+            throw ArchiveException(ar, "could not read header");
+        }
 
-        if (archive_read_open(ar, this, dummyCallback, readCallback, dummyCallback) != ARCHIVE_OK)
-            throw ArchiveException(ar, "could not open archive");
+        // Make sure to quit if we get something funky, i.e. something other than files or dirs
+
+        __LA_MODE_T entryMode = archive_entry_mode(entry);
+        PackageEntryType packageEntryType;
+        QString entryPath = QString::fromWCharArray(archive_entry_pathname_w(entry))
+                .normalized(QString::NormalizationForm_C);
+
+        switch (entryMode & S_IFMT) {
+        case S_IFREG:
+            packageEntryType = PackageEntry_File;
+            break;
+        case S_IFDIR:
+            packageEntryType = PackageEntry_Dir;
+            break;
+        default:
+            throw Exception(Error::Package, "file %1 in the archive has the unsupported type (mode) 0%2").arg(entryPath).arg(int(entryMode & S_IFMT), 0, 8);
+        }
 
-        bool seenHeader = false;
-        bool seenFooter = false;
-        QByteArray header;
-        QByteArray footer;
+        // Check if this entry is special (metadata vs. data)
 
-        QCryptographicHash digest(QCryptographicHash::Sha256);
+        if (entryPath == qL1S("--PACKAGE-HEADER--"))
+            packageEntryType = PackageEntry_Header;
+        else if (entryPath.startsWith(qL1S("--PACKAGE-FOOTER--")))
+            packageEntryType = PackageEntry_Footer;
+        else if (entryPath.startsWith(qL1S("--")))
+            throw Exception(Error::Package, "filename %1 in the archive starts with the reserved characters '--'").arg(entryPath);
 
-        // Iterate over all entries in the archive
-        for (bool finished = false; !finished; ) {
-            archive_entry *entry = nullptr;
-            QFile f;
+        // The first (and only the first) file in every package needs to be --PACKAGE-HEADER--
 
-            // Try to read the next entry from the archive
+        if (seenHeader == (packageEntryType == PackageEntry_Header))
+            throw Exception(Error::Package, "the first (and only the first) file of the package must be --PACKAGE-HEADER--");
 
-            switch (archive_read_next_header(ar, &entry)) {
-            case ARCHIVE_EOF:
-                finished = true;
-                continue;
-            case ARCHIVE_OK:
-                break;
-            default:
-                throw ArchiveException(ar, "could not read header");
-            }
+        // There cannot be and normal files after the first --PACKAGE-FOOTER--
+        if (seenFooter && (packageEntryType != PackageEntry_Footer))
+            throw Exception(Error::Package, "only --PACKAGE-FOOTER--* files are allowed at the end of the package");
 
-            // Make sure to quit if we get something funky, i.e. something other than files or dirs
+        QString destination; // only needed for files and directories
 
-            __LA_MODE_T entryMode = archive_entry_mode(entry);
-            PackageEntryType packageEntryType;
-            QString entryPath = QString::fromWCharArray(archive_entry_pathname_w(entry))
-                    .normalized(QString::NormalizationForm_C);
+        switch (packageEntryType) {
+        case PackageEntry_Dir:
+            if (!entryPath.endsWith(qL1C('/')))
+                throw Exception(Error::Package, "invalid archive entry '%1': directory name is missing '/' at the end").arg(entryPath);
+            entryPath.chop(1);
+            // no break;
+        case PackageEntry_File: {
+            // the destination can only change while we are waiting for the callback below
+            destination = destinationPath();
 
-            switch (entryMode & S_IFMT) {
-            case S_IFREG:
-                packageEntryType = PackageEntry_File;
-                break;
-            case S_IFDIR:
-                packageEntryType = PackageEntry_Dir;
-                break;
-            default:
-                throw Exception(Error::Package, "file %1 in the archive has the unsupported type (mode) 0%2").arg(entryPath).arg(int(entryMode & S_IFMT), 0, 8);
-            }
+            // get the directory, where the new entry will be created
+            QDir entryDir(QString(destination + entryPath).section(qL1C('/'), 0, -2));
+            if (!entryDir.exists())
+                throw Exception(Error::Package, "invalid archive entry '%1': parent directory is missing").arg(entryPath);
 
-            // Check if this entry is special (metadata vs. data)
+            QString entryCanonicalPath = entryDir.canonicalPath() + qL1C('/');
+            QString baseCanonicalPath = QDir(destination).canonicalPath() + qL1C('/');
 
-            if (entryPath == qL1S("--PACKAGE-HEADER--"))
-                packageEntryType = PackageEntry_Header;
-            else if (entryPath.startsWith(qL1S("--PACKAGE-FOOTER--")))
-                packageEntryType = PackageEntry_Footer;
-            else if (entryPath.startsWith(qL1S("--")))
-                throw Exception(Error::Package, "filename %1 in the archive starts with the reserved characters '--'").arg(entryPath);
+            // security check: make sure that entryCanonicalPath is NOT outside of baseCanonicalPath
+            if (!entryCanonicalPath.startsWith(baseCanonicalPath))
+                throw Exception(Error::Package, "invalid archive entry '%1': pointing outside of extraction directory").arg(entryPath);
 
-            // The first (and only the first) file in every package needs to be --PACKAGE-HEADER--
+            // directories need to be created right away: the checks above depend on them
+            if (packageEntryType == PackageEntry_Dir) {
+                QString entryName = entryPath.section(qL1C('/'), -1, -1);
 
-            if (seenHeader == (packageEntryType == PackageEntry_Header))
-                throw Exception(Error::Package, "the first (and only the first) file of the package must be --PACKAGE-HEADER--");
+                if ((entryName != qL1S(".")) && !entryDir.mkdir(entryName))
+                    throw Exception(Error::IO, "could not create directory '%1'").arg(entryDir.filePath(entryName));
 
-            // There cannot be and normal files after the first --PACKAGE-FOOTER--
-            if (seenFooter && (packageEntryType != PackageEntry_Footer))
-                throw Exception(Error::Package, "only --PACKAGE-FOOTER--* files are allowed at the end of the package");
+                archive_read_data_skip(ar);
+            }
+            break;
+        }
+        case PackageEntry_Footer:
+            seenFooter = true;
+            break;
+        case PackageEntry_Header:
+            seenHeader = true;
+            break;
+        default:
+            archive_read_data_skip(ar);
+            continue;
+        }
 
-            switch (packageEntryType) {
-            case PackageEntry_Dir:
-                if (!entryPath.endsWith(qL1C('/')))
-                    throw Exception(Error::Package, "invalid archive entry '%1': directory name is missing '/' at the end").arg(entryPath);
-                entryPath.chop(1);
-                // no break;
-            case PackageEntry_File: {
-                // get the directory, where the new entry will be created
-                QDir entryDir(QString(m_destinationPath + entryPath).section(qL1C('/'), 0, -2));
-                if (!entryDir.exists())
-                    throw Exception(Error::Package, "invalid archive entry '%1': parent directory is missing").arg(entryPath);
-
-                QString entryCanonicalPath = entryDir.canonicalPath() + qL1C('/');
-                QString baseCanonicalPath = QDir(m_destinationPath).canonicalPath() + qL1C('/');
-
-                // security check: make sure that entryCanonicalPath is NOT outside of baseCanonicalPath
-                if (!entryCanonicalPath.startsWith(baseCanonicalPath))
-                    throw Exception(Error::Package, "invalid archive entry '%1': pointing outside of extraction directory").arg(entryPath);
-
-                if (packageEntryType == PackageEntry_Dir) {
-                    QString entryName = entryPath.section(qL1C('/'), -1, -1);
-
-                    if ((entryName != qL1S(".")) && !entryDir.mkdir(entryName))
-                        throw Exception(Error::IO, "could not create directory '%1'").arg(entryDir.filePath(entryName));
-
-                    archive_read_data_skip(ar);
-
-                } else { // PackageEntry_File
-                    f.setFileName(m_destinationPath + entryPath);
-                    if (!f.open(QFile::WriteOnly | QFile::Truncate))
-                        throw Exception(f, "could not create file");
-
-                    if (entryMode & S_IEXEC)
-                        f.setPermissions(f.permissions() | QFile::ExeUser);
+        WriteItem startItem;
+        startItem.type = WriteItem::StartEntry;
+        startItem.entryType = packageEntryType;
+        startItem.path = entryPath;
+        startItem.destinationPath = destination;
+        startItem.size = archive_entry_size(entry);
+        startItem.executable = (entryMode & S_IEXEC);
+        pushToWriter(startItem);
+
+        // Read in the entry's data (which can be a normal file or header/footer metadata)
+
+        if ((packageEntryType != PackageEntry_Dir) && archive_entry_size(entry)) {
+            __LA_INT64_T readPosition = 0;
+            WriteItem dataItem;
+            dataItem.type = WriteItem::Data;
+
+            for (bool fileFinished = false; !fileFinished; ) {
+                const char *buffer;
+                size_t bytesRead;
+                __LA_INT64_T offset;
+
+                switch (archive_read_data_block(ar, reinterpret_cast<const void **>(&buffer), &bytesRead, &offset)) {
+                case ARCHIVE_EOF:
+                    fileFinished = true;
+                    continue;
+                case ARCHIVE_OK:
+                    break;
+                default:
+                    throw ArchiveException(ar, "could not read from archive");
                 }
 
-                m_report.addFile(entryPath);
-                break;
+                if (offset != readPosition)
+                    throw Exception(Error::Package, "[libarchive] current read position (%1) does not match requested offset (%2)").arg(readPosition).arg(offset);
+
+                readPosition += bytesRead;
+
+                // libarchive's buffers are only valid until the next call, so we need to copy
+                // the data anyway: collect it in big chunks to keep the writes efficient
+                if (dataItem.data.isNull())
+                    dataItem.data.reserve(writeChunkSize);
+                dataItem.data.append(buffer, int(bytesRead));
+                if (dataItem.data.size() >= writeChunkSize) {
+                    pushToWriter(dataItem);
+                    dataItem.data = QByteArray();
+                }
             }
-            case PackageEntry_Footer:
-                seenFooter = true;
+            if (!dataItem.data.isEmpty())
+                pushToWriter(dataItem);
+        }
+
+        WriteItem endItem;
+        endItem.type = WriteItem::EndEntry;
+        pushToWriter(endItem);
+
+        // Nothing should be created for packages with an invalid header. The callback may also
+        // switch to a different destination directory: the next entry can only be checked (and
+        // its directory created) after the callback is done with this one.
+        if (packageEntryType == PackageEntry_Header) {
+            if (!waitForHeaderValidation())
+                throw Exception(Error::Canceled, "canceled");
+        } else if ((packageEntryType == PackageEntry_File) || (packageEntryType == PackageEntry_Dir)) {
+            if (!waitForFileExtractedCallback(++entryCount))
+                throw Exception(Error::Canceled, "canceled");
+        }
+    }
+}
+
+// The write stage: writes the files, calculates the digest and post-processes the entries.
+void PackageExtractorPrivate::write()
+{
+    try {
+        writeEntries();
+    } catch (const Exception &e) {
+        if (!q->wasCanceled())
+            setError(e.errorCode(), e.errorString());
+        abortPipeline();
+    }
+
+    QMetaObject::invokeMethod(this, "pipelineFinished", Qt::QueuedConnection);
+}
+
+void PackageExtractorPrivate::writeEntries() Q_DECL_NOEXCEPT_EXPR(false)
+{
+    QByteArray header;
+    QByteArray footer;
+    Sha256Digest digest;
+    QFile f;
+    PackageEntryType packageEntryType = PackageEntry_Header;
+    QString entryPath;
+    QString destination;
+
+    WriteItem item;
+    while (m_writeQueue.pop(&item)) {
+        switch (item.type) {
+        case WriteItem::StartEntry:
+            packageEntryType = PackageEntryType(item.entryType);
+            entryPath = item.path;
+            destination = item.destinationPath;
+
+            if (packageEntryType == PackageEntry_File) {
+                f.setFileName(destination + entryPath);
+                if (!f.open(QFile::WriteOnly | QFile::Truncate))
+                    throw Exception(f, "could not create file");
+
+                if (item.executable)
+                    f.setPermissions(f.permissions() | QFile::ExeUser);
+
+#if defined(Q_OS_LINUX)
+                // reserve the space upfront: this avoids fragmentation and fails early if the
+                // file-system is full
+                if (item.size > 0) {
+                    int result = posix_fallocate(f.handle(), 0, item.size);
+                    if (result == ENOSPC)
+                        throw Exception(Error::IO, "could not create file '%1': %2").arg(f.fileName(), qL1S(strerror(result)));
+                }
+#endif
+            }
+            if ((packageEntryType == PackageEntry_File) || (packageEntryType == PackageEntry_Dir))
+                m_report.addFile(entryPath);
+            break;
+
+        case WriteItem::Data:
+            switch (packageEntryType) {
+            case PackageEntry_File:
+                digest.addData(item.data);
+
+                if (f.write(item.data) != item.data.size())
+                    throw Exception(f, "could not write to file");
                 break;
             case PackageEntry_Header:
-                seenHeader = true;
+                header.append(item.data);
+                break;
+            case PackageEntry_Footer:
+                footer.append(item.data);
                 break;
             default:
-                archive_read_data_skip(ar);
-                continue;
-            }
-
-            // Read in the entry's data (which can be a normal file or header/footer metadata)
-
-            if (archive_entry_size(entry)) {
-                __LA_INT64_T readPosition = 0;
-
-                for (bool fileFinished = false; !fileFinished; ) {
-                    const char *buffer;
-                    size_t bytesRead;
-                    __LA_INT64_T offset;
-
-                    switch (archive_read_data_block(ar, reinterpret_cast<const void **>(&buffer), &bytesRead, &offset)) {
-                    case ARCHIVE_EOF:
-                        fileFinished = true;
-                        continue;
-                    case ARCHIVE_OK:
-                        break;
-                    default:
-                        throw ArchiveException(ar, "could not read from archive");
-                    }
-
-                    if (offset != readPosition)
-                        throw Exception(Error::Package, "[libarchive] current read position (%1) does not match requested offset (%2)").arg(readPosition).arg(offset);
-
-                    readPosition += bytesRead;
-
-                    switch (packageEntryType) {
-                    case PackageEntry_File:
-                        digest.addData(buffer, int(bytesRead));
-
-                        if (!f.write(buffer, bytesRead))
-                            throw Exception(f, "could not write to file");
-                        break;
-                    case PackageEntry_Header:
-                        header.append(buffer, int(bytesRead));
-                        break;
-                    case PackageEntry_Footer:
-                        footer.append(buffer, int(bytesRead));
-                        break;
-                    default:
-                        break;
-                    }
-                }
+                break;
             }
+            break;
 
+        case WriteItem::EndEntry:
             // We finished reading an entry from the archive. Now we need to
             // post-process it, depending on its type
 
             switch (packageEntryType) {
-            case PackageEntry_Header:
+            case PackageEntry_Header: {
                 processMetaData(header, digest, true /*header*/);
+
+                QMutexLocker locker(&m_callbackMutex);
+                m_headerValidated = true;
+                m_callbackCondition.wakeAll();
                 break;
+            }
             case PackageEntry_File:
                 f.close();
                 // no break
             case PackageEntry_Dir: {
                 // Just to be on the safe side, we also add the file's meta-data to the digest
-                PackageUtilities::addFileMetadataToDigest(entryPath, QFileInfo(m_destinationPath + entryPath), digest);
+                PackageUtilities::addFileMetadataToDigest(entryPath, QFileInfo(destination + entryPath), digest);
 
                 // Finally call the user's code to post-process whatever was extracted right now
-                if (m_fileExtractedCallback)
-                    m_fileExtractedCallback(entryPath);
+                fileExtracted(entryPath);
                 break;
             }
             default:
                 break;
             }
+            break;
         }
-
-        // Finished extracting
-
-        // We are only post-processing the footer now, because we allow for multiple --PACKAGE-FOOTER--
-        // files in the archive, so we can only start processing them, when we are sure that there
-        // are no more. This makes it easier for 3rd party tools like e.g. app-stores to add the required
-        // signature metadata
-        processMetaData(footer, digest, false /*footer*/);
-
-        emit q->progress(1);
-
-    } catch (const Exception &e) {
-        if (!q->wasCanceled())
-            setError(e.errorCode(), e.errorString());
+        item.data.clear();
     }
 
-    if (ar)
-        archive_read_free(ar);
+    if (m_writeQueue.isAborted())
+        throw Exception(Error::Canceled, "canceled");
 
-    m_loop.quit();
+    // Finished extracting
+
+    // We are only post-processing the footer now, because we allow for multiple --PACKAGE-FOOTER--
+    // files in the archive, so we can only start processing them, when we are sure that there
+    // are no more. This makes it easier for 3rd party tools like e.g. app-stores to add the required
+    // signature metadata
+    processMetaData(footer, digest, false /*footer*/);
 }
 
-void PackageExtractorPrivate::processMetaData(const QByteArray &metadata, QCryptographicHash &digest,
+void PackageExtractorPrivate::processMetaData(const QByteArray &metadata, Sha256Digest &digest,
                                               bool isHeader) Q_DECL_NOEXCEPT_EXPR(false)
 {
     QtYaml::ParseError error;
@@ -473,6 +789,21 @@ void PackageExtractorPrivate::processMetaData(const QByteArray &metadata, QCrypt
             throw Exception(Error::Package, "metadata has an invalid diskSpaceUsed field (%1)").arg(diskSpaceUsed);
         m_report.setDiskSpaceUsed(diskSpaceUsed);
 
+        // Packages without a compression field are gzip compressed by definition, but we do not
+        // enforce this, since older tools (and our tests) also produced uncompressed packages.
+        m_compression = qSL("gzip");
+        if (map.contains(qSL("compression"))) {
+            QString compression = map.value(qSL("compression")).toString();
+            if (PackageUtilities::archiveFilterCode(compression) != m_archiveFilterCode) {
+                QString actual = PackageUtilities::compressionFromArchiveFilterCode(m_archiveFilterCode);
+                if (actual.isEmpty())
+                    actual = qSL("unknown filter %1").arg(m_archiveFilterCode);
+                throw Exception(Error::Package, "metadata has an invalid compression field (%1), but the package is compressed with %2")
+                    .arg(compression, actual);
+            }
+            m_compression = compression;
+        }
+
         PackageUtilities::addImportantHeaderDataToDigest(map, digest);
 
     } else { // footer(s)
@@ -496,6 +827,8 @@ void PackageExtractorPrivate::processMetaData(const QByteArray &metadata, QCrypt
 
 void PackageExtractorPrivate::setError(Error errorCode, const QString &errorString)
 {
+    // this can be called from any of the pipeline stages
+    QMutexLocker locker(&m_errorMutex);
     m_failed = true;
 
     // only the first error is the one that counts!
@@ -525,18 +858,54 @@ void PackageExtractorPrivate::download(const QUrl &url)
     }
 #endif
 
+    connectReply();
+}
+
+void PackageExtractorPrivate::connectReply()
+{
+    // limit the amount of data buffered in the reply, if the pipeline cannot keep up
+    m_reply->setReadBufferSize(4 * 1024 * 1024);
+
     connect(m_reply, static_cast<void (QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error),
             this, &PackageExtractorPrivate::networkError);
     connect(m_reply, &QNetworkReply::metaDataChanged,
             this, &PackageExtractorPrivate::handleRedirect);
     connect(m_reply, &QNetworkReply::downloadProgress,
             this, &PackageExtractorPrivate::downloadProgressChanged);
+    connect(m_reply, &QIODevice::readyRead,
+            this, &PackageExtractorPrivate::readFromReply);
+    connect(m_reply, &QNetworkReply::finished,
+            this, &PackageExtractorPrivate::readFromReply);
+}
+
+/* \internal
+    Packages on the local file-system (e.g. on USB sticks or in OTA staging areas) are read
+    directly by the decompression stage of the pipeline using large, sequential reads, instead of
+    going through the QNetworkAccessManager and the reading stage.
+*/
+bool PackageExtractorPrivate::openLocalFile(const QUrl &url)
+{
+    if (!url.isLocalFile())
+        return false;
+
+    // FIFOs and other special files need to go through the normal reading stage
+    m_localFile.setFileName(url.toLocalFile());
+    if (!QFileInfo(m_localFile).isFile() || !m_localFile.open(QFile::ReadOnly | QFile::Unbuffered))
+        return false;
+
+#if defined(Q_OS_LINUX)
+    posix_fadvise(m_localFile.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    m_downloadTotal = m_localFile.size();
+    m_localReadBuffer.resize(1024 * 1024);
+    return true;
 }
 
 void PackageExtractorPrivate::networkError(QNetworkReply::NetworkError)
 {
     setError(Error::Network, qobject_cast<QNetworkReply *>(sender())->errorString());
-    QMetaObject::invokeMethod(&m_loop, "quit", Qt::QueuedConnection);
+    // the pipeline stages will stop and the write stage will then quit the event loop
+    abortPipeline();
 }
 
 void PackageExtractorPrivate::handleRedirect()
@@ -548,6 +917,7 @@ void PackageExtractorPrivate::handleRedirect()
         m_reply->deleteLater();
         QNetworkRequest request(url);
         m_reply = m_nam->get(request);
+        connectReply();
     }
 }
 
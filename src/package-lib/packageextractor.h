@@ -71,6 +71,7 @@ public:
     bool extract();
 
     const InstallationReport &installationReport() const;
+    QString compression() const;
 
     bool hasFailed() const;
     bool wasCanceled() const;
@@ -44,16 +44,119 @@
 #include <QObject>
 #include <QNetworkReply>
 #include <QEventLoop>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QThread>
+#include <QFile>
+#include <functional>
 
 #include <archive.h>
 
 #include <QtAppManPackage/packageextractor.h>
 #include <QtAppManApplication/installationreport.h>
 
-QT_FORWARD_DECLARE_CLASS(QCryptographicHash)
-
 QT_BEGIN_NAMESPACE_AM
 
+class Sha256Digest;
+
+// A bounded FIFO for handing over work between the stages of the extraction pipeline
+template <typename T> class PipelineQueue
+{
+public:
+    explicit PipelineQueue(int capacity)
+        : m_capacity(capacity)
+    { }
+
+    void reset()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.clear();
+        m_closed = m_aborted = false;
+    }
+
+    bool isFull() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_queue.size() >= m_capacity;
+    }
+
+    bool isAborted() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_aborted;
+    }
+
+    // blocks while the queue is full; returns false if the queue has been aborted
+    bool push(const T &item)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_aborted && (m_queue.size() >= m_capacity))
+            m_notFull.wait(&m_mutex);
+        if (m_aborted)
+            return false;
+        m_queue.enqueue(item);
+        m_notEmpty.wakeOne();
+        return true;
+    }
+
+    // blocks while the queue is empty; returns false if the queue has been aborted or if it has
+    // been closed and there are no more items
+    bool pop(T *item)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_aborted && !m_closed && m_queue.isEmpty())
+            m_notEmpty.wait(&m_mutex);
+        if (m_aborted || m_queue.isEmpty())
+            return false;
+        *item = m_queue.dequeue();
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    // no more items will be pushed
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_notEmpty.wakeAll();
+    }
+
+    // wakes up and fails all pending and future push() and pop() calls
+    void abort()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_aborted = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<T> m_queue;
+    int m_capacity;
+    bool m_closed = false;
+    bool m_aborted = false;
+};
+
+class PipelineThread : public QThread // clazy:exclude=missing-qobject-macro
+{
+public:
+    PipelineThread(const std::function<void()> &function)
+        : m_function(function)
+    { }
+
+protected:
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
 
 class PackageExtractorPrivate : public QObject
 {
@@ -65,34 +168,90 @@ public:
     Q_INVOKABLE void extract();
 
     void download(const QUrl &url);
+    bool openLocalFile(const QUrl &url);
+
+    // a single step for the writing stage of the pipeline
+    struct WriteItem
+    {
+        enum Type { StartEntry, Data, EndEntry };
+
+        Type type;
+        int entryType = 0; // PackageEntryType
+        QString path;
+        QString destinationPath; // the one the path has been checked against
+        qint64 size = 0;
+        bool executable = false;
+        QByteArray data;
+    };
 
 private slots:
     void networkError(QNetworkReply::NetworkError);
     void handleRedirect();
     void downloadProgressChanged(qint64 downloaded, qint64 total);
+    void readFromReply();
+    void pipelineFinished();
+    void emitProgress(qreal progress);
 
 private:
+    void connectReply();
     void setError(Error errorCode, const QString &errorString);
+    void abortPipeline();
     qint64 readTar(struct archive *ar, const void **archiveBuffer);
-    void processMetaData(const QByteArray &metadata, QCryptographicHash &digest, bool isHeader) Q_DECL_NOEXCEPT_EXPR(false);
+    qint64 readLocalFile(struct archive *ar, const void **archiveBuffer);
+    void decompress();
+    void decompressEntries(struct archive *ar) Q_DECL_NOEXCEPT_EXPR(false);
+    void write();
+    void writeEntries() Q_DECL_NOEXCEPT_EXPR(false);
+    void processMetaData(const QByteArray &metadata, Sha256Digest &digest, bool isHeader) Q_DECL_NOEXCEPT_EXPR(false);
+    QString destinationPath() const;
+    bool waitForFileExtractedCallback(quint64 entryCount);
+    bool waitForHeaderValidation();
+    void fileExtracted(const QString &entryPath) Q_DECL_NOEXCEPT_EXPR(false);
 
 private:
     PackageExtractor *q;
 
     QUrl m_url;
+
+    // The file-extracted callback runs in the write stage and is allowed to change the destination
+    // directory. As long as there is a callback, the decompression stage waits for it after each
+    // file and directory, so it never resolves paths against an outdated destination.
+    // It also waits for the header to be validated, before it creates any directories.
+    mutable QMutex m_callbackMutex;
+    QWaitCondition m_callbackCondition;
     QString m_destinationPath;
     std::function<void(const QString &)> m_fileExtractedCallback;
+    quint64 m_extractedEntryCount = 0; // files and directories that went through the callback
+    bool m_headerValidated = false;
+
     bool m_failed = false;
     QAtomicInt m_canceled;
     Error m_errorCode = Error::None;
     QString m_errorString;
+    QMutex m_errorMutex;
 
     QEventLoop m_loop;
     QNetworkAccessManager *m_nam;
     QNetworkReply *m_reply = nullptr;
     bool m_downloadingFromFIFO = false;
-    QByteArray m_buffer;
     InstallationReport m_report;
+    QString m_compression;
+    int m_archiveFilterCode = -1; // set by the decompression stage, before the header is processed
+
+    // local packages are read directly by the decompression stage, bypassing the network stack
+    QFile m_localFile;
+    QByteArray m_localReadBuffer;
+
+    // The extraction is a pipeline of three stages, each one running in its own thread:
+    //   reading (network or file) -> decompressing and parsing the archive -> hashing and writing
+    // The stages are connected via bounded queues, so the memory usage is limited and the
+    // throughput is determined by the slowest stage.
+    PipelineQueue<QByteArray> m_readQueue;
+    PipelineQueue<WriteItem> m_writeQueue;
+    QAtomicInt m_readerThrottled;
+    QByteArray m_currentReadChunk;
+    PipelineThread *m_decompressThread = nullptr;
+    PipelineThread *m_writeThread = nullptr;
 
     qint64 m_downloadTotal = 0;
     qint64 m_bytesReadTotal = 0;
@@ -138,6 +138,7 @@ int main(int argc, char *argv[])
     case CreatePackage:
         clp.addOption({ qSL("verbose"), qSL("Dump the package's meta-data header and footer information to stdout.") });
         clp.addOption({ qSL("json"),    qSL("Output in JSON format instead of YAML.") });
+        clp.addOption({ qSL("compression"), qSL("The compression filter: gzip (default), xz or zstd."), qSL("filter"), qSL("gzip") });
         clp.addPositionalArgument(qSL("package"),          qSL("The file name of the created package."));
         clp.addPositionalArgument(qSL("source-directory"), qSL("The package's content root directory."));
         clp.process(a);
@@ -147,7 +148,8 @@ int main(int argc, char *argv[])
 
         p = PackagingJob::create(clp.positionalArguments().at(1),
                                  clp.positionalArguments().at(2),
-                                 clp.isSet(qSL("json")));
+                                 clp.isSet(qSL("json")),
+                                 clp.value(qSL("compression")));
         break;
 
     case DevSignPackage:
@@ -55,13 +55,15 @@ QT_USE_NAMESPACE_AM
 static const int Ext2BlockSize = 1024;
 
 
-PackagingJob *PackagingJob::create(const QString &destinationName, const QString &sourceDir, bool asJson)
+PackagingJob *PackagingJob::create(const QString &destinationName, const QString &sourceDir, bool asJson,
+                                   const QString &compression)
 {
     PackagingJob *p = new PackagingJob();
     p->m_mode = Create;
     p->m_asJson = asJson;
     p->m_destinationName = destinationName;
     p->m_sourceDir = sourceDir;
+    p->m_compression = compression;
     return p;
 }
 
@@ -196,6 +198,7 @@ void PackagingJob::execute() Q_DECL_NOEXCEPT_EXPR(false)
 
         // finally create the package
         PackageCreator creator(source, &destination, report);
+        creator.setCompression(m_compression);
         if (!creator.create())
             throw Exception(Error::Package, "could not create package %1: %2").arg(app->id()).arg(creator.errorString());
 
@@ -275,6 +278,7 @@ void PackagingJob::execute() Q_DECL_NOEXCEPT_EXPR(false)
             throw Exception(destination, "could not create package file");
 
         PackageCreator creator(tmp.path(), &destination, report);
+        creator.setCompression(extractor.compression());
 
         if (certificates.size() != 1)
             throw Exception(Error::Package, "cannot sign packages with more than one certificate");
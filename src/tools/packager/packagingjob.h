@@ -35,7 +35,8 @@
 class PackagingJob
 {
 public:
-    static PackagingJob *create(const QString &destinationName, const QString &sourceDir, bool asJson = false);
+    static PackagingJob *create(const QString &destinationName, const QString &sourceDir, bool asJson = false,
+                                const QString &compression = QString());
 
     static PackagingJob *developerSign(const QString &sourceName, const QString &destinationName,
                                        const QString &certificateFile, const QString &passPhrase,
@@ -72,6 +73,7 @@ private:
     QString m_sourceName;
     QString m_destinationName; // create and signing only
     QString m_sourceDir; // create only
+    QString m_compression; // create only (signing keeps the compression of the source package)
     QStringList m_certificateFiles;
     QString m_passphrase;  // sign only
     QString m_hardwareId; // store sign/verify only
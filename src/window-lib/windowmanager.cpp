@@ -65,6 +65,7 @@
 #include "waylandwindow.h"
 #include "inprocesswindow.h"
 #include "qml-utilities.h"
+#include "utilities.h"
 
 
 /*!
@@ -624,7 +625,7 @@ void WindowManager::registerCompositorView(QQuickWindow *view)
         if (!d->waylandCompositor) {
             d->waylandCompositor = new WaylandCompositor(view, d->waylandSocketName, this);
             // export the actual socket name for our child processes.
-            qputenv("WAYLAND_DISPLAY", d->waylandCompositor->socketName());
+            setProcessEnvironmentVariable("WAYLAND_DISPLAY", d->waylandCompositor->socketName());
             qCDebug(LogWayland).nospace() << "WindowManager: running in Wayland mode [socket: "
                                           << d->waylandCompositor->socketName() << "]";
         } else {
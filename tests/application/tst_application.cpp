@@ -32,6 +32,8 @@
 #include "global.h"
 #include "application.h"
 #include "applicationdatabase.h"
+#include "installationreport.h"
+#include "applicationmanifestcache.h"
 #include "yamlapplicationscanner.h"
 #include "exception.h"
 
@@ -48,6 +50,7 @@ private slots:
     void initTestCase();
     void cleanupTestCase();
     void database();
+    void manifestCache();
     void application_data();
     void application();
     void validApplicationId_data();
@@ -98,6 +101,12 @@ void tst_Application::database()
         QVERIFY(!adb.isValid());
     }
 
+    InstallationReport *report = new InstallationReport(apps.at(0)->id());
+    report->setInstallationLocationId(qSL("internal-0"));
+    report->setDigest("digest");
+    report->addFiles({ qSL("info.yaml"), qSL("icon.png") });
+    const_cast<Application *>(apps.at(0))->setInstallationReport(report);
+
     {
         ApplicationDatabase adb(tmpDbPath);
         QVERIFY(adb.isValid());
@@ -122,12 +131,103 @@ void tst_Application::database()
         try {
             QVector<const Application *> appsInDb = adb.read();
             QCOMPARE(appsInDb.size(), apps.size());
+            for (int i = 0; i < apps.size(); ++i)
+                QCOMPARE(appsInDb.at(i)->id(), apps.at(i)->id());
+
+            // the installation report is deserialized lazily from the mapped database
+            const InstallationReport *reportInDb = appsInDb.at(0)->installationReport();
+            QVERIFY(reportInDb);
+            QCOMPARE(reportInDb->applicationId(), apps.at(0)->id());
+            QCOMPARE(reportInDb->installationLocationId(), qSL("internal-0"));
+            QCOMPARE(reportInDb->digest(), QByteArray("digest"));
+            QCOMPARE(reportInDb->files(), report->files());
+            QVERIFY(!appsInDb.at(1)->installationReport());
+
+            // writing and re-reading must not invalidate the mapping of the reports
+            adb.write(appsInDb);
+            QVector<const Application *> appsInDb2 = adb.read();
+            QCOMPARE(appsInDb2.size(), apps.size());
             qDeleteAll(appsInDb);
+            QVERIFY(appsInDb2.at(0)->installationReport());
+            QCOMPARE(appsInDb2.at(0)->installationReport()->files(), report->files());
+            qDeleteAll(appsInDb2);
         } catch (Exception &e) {
             QVERIFY2(false, e.what());
         }
     }
 
+    {
+        // incremental updates are appended to the journal and replayed on read
+        ApplicationDatabase adb(tmpDbPath);
+        QVERIFY(adb.isValid());
+
+        try {
+            QVector<const Application *> appsInDb = adb.read();
+            QCOMPARE(appsInDb.size(), apps.size());
+            qint64 dbSize = QFileInfo(tmpDbPath).size();
+
+            const QString removedId = appsInDb.at(1)->id();
+            QVector<const Application *> remainingApps { appsInDb.at(0) };
+            adb.remove(removedId, remainingApps);
+            adb.update(appsInDb.at(0), remainingApps);
+            QCOMPARE(QFileInfo(tmpDbPath).size(), dbSize);
+            QVERIFY(QFile::exists(tmpDbPath + qSL(".journal")));
+            qDeleteAll(appsInDb);
+
+            appsInDb = adb.read();
+            QCOMPARE(appsInDb.size(), 1);
+            QCOMPARE(appsInDb.at(0)->id(), apps.at(0)->id());
+            QVERIFY(appsInDb.at(0)->installationReport());
+            QCOMPARE(appsInDb.at(0)->installationReport()->files(), report->files());
+
+            // a complete write compacts the journal into the database
+            adb.write(appsInDb);
+            QVERIFY(!QFile::exists(tmpDbPath + qSL(".journal")));
+            qDeleteAll(appsInDb);
+
+            appsInDb = adb.read();
+            QCOMPARE(appsInDb.size(), 1);
+            adb.write(apps); // restore the original state for the tests below
+            qDeleteAll(appsInDb);
+        } catch (Exception &e) {
+            QVERIFY2(false, e.what());
+        }
+    }
+
+    {
+        // databases in the old, header-less format or with a different format version cannot be
+        // read: they need to be recreated from the manifests
+        QFile legacy(tmpDbPath);
+        QVERIFY(legacy.open(QFile::WriteOnly | QFile::Truncate));
+        QDataStream ds(&legacy);
+        ds << apps.at(0)->id() << apps.at(0)->uniqueNumber();
+        legacy.close();
+
+        ApplicationDatabase adb(tmpDbPath);
+        QVERIFY(adb.isValid());
+        QVERIFY(adb.isOutdated());
+        try {
+            adb.read();
+            QVERIFY(false);
+        } catch (const Exception &) {
+        }
+
+        try {
+            adb.write(apps);
+        } catch (const Exception &e) {
+            QVERIFY2(false, e.what());
+        }
+        QVERIFY(!adb.isOutdated());
+
+        // the format version directly follows the 8 byte magic
+        QVERIFY(legacy.open(QFile::ReadWrite));
+        QVERIFY(legacy.seek(8));
+        const quint32 otherVersion = 0xffffffff;
+        QCOMPARE(legacy.write(reinterpret_cast<const char *>(&otherVersion), sizeof(otherVersion)), qint64(sizeof(otherVersion)));
+        legacy.close();
+        QVERIFY(adb.isOutdated());
+    }
+
     {
 #if defined(Q_OS_WIN)
         QString nullDb(qSL("\\\\.\\NUL"));
@@ -157,6 +257,40 @@ void tst_Application::database()
     }*/
 
 }
+
+void tst_Application::manifestCache()
+{
+    QTemporaryDir tmpDir;
+    QVERIFY(tmpDir.isValid());
+    const QString cachePath = tmpDir.path() + qSL("/manifest.cache");
+
+    for (int pass = 0; pass < 2; ++pass) {
+        ApplicationManifestCache cache(cachePath);
+        QCOMPARE(cache.load(), pass > 0);
+
+        YamlApplicationScanner scanner;
+        scanner.setCache(&cache);
+
+        for (const Application *app : qAsConst(apps)) {
+            try {
+                const QString manifestPath = QDir(app->manifestDir()).absoluteFilePath(qSL("info.yaml"));
+                QScopedPointer<Application> scannedApp(scanner.scan(manifestPath));
+                QVERIFY(scannedApp);
+                QCOMPARE(scannedApp->id(), app->id());
+                QCOMPARE(scannedApp->names(), app->names());
+                QCOMPARE(scannedApp->codeDir(), app->codeDir());
+                QVERIFY(scannedApp->uniqueNumber() != app->uniqueNumber());
+            } catch (const std::exception &e) {
+                QFAIL(e.what());
+            }
+        }
+        // the first pass has to parse all manifests, the second one can use the cache
+        QCOMPARE(cache.hits(), pass ? apps.size() : 0);
+        QCOMPARE(cache.misses(), pass ? 0 : apps.size());
+        QVERIFY(cache.save());
+    }
+}
+
 void tst_Application::application_data()
 {
     QTest::addColumn<QString>("id");
@@ -107,6 +107,8 @@ private slots:
     void cancelPackageInstallation_data();
     void cancelPackageInstallation();
 
+    void concurrentInstallations();
+
     void validateDnsName_data();
     void validateDnsName();
 
@@ -935,6 +937,90 @@ void tst_ApplicationInstaller::cancelPackageInstallation()
     }
 }
 
+void tst_ApplicationInstaller::concurrentInstallations()
+{
+    AllowUnsignedInstallation allow(true);
+    m_ai->setMaximumConcurrentTasks(3);
+
+    QString packageDir = AM_TESTDATA_DIR "packages/";
+
+    // the first two tasks are for the same application and have to be serialized, while the big
+    // package is independent and can be installed in parallel
+    QStringList taskIds;
+    for (const char *package : { "test.appkg", "test-update.appkg", "bigtest.appkg" }) {
+        QString taskId = m_ai->startPackageInstallation("internal-0", QUrl::fromLocalFile(packageDir + package));
+        QVERIFY(!taskId.isEmpty());
+        m_ai->acknowledgePackageInstallation(taskId);
+        taskIds << taskId;
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(m_finishedSpy->count(), 3, 3 * spyTimeout);
+    QVERIFY(m_failedSpy->isEmpty());
+
+    QStringList finishedIds;
+    for (int i = 0; i < m_finishedSpy->count(); ++i)
+        finishedIds << m_finishedSpy->at(i).at(0).toString();
+    QVERIFY(finishedIds.indexOf(taskIds.at(0)) < finishedIds.indexOf(taskIds.at(1)));
+
+    // the update has to win, since it was started last
+    QFile f(pathTo(Internal0, "com.pelagicore.test/test"));
+    QVERIFY(f.open(QFile::ReadOnly));
+    QCOMPARE(f.readAll(), QByteArray("test update\n"));
+    f.close();
+
+    // a task waiting for another task handling the same application can still be canceled
+    clearSignalSpies();
+    QString blockingTaskId = m_ai->startPackageInstallation("internal-0", QUrl::fromLocalFile(packageDir + "test.appkg"));
+    QString waitingTaskId = m_ai->startPackageInstallation("internal-0", QUrl::fromLocalFile(packageDir + "test-update.appkg"));
+    QVERIFY(m_blockingUntilInstallationAcknowledgeSpy->wait(spyTimeout));
+    QCOMPARE(m_blockingUntilInstallationAcknowledgeSpy->first()[0].toString(), blockingTaskId);
+    QTRY_COMPARE(m_startedSpy->count(), 2);
+
+    QVERIFY(m_ai->cancelTask(waitingTaskId));
+    QVERIFY(m_failedSpy->wait(spyTimeout));
+    QCOMPARE(m_failedSpy->first()[0].toString(), waitingTaskId);
+    QCOMPARE(m_failedSpy->first()[1].toInt(), int(Error::Canceled));
+
+    m_ai->acknowledgePackageInstallation(blockingTaskId);
+    QVERIFY(m_finishedSpy->wait(spyTimeout));
+    QCOMPARE(m_finishedSpy->first()[0].toString(), blockingTaskId);
+
+    // a deinstallation that is queued behind a running installation of the same application has
+    // to be processed before an installation that was queued after it, even though the latter
+    // can already be started
+    clearSignalSpies();
+    taskIds.clear();
+    taskIds << m_ai->startPackageInstallation("internal-0", QUrl::fromLocalFile(packageDir + "test-update.appkg"));
+    QVERIFY(m_blockingUntilInstallationAcknowledgeSpy->wait(spyTimeout));
+    taskIds << m_ai->removePackage("com.pelagicore.test", false);
+    taskIds << m_ai->startPackageInstallation("internal-0", QUrl::fromLocalFile(packageDir + "test.appkg"));
+    QVERIFY(!taskIds.contains(QString()));
+    m_ai->acknowledgePackageInstallation(taskIds.at(2));
+    QTRY_COMPARE(m_startedSpy->count(), 2);
+    m_ai->acknowledgePackageInstallation(taskIds.at(0));
+
+    QTRY_COMPARE_WITH_TIMEOUT(m_finishedSpy->count(), 3, 3 * spyTimeout);
+    QVERIFY(m_failedSpy->isEmpty());
+
+    finishedIds.clear();
+    for (int i = 0; i < m_finishedSpy->count(); ++i)
+        finishedIds << m_finishedSpy->at(i).at(0).toString();
+    QCOMPARE(finishedIds, taskIds);
+
+    QVERIFY(f.open(QFile::ReadOnly));
+    QCOMPARE(f.readAll(), QByteArray("test\n"));
+    f.close();
+
+    // remove both applications in parallel
+    clearSignalSpies();
+    QVERIFY(!m_ai->removePackage("com.pelagicore.test", false).isEmpty());
+    QVERIFY(!m_ai->removePackage("com.pelagicore.test.bigtest", false).isEmpty());
+    QTRY_COMPARE_WITH_TIMEOUT(m_finishedSpy->count(), 2, 2 * spyTimeout);
+    QVERIFY(m_failedSpy->isEmpty());
+
+    m_ai->setMaximumConcurrentTasks(1);
+}
+
 
 static tst_ApplicationInstaller *tstApplicationInstaller = nullptr;
 
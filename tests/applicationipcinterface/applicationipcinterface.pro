@@ -0,0 +1,10 @@
+TARGET = tst_applicationipcinterface
+
+include($$PWD/../tests.pri)
+
+QT *= dbus
+QT *= \
+    appman_common-private \
+    appman_manager-private \
+
+SOURCES += tst_applicationipcinterface.cpp
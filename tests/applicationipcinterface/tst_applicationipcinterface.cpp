@@ -0,0 +1,706 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtCore>
+#include <QtTest>
+#include <QDBusServer>
+#include <QDBusConnection>
+#include <QDBusUnixFileDescriptor>
+
+#include "global.h"
+#include "applicationipcinterface_p.h"
+#include "sharedmemoryring.h"
+#include "exception.h"
+
+QT_USE_NAMESPACE_AM
+
+static const char *interfaceName = "io.qt.test.ipc";
+static const char *pathName = "/Test";
+static const char *streamPathName = "/Stream";
+
+
+class IpcTestObject : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int value READ value WRITE setValue NOTIFY valueChanged)
+    Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
+
+public:
+    int value() const { return m_value; }
+    void setValue(int value)
+    {
+        if (value != m_value) {
+            m_value = value;
+            emit valueChanged();
+        }
+    }
+
+    QString text() const { return m_text; }
+    void setText(const QString &text)
+    {
+        if (text != m_text) {
+            m_text = text;
+            emit textChanged();
+        }
+    }
+
+public slots:
+    int add(int a, int b) { return a + b; }
+    QVariant echo(const QVariant &v) { return v; }
+    void reset() { setValue(0); }
+
+signals:
+    void valueChanged();
+    void textChanged();
+    void ping(int serial);
+
+private:
+    int m_value = 0;
+    QString m_text;
+};
+
+class IpcTestClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    IpcTestClient(const QDBusConnection &connection)
+        : m_connection(connection)
+    {
+        m_connection.connect(QString(), qL1S(pathName), qSL("org.freedesktop.DBus.Properties"),
+                             qSL("PropertiesChanged"),
+                             this, SLOT(onPropertiesChanged(QString,QVariantMap,QStringList)));
+        m_connection.connect(QString(), qL1S(pathName), qL1S(interfaceName), qSL("ping"),
+                             this, SLOT(onPing(int)));
+    }
+
+    QDBusConnection connection() const
+    {
+        return m_connection;
+    }
+
+    QDBusMessage call(const QString &method, const QVariantList &args = QVariantList(),
+                      const QString &interface = qL1S(interfaceName))
+    {
+        QDBusMessage message = QDBusMessage::createMethodCall(QString(), qL1S(pathName), interface, method);
+        message.setArguments(args);
+        // the server lives in the same thread, so we have to keep the event loop running
+        return m_connection.call(message, QDBus::BlockWithGui);
+    }
+
+    void reset()
+    {
+        messageCount = 0;
+        events.clear();
+    }
+
+    int messageCount = 0;
+    QStringList events;
+    QVariantMap values;
+
+private slots:
+    void onPropertiesChanged(const QString &interface, const QVariantMap &changed, const QStringList &invalidated)
+    {
+        Q_UNUSED(interface)
+        Q_UNUSED(invalidated)
+
+        ++messageCount;
+        QStringList event;
+        for (auto it = changed.cbegin(); it != changed.cend(); ++it) {
+            values.insert(it.key(), it.value());
+            event << it.key() + qL1C('=') + it.value().toString();
+        }
+        events << event.join(qL1C(','));
+    }
+
+    void onPing(int serial)
+    {
+        ++messageCount;
+        events << qSL("ping=%1").arg(serial);
+    }
+
+private:
+    QDBusConnection m_connection;
+};
+
+// a high-frequency signal, that can be sent via shared memory and an identical one that cannot,
+// plus a method and a property that can be called and set by the client via shared memory
+class IpcStreamObject : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString _transport_sample READ sharedMemoryTransport CONSTANT)
+    Q_PROPERTY(QString _transport_feed READ sharedMemoryTransport CONSTANT)
+    Q_PROPERTY(QString _transport_gain READ sharedMemoryTransport CONSTANT)
+    Q_PROPERTY(double gain READ gain WRITE setGain)
+
+public:
+    QString sharedMemoryTransport() const { return qSL("shared-memory"); }
+
+    double gain() const { return m_gain; }
+    void setGain(double gain) { m_gain = gain; }
+
+    void reset()
+    {
+        fedCount = lastFedSerial = 0;
+        fedInOrder = true;
+    }
+
+    int fedCount = 0;
+    int lastFedSerial = 0;
+    bool fedInOrder = true;
+
+public slots:
+    void feed(double value, int serial)
+    {
+        if ((serial != lastFedSerial + 1) || (value != serial / 2.))
+            fedInOrder = false;
+        lastFedSerial = serial;
+        ++fedCount;
+    }
+
+signals:
+    void sample(double value, int serial);
+    void dbusSample(double value, int serial);
+
+private:
+    double m_gain = 1;
+};
+
+class IpcStreamClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    IpcStreamClient(const QDBusConnection &connection)
+        : m_connection(connection)
+    {
+        m_connection.connect(QString(), qL1S(streamPathName), qL1S(interfaceName), qSL("sample"),
+                             this, SLOT(onDBusSample(double,int)));
+        m_connection.connect(QString(), qL1S(streamPathName), qL1S(interfaceName), qSL("dbusSample"),
+                             this, SLOT(onDBusSample(double,int)));
+    }
+
+    QStringList openSharedMemoryTransport(QStringList *inputMembers)
+    {
+        QDBusMessage message = QDBusMessage::createMethodCall(QString(), qL1S(streamPathName),
+                                                              qSL("io.qt.ApplicationManager.SharedMemoryTransport"),
+                                                              qSL("Open"));
+        QDBusMessage reply = m_connection.call(message, QDBus::BlockWithGui);
+        if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().size() != 8)
+            return QStringList();
+
+        auto fd = [&reply](int i) { return reply.arguments().at(i).value<QDBusUnixFileDescriptor>().fileDescriptor(); };
+        try {
+            delete m_ring;
+            delete m_inputRing;
+            m_ring = SharedMemoryRing::attach(SharedMemoryRing::Consumer, fd(0), fd(1), fd(2), this);
+            m_inputRing = SharedMemoryRing::attach(SharedMemoryRing::Producer, fd(3), fd(4), fd(5), this);
+        } catch (const Exception &e) {
+            qWarning() << e.errorString();
+            return QStringList();
+        }
+        connect(m_ring, &SharedMemoryRing::readyRead, this, &IpcStreamClient::onReadyRead);
+        *inputMembers = reply.arguments().at(7).toStringList();
+        return reply.arguments().at(6).toStringList();
+    }
+
+    // returns false, if the ring buffer is full
+    bool send(int member, const QVariantList &arguments)
+    {
+        return m_inputRing->write(SharedMemoryRing::encodeMessage(member, arguments));
+    }
+
+    bool sendRaw(const QByteArray &message)
+    {
+        return m_inputRing->write(message);
+    }
+
+    void notify()
+    {
+        m_inputRing->notify();
+    }
+
+    void reset()
+    {
+        dbusCount = sharedMemoryCount = 0;
+        lastSerial = 0;
+        inOrder = true;
+    }
+
+    int count() const { return dbusCount + sharedMemoryCount; }
+
+    int dbusCount = 0;
+    int sharedMemoryCount = 0;
+    int lastSerial = 0;
+    bool inOrder = true;
+
+private slots:
+    void onDBusSample(double value, int serial)
+    {
+        ++dbusCount;
+        received(value, serial);
+    }
+
+    void onReadyRead()
+    {
+        QByteArray data;
+        while (m_ring->read(&data)) {
+            int member;
+            QVariantList arguments;
+            if (SharedMemoryRing::decodeMessage(data, &member, &arguments) && (member == 0)
+                    && (arguments.size() == 2)) {
+                ++sharedMemoryCount;
+                received(arguments.at(0).toDouble(), arguments.at(1).toInt());
+            }
+        }
+    }
+
+private:
+    void received(double value, int serial)
+    {
+        if ((serial != lastSerial + 1) || (value != serial / 2.))
+            inOrder = false;
+        lastSerial = serial;
+    }
+
+    QDBusConnection m_connection;
+    SharedMemoryRing *m_ring = nullptr;
+    SharedMemoryRing *m_inputRing = nullptr;
+};
+
+
+class tst_ApplicationIPCInterface : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_ApplicationIPCInterface();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanupTestCase();
+
+    void coalescePropertyChanges();
+    void keepSignalOrder();
+    void receiverFilter();
+    void callMethods();
+    void properties();
+    void sharedMemoryTransport();
+    void benchmarkPropertyChanges();
+    void benchmarkMethodCalls();
+    void benchmarkStreaming_data();
+    void benchmarkStreaming();
+    void benchmarkStreamingLatency_data();
+    void benchmarkStreamingLatency();
+
+private:
+    bool waitForValue(int value, int timeout = 10000);
+    void emitSamples(bool viaDBus, int count);
+
+    static const int ClientCount = 20;
+    static const int ChangeCount = 10000;
+
+    IpcTestObject m_object;
+    IpcProxyObject *m_proxy = nullptr;
+    QDBusServer *m_server = nullptr;
+    QVector<QDBusConnection> m_serverConnections;
+    QVector<IpcTestClient *> m_clients;
+
+    IpcStreamObject m_streamObject;
+    IpcProxyObject *m_streamProxy = nullptr;
+    IpcStreamClient *m_streamClient = nullptr;
+    bool m_sharedMemoryOpened = false;
+};
+
+tst_ApplicationIPCInterface::tst_ApplicationIPCInterface()
+{ }
+
+void tst_ApplicationIPCInterface::initTestCase()
+{
+    m_proxy = new IpcProxyObject(&m_object, QString(), qL1S(pathName), qL1S(interfaceName), QVariantMap());
+    m_streamProxy = new IpcProxyObject(&m_streamObject, QString(), qL1S(streamPathName), qL1S(interfaceName), QVariantMap());
+
+    m_server = new QDBusServer(this);
+    QVERIFY(m_server->isConnected());
+    connect(m_server, &QDBusServer::newConnection, this, [this](const QDBusConnection &connection) {
+        // the stream client connects last and gets its own object
+        bool isStreamClient = (m_serverConnections.size() == ClientCount);
+        m_serverConnections << connection;
+        QVERIFY((isStreamClient ? m_streamProxy : m_proxy)->dbusRegister(nullptr, connection));
+    });
+
+    for (int i = 0; i < ClientCount; ++i) {
+        QDBusConnection connection = QDBusConnection::connectToPeer(m_server->address(), qSL("client%1").arg(i));
+        QVERIFY2(connection.isConnected(), qPrintable(connection.lastError().message()));
+        m_clients << new IpcTestClient(connection);
+    }
+    QTRY_COMPARE(m_serverConnections.size(), int(ClientCount));
+
+    QDBusConnection connection = QDBusConnection::connectToPeer(m_server->address(), qSL("stream"));
+    QVERIFY2(connection.isConnected(), qPrintable(connection.lastError().message()));
+    m_streamClient = new IpcStreamClient(connection);
+    QTRY_COMPARE(m_serverConnections.size(), int(ClientCount) + 1);
+}
+
+void tst_ApplicationIPCInterface::init()
+{
+    // make sure nothing is left over from the last test function
+    QTest::qWait(10);
+    for (IpcTestClient *client : qAsConst(m_clients))
+        client->reset();
+    m_streamClient->reset();
+}
+
+void tst_ApplicationIPCInterface::cleanupTestCase()
+{
+    qDeleteAll(m_clients);
+    m_clients.clear();
+    delete m_streamClient;
+    for (int i = 0; i < ClientCount; ++i)
+        QDBusConnection::disconnectFromPeer(qSL("client%1").arg(i));
+    QDBusConnection::disconnectFromPeer(qSL("stream"));
+    for (const QDBusConnection &connection : qAsConst(m_serverConnections)) {
+        m_proxy->dbusUnregister(connection);
+        m_streamProxy->dbusUnregister(connection);
+    }
+    delete m_streamProxy;
+    delete m_proxy;
+    delete m_server;
+}
+
+bool tst_ApplicationIPCInterface::waitForValue(int value, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for (IpcTestClient *client : qAsConst(m_clients)) {
+        while (client->values.value(qSL("value")).toInt() != value) {
+            if (timer.hasExpired(timeout))
+                return false;
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+    }
+    return true;
+}
+
+void tst_ApplicationIPCInterface::emitSamples(bool viaDBus, int count)
+{
+    for (int serial = 1; serial <= count; ++serial) {
+        if (viaDBus)
+            emit m_streamObject.dbusSample(serial / 2., serial);
+        else
+            emit m_streamObject.sample(serial / 2., serial);
+    }
+}
+
+void tst_ApplicationIPCInterface::coalescePropertyChanges()
+{
+    for (int i = 1; i <= 100; ++i) {
+        m_object.setValue(m_object.value() + 1);
+        m_object.setText(QString::number(i));
+    }
+    int expectedValue = m_object.value();
+
+    QVERIFY(waitForValue(expectedValue));
+    QTest::qWait(10);
+
+    for (IpcTestClient *client : qAsConst(m_clients)) {
+        QCOMPARE(client->messageCount, 1);
+        QCOMPARE(client->values.value(qSL("text")).toString(), qSL("100"));
+    }
+}
+
+void tst_ApplicationIPCInterface::keepSignalOrder()
+{
+    int first = m_object.value() + 1;
+    int second = m_object.value() + 2;
+
+    m_object.setValue(first);
+    emit m_object.ping(1);
+    m_object.setValue(second);
+    emit m_object.ping(2);
+
+    const QStringList expected = {
+        qSL("value=%1").arg(first), qSL("ping=1"), qSL("value=%1").arg(second), qSL("ping=2")
+    };
+    for (IpcTestClient *client : qAsConst(m_clients))
+        QTRY_COMPARE(client->events, expected);
+}
+
+void tst_ApplicationIPCInterface::receiverFilter()
+{
+    // all connections are registered without an application, so a receiver filter must block
+    // the signal for all of them
+    ApplicationIPCInterfaceAttached attached(&m_object);
+    attached.setReceivers(QStringList(qSL("io.qt.test.nobody")));
+    emit m_object.ping(42);
+    QVERIFY(attached.receivers().toStringList().isEmpty());
+
+    emit m_object.ping(43);
+    for (IpcTestClient *client : qAsConst(m_clients))
+        QTRY_COMPARE(client->events, QStringList(qSL("ping=43")));
+}
+
+void tst_ApplicationIPCInterface::callMethods()
+{
+    IpcTestClient *client = m_clients.first();
+
+    QDBusMessage reply = client->call(qSL("add"), { 20, 22 });
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(reply.arguments().value(0).toInt(), 42);
+
+    reply = client->call(qSL("echo"), { QVariant::fromValue(QDBusVariant(qSL("foo"))) });
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(reply.arguments().value(0).toString(), qSL("foo"));
+
+    m_object.setValue(1);
+    reply = client->call(qSL("reset"));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QVERIFY(reply.arguments().isEmpty());
+    QCOMPARE(m_object.value(), 0);
+    // the property change has to arrive before the reply
+    QCOMPARE(client->values.value(qSL("value")).toInt(), 0);
+
+    // wrong arity, wrong types and unknown methods
+    QCOMPARE(client->call(qSL("add"), { 1 }).type(), QDBusMessage::ErrorMessage);
+    QCOMPARE(client->call(qSL("add"), { 1, qSL("2") }).type(), QDBusMessage::ErrorMessage);
+    QCOMPARE(client->call(qSL("setValue"), { 1 }).type(), QDBusMessage::ErrorMessage);
+}
+
+void tst_ApplicationIPCInterface::properties()
+{
+    static const QString propertiesInterface = qSL("org.freedesktop.DBus.Properties");
+    IpcTestClient *client = m_clients.first();
+
+    m_object.setValue(7);
+    m_object.setText(qSL("seven"));
+
+    QDBusMessage reply = client->call(qSL("Get"), { qL1S(interfaceName), qSL("value") }, propertiesInterface);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(reply.arguments().value(0).value<QDBusVariant>().variant().toInt(), 7);
+
+    reply = client->call(qSL("GetAll"), { qL1S(interfaceName) }, propertiesInterface);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QVariantMap all = qdbus_cast<QVariantMap>(reply.arguments().value(0));
+    QCOMPARE(all.size(), 2);
+    QCOMPARE(all.value(qSL("value")).toInt(), 7);
+    QCOMPARE(all.value(qSL("text")).toString(), qSL("seven"));
+
+    reply = client->call(qSL("Set"), { qL1S(interfaceName), qSL("value"), QVariant::fromValue(QDBusVariant(8)) },
+                         propertiesInterface);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(m_object.value(), 8);
+
+    reply = client->call(qSL("Get"), { qL1S(interfaceName), qSL("unknown") }, propertiesInterface);
+    QCOMPARE(reply.type(), QDBusMessage::ErrorMessage);
+    QCOMPARE(reply.errorName(), QDBusError::errorString(QDBusError::UnknownProperty));
+}
+
+void tst_ApplicationIPCInterface::sharedMemoryTransport()
+{
+    if (!SharedMemoryRing::isSupported())
+        QSKIP("The shared memory transport is not supported on this platform");
+
+    // the opted-in signal is sent via the D-Bus, until the client asks for the transport
+    emitSamples(false, 10);
+    QTRY_COMPARE(m_streamClient->dbusCount, 10);
+    QVERIFY(m_streamClient->inOrder);
+
+    QStringList inputMembers;
+    QCOMPARE(m_streamClient->openSharedMemoryTransport(&inputMembers), QStringList(qSL("sample")));
+    QCOMPARE(inputMembers, QStringList({ qSL("feed"), qSL("gain") }));
+    m_sharedMemoryOpened = true;
+
+    // a burst that does not fit into the ring buffer at once has to arrive completely and in order
+    static const int burst = 80000;
+    m_streamClient->reset();
+    emitSamples(false, burst);
+    QTRY_COMPARE_WITH_TIMEOUT(m_streamClient->sharedMemoryCount, burst, 30000);
+    QCOMPARE(m_streamClient->dbusCount, 0);
+    QVERIFY(m_streamClient->inOrder);
+
+    // the other signal is not affected
+    m_streamClient->reset();
+    emitSamples(true, 10);
+    QTRY_COMPARE(m_streamClient->dbusCount, 10);
+    QCOMPARE(m_streamClient->sharedMemoryCount, 0);
+    QVERIFY(m_streamClient->inOrder);
+
+    // the other direction: a burst of calls has to arrive completely and in order, even if
+    // the client has to wait for the server to make room in the ring buffer
+    m_streamObject.reset();
+    for (int serial = 1; serial <= burst; ) {
+        if (m_streamClient->send(0, { serial / 2., serial })) {
+            ++serial;
+        } else {
+            m_streamClient->notify();
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+    }
+    m_streamClient->notify();
+    QTRY_COMPARE_WITH_TIMEOUT(m_streamObject.fedCount, burst, 30000);
+    QVERIFY(m_streamObject.fedInOrder);
+
+    QVERIFY(m_streamClient->send(1, { 0.5 }));
+    m_streamClient->notify();
+    QTRY_COMPARE(m_streamObject.gain(), 0.5);
+
+    // calls with wrong arguments are dropped, without affecting the following ones
+    QVERIFY(m_streamClient->send(0, { qSL("not a number") }));
+    QVERIFY(m_streamClient->send(0, { (burst + 1) / 2., burst + 1 }));
+    m_streamClient->notify();
+    QTRY_COMPARE(m_streamObject.fedCount, burst + 1);
+    QVERIFY(m_streamObject.fedInOrder);
+
+    // only D-Bus compatible types can be sent
+    QVERIFY(SharedMemoryRing::encodeMessage(0, { QPoint(1, 2) }).isNull());
+    QVERIFY(SharedMemoryRing::encodeMessage(0, { QVariantList { QUrl(qSL("file:///")) } }).isNull());
+    QVariantList arguments { true, 1, 2u, qlonglong(-3), qulonglong(4), 5.5, qSL("6"),
+                             QStringList { qSL("7") }, QByteArray("8"),
+                             QVariantList { 9, QVariantMap { { qSL("10"), QVariantList { 11 } } } } };
+    int member;
+    QVariantList decoded;
+    QVERIFY(SharedMemoryRing::decodeMessage(SharedMemoryRing::encodeMessage(1, arguments), &member, &decoded));
+    QCOMPARE(member, 1);
+    QCOMPARE(decoded, arguments);
+
+    // a malformed message closes the transport: the signals are sent via the D-Bus again
+    auto sentViaDBus = [this]() {
+        emitSamples(false, 1);
+        return m_streamClient->dbusCount > 0;
+    };
+    QByteArray truncated = SharedMemoryRing::encodeMessage(0, { 0.5, 1 });
+    truncated.chop(1);
+    QVERIFY(!SharedMemoryRing::decodeMessage(truncated, &member, &decoded));
+    QVERIFY(m_streamClient->sendRaw(truncated));
+    QVERIFY(m_streamClient->send(0, { (burst + 2) / 2., burst + 2 }));
+    m_streamClient->notify();
+    m_streamClient->reset();
+    QTRY_VERIFY(sentViaDBus());
+    QCOMPARE(m_streamObject.fedCount, burst + 1);
+
+    // so do unknown members
+    QCOMPARE(m_streamClient->openSharedMemoryTransport(&inputMembers), QStringList(qSL("sample")));
+    QVERIFY(m_streamClient->send(42, { }));
+    m_streamClient->notify();
+    m_streamClient->reset();
+    QTRY_VERIFY(sentViaDBus());
+
+    // reopen the transport for the benchmarks
+    QCOMPARE(m_streamClient->openSharedMemoryTransport(&inputMembers), QStringList(qSL("sample")));
+}
+
+void tst_ApplicationIPCInterface::benchmarkPropertyChanges()
+{
+    int messages = 0;
+    int iterations = 0;
+
+    QBENCHMARK {
+        for (IpcTestClient *client : qAsConst(m_clients))
+            client->reset();
+
+        // a burst of changes within a single event loop iteration
+        for (int i = 0; i < ChangeCount; ++i)
+            m_object.setValue(m_object.value() + 1);
+
+        QVERIFY(waitForValue(m_object.value()));
+
+        for (IpcTestClient *client : qAsConst(m_clients))
+            messages += client->messageCount;
+        ++iterations;
+    }
+
+    qInfo("%d property changes sent to %d clients resulted in %.1f D-Bus messages per burst",
+          ChangeCount, ClientCount, qreal(messages) / qMax(1, iterations));
+}
+
+void tst_ApplicationIPCInterface::benchmarkMethodCalls()
+{
+    IpcTestClient *client = m_clients.first();
+    const QVariantList args = { 20, 22 };
+
+    QBENCHMARK {
+        QDBusMessage reply = client->call(qSL("add"), args);
+        QCOMPARE(reply.arguments().value(0).toInt(), 42);
+    }
+}
+
+void tst_ApplicationIPCInterface::benchmarkStreaming_data()
+{
+    QTest::addColumn<bool>("viaDBus");
+    QTest::newRow("dbus") << true;
+    QTest::newRow("shared-memory") << false;
+}
+
+void tst_ApplicationIPCInterface::benchmarkStreaming()
+{
+    QFETCH(bool, viaDBus);
+    if (!viaDBus && !m_sharedMemoryOpened)
+        QSKIP("The shared memory transport is not available");
+
+    QBENCHMARK {
+        m_streamClient->reset();
+        emitSamples(viaDBus, ChangeCount);
+        QTRY_COMPARE_WITH_TIMEOUT(m_streamClient->count(), int(ChangeCount), 30000);
+    }
+    QVERIFY(m_streamClient->inOrder);
+}
+
+void tst_ApplicationIPCInterface::benchmarkStreamingLatency_data()
+{
+    benchmarkStreaming_data();
+}
+
+void tst_ApplicationIPCInterface::benchmarkStreamingLatency()
+{
+    QFETCH(bool, viaDBus);
+    if (!viaDBus && !m_sharedMemoryOpened)
+        QSKIP("The shared memory transport is not available");
+
+    // one signal at a time: the time until it is received is the latency of the transport
+    m_streamClient->reset();
+    QBENCHMARK {
+        int serial = m_streamClient->lastSerial + 1;
+        if (viaDBus)
+            emit m_streamObject.dbusSample(serial / 2., serial);
+        else
+            emit m_streamObject.sample(serial / 2., serial);
+        QElapsedTimer timer;
+        timer.start();
+        while ((m_streamClient->lastSerial != serial) && !timer.hasExpired(10000))
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
+        QCOMPARE(m_streamClient->lastSerial, serial);
+    }
+    QVERIFY(m_streamClient->inOrder);
+}
+
+QTEST_GUILESS_MAIN(tst_ApplicationIPCInterface)
+
+#include "tst_applicationipcinterface.moc"
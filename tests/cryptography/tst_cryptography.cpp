@@ -30,6 +30,7 @@
 #include <QtTest>
 
 #include "cryptography.h"
+#include "digest.h"
 
 QT_USE_NAMESPACE_AM
 
@@ -42,6 +43,10 @@ public:
 
 private slots:
     void random();
+    void sha256Digest_data();
+    void sha256Digest();
+    void benchmarkSha256Digest_data();
+    void benchmarkSha256Digest();
 };
 
 tst_Cryptography::tst_Cryptography()
@@ -55,6 +60,86 @@ void tst_Cryptography::random()
     QCOMPARE(Cryptography::generateRandomBytes(128).size(), 128);
 }
 
+void tst_Cryptography::sha256Digest_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QByteArray>("expected");
+
+    // test vectors from FIPS 180-2
+    QTest::newRow("empty") << QByteArray()
+                           << QByteArray("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    QTest::newRow("abc") << QByteArray("abc")
+                         << QByteArray("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    QTest::newRow("448bit") << QByteArray("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+                            << QByteArray("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    QTest::newRow("million-a") << QByteArray(1000000, 'a')
+                               << QByteArray("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+void tst_Cryptography::sha256Digest()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QByteArray, expected);
+
+    QCOMPARE(Sha256Digest::hash(data).toHex(), expected);
+
+    // feed the data in odd chunk sizes, plus check that result() does not finalize the digest
+    Sha256Digest digest;
+    QCryptographicHash reference(QCryptographicHash::Sha256);
+    for (int pos = 0, chunk = 1; pos < data.size(); pos += chunk, chunk = chunk * 3 + 1) {
+        QByteArray part = data.mid(pos, chunk);
+        digest.addData(part);
+        reference.addData(part);
+        QCOMPARE(digest.result(), reference.result());
+    }
+    QCOMPARE(digest.result().toHex(), expected);
+
+    digest.reset();
+    digest.addData(data);
+    QCOMPARE(digest.result().toHex(), expected);
+}
+
+void tst_Cryptography::benchmarkSha256Digest_data()
+{
+    QTest::addColumn<bool>("useQt");
+
+    QTest::newRow("Sha256Digest") << false;
+    QTest::newRow("QCryptographicHash") << true;
+}
+
+void tst_Cryptography::benchmarkSha256Digest()
+{
+    // This only runs on request: the amount of data to hash in MB has to be set via the
+    // environment (e.g. AM_BENCHMARK_DIGEST_SIZE=64).
+    if (!qEnvironmentVariableIsSet("AM_BENCHMARK_DIGEST_SIZE"))
+        QSKIP("Set AM_BENCHMARK_DIGEST_SIZE to the amount of data in MB to run this benchmark");
+    const int chunks = qEnvironmentVariableIntValue("AM_BENCHMARK_DIGEST_SIZE");
+    QVERIFY(chunks > 0);
+
+    QFETCH(bool, useQt);
+
+    // the package extractor hashes the data in chunks of this size
+    QByteArray chunk(1024 * 1024, Qt::Uninitialized);
+    for (int i = 0; i < chunk.size(); ++i)
+        chunk[i] = char(i * 7 + (i >> 8));
+
+    QByteArray result;
+    QBENCHMARK {
+        if (useQt) {
+            QCryptographicHash digest(QCryptographicHash::Sha256);
+            for (int i = 0; i < chunks; ++i)
+                digest.addData(chunk);
+            result = digest.result();
+        } else {
+            Sha256Digest digest;
+            for (int i = 0; i < chunks; ++i)
+                digest.addData(chunk);
+            result = digest.result();
+        }
+    }
+    QCOMPARE(result.size(), 32);
+}
+
 QTEST_APPLESS_MAIN(tst_Cryptography)
 
 #include "tst_cryptography.moc"
@@ -143,6 +143,9 @@ info "Create a package with an invalid id header field"
 mv "$src"/--PACKAGE-HEADER--{,.orig}
 sed <"$src/--PACKAGE-HEADER--.orig" >"$src/--PACKAGE-HEADER--" "s/applicationId: '[a-z0-9.-]*'/applicationId: ':invalid'/"
 tar -C "$src" -cf "$dst/test-invalid-header-id.appkg" -- --PACKAGE-HEADER-- info.yaml icon.png test --PACKAGE-FOOTER--
+mkdir "$src/subdir"
+tar -C "$src" -cf "$dst/test-invalid-header-id-with-dir.appkg" -- --PACKAGE-HEADER-- subdir/ info.yaml icon.png test --PACKAGE-FOOTER--
+rmdir "$src/subdir"
 mv "$src"/--PACKAGE-HEADER--{.orig,}
 
 info "Create a package with an non-matching id header field"
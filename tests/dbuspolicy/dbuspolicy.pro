@@ -0,0 +1,11 @@
+TARGET = tst_dbuspolicy
+
+include($$PWD/../tests.pri)
+
+QT *= dbus
+QT *= \
+    appman_common-private \
+    appman_manager-private \
+    appman_dbus-private \
+
+SOURCES += tst_dbuspolicy.cpp
@@ -0,0 +1,174 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <QtCore>
+#include <QtTest>
+#include <QDBusAbstractAdaptor>
+
+#include "global.h"
+#include "dbuspolicy.h"
+#include "dbuspolicy_p.h"
+
+QT_USE_NAMESPACE_AM
+
+class TestAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "io.qt.test.policy")
+
+public:
+    TestAdaptor(QObject *parent)
+        : QDBusAbstractAdaptor(parent)
+    { }
+
+public slots:
+    void protectedFunction() { }
+};
+
+class tst_DBusPolicy : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_DBusPolicy() { }
+
+private slots:
+    void cleanup();
+    void add();
+    void uids();
+    void executables();
+    void credentialCache();
+
+private:
+    static DBusCredentials credentials(uint uid, const QString &executable = QString(),
+                                       const QString &applicationId = QString(),
+                                       const QStringList &capabilities = QStringList());
+};
+
+// pre-resolved credentials, so no ApplicationManager and no /proc access is needed
+DBusCredentials tst_DBusPolicy::credentials(uint uid, const QString &executable,
+                                            const QString &applicationId, const QStringList &capabilities)
+{
+    DBusCredentials creds;
+    creds.pid = 42;
+    creds.uid = uid;
+    creds.executableResolved = true;
+    creds.executable = executable;
+    creds.applicationResolved = true;
+    creds.applicationId = applicationId;
+    creds.capabilities = capabilities;
+    creds.capabilities.sort();
+    return creds;
+}
+
+void tst_DBusPolicy::cleanup()
+{
+    DBusCredentialCache::clear();
+}
+
+void tst_DBusPolicy::add()
+{
+    QObject object;
+    TestAdaptor *adaptor = new TestAdaptor(&object);
+
+    QVariantMap policy { { qSL("protectedFunction"), QVariantMap { { qSL("uids"), QVariantList { 0 } } } } };
+    QVERIFY(DBusPolicy::add(adaptor, policy));
+
+    policy.insert(qSL("unknownFunction"), QVariantMap());
+    QVERIFY(!DBusPolicy::add(adaptor, policy));
+
+    // not called via D-Bus
+    QVERIFY(!DBusPolicy::check(adaptor, "protectedFunction"));
+}
+
+void tst_DBusPolicy::uids()
+{
+    DBusPolicyEntry entry;
+    entry.m_uids = { 0, 1000 };
+
+    DBusCredentials creds = credentials(0);
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), "uid blocked");
+    creds = credentials(1000);
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), "uid blocked");
+    creds = credentials(1001);
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), static_cast<const char *>(nullptr));
+}
+
+void tst_DBusPolicy::executables()
+{
+    DBusPolicyEntry entry;
+    entry.m_executables = QStringList { qSL("/usr/bin/appstore"), qSL("/usr/bin/browser") };
+
+    DBusCredentials creds = credentials(1000, qSL("/usr/bin/appstore"));
+#if defined(Q_OS_LINUX)
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), "executable blocked");
+    creds = credentials(1000, qSL("/usr/bin/other"));
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), static_cast<const char *>(nullptr));
+    creds = credentials(1000);
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), "cannot get executable");
+#else
+    QCOMPARE(checkDBusPolicyEntry(entry, &creds), "executable checks are not supported on this platform");
+#endif
+}
+
+void tst_DBusPolicy::credentialCache()
+{
+    const QString bus = qSL("bus");
+
+    QVERIFY(!DBusCredentialCache::find(bus, qSL(":1.1")));
+    DBusCredentialCache::insert(bus, qSL(":1.1"), credentials(1000, QString(), qSL("app1"), { qSL("cap") }));
+    DBusCredentialCache::insert(bus, qSL(":1.2"), credentials(1001, QString(), qSL("app2"), { qSL("cap") }));
+
+    DBusCredentials *creds1 = DBusCredentialCache::find(bus, qSL(":1.1"));
+    QVERIFY(creds1);
+    QCOMPARE(creds1->uid, 1000u);
+    QVERIFY(!DBusCredentialCache::find(qSL("otherbus"), qSL(":1.1")));
+
+    // an update or removal of app1 must not leave its old identity and capabilities behind
+    DBusCredentialCache::invalidateApplication(qSL("app1"));
+    creds1 = DBusCredentialCache::find(bus, qSL(":1.1"));
+    QVERIFY(creds1);
+    QVERIFY(!creds1->applicationResolved);
+    QVERIFY(creds1->applicationId.isEmpty());
+    QVERIFY(creds1->capabilities.isEmpty());
+    QCOMPARE(creds1->uid, 1000u);
+
+    DBusCredentials *creds2 = DBusCredentialCache::find(bus, qSL(":1.2"));
+    QVERIFY(creds2);
+    QVERIFY(creds2->applicationResolved);
+    QCOMPARE(creds2->capabilities, QStringList { qSL("cap") });
+
+    // the peer vanished from the bus
+    DBusCredentialCache::removePeer(bus, qSL(":1.2"));
+    QVERIFY(!DBusCredentialCache::find(bus, qSL(":1.2")));
+    QVERIFY(DBusCredentialCache::find(bus, qSL(":1.1")));
+}
+
+QTEST_GUILESS_MAIN(tst_DBusPolicy)
+
+#include "tst_dbuspolicy.moc"
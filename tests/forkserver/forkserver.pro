@@ -0,0 +1,13 @@
+TARGET = tst_forkserver
+
+include($$PWD/../tests.pri)
+
+QT *= \
+    appman_common-private \
+    appman_manager-private \
+
+# the test binary acts as its own fork-server
+INCLUDEPATH += ../../src/launchers/qml
+SOURCES += ../../src/launchers/qml/launcherforkserver.cpp
+
+SOURCES += tst_forkserver.cpp
@@ -0,0 +1,281 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtCore>
+#include <QtTest>
+
+#include "global.h"
+#include "forkserverprotocol.h"
+#include "forkserver.h"
+#include "utilities.h"
+#include "launcherforkserver.h"
+
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+QT_USE_NAMESPACE_AM
+
+static const char ForkedChildVariable[] = "AM_TEST_FORKED_CHILD";
+
+class tst_ForkServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_ForkServer();
+
+private slots:
+    void protocolRoundTrip();
+    void protocolErrors();
+    void spawnAndExit();
+    void spawnAndCrash();
+    void terminate();
+    void environmentChange();
+
+private:
+    struct Result
+    {
+        int startedCount = 0;
+        int finishedCount = 0;
+        int exitCode = -1;
+        QProcess::ExitStatus exitStatus = QProcess::NormalExit;
+    };
+
+    ForkServerProcess *spawn(const QString &command, Result *result, int stdoutFd = -1);
+
+    QTemporaryDir m_workingDirectory;
+};
+
+tst_ForkServer::tst_ForkServer()
+{ }
+
+void tst_ForkServer::protocolRoundTrip()
+{
+    int amSocket, serverSocket;
+    QVERIFY(ForkServerProtocol::createSocketPair(&amSocket, &serverSocket));
+
+    int pipeFds[2];
+    QVERIFY(::pipe2(pipeFds, O_CLOEXEC) == 0);
+
+    // a message with a file descriptor, which has to arrive as a new, working fd
+    const QByteArray sent(64 * 1024, 'x');
+    QVERIFY(ForkServerProtocol::sendMessage(amSocket, sent, { pipeFds[1] }));
+    ::close(pipeFds[1]);
+
+    QByteArray received;
+    QVector<int> fds;
+    QVERIFY(ForkServerProtocol::receiveMessage(serverSocket, &received, &fds));
+    QCOMPARE(received, sent);
+    QCOMPARE(fds.size(), 1);
+    QVERIFY(::fcntl(fds.at(0), F_GETFD) & FD_CLOEXEC);
+
+    QCOMPARE(::write(fds.at(0), "ok", 2), ssize_t(2));
+    ::close(fds.at(0));
+    char buffer[2];
+    QCOMPARE(::read(pipeFds[0], buffer, 2), ssize_t(2));
+    QCOMPARE(QByteArray(buffer, 2), QByteArray("ok"));
+    ::close(pipeFds[0]);
+
+    // the other direction, without file descriptors
+    QVERIFY(ForkServerProtocol::sendMessage(serverSocket, "reply"));
+    QVERIFY(ForkServerProtocol::receiveMessage(amSocket, &received, &fds, true));
+    QCOMPARE(received, QByteArray("reply"));
+    QVERIFY(fds.isEmpty());
+
+    ::close(amSocket);
+    ::close(serverSocket);
+}
+
+void tst_ForkServer::protocolErrors()
+{
+    int amSocket, serverSocket;
+    QVERIFY(ForkServerProtocol::createSocketPair(&amSocket, &serverSocket));
+
+    QByteArray received;
+    QVector<int> fds;
+
+    // nothing to read
+    QVERIFY(!ForkServerProtocol::receiveMessage(serverSocket, &received, &fds, true));
+    QVERIFY(errno == EAGAIN || errno == EWOULDBLOCK);
+
+    // too big or too many file descriptors
+    QVERIFY(!ForkServerProtocol::sendMessage(amSocket, QByteArray(ForkServerProtocol::MaximumMessageSize + 1, 'x')));
+    QCOMPARE(errno, EMSGSIZE);
+    QVERIFY(!ForkServerProtocol::sendMessage(amSocket, "fds", { 0, 1, 2, 0 }));
+    QCOMPARE(errno, EMSGSIZE);
+
+    // EOF
+    ::close(amSocket);
+    QVERIFY(!ForkServerProtocol::receiveMessage(serverSocket, &received, &fds));
+    QCOMPARE(errno, 0);
+    QVERIFY(received.isEmpty());
+    ::close(serverSocket);
+}
+
+ForkServerProcess *tst_ForkServer::spawn(const QString &command, Result *result, int stdoutFd)
+{
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert(qL1S(ForkedChildVariable), qSL("1"));
+
+    ForkServer *server = ForkServer::instance(QCoreApplication::applicationFilePath());
+    ForkServerProcess *process = server->spawn({ command }, env, m_workingDirectory.path(),
+                                               { -1, stdoutFd, -1 });
+    connect(process, &AbstractContainerProcess::started, this, [result]() { ++result->startedCount; });
+    connect(process, &AbstractContainerProcess::finished,
+            this, [result](int exitCode, QProcess::ExitStatus exitStatus) {
+        ++result->finishedCount;
+        result->exitCode = exitCode;
+        result->exitStatus = exitStatus;
+    });
+    return process;
+}
+
+void tst_ForkServer::spawnAndExit()
+{
+    QVERIFY(m_workingDirectory.isValid());
+
+    int pipeFds[2];
+    QVERIFY(::pipe2(pipeFds, O_CLOEXEC) == 0);
+
+    // the fork-server takes ownership of the redirected fd
+    Result result;
+    QScopedPointer<ForkServerProcess> process(spawn(qSL("42"), &result, pipeFds[1]));
+    QCOMPARE(process->state(), QProcess::Starting);
+
+    // processId() has to find the reply without dispatching it: the state only changes and
+    // the signals are only emitted from the event loop
+    qint64 pid = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (!(pid = process->processId()) && !timer.hasExpired(10000))
+        QThread::msleep(10);
+    QVERIFY(pid > 0);
+    QCOMPARE(process->state(), QProcess::Starting);
+    QCOMPARE(result.startedCount, 0);
+
+    QTRY_COMPARE(result.startedCount, 1);
+    QCOMPARE(process->state(), QProcess::Running);
+    QCOMPARE(process->processId(), pid);
+
+    QTRY_COMPARE_WITH_TIMEOUT(result.finishedCount, 1, 10000);
+    QCOMPARE(result.exitCode, 42);
+    QCOMPARE(result.exitStatus, QProcess::NormalExit);
+    QCOMPARE(process->state(), QProcess::NotRunning);
+
+    // the child reported its working directory via the redirected stdout
+    QFile output;
+    QVERIFY(output.open(pipeFds[0], QIODevice::ReadOnly, QFile::AutoCloseHandle));
+    QCOMPARE(QString::fromLocal8Bit(output.readAll()), QDir(m_workingDirectory.path()).canonicalPath());
+}
+
+void tst_ForkServer::spawnAndCrash()
+{
+    Result result;
+    QScopedPointer<ForkServerProcess> process(spawn(qSL("crash"), &result));
+
+    QTRY_COMPARE_WITH_TIMEOUT(result.finishedCount, 1, 10000);
+    QCOMPARE(result.startedCount, 1);
+    QCOMPARE(result.exitCode, int(SIGKILL));
+    QCOMPARE(result.exitStatus, QProcess::CrashExit);
+}
+
+void tst_ForkServer::terminate()
+{
+    Result result;
+    QScopedPointer<ForkServerProcess> process(spawn(qSL("sleep"), &result));
+
+    // a request before the pid is known has to be delivered as well
+    process->terminate();
+
+    QTRY_COMPARE_WITH_TIMEOUT(result.finishedCount, 1, 10000);
+    QCOMPARE(result.startedCount, 1);
+    QCOMPARE(result.exitCode, int(SIGTERM));
+    QCOMPARE(result.exitStatus, QProcess::CrashExit);
+}
+
+void tst_ForkServer::environmentChange()
+{
+    Result oldResult;
+    QScopedPointer<ForkServerProcess> oldProcess(spawn(qSL("sleep"), &oldResult));
+    QPointer<ForkServer> oldServer = ForkServer::instance(QCoreApplication::applicationFilePath());
+    QTRY_COMPARE_WITH_TIMEOUT(oldResult.startedCount, 1, 10000);
+
+    // the next request needs a new fork-server, but the old one has to stay alive for its child
+    QVERIFY(setProcessEnvironmentVariable("AM_TEST_ENVIRONMENT_CHANGE", "1"));
+    Result newResult;
+    QScopedPointer<ForkServerProcess> newProcess(spawn(qSL("crash"), &newResult));
+    QVERIFY(ForkServer::instance(QCoreApplication::applicationFilePath()) != oldServer);
+
+    QTRY_COMPARE_WITH_TIMEOUT(newResult.finishedCount, 1, 10000);
+    QCOMPARE(newResult.startedCount, 1);
+    QCOMPARE(newResult.exitCode, int(SIGKILL));
+    QVERIFY(oldServer);
+    QCOMPARE(oldProcess->state(), QProcess::Running);
+
+    // the retired fork-server goes away after its last child
+    oldProcess->terminate();
+    QTRY_COMPARE_WITH_TIMEOUT(oldResult.finishedCount, 1, 10000);
+    QCOMPARE(oldResult.exitCode, int(SIGTERM));
+    QTRY_VERIFY(oldServer.isNull());
+}
+
+// the forked children end up here: the first argument tells them what to do
+static int forkedChild(int argc, char *argv[])
+{
+    const QByteArray command = (argc > 1) ? QByteArray(argv[1]) : QByteArray();
+    if (command == "crash") {
+        ::raise(SIGKILL);
+    } else if (command == "sleep") {
+        forever
+            ::pause();
+    }
+
+    const QByteArray cwd = QFile::encodeName(QDir::currentPath());
+    if (::write(STDOUT_FILENO, cwd.constData(), size_t(cwd.size())) != cwd.size())
+        return 1;
+    return command.toInt();
+}
+
+int main(int argc, char *argv[])
+{
+    // the ForkServer started by this test runs this binary as its fork-server: only the children
+    // return from this call
+    LauncherForkServer::runIfRequested(argc, argv, nullptr);
+    if (qEnvironmentVariableIsSet(ForkedChildVariable))
+        return forkedChild(argc, argv);
+
+    QCoreApplication app(argc, argv);
+    tst_ForkServer tc;
+    QTEST_SET_MAIN_SOURCE_PATH
+    return QTest::qExec(&tc, argc, argv);
+}
+
+#include "tst_forkserver.moc"
@@ -29,6 +29,7 @@
 #include <QtTest>
 #include <QtNetwork>
 #include <QTemporaryDir>
+#include <QStorageInfo>
 #include <qplatformdefs.h>
 
 #if defined(Q_OS_UNIX)
@@ -39,8 +40,10 @@
 
 #include "global.h"
 #include "packageextractor.h"
+#include "packagecreator.h"
 #include "installationreport.h"
 #include "package.h"
+#include "package_p.h"
 
 #include "../error-checking.h"
 
@@ -63,9 +66,22 @@ private slots:
 
     void cancelExtraction();
 
+    void changeDestination();
+
     void extractFromFifo();
 
+    void compression_data();
+    void compression();
+
+    void benchmarkExtraction();
+
+    void benchmarkCompression_data();
+    void benchmarkCompression();
+
 private:
+    void repackage(const QString &path, const QString &compression, QFile *package,
+                   InstallationReport *report);
+
     QString m_taest;
     QScopedPointer<QTemporaryDir> m_extractDir;
 };
@@ -148,6 +164,9 @@ void tst_PackageExtractor::extractAndVerify_data()
     QTest::newRow("invalid-path")   << "packages/test-invalid-path.appkg"
                                     << false << "~invalid archive entry .*: pointing outside of extraction directory"
                                     << noEntries << noContent << noSizes;
+    QTest::newRow("invalid-header") << "packages/test-invalid-header-id-with-dir.appkg"
+                                    << false << "~metadata has an invalid applicationId field .*"
+                                    << noEntries << noContent << noSizes;
 }
 
 void tst_PackageExtractor::extractAndVerify()
@@ -174,6 +193,10 @@ void tst_PackageExtractor::extractAndVerify()
         QVERIFY(!extractor.wasCanceled());
 
         AM_CHECK_ERRORSTRING(extractor.errorString(), errorString);
+
+        // nothing should be created for packages with an invalid header
+        if (!qstrcmp(QTest::currentDataTag(), "invalid-header"))
+            QVERIFY(QDir(m_extractDir->path()).entryList(QDir::NoDotAndDotDot | QDir::AllEntries).isEmpty());
         return;
     }
 
@@ -232,6 +255,34 @@ void tst_PackageExtractor::cancelExtraction()
     }
 }
 
+void tst_PackageExtractor::changeDestination()
+{
+    // the same thing that the InstallationTask does after the first two files
+    QTemporaryDir otherDir;
+    QVERIFY(otherDir.isValid());
+
+    PackageExtractor extractor(QUrl::fromLocalFile(qL1S(AM_TESTDATA_DIR "packages/test.appkg")), m_extractDir->path());
+    QStringList callbackEntries;
+    extractor.setFileExtractedCallback([&extractor, &otherDir, &callbackEntries](const QString &entry) {
+        callbackEntries << entry;
+        if (callbackEntries.size() == 2) {
+            extractor.setDestinationDirectory(QDir(otherDir.path()));
+            extractor.setFileExtractedCallback(nullptr);
+        }
+    });
+    QVERIFY2(extractor.extract(), qPrintable(extractor.errorString()));
+
+    QCOMPARE(callbackEntries, QStringList({ qSL("info.yaml"), qSL("icon.png") }));
+    QCOMPARE(extractor.destinationDirectory().absolutePath(), QDir(otherDir.path()).absolutePath());
+
+    QDir firstDir(m_extractDir->path());
+    QDir secondDir(otherDir.path());
+    QCOMPARE(firstDir.entryList(QDir::NoDotAndDotDot | QDir::AllEntries, QDir::Name),
+             QStringList({ qSL("icon.png"), qSL("info.yaml") }));
+    QCOMPARE(secondDir.entryList(QDir::NoDotAndDotDot | QDir::AllEntries, QDir::Name),
+             QStringList({ qSL("test"), m_taest }));
+}
+
 class FifoSource : public QThread // clazy:exclude=missing-qobject-macro
 {
 public:
@@ -297,6 +348,150 @@ void tst_PackageExtractor::extractFromFifo()
     QTRY_VERIFY(fifo.isFinished());
 }
 
+// re-packages the test package at path with the requested compression
+void tst_PackageExtractor::repackage(const QString &path, const QString &compression, QFile *package,
+                                     InstallationReport *report)
+{
+    PackageExtractor sourceExtractor(QUrl::fromLocalFile(AM_TESTDATA_DIR + path), m_extractDir->path());
+    QVERIFY2(sourceExtractor.extract(), qPrintable(sourceExtractor.errorString()));
+    *report = sourceExtractor.installationReport();
+
+    PackageCreator creator(QDir(m_extractDir->path()), package, *report);
+    creator.setCompression(compression);
+    QVERIFY2(creator.create(), qPrintable(creator.errorString()));
+    QCOMPARE(creator.metaData().value(qSL("compression"), qSL("gzip")).toString(), compression);
+}
+
+void tst_PackageExtractor::compression_data()
+{
+    QTest::addColumn<QString>("compression");
+
+    for (const char *compression : { "gzip", "xz", "zstd" })
+        QTest::newRow(compression) << compression;
+}
+
+void tst_PackageExtractor::compression()
+{
+    QFETCH(QString, compression);
+
+    if (!PackageUtilities::supportedCompressions().contains(compression))
+        QSKIP(qPrintable(qSL("The %1 compression is not supported by this libarchive build").arg(compression)));
+
+    QTemporaryFile package;
+    QVERIFY(package.open());
+    InstallationReport report;
+    repackage(qSL("packages/test.appkg"), compression, &package, &report);
+    if (QTest::currentTestFailed())
+        return;
+    package.close();
+
+    QTemporaryDir extractDir;
+    PackageExtractor extractor(QUrl::fromLocalFile(package.fileName()), QDir(extractDir.path()));
+    QVERIFY2(extractor.extract(), qPrintable(extractor.errorString()));
+    QCOMPARE(extractor.compression(), compression);
+    QCOMPARE(extractor.installationReport().digest(), report.digest());
+    QCOMPARE(extractor.installationReport().files(), report.files());
+}
+
+void tst_PackageExtractor::benchmarkExtraction()
+{
+    // This generates a big package first, so it only runs on request: the package size in MB
+    // has to be set via the environment (e.g. AM_BENCHMARK_PACKAGE_SIZE=500).
+    if (!qEnvironmentVariableIsSet("AM_BENCHMARK_PACKAGE_SIZE"))
+        QSKIP("Set AM_BENCHMARK_PACKAGE_SIZE to the package size in MB to run this benchmark");
+    qint64 size = qEnvironmentVariableIntValue("AM_BENCHMARK_PACKAGE_SIZE");
+    QVERIFY(size > 0);
+    size *= 1024 * 1024;
+
+    // we need the source file, the package and the extracted file at the same time
+    if (QStorageInfo(QDir::tempPath()).bytesAvailable() < (3 * size))
+        QSKIP("Not enough free disk space for the benchmark package");
+
+    QTemporaryDir sourceDir;
+    QVERIFY(sourceDir.isValid());
+
+    // half random, half repetitive: compresses roughly like typical application binaries
+    QFile bigFile(QDir(sourceDir.path()).absoluteFilePath(qSL("bigfile")));
+    QVERIFY(bigFile.open(QFile::WriteOnly));
+    QByteArray block(1024 * 1024, Qt::Uninitialized);
+    qsrand(42);
+    for (qint64 written = 0; written < size; written += block.size()) {
+        for (int i = 0; i < block.size(); ++i)
+            block[i] = char((i & 0x100) ? qrand() : i);
+        QCOMPARE(bigFile.write(block), qint64(block.size()));
+    }
+    bigFile.close();
+
+    InstallationReport report(qSL("com.pelagicore.test"));
+    report.addFile(qSL("bigfile"));
+    report.setDiskSpaceUsed(quint64(size));
+
+    QTemporaryFile package;
+    QVERIFY(package.open());
+    PackageCreator creator(QDir(sourceDir.path()), &package, report);
+    QVERIFY2(creator.create(), qPrintable(creator.errorString()));
+    package.close();
+    bigFile.remove();
+
+    QElapsedTimer timer;
+    int iterations = 0;
+    timer.start();
+
+    QBENCHMARK {
+        QTemporaryDir extractDir;
+        PackageExtractor extractor(QUrl::fromLocalFile(package.fileName()), QDir(extractDir.path()));
+        QVERIFY2(extractor.extract(), qPrintable(extractor.errorString()));
+        ++iterations;
+    }
+
+    qInfo("Extraction throughput: %.1f MB/s", double(size) * iterations * 1000000000 / timer.nsecsElapsed() / (1024 * 1024));
+}
+
+void tst_PackageExtractor::benchmarkCompression_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<QString>("compression");
+
+    for (const char *compression : { "gzip", "xz", "zstd" }) {
+        for (const char *path : { "packages/test.appkg", "packages/bigtest.appkg" }) {
+            QTest::newRow(qPrintable(qL1S(compression) + qL1C('/') + QFileInfo(qL1S(path)).baseName()))
+                    << path << compression;
+        }
+    }
+}
+
+void tst_PackageExtractor::benchmarkCompression()
+{
+    // this only runs on request, like benchmarkExtraction(): the round-trip itself is covered
+    // by compression()
+    if (!qEnvironmentVariableIsSet("AM_BENCHMARK_COMPRESSION"))
+        QSKIP("Set AM_BENCHMARK_COMPRESSION to run this benchmark");
+
+    QFETCH(QString, path);
+    QFETCH(QString, compression);
+
+    if (!PackageUtilities::supportedCompressions().contains(compression))
+        QSKIP(qPrintable(qSL("The %1 compression is not supported by this libarchive build").arg(compression)));
+
+    QTemporaryFile package;
+    QVERIFY(package.open());
+    InstallationReport report;
+    repackage(path, compression, &package, &report);
+    if (QTest::currentTestFailed())
+        return;
+    package.close();
+
+    QBENCHMARK {
+        QTemporaryDir extractDir;
+        PackageExtractor extractor(QUrl::fromLocalFile(package.fileName()), QDir(extractDir.path()));
+        QVERIFY2(extractor.extract(), qPrintable(extractor.errorString()));
+        QCOMPARE(extractor.compression(), compression);
+        QCOMPARE(extractor.installationReport().digest(), report.digest());
+    }
+
+    qInfo("Package size (%s): %lld bytes", qPrintable(compression), package.size());
+}
+
 int main(int argc, char *argv[])
 {
     Package::ensureCorrectLocale();
@@ -0,0 +1,11 @@
+TARGET = tst_processmonitor
+
+include($$PWD/../tests.pri)
+
+QT *= qml quick
+QT *= \
+    appman_common-private \
+    appman_manager-private \
+    appman_monitor-private \
+
+SOURCES += tst_processmonitor.cpp
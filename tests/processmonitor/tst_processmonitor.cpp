@@ -0,0 +1,178 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtCore>
+#include <QtTest>
+
+#include "global.h"
+#include "sysfsreader.h"
+#include "processmonitor_p.h"
+
+QT_USE_NAMESPACE_AM
+
+class tst_ProcessMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_ProcessMonitor();
+
+private slots:
+    void initTestCase();
+    void smaps();
+    void smapsRollup();
+    void benchmarkSmaps();
+    void benchmarkSmapsRollup();
+
+private:
+    QTemporaryDir m_tmp;
+    QByteArray m_smapsPath;
+    QByteArray m_smapsRollupPath;
+
+    static const int MappingCount = 5000;
+};
+
+tst_ProcessMonitor::tst_ProcessMonitor()
+{ }
+
+void tst_ProcessMonitor::initTestCase()
+{
+    QVERIFY(m_tmp.isValid());
+    m_smapsPath = QFile::encodeName(m_tmp.path() + qSL("/smaps"));
+    m_smapsRollupPath = QFile::encodeName(m_tmp.path() + qSL("/smaps_rollup"));
+
+    // a synthetic smaps file: every 4th mapping is text, every 4th mapping is heap
+    QFile smaps(QString::fromLocal8Bit(m_smapsPath));
+    QVERIFY(smaps.open(QFile::WriteOnly));
+    for (int i = 0; i < MappingCount; ++i) {
+        const char *perms = (i % 4 == 0) ? "r-xp" : ((i % 4 == 1) ? "rw-p" : "r--p");
+        const char *inode = (i % 4 == 1) ? "0       " : "1234    ";
+        const char *name = (i % 4 == 1) ? "" : "/usr/lib/libQt5Quick.so.5.9.0";
+        smaps.write(QByteArray::number(0x400000 + i * 0x4000, 16) + '-'
+                    + QByteArray::number(0x404000 + i * 0x4000, 16) + ' ' + perms
+                    + " 00000000 08:01 " + inode + "                   " + name + '\n');
+        smaps.write("Size:                 16 kB\n"
+                    "Rss:                   8 kB\n"
+                    "Pss:                   4 kB\n"
+                    "Shared_Clean:          4 kB\n"
+                    "Shared_Dirty:          0 kB\n"
+                    "Private_Clean:         4 kB\n"
+                    "Private_Dirty:         0 kB\n"
+                    "Referenced:            8 kB\n"
+                    "Anonymous:             0 kB\n"
+                    "AnonHugePages:         0 kB\n"
+                    "Swap:                  0 kB\n"
+                    "KernelPageSize:        4 kB\n"
+                    "MMUPageSize:           4 kB\n"
+                    "Locked:                0 kB\n"
+                    "LazyFree:              0 kB\n"
+                    "VmFlags: rd ex mr mw me sd \n");
+    }
+    smaps.close();
+
+    QFile rollup(QString::fromLocal8Bit(m_smapsRollupPath));
+    QVERIFY(rollup.open(QFile::WriteOnly));
+    rollup.write("00400000-ffffffffff601000 ---p 00000000 00:00 0                          [rollup]\n"
+                 "Rss:               40000 kB\n"
+                 "Pss:               20000 kB\n"
+                 "Pss_Anon:           5000 kB\n"
+                 "Pss_File:          15000 kB\n"
+                 "Pss_Shmem:             0 kB\n"
+                 "Shared_Clean:      20000 kB\n"
+                 "Shared_Dirty:          0 kB\n"
+                 "Private_Clean:     20000 kB\n"
+                 "Private_Dirty:         0 kB\n"
+                 "Referenced:        40000 kB\n"
+                 "Anonymous:          5000 kB\n"
+                 "LazyFree:              0 kB\n"
+                 "AnonHugePages:         0 kB\n"
+                 "Swap:                  0 kB\n"
+                 "SwapPss:               0 kB\n"
+                 "Locked:                0 kB\n");
+    rollup.close();
+}
+
+void tst_ProcessMonitor::smaps()
+{
+    ReadingTask::Results::Memory mem;
+    QVERIFY(ReadingTask::readSmaps(m_smapsPath, mem));
+
+    QCOMPARE(mem.totalVm, quint32(MappingCount * 16));
+    QCOMPARE(mem.totalRss, quint32(MappingCount * 8));
+    QCOMPARE(mem.totalPss, quint32(MappingCount * 4));
+    QCOMPARE(mem.textVm, quint32(MappingCount / 4 * 16));
+    QCOMPARE(mem.textPss, quint32(MappingCount / 4 * 4));
+    QCOMPARE(mem.heapVm, quint32(MappingCount / 4 * 16));
+    QCOMPARE(mem.heapRss, quint32(MappingCount / 4 * 8));
+}
+
+void tst_ProcessMonitor::smapsRollup()
+{
+    SysFsReader reader(m_smapsRollupPath);
+    QVERIFY(reader.isOpen());
+
+    const char *data = nullptr;
+    int size = reader.readRaw(&data);
+    QVERIFY(size > 0);
+    QVERIFY(data);
+
+    ReadingTask::Results::Memory mem;
+    QVERIFY(ReadingTask::parseSmapsRollup(data, size, mem));
+    QCOMPARE(mem.totalRss, quint32(40000));
+    QCOMPARE(mem.totalPss, quint32(20000));
+    QCOMPARE(mem.textPss, quint32(0));
+    QCOMPARE(mem.heapPss, quint32(0));
+
+    // truncated input
+    ReadingTask::Results::Memory broken;
+    QVERIFY(!ReadingTask::parseSmapsRollup(data, 100, broken));
+}
+
+void tst_ProcessMonitor::benchmarkSmaps()
+{
+    QBENCHMARK {
+        ReadingTask::Results::Memory mem;
+        ReadingTask::readSmaps(m_smapsPath, mem);
+    }
+}
+
+void tst_ProcessMonitor::benchmarkSmapsRollup()
+{
+    SysFsReader reader(m_smapsRollupPath);
+    QBENCHMARK {
+        ReadingTask::Results::Memory mem;
+        const char *data = nullptr;
+        int size = reader.readRaw(&data);
+        ReadingTask::parseSmapsRollup(data, size, mem);
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_ProcessMonitor)
+
+#include "tst_processmonitor.moc"
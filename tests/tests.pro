@@ -6,6 +6,7 @@ SUBDIRS = \
     cryptography \
     signature \
     utilities \
+    yaml \
     installationreport \
     packagecreator \
     packageextractor \
@@ -16,6 +17,14 @@ SUBDIRS = \
 
 linux*:SUBDIRS += \
     sudo \
+    processmonitor \
+    forkserver \
+
+qtHaveModule(dbus):SUBDIRS += \
+    applicationipcinterface \
+
+!disable-external-dbus-interfaces:qtHaveModule(dbus):SUBDIRS += \
+    dbuspolicy \
 
 OTHER_FILES += \
     tests.pri \
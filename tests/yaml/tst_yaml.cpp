@@ -0,0 +1,317 @@
+/****************************************************************************
+**
+** Copyright (C) 2017 Pelagicore AG
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Pelagicore Application Manager.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT-QTAS$
+** Commercial License Usage
+** Licensees holding valid commercial Qt Automotive Suite licenses may use
+** this file in accordance with the commercial license agreement provided
+** with the Software or, alternatively, in accordance with the terms
+** contained in a written agreement between you and The Qt Company.  For
+** licensing terms and conditions see https://www.qt.io/terms-conditions.
+** For further information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <QtCore>
+#include <QtTest>
+
+#include <yaml.h>
+
+#include "global.h"
+#include "qtyaml.h"
+
+QT_USE_NAMESPACE_AM
+
+class tst_Yaml : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Yaml();
+
+private slots:
+    void initTestCase();
+    void parser();
+    void documents();
+    void anchors();
+    void filter();
+    void parseFields();
+    void parseErrors();
+    void benchmark_data();
+    void benchmarkDocumentTree();
+    void benchmarkVariantDocuments();
+    void benchmarkParseFields();
+
+private:
+    QByteArray m_bigConfig;
+};
+
+tst_Yaml::tst_Yaml()
+{ }
+
+void tst_Yaml::initTestCase()
+{
+    // a synthetic, but realistically structured config file with a few thousand values
+    m_bigConfig = "formatVersion: 1\nformatType: am-configuration\n---\n";
+    m_bigConfig += "runtimes:\n";
+    for (int i = 0; i < 200; ++i) {
+        m_bigConfig += "  runtime" + QByteArray::number(i) + ":\n"
+                       "    environmentVariables: { FOO: 'bar', LIMIT: " + QByteArray::number(i * 1024) + " }\n"
+                       "    importPaths: [ '/usr/lib/qml', \"/opt/qml/" + QByteArray::number(i) + "\" ]\n"
+                       "    quicklaunchQml: ${CONFIG_PWD}/quicklaunch.qml\n"
+                       "    enabled: yes\n"
+                       "    ratio: 0.75\n";
+    }
+    m_bigConfig += "applications:\n  builtinAppsManifestDir: /opt/am/apps\n  database: /opt/am/apps.db\n";
+}
+
+void tst_Yaml::parser()
+{
+    const QByteArray yaml =
+            "bool-true: true\n"
+            "bool-yes: yes\n"
+            "bool-false: false\n"
+            "bool-off: off\n"
+            "tilde: ~\n"
+            "empty:\n"
+            "int-dec: 42\n"
+            "int-neg: -42\n"
+            "int-hex: 0x2a\n"
+            "int-oct: 052\n"
+            "int-bin: 0b101010\n"
+            "int-grouped: 1_000\n"
+            "int-64: 4294967296\n"
+            "float: .5\n"
+            "nan: .nan\n"
+            "inf: .inf\n"
+            "string: text\n"
+            "string-quoted: '42'\n"
+            "string-double-quoted: \"yes\"\n"
+            "list: [ 1, two, [ 3 ] ]\n"
+            "map: { a: 1, b: { c: 2 } }\n";
+
+    QtYaml::ParseError error;
+    QVector<QVariant> docs = QtYaml::variantDocumentsFromYaml(yaml, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(docs.size(), 1);
+
+    const QVariantMap map = docs.at(0).toMap();
+    QCOMPARE(map.size(), 21);
+    QCOMPARE(map.value(qSL("bool-true")), QVariant(true));
+    QCOMPARE(map.value(qSL("bool-yes")), QVariant(true));
+    QCOMPARE(map.value(qSL("bool-false")), QVariant(false));
+    QCOMPARE(map.value(qSL("bool-off")), QVariant(false));
+    QVERIFY(map.contains(qSL("tilde")));
+    QVERIFY(!map.value(qSL("tilde")).isValid());
+    QVERIFY(!map.value(qSL("empty")).isValid());
+    QCOMPARE(map.value(qSL("int-dec")), QVariant(42));
+    QCOMPARE(map.value(qSL("int-neg")), QVariant(-42));
+    QCOMPARE(map.value(qSL("int-hex")), QVariant(42));
+    QCOMPARE(map.value(qSL("int-oct")), QVariant(42));
+    QCOMPARE(map.value(qSL("int-bin")), QVariant(42));
+    QCOMPARE(map.value(qSL("int-grouped")), QVariant(1000));
+    QCOMPARE(map.value(qSL("int-64")), QVariant(qint64(4294967296LL)));
+    QCOMPARE(map.value(qSL("float")), QVariant(0.5));
+    QVERIFY(qIsNaN(map.value(qSL("nan")).toDouble()));
+    QVERIFY(qIsInf(map.value(qSL("inf")).toDouble()));
+    QCOMPARE(map.value(qSL("string")), QVariant(qSL("text")));
+    QCOMPARE(map.value(qSL("string-quoted")), QVariant(qSL("42")));
+    QCOMPARE(map.value(qSL("string-double-quoted")), QVariant(qSL("yes")));
+    QCOMPARE(map.value(qSL("list")), QVariant(QVariantList { 1, qSL("two"), QVariantList { 3 } }));
+    QCOMPARE(map.value(qSL("map")), QVariant(QVariantMap { { qSL("a"), 1 },
+                                                           { qSL("b"), QVariantMap { { qSL("c"), 2 } } } }));
+}
+
+void tst_Yaml::documents()
+{
+    QtYaml::ParseError error;
+    QVector<QVariant> docs = QtYaml::variantDocumentsFromYaml("a: 1\n---\n- 2\n---\nthree\n", &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(docs.size(), 3);
+    QCOMPARE(docs.at(0), QVariant(QVariantMap { { qSL("a"), 1 } }));
+    QCOMPARE(docs.at(1), QVariant(QVariantList { 2 }));
+    QCOMPARE(docs.at(2), QVariant(qSL("three")));
+
+    docs = QtYaml::variantDocumentsFromYaml(QByteArray(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(docs.isEmpty());
+
+    // documents that are not consumed are skipped
+    QtYaml::YamlParser p("a: [ 1, { b: 2 } ]\n---\nc: 3\n");
+    QVERIFY(p.nextDocument());
+    QVERIFY(p.isMap());
+    QVERIFY(p.nextDocument());
+    QCOMPARE(p.parseMap(), (QVariantMap { { qSL("c"), 3 } }));
+    QVERIFY(!p.nextDocument());
+}
+
+void tst_Yaml::anchors()
+{
+    QVector<QVariant> docs = QtYaml::variantDocumentsFromYaml("base: &b { x: 1 }\nref: *b\nscalar: &s foo\nlist: [ *s, *s ]\n");
+    QCOMPARE(docs.size(), 1);
+    const QVariantMap map = docs.at(0).toMap();
+    QCOMPARE(map.value(qSL("ref")), map.value(qSL("base")));
+    QCOMPARE(map.value(qSL("list")), QVariant(QVariantList { qSL("foo"), qSL("foo") }));
+}
+
+void tst_Yaml::filter()
+{
+    auto replace = [](const QVariant &v) -> QVariant {
+        if (v.type() == QVariant::String && v.toString().startsWith(qSL("${CONFIG_PWD}")))
+            return QVariant(qSL("/config") + v.toString().mid(13));
+        return v;
+    };
+    QVector<QVariant> docs = QtYaml::variantDocumentsFromYamlFiltered("a: ${CONFIG_PWD}/x\nb: [ ${CONFIG_PWD} ]\n", replace);
+    QCOMPARE(docs.size(), 1);
+    QCOMPARE(docs.at(0), QVariant(QVariantMap { { qSL("a"), qSL("/config/x") },
+                                                { qSL("b"), QVariantList { qSL("/config") } } }));
+}
+
+void tst_Yaml::parseFields()
+{
+    struct Runtime {
+        QString name;
+        QStringList importPaths;
+        bool enabled = false;
+    };
+    QVector<Runtime> runtimes;
+    int unknownFields = 0;
+
+    QtYaml::YamlParser p(m_bigConfig);
+    QVERIFY(p.nextDocument());
+    p.skipValue(); // header
+    QVERIFY(p.nextDocument());
+
+    p.parseFields([&runtimes, &unknownFields](QtYaml::YamlParser *parser, const QString &key) {
+        if (key == qL1S("runtimes")) {
+            parser->parseFields([&runtimes](QtYaml::YamlParser *parser, const QString &name) {
+                Runtime rt;
+                rt.name = name;
+                parser->parseFields([&rt](QtYaml::YamlParser *parser, const QString &key) {
+                    if (key == qL1S("importPaths")) {
+                        const QVariantList importPaths = parser->parseList();
+                        for (const QVariant &importPath : importPaths)
+                            rt.importPaths << importPath.toString();
+                    } else if (key == qL1S("enabled")) {
+                        rt.enabled = parser->parseScalar().toBool();
+                    }
+                    // everything else is skipped automatically
+                });
+                runtimes << rt;
+            });
+        } else {
+            ++unknownFields;
+        }
+    });
+    QVERIFY(!p.nextDocument());
+
+    QCOMPARE(runtimes.size(), 200);
+    QCOMPARE(runtimes.at(10).name, qSL("runtime10"));
+    QVERIFY(runtimes.at(10).enabled);
+    QCOMPARE(runtimes.at(10).importPaths, QStringList({ qSL("/usr/lib/qml"), qSL("/opt/qml/10") }));
+    QCOMPARE(unknownFields, 1);
+}
+
+void tst_Yaml::parseErrors()
+{
+    QtYaml::ParseError error;
+    QVector<QVariant> docs = QtYaml::variantDocumentsFromYaml("a: 1\n---\nb: [ 1, 2\nc: 3\n", &error);
+    QVERIFY(error.error != QJsonParseError::NoError);
+    QVERIFY(error.line >= 2);
+    QVERIFY(!error.errorString().isEmpty());
+    QCOMPARE(docs.size(), 1); // the documents before the error are still returned
+
+    docs = QtYaml::variantDocumentsFromYaml("a: *unknown\n", &error);
+    QVERIFY(error.error != QJsonParseError::NoError);
+    QVERIFY(docs.isEmpty());
+
+    QtYaml::YamlParser p("- 1\n");
+    QVERIFY(p.nextDocument());
+    try {
+        p.parseMap();
+        QFAIL("parseMap() on a list did not throw");
+    } catch (const QtYaml::ParseError &e) {
+        QCOMPARE(e.line, 1);
+    }
+}
+
+void tst_Yaml::benchmark_data()
+{
+    QTest::addColumn<QByteArray>("yaml");
+
+    QFile f(qL1S(AM_TESTDATA_DIR "info-big.yaml"));
+    QVERIFY(f.open(QFile::ReadOnly));
+    QTest::newRow("info-big.yaml") << f.readAll();
+    QTest::newRow("big-config") << m_bigConfig;
+}
+
+void tst_Yaml::benchmarkDocumentTree()
+{
+    // reference: only building libyaml's document tree, without any conversion to QVariant -
+    // this is the work the old parser had to do before even starting with the conversion
+    QFETCH(QByteArray, yaml);
+
+    QBENCHMARK {
+        yaml_parser_t p;
+        QVERIFY(yaml_parser_initialize(&p));
+        yaml_parser_set_input_string(&p, reinterpret_cast<const uchar *>(yaml.constData()), size_t(yaml.size()));
+
+        yaml_document_t doc;
+        yaml_node_t *root;
+        do {
+            QVERIFY(yaml_parser_load(&p, &doc));
+            root = yaml_document_get_root_node(&doc);
+            yaml_document_delete(&doc);
+        } while (root);
+
+        yaml_parser_delete(&p);
+    }
+}
+
+void tst_Yaml::benchmarkVariantDocuments()
+{
+    QFETCH(QByteArray, yaml);
+
+    QBENCHMARK {
+        QtYaml::ParseError error;
+        QVector<QVariant> docs = QtYaml::variantDocumentsFromYaml(yaml, &error);
+        QCOMPARE(docs.size(), 2);
+    }
+}
+
+void tst_Yaml::benchmarkParseFields()
+{
+    QFETCH(QByteArray, yaml);
+
+    QBENCHMARK {
+        int fields = 0;
+        QtYaml::YamlParser p(yaml);
+        QVERIFY(p.nextDocument());
+        p.skipValue();
+        QVERIFY(p.nextDocument());
+        p.parseFields([&fields](QtYaml::YamlParser *parser, const QString &) {
+            parser->skipValue();
+            ++fields;
+        });
+        QVERIFY(fields > 0);
+    }
+}
+
+QTEST_APPLESS_MAIN(tst_Yaml)
+
+#include "tst_yaml.moc"
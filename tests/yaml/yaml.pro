@@ -0,0 +1,10 @@
+TARGET = tst_yaml
+
+include($$PWD/../tests.pri)
+
+# the document-tree based reference benchmark needs direct access to libyaml
+include($$SOURCE_DIR/3rdparty/libyaml.pri)
+
+QT *= appman_common-private
+
+SOURCES += tst_yaml.cpp